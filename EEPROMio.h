@@ -25,4 +25,16 @@ template <typename T> boolean EEPROMWrite(unsigned int addr, T val, int bytes) {
   return EEPROMWrite(addr, temp, bytes);
 }
 
+#if __SIZEOF_DOUBLE__ != 4  // off-target double is 64 bit; keep the 4 byte AVR layout by storing doubles as float
+inline void EEPROMRead(unsigned int addr, double* val, int bytes) {
+  float temp;
+  EEPROMRead(addr, &temp, bytes);
+  *val = temp;
+}
+
+inline boolean EEPROMWrite(unsigned int addr, double val, int bytes) {
+  return EEPROMWrite(addr, (float)val, bytes);
+}
+#endif
+
 #endif
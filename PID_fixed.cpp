@@ -0,0 +1,232 @@
+#include "PID_fixed.h"
+#include <math.h>
+
+static pidGain toGain(double g) {  // normalise to a 30 bit mantissa
+  pidGain r = { 0, 0 };
+  int ex;
+  if ((g == 0) || !isfinite(g)) return r;
+  frexp(g, &ex);  // 0.5 <= |g| / 2^ex < 1
+  int s = 30 - ex;
+  if (s > 62) return r;  // below the value resolution
+  if (s < 0) s = 0;      // gains of 2^30 and more saturate
+  double m = ldexp(g, s);
+  r.m = (m >= 2147483647.0) ? 2147483647L : ((m <= -2147483647.0) ? -2147483647L : (int32_t)lround(m));
+  r.s = s;
+  return r;
+}
+
+static int64_t apply(const pidGain& g, int64_t x, int8_t extra) {  // g * x with extra fraction bits, saturating
+  int sh = g.s - extra;
+  while ((x > INT32_MAX) || (x < -INT32_MAX)) { x >>= 1; sh--; }  // keep g.m * x inside int64
+  int64_t p = (int64_t)g.m * x;
+  if (sh >= 63) return 0;
+  if (sh > 0) return (p + ((int64_t)1 << (sh - 1))) >> sh;  // round to nearest
+  sh = -sh;
+  if (p > (INT64_MAX >> sh)) return INT64_MAX;
+  if (p < (INT64_MIN >> sh)) return INT64_MIN;
+  return p * ((int64_t)1 << sh);
+}
+
+static int32_t sat32(int64_t v) { return (v > INT32_MAX) ? INT32_MAX : ((v < INT32_MIN) ? INT32_MIN : (int32_t)v); }
+
+static int64_t rescale(int64_t v, int8_t delta) {  // multiply by 2^delta, saturating
+  if (delta >= 0) {
+    if (v > (INT64_MAX >> delta)) return INT64_MAX;
+    if (v < (INT64_MIN >> delta)) return INT64_MIN;
+    return v * ((int64_t)1 << delta);
+  }
+  return v >> -delta;
+}
+
+PIDfixed::PIDfixed(double* Input, double* Output, double* Setpoint, double Kp, double Ki, double Kd, int ControllerDirection) {
+  myOutput = Output;
+  myInput = Input;
+  mySetpoint = Setpoint;
+
+  inAuto = false;
+  isRaw = true;
+  slopeMode = SLOPE_ENDPOINT;
+  History.configure(pidHistoryMax, 10, 0);
+  FilterConstant = 1;
+  frac = 0;
+  PTerm = DTerm = lastOutput = 0;
+  ITerm = 0;
+
+  PIDfixed::SetOutputLimits(0, 255);  // as PID
+  SampleTime = 100;
+  PIDfixed::SetControllerDirection(ControllerDirection);
+  PIDfixed::SetTunings(Kp, Ki, Kd);
+  lastTime = millis()-SampleTime;
+}
+
+bool PIDfixed::Compute() {
+  return Compute(millis());
+}
+
+bool PIDfixed::Compute(unsigned long now) {  // PID::Compute() in integer arithmetic
+  if(!inAuto) return false;
+  unsigned long timeChange = (uint32_t)(now - lastTime);
+  if(timeChange>=SampleTime) {
+    int32_t input = _toFix(*myInput, pidInputFrac);
+    History.sample(input);
+    int32_t error = sat32((int64_t)_toFix(*mySetpoint, pidInputFrac) - input);
+
+    int64_t dI = apply(gi, error, frac + 16 - pidInputFrac);
+    if ((dI > 0) && (ITerm > INT64_MAX - dI)) ITerm = INT64_MAX;
+      else if ((dI < 0) && (ITerm < INT64_MIN - dI)) ITerm = INT64_MIN;
+      else ITerm += dI;
+    if (ITerm > ((int64_t)fixMax * 65536)) ITerm = (int64_t)fixMax * 65536;
+      else if (ITerm < (int64_t)fixMin * 65536) ITerm = (int64_t)fixMin * 65536;
+    PTerm = sat32(apply(gp, error, frac - pidInputFrac));
+    int64_t slope = (slopeMode == SLOPE_REGRESSION) ? History.numerator() : (int64_t)History.newest() - History.oldest();
+    DTerm = sat32(-apply(gd, slope, frac - pidInputFrac));  // the window scaling is in gd
+
+    int64_t output = (int64_t)PTerm + ((ITerm + 32768) >> 16) + DTerm;
+    if (output > fixMax) output = fixMax;
+      else if (output < fixMin) output = fixMin;
+    if (!isRaw) output = lastOutput + apply(gf, output - lastOutput, 0);
+    *myOutput = _toDouble(output, frac);
+
+    lastOutput = output;
+    lastTime = now;
+    return true;
+  }
+  return false;
+}
+
+void PIDfixed::SetTunings(double Kp, double Ki, double Kd) {  // same scaling (and sign handling) as PID
+  if (Kp<0 || Ki<0 || Kd<0) return;
+
+  dispKp = Kp; dispKi = Ki; dispKd = Kd;
+
+  double SampleTimeInSec = ((double)SampleTime)/1000;
+  kp = Kp;
+  ki = Ki * SampleTimeInSec;
+  kd = Kd / SampleTimeInSec;
+
+  if (controllerDirection == REVERSE) {
+    kp = (0 - kp);
+    ki = (0 - ki);
+    kd = (0 - kd);
+  }
+  _scale();
+}
+
+void PIDfixed::SetSampleTime(unsigned long NewSampleTime) {
+  if (NewSampleTime > 0) {
+    double ratio = (double)(NewSampleTime / SampleTime);  // integer ratio, as PID
+    ki *= ratio;
+    kd /= ratio;
+    SampleTime = NewSampleTime;
+    _scale();
+  }
+}
+
+void PIDfixed::SetOutputLimits(double Min, double Max) {
+  if(Min >= Max) return;
+  outMin = Min;
+  outMax = Max;
+
+  double span = max(max(fabs(Min), fabs(Max)), 256.0);
+  int8_t bits = 0;
+  while ((bits < 30) && (ldexp(1.0, bits) <= span)) bits++;
+  _setFrac(30 - bits);  // twice the largest limit fits
+  unit = ldexp(1.0, -frac);
+  fixMin = _toFix(Min, frac);
+  fixMax = _toFix(Max, frac);
+
+  if(inAuto) {
+    if(*myOutput > outMax) *myOutput = outMax;
+      else if(*myOutput < outMin) *myOutput = outMin;
+    if (ITerm > ((int64_t)fixMax * 65536)) ITerm = (int64_t)fixMax * 65536;
+      else if (ITerm < (int64_t)fixMin * 65536) ITerm = (int64_t)fixMin * 65536;
+   }
+}
+
+void PIDfixed::SetMode(int Mode) {
+  bool newAuto = (Mode == AUTOMATIC);
+    if(newAuto == !inAuto) { PIDfixed::Initialize(); }  // re-init on change to auto
+    inAuto = newAuto;
+}
+
+void PIDfixed::setOutputType(int type) {  // change output between RAW and FILTERED (first order)
+  isRaw = (type != FILTERED);
+}
+
+void PIDfixed::setFilterConstant(double constant) {
+  FilterConstant = constant;
+  _scale();
+}
+
+void PIDfixed::setOutput(double output) {  // bumpless: the next Compute() continues from output
+  output = constrain(output, outMin, outMax);
+  int32_t target = _toFix(output, frac);
+  ITerm += ((int64_t)target - _toFix(*myOutput, frac)) * 65536;
+  if (ITerm > ((int64_t)fixMax * 65536)) ITerm = (int64_t)fixMax * 65536;
+    else if (ITerm < (int64_t)fixMin * 65536) ITerm = (int64_t)fixMin * 65536;
+  lastOutput = target;
+  *myOutput = output;
+}
+
+void PIDfixed::Initialize() {
+  PIDfixed::initHistory();
+  ITerm = (int64_t)_toFix(*myOutput, frac) * 65536;
+  if (ITerm > ((int64_t)fixMax * 65536)) ITerm = (int64_t)fixMax * 65536;
+    else if (ITerm < (int64_t)fixMin * 65536) ITerm = (int64_t)fixMin * 65536;
+}
+
+void PIDfixed::initHistory() {
+  History.fill(_toFix(*myInput, pidInputFrac));
+}
+
+void PIDfixed::setHistory(byte length, byte decimation, byte mode) {
+  History.configure(length, decimation, _toFix(*myInput, pidInputFrac));
+  slopeMode = mode;
+  _scale();
+}
+
+void PIDfixed::SetControllerDirection(int Direction) {
+  if(inAuto && Direction !=controllerDirection) {
+    kp = (0 - kp);
+    ki = (0 - ki);
+    kd = (0 - kd);
+    _scale();
+  }
+  controllerDirection = Direction;
+}
+
+void PIDfixed::_scale() {  // derive the integer gains from kp/ki/kd and the filter constant
+  gp = toGain(kp);
+  gi = toGain(ki);
+  double window = (slopeMode == SLOPE_REGRESSION) ? History.scale() : 1.0 / History.length();
+  gd = toGain(kd * window / History.decimation());  // as PID: 300 computes for the default endpoint slope
+  gf = toGain((SampleTime / 1000) / FilterConstant);  // integer seconds, as PID
+}
+
+void PIDfixed::_setFrac(int8_t newFrac) {  // change the value format, converting the state
+  int8_t delta = newFrac - frac;
+  frac = newFrac;
+  if (!delta) return;
+  PTerm = sat32(rescale(PTerm, delta));
+  DTerm = sat32(rescale(DTerm, delta));
+  lastOutput = sat32(rescale(lastOutput, delta));
+  ITerm = rescale(ITerm, delta);
+}
+
+int32_t PIDfixed::_toFix(double v, int8_t f) {
+  v *= (f == pidInputFrac) ? pidInputScale : ldexp(1.0, f);  // the per-sample conversions need no ldexp()
+  if (v >= 2147483647.0) return INT32_MAX;
+  if (v <= -2147483648.0) return INT32_MIN;
+  return (int32_t)(v + (v < 0 ? -0.5 : 0.5));
+}
+
+double PIDfixed::_toDouble(int64_t v, int8_t f) { return (f == frac) ? v * unit : ldexp((double)v, -f); }
+
+double PIDfixed::GetKp() { return  dispKp; }
+double PIDfixed::GetKi() { return  dispKi; }
+double PIDfixed::GetKd() { return  dispKd; }
+double PIDfixed::GetPTerm() { return _toDouble(PTerm, frac); }
+double PIDfixed::GetITerm() { return _toDouble(ITerm, frac + 16); }
+double PIDfixed::GetDTerm() { return _toDouble(DTerm, frac); }
+int PIDfixed::GetMode() { return  inAuto ? AUTOMATIC : MANUAL; }
+int PIDfixed::GetDirection() { return controllerDirection; }
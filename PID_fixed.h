@@ -0,0 +1,85 @@
+#ifndef PID_fixed_h
+#define PID_fixed_h
+
+#include "Arduino.h"
+#include "PID_v1.h"
+
+// fixed point engine with the PID API.  tunings and limits are still given (and kept) as double; the
+// per-sample arithmetic is integer.  input, setpoint and the slope history are int32 with pidInputFrac
+// fraction bits; terms and output are int32 with a number of fraction bits chosen from the output limits
+// (mainPID, 0.3-38 deg C: 21 bits; heatPID, 0-300000 ms: 11 bits).  gains are an int32 mantissa with a
+// binary exponent so that tiny integral gains keep their precision, and the integral term carries 16
+// extra fraction bits in an int64.  only Input, Setpoint and Output are converted from/to double, once
+// each per Compute().
+
+#ifndef PID_FIXED
+#define PID_FIXED false  // true: the sketch's PIDs use the fixed point engine
+#endif
+
+const int8_t pidInputFrac = 20;  // input range +/-2048 (deg C, ADC counts), resolution 1e-6
+const double pidInputScale = 1048576.0;  // 2^pidInputFrac
+
+struct pidGain {  // m * 2^-s
+  int32_t m;
+  int8_t s;
+};
+
+class PIDfixed {
+  public:
+    PIDfixed(double*, double*, double*, double, double, double, int);
+
+    void SetMode(int Mode);
+    bool Compute();
+    bool Compute(unsigned long now);
+    void SetOutputLimits(double, double);
+    void SetTunings(double, double, double);
+    void SetControllerDirection(int);
+    void SetSampleTime(unsigned long);
+    void initHistory();
+    void setHistory(byte, byte, byte);
+    void setOutputType(int);
+    void setFilterConstant(double);
+    void setOutput(double);                // as PID
+
+    double GetKp();
+    double GetKi();
+    double GetKd();
+    double GetPTerm();
+    double GetITerm();
+    double GetDTerm();
+    int GetMode();
+    int GetDirection();
+
+  private:
+    void Initialize();
+    void _scale();                         // derive the integer gains from kp/ki/kd and the filter constant
+    void _setFrac(int8_t frac);            // change the value format, converting the state
+    int32_t _toFix(double v, int8_t f);
+    double _toDouble(int64_t v, int8_t frac);
+
+    double dispKp, dispKi, dispKd;         // as PID
+    double kp, ki, kd;                     // per sample, direction applied
+    double FilterConstant;
+    int controllerDirection;
+    double *myInput, *myOutput, *mySetpoint;
+
+    int8_t frac;                           // fraction bits of terms and output
+    double unit;                           // 2^-frac
+    pidGain gp, gi, gd, gf;                // kp, ki, kd per window delta or regression numerator, output filter factor
+    int32_t PTerm, DTerm, lastOutput;
+    int64_t ITerm;                         // frac + 16 fraction bits
+    slopeHistory<int32_t, int64_t, pidHistoryMax> History;  // pidInputFrac; integer sums are exact
+    byte slopeMode;
+    unsigned long SampleTime, lastTime;
+    double outMin, outMax;
+    int32_t fixMin, fixMax;
+    bool inAuto, isRaw;
+};
+
+#if PID_FIXED == true
+typedef PIDfixed pidEngine;
+#else
+typedef PID pidEngine;
+#endif
+
+#endif
@@ -24,6 +24,10 @@ PID::PID(double* Input, double* Output, double* Setpoint, double Kp, double Ki,
 
   inAuto = false;
   isRaw = true;
+  slopeMode = SLOPE_ENDPOINT;
+  History.configure(pidHistoryMax, 10, 0);
+  PTerm = ITerm = DTerm = lastOutput = 0;
+  FilterConstant = 1;
 
   PID::SetOutputLimits(0, 255);	 //default output limit corresponds to 
 				 //the arduino pwm limits
@@ -40,24 +44,22 @@ PID::PID(double* Input, double* Output, double* Setpoint, double Kp, double Ki,
  *   false when nothing has been done.
  **********************************************************************************/ 
 bool PID::Compute() {
-  static byte count = 0;
+  return Compute(millis());
+}
+
+bool PID::Compute(unsigned long now) {
   if(!inAuto) return false;
-  unsigned long now = millis();
-  unsigned long timeChange = (now - lastTime);
+  unsigned long timeChange = (uint32_t)(now - lastTime);
   if(timeChange>=SampleTime) {  // compute all the working error variables
-    count++;
-    if (count == 10) {
-      for (int i = 29; i > 0; i--) { History[i] = History[i - 1]; }
-      History[0] = *myInput;
-      count = 0;
-    }
+    History.sample(*myInput);
     double input = *myInput;
     double error = *mySetpoint - input;
     
     ITerm += (ki * error);
     if (ITerm > outMax) ITerm= outMax;
       else if (ITerm < outMin) ITerm= outMin;
-    double dInput = (History[0] - History[29]) / (5*60);
+    double dInput = (slopeMode == SLOPE_REGRESSION) ? History.slope() / History.decimation()
+                                                    : History.delta() / (History.length() * History.decimation());  // 300 computes by default
     PTerm = kp * error;
     DTerm = -kd * dInput;
 
@@ -143,18 +145,21 @@ void PID::SetMode(int Mode) {
 }
 
 void PID::setOutputType(int type) {  // change output between RAW and FILTERED (first order)
-  switch (type) {
-    default:
-    case RAW:
-      isRaw = true;
-    case FILTERED:
-      isRaw = false;
-  }
+  isRaw = (type != FILTERED);  // RAW used to fall through to FILTERED
 }
 
 void PID::setFilterConstant(double constant) {
  FilterConstant = constant; 
 } 
+
+void PID::setOutput(double output) {  // bumpless: the next Compute() continues from output
+  output = constrain(output, outMin, outMax);
+  ITerm += output - *myOutput;
+  if(ITerm > outMax) ITerm = outMax;
+    else if (ITerm < outMin) ITerm = outMin;
+  lastOutput = output;
+  *myOutput = output;
+}
 /* Initialize()****************************************************************
  *	does all the things that need to happen to ensure a bumpless transfer
  *  from manual to automatic mode.
@@ -168,8 +173,12 @@ void PID::Initialize() {
 }
 
 void PID::initHistory() {
-  History[0] = *myInput;
-  for (int i = 1; i < 30; i++) { History[i] = History[0]; }
+  History.fill(*myInput);
+}
+
+void PID::setHistory(byte length, byte decimation, byte mode) {  // restarts the window at the current input
+  History.configure(length, decimation, *myInput);
+  slopeMode = mode;
 }
 
 /* SetControllerDirection(...)*************************************************
@@ -2,6 +2,10 @@
 #define PID_v1_h
 #define LIBRARY_VERSION	1.0.0
 
+#include "slopeHistory.h"
+
+const byte pidHistoryMax = 30;  // slope window capacity (samples)
+
 class PID {
   public:
     #define AUTOMATIC 1  //Constants used in some of the functions below
@@ -20,6 +24,7 @@ class PID {
                                            // called every time loop() cycles. ON/OFF and
                                            // calculation frequency can be set using SetMode
                                            // SetSampleTime respectively
+    bool Compute(unsigned long now);       // * as above with the caller supplying the time (ms)
 
     void SetOutputLimits(double, double);  //clamps the output to a specific range. 0-255 by default, but
                                            //it's likely the user will want to change this depending on
@@ -36,8 +41,12 @@ class PID {
     void SetSampleTime(unsigned long);        // * sets the frequency, in Milliseconds, with which 
                                               // the PID calculation is performed.  default is 100
     void initHistory();                       // init array for calculating slope for D term
+    void setHistory(byte, byte, byte);        // slope window length, decimation and SLOPE_ENDPOINT/SLOPE_REGRESSION
+                                              // (default 30 samples, every 10th compute, endpoint)
     void setOutputType(int);                  // set output type, RAW or FILTERED
     void setFilterConstant(double);           // set filter constant for first order output filter
+    void setOutput(double);                   // move Output without a bump: the integral term and the
+                                              // output filter take the step (a replay picking up a log)
 
 //Display functions ****************************************************************
     double GetKp();      // These functions query the pid for interal values.
@@ -67,7 +76,8 @@ class PID {
                                   //   what these values are.  with pointers we'll just know.			  
     double PTerm, ITerm, DTerm;          // control output terms
     double lastOutput, FilterConstant;   // for outputing a filtered control signal
-    double History[30];                  // for calculating broad PV slope for derivative term
+    slopeHistory<double, double, pidHistoryMax> History;  // for calculating broad PV slope for derivative term
+    byte slopeMode;                      // SLOPE_ENDPOINT or SLOPE_REGRESSION
     unsigned long SampleTime, lastTime;  // time between sample/compute (ms), time of last sample (ms)
     double outMin, outMax;     // output constraints
     bool inAuto, isRaw;        // state flags
@@ -0,0 +1,76 @@
+#include "autotune.h"
+
+void relayTuner::begin(double* input, double* output, double setpoint, double high, double low, double hysteresis,
+                       unsigned long timeoutMs, unsigned long now) {
+  _input = input;
+  _output = output;
+  _setpoint = setpoint;
+  _high = high;
+  _low = low;
+  _hysteresis = hysteresis;
+  _start = _rise = now;
+  _timeout = timeoutMs;
+  _cycles = 0;
+  _ku = _pu = 0;
+  _max = _min = *input;
+  _state = TUNE_RUNNING;
+  _switch(*input < setpoint);
+}
+
+void relayTuner::_switch(boolean up) {
+  _up = up;
+  *_output = up ? _high : _low;
+}
+
+byte relayTuner::update(unsigned long now) {
+  if (_state != TUNE_RUNNING) return _state;
+  if ((uint32_t)(now - _start) > _timeout) return _state = TUNE_FAILED;
+  double pv = *_input;
+  _max = max(_max, pv);
+  _min = min(_min, pv);
+  if (_up && (pv > _setpoint + _hysteresis)) _switch(false);
+  else if (!_up && (pv < _setpoint - _hysteresis)) {  // cycle complete
+    if (_cycles) {
+      byte i = (_cycles - 1) % tuneCycles;
+      _period[i] = (uint32_t)(now - _rise) / 1000.0;
+      _amplitude[i] = (_max - _min) / 2;
+    }
+    if (_cycles < 255) _cycles++;
+    _rise = now;
+    _max = _min = pv;
+    _switch(true);
+    if (_settled()) _state = TUNE_DONE;
+  }
+  return _state;
+}
+
+boolean relayTuner::_settled() {
+  if (_cycles <= tuneCycles) return false;  // the first cycle does not count
+  double p = 0, a = 0;
+  for (byte i = 0; i < tuneCycles; i++) {
+    p += _period[i] / tuneCycles;
+    a += _amplitude[i] / tuneCycles;
+  }
+  if (a <= _hysteresis) return false;  // no oscillation beyond the relay's own band
+  for (byte i = 0; i < tuneCycles; i++)
+    if ((abs(_period[i] - p) > tuneTolerance * p) || (abs(_amplitude[i] - a) > tuneTolerance * a)) return false;
+  _pu = p;
+  _ku = 4 * (_high - _low) / 2 / (PI * sqrt(a * a - _hysteresis * _hysteresis));
+  return true;
+}
+
+void relayTuner::getTunings(byte rule, double* kp, double* ki, double* kd) {
+  double ti, td;
+  switch (rule) {
+    case TUNE_TYREUS_LUYBEN:
+      *kp = 0.45 * _ku; ti = 2.2 * _pu; td = _pu / 6.3;
+      break;
+    case TUNE_NO_OVERSHOOT:
+      *kp = 0.2 * _ku; ti = _pu / 2; td = _pu / 3;
+      break;
+    default:
+      *kp = 0.6 * _ku; ti = _pu / 2; td = _pu / 8;
+  }
+  *ki = *kp / ti;
+  *kd = *kp * td;
+}
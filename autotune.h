@@ -0,0 +1,75 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include "Arduino.h"
+
+// relay feedback auto-tuning (Astrom-Hagglund).  the loop's PID is set to manual and a relay with
+// hysteresis drives its output instead: high when the process value falls below setpoint - hysteresis,
+// low when it rises above setpoint + hysteresis.  the loop settles into a limit cycle whose period is the
+// ultimate period Pu and whose amplitude a gives the ultimate gain (describing function of a relay with
+// hysteresis, relay amplitude d = (high - low) / 2):
+//
+//   Ku = 4 d / (pi * sqrt(a^2 - hysteresis^2))
+//
+// a cycle runs from one switch to high to the next.  the first cycle (the approach from wherever the loop
+// started) is discarded; the experiment ends once tuneCycles consecutive cycles agree within
+// tuneTolerance in period and amplitude, and fails at its timeout.  the output only ever takes the two
+// relay values, so whatever protects the final control elements downstream (fridgeControl's compressor
+// minimum on/off and maximum on times) stays in force.
+//
+// getTunings() turns Ku and Pu into pidEngine::SetTunings() units (Ki per second, Kd in seconds):
+//   rule                 Kp         Ti         Td
+//   TUNE_ZIEGLER_NICHOLS 0.6 Ku     Pu / 2     Pu / 8
+//   TUNE_TYREUS_LUYBEN   0.45 Ku    2.2 Pu     Pu / 6.3   (less aggressive: lag dominant loops)
+//   TUNE_NO_OVERSHOOT    0.2 Ku     Pu / 2     Pu / 3
+
+const byte tuneCycles = 3;            // consistent cycles that end the experiment
+const double tuneTolerance = 0.2;     // accepted spread of period and amplitude, relative to the mean
+
+enum tuneState {
+  TUNE_IDLE,
+  TUNE_RUNNING,
+  TUNE_DONE,
+  TUNE_FAILED,        // timed out, or no usable oscillation
+};
+
+enum tuneRule {
+  TUNE_ZIEGLER_NICHOLS,
+  TUNE_TYREUS_LUYBEN,
+  TUNE_NO_OVERSHOOT,
+};
+
+class relayTuner {
+    double* _input;           // process value
+    double* _output;          // relay output, written on every switch
+    double _setpoint;
+    double _high, _low;
+    double _hysteresis;
+    unsigned long _start;     // ms
+    unsigned long _timeout;   // ms
+    unsigned long _rise;      // last switch to high, ms
+    boolean _up;              // relay at high
+    double _max, _min;        // process value extremes since _rise
+    byte _cycles;             // complete cycles, counting the discarded one (saturates)
+    double _period[tuneCycles];     // s, ring of the latest cycles
+    double _amplitude[tuneCycles];  // peak to peak / 2
+    byte _state;
+    double _ku, _pu;
+
+    void _switch(boolean up);
+    boolean _settled();       // last tuneCycles cycles consistent; sets _ku, _pu
+
+  public:
+    relayTuner() : _state(TUNE_IDLE), _ku(0), _pu(0) {}
+    void begin(double* input, double* output, double setpoint, double high, double low, double hysteresis,
+               unsigned long timeoutMs, unsigned long now);
+    byte update(unsigned long now);  // call once per sample; returns tuneState
+    void cancel() { _state = TUNE_IDLE; }
+    byte getState() { return _state; }
+    byte getCycles() { return _cycles ? _cycles - 1 : 0; }  // usable cycles so far
+    double getKu() { return _ku; }
+    double getPu() { return _pu; }  // s
+    void getTunings(byte rule, double* kp, double* ki, double* kd);
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "chamber.h"
+
+chamber::chamber(probe* beer, probe* air, byte coolRelay, byte heatRelay, byte* programState, settingsStore* settings)
+  : _beer(beer), _coolRelay(coolRelay), _heatRelay(heatRelay), _flags(0b110000),
+    _programState(programState ? programState : &_flags), _beerLost(false),
+    input(0), setpoint(0), output(0), heatInput(0), heatSetpoint(0), heatOutput(0),
+    mainPID(&input, &output, &setpoint, 0, 0, 0, DIRECT),             // DIRECT: beer temperature ~ fridge (air) temperature
+    heatPID(&heatInput, &heatOutput, &heatSetpoint, 0, 0, 0, DIRECT),  // HEATing is a DIRECT process
+    controller(air, &output, &heatInput, &heatSetpoint, &heatOutput, &heatPID, coolRelay, heatRelay, _programState, settings) {}
+
+void chamber::openRelays() {
+  pinMode(_coolRelay, OUTPUT);  // write default HIGH (relay open)
+    digitalWrite(_coolRelay, HIGH);
+  pinMode(_heatRelay, OUTPUT);
+    digitalWrite(_heatRelay, HIGH);
+}
+
+void chamber::begin(unsigned long sampleMs, double kp, double ki, double kd, double heatKp, double heatKi, double heatKd) {
+  mainPID.SetTunings(kp, ki, kd);
+  mainPID.SetSampleTime(sampleMs);   // (ms) matches the probe sample rate
+  mainPID.SetOutputLimits(0.3, 38);  // deg C (~32.5 - ~100 deg F)
+  heatPID.SetTunings(heatKp, heatKi, heatKd);
+  heatPID.SetSampleTime(heatWindow);       // sampletime = time proportioning window length
+  heatPID.SetOutputLimits(0, heatWindow);  // heatPID output = duty time per window
+  setModes();
+  mainPID.setOutputType(FILTERED);
+  mainPID.setFilterConstant(10);
+  mainPID.initHistory();
+  heatPID.initHistory();
+}
+
+void chamber::compute(unsigned long now) {
+  if (_beer->isValid()) {
+    if (_beerLost) mainPID.initHistory();  // slope from the beer's reading on, not across the gap
+    _beerLost = false;
+    mainPID.Compute(now);
+    return;
+  }
+  _beerLost = true;  // fridge-only: the air held at the beer setpoint, bumpless when the probe is back
+  if (mainPID.GetMode() == AUTOMATIC) mainPID.setOutput(setpoint);
+}
+
+byte chamber::getLost() {
+  return (_beer->isValid() ? 0 : 0b01) | (controller.getAir()->isValid() ? 0 : 0b10);
+}
+
+void chamber::setModes() {
+  mainPID.SetMode((*_programState & 0b100000) ? AUTOMATIC : MANUAL);
+  heatPID.SetMode((*_programState & 0b010000) ? AUTOMATIC : MANUAL);
+}
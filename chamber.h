@@ -0,0 +1,59 @@
+#ifndef CHAMBER_H
+#define CHAMBER_H
+
+#include "Arduino.h"
+#include "probe.h"
+#include "PID_fixed.h"
+#include "fridge.h"
+#include "settings.h"
+
+// one fermentation chamber: the beer and air probes, the cascade of mainPID (beer temperature -> fridge
+// target) into fridgeControl (COOL by predictive differential, HEAT by heatPID time proportioning), and the
+// two relays.  the sketch keeps its chambers in an array and runs all of them from the same tasks:
+// sample() after every probe bus sample, compute() every sample time, update() every relay period.  each
+// call is one PID compute or one pass of the fridge state machine, so the control tasks cost the chamber
+// count times a fixed amount (npid-bench chamber measures it).  chamber 0 is the one the display, menu,
+// settings, data log and telemetry snapshot work on; the others run the same tunings, start at chamber
+// 0's setpoint and take theirs from CMD_SETPOINT.
+//
+// a lost probe (probe.h) puts the chamber in a degraded mode.  without the beer probe the main PID stops
+// computing and, in automatic, holds the fridge target at the beer setpoint (fridge-only control); its
+// slope history restarts when the probe is back.  without the air probe fridgeControl idles with both
+// relays open.
+//
+// SRAM per chamber is sizeof(chamber) (the DEBUG boot message reports it with the room left for more);
+// nearly all of it is the two PIDs' slope history rings (pidHistoryMax samples each) and the coolModel
+// covariance.  probes and their filters are counted separately: chambers may share the ambient probe.
+
+#ifndef CHAMBERS
+#define CHAMBERS 1  // chambers run by the sketch: 1, or 2 with the second fermenter on ROLE_VESSEL, ROLE_VESSEL_AIR, relay3 and relay4
+#endif
+const byte chamberCount = CHAMBERS;
+
+class chamber {
+    probe* _beer;
+    byte _coolRelay;         // relay pins (active LOW)
+    byte _heatRelay;
+    byte _flags;             // program state of a chamber without the sketch's: both PIDs automatic
+    byte* _programState;     // MAIN_PID_MODE 0b100000, HEAT_PID_MODE 0b010000, COOL_MODEL 0b1000000
+    boolean _beerLost;       // degraded: last compute() found the beer probe lost
+
+  public:
+    double input, setpoint, output;              // mainPID: beer temperature, its setpoint, fridge target
+    double heatInput, heatSetpoint, heatOutput;  // heatPID: air temperature, fridge target, duty per window (ms)
+    pidEngine mainPID;
+    pidEngine heatPID;
+    fridgeControl controller;
+
+    chamber(probe* beer, probe* air, byte coolRelay, byte heatRelay, byte* programState = 0, settingsStore* settings = 0);
+    void openRelays();       // relay pins to outputs, both open; first thing at power up
+    void begin(unsigned long sampleMs, double kp, double ki, double kd, double heatKp, double heatKi, double heatKd);
+    void setModes();         // PID modes from the program state
+    void sample() { input = _beer->getFilter(); }                // after each probe bus sample
+    void compute(unsigned long now);                             // every sample time, now = release time (ms)
+    void update(unsigned long now) { controller.update(now); }   // every relay period, now in ms
+    byte* getProgramState() { return _programState; }
+    byte getLost();          // lost probes: bit 0 beer, bit 1 air
+};
+
+#endif
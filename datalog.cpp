@@ -0,0 +1,249 @@
+#include "datalog.h"
+#include <avr/wdt.h>
+
+static const char logMagic[7] = { 'N', 'P', 'I', 'D', 'L', 'O', 'G' };
+const byte logHeaderSize = 16;  // header bytes covered by the header CRC (stored at offset 16)
+
+static Sd2Card card;  // SdFat level access to the card SD already mounted, for contiguous logs
+static SdVolume volume;
+static SdFile root;
+static boolean cardReady = false;
+
+static void put16(byte* buf, uint16_t v) { buf[0] = v; buf[1] = v >> 8; }
+static void put32(byte* buf, uint32_t v) { put16(buf, v); put16(buf + 2, v >> 16); }
+static uint16_t get16(const byte* buf) { return buf[0] | (uint16_t)buf[1] << 8; }
+static uint32_t get32(const byte* buf) { return get16(buf) | (uint32_t)get16(buf + 2) << 16; }
+
+static int16_t toTemp(double t) { return constrain(t * logTempScale + (t < 0 ? -0.5 : 0.5), -32768.0, 32767.0); }
+static double fromTemp(const byte* buf) { return (double)(int16_t)get16(buf) / logTempScale; }
+
+datalog::datalog() {
+  _name[0] = 0;
+  _count = 0;
+  _seq = 0;
+  _lastState = 0xFF;
+  _dirty = false;
+  _contiguous = false;
+  _streaming = false;
+  _blockPos = 0;
+  _firstBlock = _nextBlock = _endBlock = 0;
+  _lastFlush = 0;
+  _flushInterval = 60;
+  _commits = 0;
+  _maxLatency = 0;
+}
+
+boolean datalog::begin(byte cs, byte mosi, byte miso, byte sck) {  // raw card access for contiguous mode
+  cardReady = card.init(SPI_HALF_SPEED, cs, mosi, miso, sck) && volume.init(&card) && root.openRoot(&volume);
+  return cardReady;
+}
+
+void datalog::_header(byte flags, uint32_t blocks) {  // build the header block in _block
+  memset(_block, 0, sizeof(_block));
+  memcpy(_block, logMagic, sizeof(logMagic));
+  _block[7] = logVersion;
+  _block[8] = logRecordSize;
+  _block[9] = logRecordsPerBlock;
+  _block[10] = logTempScale;
+  _block[11] = logHeatScale;
+  _block[12] = flags;
+  _block[13] = blocks;
+  _block[14] = blocks >> 8;
+  _block[15] = blocks >> 16;
+  _block[logHeaderSize] = OneWire::crc8(_block, logHeaderSize);
+}
+
+boolean datalog::open(const char* filename, uint32_t preallocate) {  // create (with header) or append to a log file
+  close();
+  strncpy(_name, filename, sizeof(_name) - 1);
+  _name[sizeof(_name) - 1] = 0;
+  _count = 0;
+  _dirty = false;
+  _lastState = 0xFF;
+  _lastFlush = millis();
+  _commits = 0;
+  _maxLatency = 0;
+  if (preallocate && cardReady && _openContiguous(filename, preallocate)) {
+    memset(_block, 0xFF, sizeof(_block));
+    return true;
+  }
+  _file = SD.open(filename, O_READ | O_WRITE | O_CREAT);  // no O_APPEND: SdFile would seek to the end before every write
+  if (!_file) return false;
+  uint32_t size = _file.size();
+  if (!size) {  // new file: header block
+    _header(0, 0);
+    _file.write(_block, sizeof(_block));
+    _file.flush();
+    size = sizeof(_block);
+  }
+  _blockPos = (size + 511) & ~(uint32_t)511;  // resume on a fresh block after any partly filled one
+  memset(_block, 0xFF, sizeof(_block));
+  return true;
+}
+
+boolean datalog::_openContiguous(const char* filename, uint32_t preallocate) {  // new pre-allocated log, or resume an unclosed one
+  if (_raw.open(&root, filename, O_READ | O_WRITE)) {  // existing file: only a contiguous log that was never closed can stream
+    uint32_t size = _raw.fileSize(), blocks = 0;
+    if ((_raw.read(_block, sizeof(_block)) == sizeof(_block)) && checkHeader(_block) && (_block[12] & logContiguous))
+      blocks = _block[13] | (uint32_t)_block[14] << 8 | (uint32_t)_block[15] << 16;
+    if (!blocks || (size != (blocks + 1) * 512) || !_raw.contiguousRange(&_firstBlock, &_endBlock)) {
+      _raw.close();  // closed (size fixed up) or not a contiguous log: append through SD instead
+      return false;
+    }
+    uint32_t lo = _firstBlock + 1, hi = _endBlock + 1;  // blocks are written in order onto erased ones; binary search for the end
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      wdt_reset();
+      if (_validBlock(mid)) lo = mid + 1;
+        else hi = mid;
+    }
+    _nextBlock = lo;
+  }
+  else {
+    uint32_t blocks = min(preallocate / 512, 0xFFFFFFUL);
+    if (!_raw.createContiguous(&root, filename, (blocks + 1) * 512)) return false;
+    wdt_reset();
+    _header(logContiguous, blocks);
+    if (!_raw.contiguousRange(&_firstBlock, &_endBlock) || !card.erase(_firstBlock + 1, _endBlock)  // erased blocks mark the end of the stream
+        || (_raw.write(_block, sizeof(_block)) != sizeof(_block)) || !_raw.sync()) {
+      _raw.close();
+      SD.remove((char*)filename);
+      return false;
+    }
+    _nextBlock = _firstBlock + 1;
+  }
+  _contiguous = true;
+  _streaming = false;
+  return true;
+}
+
+boolean datalog::_validBlock(uint32_t block) {  // block holds at least one record (first slot is never left empty)
+  logRecord rec;
+  return card.readBlock(block, _block) && unpack(_block, rec);
+}
+
+void datalog::close() {
+  if (_contiguous) {
+    flush();
+    pause();
+    _raw.truncate((_nextBlock - _firstBlock) * 512UL);  // the only size/FAT update of a contiguous log
+    _raw.close();
+    _contiguous = false;
+    return;
+  }
+  if (!_file) return;
+  flush();
+  _file.close();
+}
+
+void datalog::pause() {  // end a multi-block write before other SD access
+  if (!_streaming) return;
+  card.writeStop();
+  _streaming = false;
+}
+
+void datalog::append(logRecord& rec) {  // stage a sample; commits on full block, interval or state change
+  if (!*this) return;
+  unsigned long start = micros();
+  rec.seq = _seq++;
+  pack(rec, _block + _count * logRecordSize);
+  _count++;
+  _dirty = true;
+  boolean changed = (_lastState != 0xFF) && (rec.state != _lastState);
+  _lastState = rec.state;
+  if ((_count == logRecordsPerBlock) || changed || ((uint32_t)(rec.ms - _lastFlush) / 1000 >= _flushInterval)) {
+    _lastFlush = rec.ms;
+    if (_contiguous) _commitStream();
+      else _commit();
+  }
+  unsigned long latency = (uint32_t)(micros() - start);
+  if (latency > _maxLatency) _maxLatency = latency;
+}
+
+boolean datalog::flush() {  // commit staged records now
+  if (!*this || !_dirty) return true;
+  _lastFlush = millis();
+  return _contiguous ? _commitStream() : _commit();
+}
+
+boolean datalog::_commit() {  // write the staging block over its sector; start a new one once it is full
+  if (!_file.seek(_blockPos)) return false;
+  boolean ok = _file.write(_block, sizeof(_block)) == sizeof(_block);
+  _file.flush();  // directory entry (file size) follows the data
+  _commits++;
+  _dirty = false;
+  if (_count == logRecordsPerBlock) {
+    _blockPos += sizeof(_block);
+    _count = 0;
+    memset(_block, 0xFF, sizeof(_block));
+  }
+  return ok;
+}
+
+boolean datalog::_commitStream() {  // next block of the multi-block write; partly filled blocks are not revisited
+  if (_nextBlock > _endBlock) {  // pre-allocation used up: carry on growing the file through SD
+    pause();
+    _raw.close();
+    _contiguous = false;
+    _file = SD.open(_name, O_READ | O_WRITE);
+    _blockPos = _file.size();
+    return _commit();
+  }
+  boolean ok = _streaming || (_streaming = card.writeStart(_nextBlock, _endBlock - _nextBlock + 1));
+  if (ok) ok = card.writeData(_block);
+  if (ok) _nextBlock++;
+    else pause();  // retried on the next block; these records are lost
+  _commits++;
+  _dirty = false;
+  _count = 0;
+  memset(_block, 0xFF, sizeof(_block));
+  return ok;
+}
+
+void datalog::pack(const logRecord& rec, byte* buf) {  // encode one record (logRecordSize bytes)
+  buf[0] = logSync;
+  buf[1] = (rec.state & 0x03) | (rec.flags << 2);
+  put32(buf + 2, rec.ms);
+  put32(buf + 6, rec.time);
+  put16(buf + 10, toTemp(rec.fridgeTemp));
+  put16(buf + 12, toTemp(rec.fridgeFilter));
+  put16(buf + 14, toTemp(rec.beerTemp));
+  put16(buf + 16, toTemp(rec.beerFilter));
+  put16(buf + 18, toTemp(rec.setpoint));
+  put16(buf + 20, toTemp(rec.output));
+  put16(buf + 22, toTemp(rec.heatSetpoint));
+  put16(buf + 24, constrain(rec.heatOutput / logHeatScale + 0.5, 0.0, 65535.0));
+  float estimator = rec.peakEstimator;  // double is already 32 bit on AVR
+  uint32_t bits;
+  memcpy(&bits, &estimator, 4);
+  put32(buf + 26, bits);
+  buf[30] = rec.seq;
+  buf[31] = OneWire::crc8(buf, logRecordSize - 1);
+}
+
+boolean datalog::unpack(const byte* buf, logRecord& rec) {  // decode; false if sync or CRC do not match
+  if (buf[0] != logSync || OneWire::crc8(buf, logRecordSize - 1) != buf[31]) return false;
+  rec.state = buf[1] & 0x03;
+  rec.flags = buf[1] >> 2;
+  rec.ms = get32(buf + 2);
+  rec.time = get32(buf + 6);
+  rec.fridgeTemp = fromTemp(buf + 10);
+  rec.fridgeFilter = fromTemp(buf + 12);
+  rec.beerTemp = fromTemp(buf + 14);
+  rec.beerFilter = fromTemp(buf + 16);
+  rec.setpoint = fromTemp(buf + 18);
+  rec.output = fromTemp(buf + 20);
+  rec.heatSetpoint = fromTemp(buf + 22);
+  rec.heatOutput = (double)get16(buf + 24) * logHeatScale;
+  uint32_t bits = get32(buf + 26);
+  float estimator;
+  memcpy(&estimator, &bits, 4);
+  rec.peakEstimator = estimator;
+  rec.seq = buf[30];
+  return true;
+}
+
+boolean datalog::checkHeader(const byte* buf) {  // header block is a valid log of this version
+  return !memcmp(buf, logMagic, sizeof(logMagic)) && (buf[7] == logVersion) && (buf[8] == logRecordSize)
+         && (OneWire::crc8(buf, logHeaderSize) == buf[logHeaderSize]);
+}
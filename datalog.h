@@ -0,0 +1,106 @@
+#ifndef DATALOG_H
+#define DATALOG_H
+
+#include "Arduino.h"
+#include <SD.h>
+#include <OneWire.h>
+
+// binary data log.  a log file is a 512 byte header block followed by 512 byte data blocks of 16
+// fixed size records; every block starts on a card sector so each commit is a single aligned block write.
+// records are staged in RAM and only committed when the block fills, when the flush interval expires or
+// when the fridge changes state.  a partly filled block is padded and rewritten in place as it fills.
+//
+// contiguous mode (open() with a pre-allocation size): the file is created as one run of erased clusters
+// and blocks are streamed to the card in a single multi-block write, so the FAT and directory entry are not
+// touched while logging.  a partly filled block is committed as is and the stream moves on to the next block.
+// the file size is fixed up at close(); after a reset open() finds the end of the stream (the first erased
+// block) and resumes there.  pause() ends the multi-block write before other SD access.
+//
+// record layout (32 bytes, little endian):
+//   0      sync (logSync)              16-17  beer filter
+//   1      fridge state, flags         18-19  mainPID setpoint
+//   2-5    millis()                    20-21  mainPID output
+//   6-9    RTC unix time               22-23  heatPID setpoint
+//   10-11  fridge actual               24-25  heatPID output (units of logHeatScale ms)
+//   12-13  fridge filter               26-29  peak estimator (IEEE 754 single)
+//   14-15  beer actual                 30     sequence number (wraps at 256)
+//                                      31     CRC-8 (Dallas/Maxim, as OneWire::crc8) of bytes 0-30
+// temperatures are signed 16 bit in units of 1/logTempScale deg C (exact for DS18B20 readings).  byte 1
+// holds the fridge state in bits 0-1 and the record flags above it: the readings each probe took since the
+// previous record and the PID modes, which is what npid-replay needs to re-run the controller.
+//
+// header block: 0-6 "NPIDLOG", 7 version, 8 record size, 9 records per block, 10 temperature scale,
+// 11 heat scale, 12 flags, 13-15 pre-allocated data blocks, 16 CRC-8 of bytes 0-15, rest zero
+
+const byte logVersion = 2;          // bump when the record layout changes
+const byte logRecordSize = 32;
+const byte logRecordsPerBlock = 512 / logRecordSize;
+const byte logSync = 0xA5;          // first byte of every written record; unused slots are 0xFF
+const int logTempScale = 128;       // 1/128 deg C per count
+const byte logHeatScale = 5;        // ms per heatPID output count (heatWindow / 5 fits 16 bits)
+const byte logContiguous = 0x01;    // header flag: pre-allocated file, streamed with multi-block writes
+const byte logBeerReads = 0x03;     // record flags: beer probe readings since the previous record (saturating)
+const byte logAirReads = 0x0C;      // fridge (air) probe readings, the same
+const byte logMainAuto = 0x10;      // mainPID automatic
+const byte logHeatAuto = 0x20;      // heatPID automatic
+const uint32_t logPreallocate = 128UL * 1024 * 1024;  // contiguous log size (~45 days at 1 Hz)
+
+struct logRecord {  // one datalog sample
+  unsigned long ms;
+  unsigned long time;
+  double fridgeTemp, fridgeFilter, beerTemp, beerFilter;
+  double setpoint, output, heatSetpoint, heatOutput;
+  double peakEstimator;
+  byte state;
+  byte flags;  // log* record flags
+  byte seq;
+};
+
+class datalog {
+    File _file;
+    SdFile _raw;                 // contiguous mode: the same file at the SdFat level
+    char _name[13];              // 8.3 file name
+    byte _block[512];            // staging ring; one card sector of records
+    byte _count;                 // records staged in _block
+    byte _seq;                   // sequence number of the next record
+    byte _lastState;             // fridge state of the previous record
+    boolean _dirty;              // _block holds records not yet on the card
+    boolean _contiguous;         // streaming into a pre-allocated file
+    boolean _streaming;          // multi-block write in progress
+    uint32_t _blockPos;          // file offset of the block being staged
+    uint32_t _firstBlock;        // contiguous mode: card block of the header, next block to write, last block of the file
+    uint32_t _nextBlock;
+    uint32_t _endBlock;
+    unsigned long _lastFlush;    // millis() of the last commit
+    unsigned int _flushInterval; // max age of staged records (s)
+    unsigned long _commits;      // blocks committed since open()
+    unsigned long _maxLatency;   // longest append() (us)
+
+    boolean _commit();
+    boolean _commitStream();
+    boolean _openContiguous(const char* filename, uint32_t preallocate);
+    boolean _validBlock(uint32_t block);
+    void _header(byte flags, uint32_t blocks);
+
+  public:
+    datalog();
+    static boolean begin(byte cs, byte mosi, byte miso, byte sck);  // raw card access for contiguous mode
+    boolean open(const char* filename, uint32_t preallocate = 0);  // create (with header) or append to a log file
+    void close();
+    void pause();                        // end a multi-block write before other SD access
+    void append(logRecord& rec);         // stage a sample; commits on full block, interval or state change
+    boolean flush();                     // commit staged records now
+    char* name() { return _name; }
+    operator bool() { return _file || _contiguous; }
+    boolean isContiguous() { return _contiguous; }
+    void setFlushInterval(unsigned int seconds) { _flushInterval = seconds; }
+    unsigned int getFlushInterval() { return _flushInterval; }
+    unsigned long getCommits() { return _commits; }
+    unsigned long getMaxLatency() { return _maxLatency; }
+
+    static void pack(const logRecord& rec, byte* buf);      // encode one record (logRecordSize bytes)
+    static boolean unpack(const byte* buf, logRecord& rec); // decode; false if sync or CRC do not match
+    static boolean checkHeader(const byte* buf);            // header block is a valid log of this version
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "encoder.h"
+
+// full-step decoder, rest at AB = 11.  clockwise (A leads B) runs 11 01 00 10 11, counter-clockwise
+// 11 10 00 01 11.  each state remembers how far into a cycle the contacts are; a return to 11 from the
+// last state of a cycle is a detent.  a bounce steps back one state, anything else starts over.
+enum { QUAD_REST, QUAD_CW1, QUAD_CW2, QUAD_CW3, QUAD_CCW1, QUAD_CCW2, QUAD_CCW3 };
+const byte quadCW = 0x10, quadCCW = 0x20;  // detent flags over the next state
+
+static const byte quadTable[7][4] PROGMEM = {  // [state][AB]
+  { QUAD_REST, QUAD_CW1, QUAD_CCW1, QUAD_REST },              // rest
+  { QUAD_CW2, QUAD_CW1, QUAD_REST, QUAD_REST },               // 01 clockwise
+  { QUAD_CW2, QUAD_CW1, QUAD_CW3, QUAD_REST },                // 00 clockwise
+  { QUAD_CW2, QUAD_REST, QUAD_CW3, QUAD_REST | quadCW },      // 10 clockwise
+  { QUAD_CCW2, QUAD_REST, QUAD_CCW1, QUAD_REST },             // 10 counter-clockwise
+  { QUAD_CCW2, QUAD_CCW3, QUAD_CCW1, QUAD_REST },             // 00 counter-clockwise
+  { QUAD_CCW2, QUAD_CCW3, QUAD_REST, QUAD_REST | quadCCW },   // 01 counter-clockwise
+};
+
+char rotaryEncoder::step(byte& state, byte ab) {
+  byte next = pgm_read_byte(&quadTable[state][ab & 0x03]);
+  state = next & 0x0F;
+  return (next & quadCW) ? 1 : (next & quadCCW) ? -1 : 0;
+}
+
+void rotaryEncoder::begin() {
+  pinMode(_pinA, INPUT_PULLUP);
+  pinMode(_pinB, INPUT_PULLUP);
+  _state = QUAD_REST;  // a knob left between detents completes no cycle until it comes back to rest
+}
+
+void rotaryEncoder::edge() {
+  char d = step(_state, (digitalRead(_pinA) << 1) | digitalRead(_pinB));
+  if (d) _ring.put((byte)d);
+}
+
+char rotaryEncoder::read() {
+  char d = 0;
+  byte v;
+  while (_ring.get(v)) d += (char)v;  // at most encoderRingSize - 1 queued
+  return d;
+}
+
+void debouncedButton::begin() {
+  pinMode(_pin, INPUT_PULLUP);
+  _level = HIGH;
+  _pressed = _held = false;
+  _changeMs = millis();
+}
+
+byte debouncedButton::poll(unsigned long ms) {
+  return update(digitalRead(_pin), ms);
+}
+
+byte debouncedButton::update(boolean level, unsigned long ms) {
+  if (level != _level) {  // still bouncing (or a new press): wait for the level to hold
+    _level = level;
+    _changeMs = ms;
+  }
+  boolean pressed = !_level;
+  if ((pressed != _pressed) && ((uint32_t)(ms - _changeMs) >= buttonDebounceMs)) {
+    _pressed = pressed;
+    if (pressed) {
+      _pressMs = ms;
+      _held = false;
+    }
+    else if (!_held) return BUTTON_PUSH;
+  }
+  if (_pressed && !_held && ((uint32_t)(ms - _pressMs) >= buttonHoldMs)) {
+    _held = true;
+    return BUTTON_HOLD;
+  }
+  return BUTTON_NONE;
+}
@@ -0,0 +1,85 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include "Arduino.h"
+
+// rotary encoder and push button input.  the encoder ISR runs on every edge of either channel and does
+// one table lookup: a full-step quadrature state machine that counts a detent only when the contacts have
+// gone through the whole A/B cycle and back to rest (both high), so contact bounce walks back and forth
+// between two neighbouring states without counting and no delay is needed to wait it out.  each detent
+// is queued in a single-producer/single-consumer ring: the ISR only writes the head, uiTask only writes
+// the tail, and both are bytes, so neither side needs to disable interrupts.  a full ring drops the
+// detent (counted) rather than wait.
+//
+// the push button (A0, no pin interrupt) is polled by uiTask and debounced on time: a level counts once
+// it has held for buttonDebounceMs.  a press shorter than buttonHoldMs is a push on release; one held for
+// buttonHoldMs is a hold, reported while still pressed, and its release is not a push.
+
+const byte encoderRingSize = 16;         // detents queued between uiTask passes; a power of 2
+const unsigned int buttonDebounceMs = 30;  // contact level must hold this long
+const unsigned int buttonHoldMs = 1000;    // long press
+
+template <byte N> class spscRing {  // lock-free byte queue: put() in one context (an ISR), get() in another
+    volatile byte _buf[N];
+    volatile byte _head;           // next slot put() writes; only put() stores it
+    volatile byte _tail;           // next slot get() reads; only get() stores it
+    volatile unsigned int _dropped;  // put() on a full ring
+
+  public:
+    spscRing() : _head(0), _tail(0), _dropped(0) {}
+    boolean put(byte v) {
+      byte h = _head, next = (h + 1) & (N - 1);
+      if (next == _tail) {
+        _dropped++;
+        return false;
+      }
+      _buf[h] = v;
+      _head = next;  // publishes the slot written above
+      return true;
+    }
+    boolean get(byte& v) {
+      byte t = _tail;
+      if (t == _head) return false;
+      v = _buf[t];
+      _tail = (t + 1) & (N - 1);  // frees the slot read above
+      return true;
+    }
+    unsigned int getDropped() { return _dropped; }
+};
+
+class rotaryEncoder {
+    byte _pinA, _pinB;
+    byte _state;                   // quadrature state machine
+    spscRing<encoderRingSize> _ring;  // detents: 1 clockwise, 0xFF counter-clockwise
+
+  public:
+    rotaryEncoder(byte pinA, byte pinB) : _pinA(pinA), _pinB(pinB), _state(0) {}
+    void begin();                  // pins with pull-ups; call before attaching edge() to their interrupts
+    void edge();                   // ISR: every edge of either channel
+    char read();                   // detents since the last read: + with A leading B
+    unsigned int getDropped() { return _ring.getDropped(); }
+    static char step(byte& state, byte ab);  // one transition: ab = A << 1 | B; +1/-1 on a completed detent
+};
+
+enum buttonEvent {
+  BUTTON_NONE,
+  BUTTON_PUSH,   // released before buttonHoldMs
+  BUTTON_HOLD,   // held for buttonHoldMs
+};
+
+class debouncedButton {
+    byte _pin;
+    boolean _level;                // raw level at the last poll (LOW = pressed)
+    boolean _pressed;              // debounced
+    boolean _held;                 // this press was reported as a hold
+    unsigned long _changeMs;       // millis() the raw level last changed
+    unsigned long _pressMs;        // millis() of the debounced press
+
+  public:
+    debouncedButton(byte pin) : _pin(pin), _level(HIGH), _pressed(false), _held(false), _changeMs(0), _pressMs(0) {}
+    void begin();
+    byte poll(unsigned long ms);   // every few ms (well under buttonDebounceMs); returns a buttonEvent
+    byte update(boolean level, unsigned long ms);  // poll() on a given pin level
+};
+
+#endif
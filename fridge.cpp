@@ -1,94 +1,174 @@
 #include "fridge.h"
 
-byte fridgeState[2] = { IDLE, IDLE };      // [0] - current fridge state; [1] - fridge state t - 1 history
-double peakEstimator = 30;    // to predict COOL overshoot; units of deg C per hour (always positive)
-double peakEstimate = 0;      // to determine prediction error = (estimate - actual)
-unsigned long startTime = 0;  // timing variables for enforcing min/max cycling times
-unsigned long stopTime = 0;
+fridgeControl::fridgeControl(probe* air, double* output, double* heatInput, double* heatSetpoint, double* heatOutput, pidEngine* heatPID,
+                             byte coolRelay, byte heatRelay, byte* programState, settingsStore* settings) {
+  _air = air;
+  _output = output;
+  _heatInput = heatInput;
+  _heatSetpoint = heatSetpoint;
+  _heatOutput = heatOutput;
+  _heatPID = heatPID;
+  _coolRelay = coolRelay;
+  _heatRelay = heatRelay;
+  _programState = programState;
+  _settings = settings;
+  _ambient = 0;
+  _state[0] = _state[1] = IDLE;
+  _peakEstimator = 30;
+  _peakEstimate = 0;
+  _startFilter = _stopFilter = 0;
+  _peakPredicted = _peakError = 0;
+  _peaks = 0;
+  _startTime = 0;
+  _stopTime = 0;
+}
 
-void updateFridge() {        // maintain fridge at temperature set by mainPID -- COOLing with predictive differential, HEATing with time proportioned heatPID
-  switch (fridgeState[0]) {  // MAIN switch -- IDLE/peak detection, COOL, HEAT routines
+void fridgeControl::update(unsigned long now) {  // maintain fridge at temperature set by mainPID -- COOLing with predictive differential, HEATing with time proportioned heatPID
+  double Output = *_output;
+  *_heatInput = _air->getFilter();
+  if (!_air->isValid()) {  // air probe lost: nothing to run COOL or HEAT on, both relays open
+    if (_state[0] != IDLE) {
+      digitalWrite(_coolRelay, HIGH);
+      digitalWrite(_heatRelay, HIGH);
+      _stopTime = now;  // minimum off times count from here when the probe is back
+    }
+    _setState(IDLE, IDLE);
+    return;
+  }
+  switch (_state[0]) {  // MAIN switch -- IDLE/peak detection, COOL, HEAT routines
     default:
     case IDLE:
-      if (fridgeState[1] == IDLE) {   // only switch to HEAT/COOL if not waiting for COOL peak
-        if ((fridge.getFilter() > Output + fridgeIdleDiff) && ((unsigned long)((millis() - stopTime) / 1000) > coolMinOff)) {  // switch to COOL only if temp exceeds IDLE range and min off time met
-          updateFridgeState(COOL);    // update current fridge status and t - 1 history
-          digitalWrite(relay1, LOW);  // close relay 1; supply power to fridge compressor
-          startTime = millis();       // record COOLing start time
+      if (_state[1] == IDLE) {   // only switch to HEAT/COOL if not waiting for COOL peak
+        if ((_air->getFilter() > Output + fridgeIdleDiff) && ((uint32_t)(now - _stopTime) / 1000 > coolMinOff)) {  // switch to COOL only if temp exceeds IDLE range and min off time met
+          _setState(COOL);                // update current fridge status and t - 1 history
+          digitalWrite(_coolRelay, LOW);  // close relay 1; supply power to fridge compressor
+          _startTime = now;               // record COOLing start time
+          _startFilter = _air->getFilter();
         }
-        else if ((fridge.getFilter() < Output - fridgeIdleDiff) && ((unsigned long)((millis() - stopTime) / 1000) > heatMinOff)) {  // switch to HEAT only if temp below IDLE range and min off time met
-          updateFridgeState(HEAT);
-          if (programState & 0b010000) heatSetpoint = Output;  // update heat PID setpoint if in automatic mode
-          heatPID.Compute();      // compute new heat PID output, update timings to align PID and time proportioning routine
-          startTime = millis();   // start new time proportioned window
+        else if ((_air->getFilter() < Output - fridgeIdleDiff) && ((uint32_t)(now - _stopTime) / 1000 > heatMinOff)) {  // switch to HEAT only if temp below IDLE range and min off time met
+          _setState(HEAT);
+          if (*_programState & 0b010000) *_heatSetpoint = Output;  // update heat PID setpoint if in automatic mode
+          _heatPID->Compute(now);  // compute new heat PID output, update timings to align PID and time proportioning routine
+          _startTime = now;        // start new time proportioned window
         }
       }
-      else if (fridgeState[1] == COOL) {  // do peak detect if waiting on COOL
-        if (fridge.peakDetect()) {        // negative peak detected...
-          tuneEstimator(&peakEstimator, peakEstimate - fridge.getFilter());  // (error = estimate - actual) positive error requires larger estimator; negative:smaller
-          fridgeState[1] = IDLE;          // stop peak detection until next COOL cycle completes
+      else if (_state[1] == COOL) {  // do peak detect if waiting on COOL
+        if (_air->peakDetect()) {    // negative peak detected...
+          _learnPeak(_air->getFilter());
+          _state[1] = IDLE;          // stop peak detection until next COOL cycle completes
         }
-        else {                                                               // no peak detected
-          double offTime = (unsigned long)(millis() - stopTime) / 1000;      // IDLE time in seconds
-          if (offTime < peakMaxWait) break;                                  // keep waiting for filter confirmed peak if too soon
-          tuneEstimator(&peakEstimator, peakEstimate - fridge.getFilter());  // temp is drifting in the right direction, but too slowly; update estimator
-          fridgeState[1] = IDLE;                                             // stop peak detection
+        else {                                                 // no peak detected
+          double offTime = (uint32_t)(now - _stopTime) / 1000;  // IDLE time in seconds
+          if (offTime < peakMaxWait) break;                    // keep waiting for filter confirmed peak if too soon
+          _learnPeak(_air->getFilter());                       // temp is drifting in the right direction, but too slowly; update estimator
+          _state[1] = IDLE;                                    // stop peak detection
         }
       }
       break;
 
     case COOL:  // run compressor until peak predictor lands on controller Output
-      { double runTime = (unsigned long)(millis() - startTime) / 1000;  // runtime in seconds
+      { double runTime = (uint32_t)(now - _startTime) / 1000;  // runtime in seconds
       if (runTime < coolMinOn) break;     // ensure minimum compressor runtime
-      if (fridge.getFilter() < Output - fridgeIdleDiff) {  // temp already below output - idle differential: most likely cause is change in setpoint or long minimum runtime
-        updateFridgeState(IDLE, IDLE);    // go IDLE, ignore peaks
-        digitalWrite(relay1, HIGH);       // open relay 1; power down fridge compressor
-        stopTime = millis();              // record idle start
+      if (_air->getFilter() < Output - fridgeIdleDiff) {  // temp already below output - idle differential: most likely cause is change in setpoint or long minimum runtime
+        _setState(IDLE, IDLE);            // go IDLE, ignore peaks
+        digitalWrite(_coolRelay, HIGH);   // open relay 1; power down fridge compressor
+        _stopTime = now;                  // record idle start
         break;
       }
-      if ((fridge.getFilter() - (min(runTime, peakMaxTime) / 3600) * peakEstimator) < Output - fridgeIdleDiff) {  // if estimated peak exceeds Output - differential, set IDLE and wait for actual peak
-        peakEstimate = fridge.getFilter() - (min(runTime, peakMaxTime) / 3600) * peakEstimator;   // record estimated peak prediction
-        updateFridgeState(IDLE);     // go IDLE, wait for peak
-        digitalWrite(relay1, HIGH);
-        stopTime = millis();
+      double estimate = _air->getFilter() - (min(runTime, peakMaxTime) / 3600) * _peakEstimator;  // peakEstimator prediction
+      double predicted = estimate;
+      if (modelActive()) {
+        _coolInputs(runTime, _modelInputs);
+        predicted = _air->getFilter() - _model.predict(_modelInputs);
+      }
+      if (predicted < Output - fridgeIdleDiff) {  // if predicted peak exceeds Output - differential, set IDLE and wait for actual peak
+        _peakEstimate = estimate;    // record both predictions; each learns from the peak whichever is in use
+        _peakPredicted = predicted;
+        _stopFilter = _air->getFilter();
+        _coolInputs(runTime, _modelInputs);
+        _setState(IDLE);             // go IDLE, wait for peak
+        digitalWrite(_coolRelay, HIGH);
+        _stopTime = now;
       }
       if (runTime > coolMaxOn) {  // if compressor runTime exceeds max on time, skip peak detect, go IDLE
-        updateFridgeState(IDLE, IDLE);
-        digitalWrite(relay1, HIGH);
-        stopTime = millis();
+        _setState(IDLE, IDLE);
+        digitalWrite(_coolRelay, HIGH);
+        _stopTime = now;
       }
       break; }
 
     case HEAT:  // run HEAT using time proportioning
-      { double runTime = millis() - startTime;  // runtime in ms
-      if ((runTime < heatOutput) && digitalRead(relay2)) digitalWrite(relay2, LOW);           // active duty; close relay, write only once
-        else if ((runTime > heatOutput) && !digitalRead(relay2)) digitalWrite(relay2, HIGH);  // active duty completed; rest of window idle; write only once
-      if (programState & 0b010000) heatSetpoint = Output;
-      if (heatPID.Compute()) {  // if heatPID computes (once per window), current window complete, start new
-        startTime = millis();
+      { double runTime = (uint32_t)(now - _startTime);  // runtime in ms
+      if ((runTime < *_heatOutput) && digitalRead(_heatRelay)) digitalWrite(_heatRelay, LOW);           // active duty; close relay, write only once
+        else if ((runTime > *_heatOutput) && !digitalRead(_heatRelay)) digitalWrite(_heatRelay, HIGH);  // active duty completed; rest of window idle; write only once
+      if (*_programState & 0b010000) *_heatSetpoint = Output;
+      if (_heatPID->Compute(now) || ((_heatPID->GetMode() == MANUAL) && (runTime >= heatWindow))) {  // if heatPID computes (once per window), current window complete, start new
+        _startTime = now;
       }
-      if (fridge.getFilter() > Output + fridgeIdleDiff) {  // temp exceeds setpoint, go to idle to decide if it is time to COOL
-        updateFridgeState(IDLE, IDLE);
-        digitalWrite(relay2, HIGH);
-        stopTime = millis();
+      if (_air->getFilter() > Output + fridgeIdleDiff) {  // temp exceeds setpoint, go to idle to decide if it is time to COOL
+        _setState(IDLE, IDLE);
+        digitalWrite(_heatRelay, HIGH);
+        _stopTime = now;
       }
       break; }
   }
 }
 
-void tuneEstimator(double* estimator, double error) {  // tune fridge overshoot estimator
-  if (abs(error) <= fridgePeakDiff) return;            // leave estimator unchanged if error falls within contstrained peak differential
-  if (error > 0) *estimator *= constrain(1.2 + 0.03 * abs(error), 1.2, 1.5);                 // if positive error; increase estimator 20% - 50% relative to error
-    else *estimator = max(0.05, *estimator / constrain(1.2 + 0.03 * abs(error), 1.2, 1.5));  // if negative error; decrease estimator 17% - 33% relative to error, constrain to non-zero value
-  EEPROMWrite(38, peakEstimator, DOUBLE);              // update estimator value stored in EEPROM
+void fridgeControl::_tuneEstimator(double error) {  // tune fridge overshoot estimator
+  if (abs(error) <= fridgePeakDiff) return;         // leave estimator unchanged if error falls within contstrained peak differential
+  if (error > 0) _peakEstimator *= constrain(1.2 + 0.03 * abs(error), 1.2, 1.5);                 // if positive error; increase estimator 20% - 50% relative to error
+    else _peakEstimator = max(0.05, _peakEstimator / constrain(1.2 + 0.03 * abs(error), 1.2, 1.5));  // if negative error; decrease estimator 17% - 33% relative to error, constrain to non-zero value
+  if (_settings) _settings->change();  // estimator is committed with the settings record
+}
+
+void fridgeControl::_coolInputs(double runTime, double* x) {  // coolModel inputs for a stop after runTime seconds
+  x[0] = 1;
+  x[1] = min(runTime, peakMaxTime) / 3600;
+  x[2] = (_startFilter - _air->getFilter()) / max(runTime, 1.0) * 360;  // deg C per 6 min
+  x[3] = (_ambient && _ambient->isPresent()) ? (_ambient->getFilter() - _air->getFilter()) / 10 : 0;
+}
+
+void fridgeControl::_learnPeak(double peak) {  // COOL peak found (or given up on): tune both predictors
+  _tuneEstimator(_peakEstimate - peak);  // (error = estimate - actual) positive error requires larger estimator; negative:smaller
+  if (!_model.getPeaks()) _model.reset(_peakEstimator);  // first peak: start the model from the tuned heuristic
+  _model.learn(_modelInputs, _stopFilter - peak);
+  _peakError = peak - _peakPredicted;
+  _peaks++;
 }
 
-void updateFridgeState(byte state) {  // update current fridge state
-  fridgeState[1] = fridgeState[0];
-  fridgeState[0] = state;
+boolean fridgeControl::modelActive() {
+  return (*_programState & 0b1000000) && (_model.getPeaks() >= coolModelWarmup);
 }
 
-void updateFridgeState(byte state0, byte state1) {  // update current fridge state and history
-  fridgeState[1] = state1;
-  fridgeState[0] = state0;
+double coolModel::_dot(const double* x) {
+  double d = 0;
+  for (byte i = 0; i < coolModelInputs; i++) d += _theta[i] * x[i];
+  return d;
+}
+
+void coolModel::reset(double estimator) {
+  for (byte i = 0; i < coolModelInputs; i++) {
+    _theta[i] = 0;
+    for (byte j = 0; j < coolModelInputs; j++) _p[i][j] = (i == j) ? coolModelP0 : 0;
+  }
+  _theta[1] = estimator;  // overshoot = estimator * runtime
+  _peaks = 0;
+}
+
+void coolModel::learn(const double* x, double overshoot) {  // one recursive least squares step with forgetting
+  double px[coolModelInputs];  // P x
+  double trace = 0, gain = 0;
+  for (byte i = 0; i < coolModelInputs; i++) {
+    px[i] = 0;
+    for (byte j = 0; j < coolModelInputs; j++) px[i] += _p[i][j] * x[j];
+    trace += _p[i][i];
+  }
+  double forget = (trace < coolModelPMax) ? coolModelForget : 1;  // no windup along inputs that stay 0
+  for (byte i = 0; i < coolModelInputs; i++) gain += x[i] * px[i];
+  gain += forget;
+  double error = overshoot - _dot(x);
+  for (byte i = 0; i < coolModelInputs; i++) _theta[i] += px[i] / gain * error;
+  for (byte i = 0; i < coolModelInputs; i++)
+    for (byte j = 0; j < coolModelInputs; j++) _p[i][j] = (_p[i][j] - px[i] * px[j] / gain) / forget;
+  if (_peaks < 255) _peaks++;
 }
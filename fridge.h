@@ -3,8 +3,8 @@
 
 #include "Arduino.h"
 #include "probe.h"
-#include "PID_v1.h"
-#include "EEPROMio.h"
+#include "PID_fixed.h"
+#include "settings.h"
 
 enum opState {  // fridge operation states
   IDLE,
@@ -21,28 +21,97 @@ const unsigned int peakMaxTime = 1200;   // maximum runTime to consider for peak
 const unsigned int peakMaxWait = 1800;   // maximum wait on peak, seconds (30 min)
 const unsigned int heatMinOff = 300;     // minimum HEAT off time, seconds (5 min)
 const unsigned int heatWindow = 300000;  // window size for HEAT time proportioning, ms (5 min)
+const byte coolModelInputs = 4;          // bias, runtime, fall rate, ambient - air
+const double coolModelForget = 0.9;      // RLS forgetting factor per learned peak (memory of ~10 COOL cycles)
+const double coolModelP0 = 100;          // initial covariance (uncertainty of every coefficient)
+const double coolModelPMax = 1000;       // covariance trace above which forgetting stops (inputs not exciting)
+const byte coolModelWarmup = 8;          // peaks learned before the model replaces the peakEstimator
 
-extern byte fridgeState[2];      // [0] - current fridge state; [1] - fridge state t - 1 history
-extern double peakEstimator;     // to predict COOL overshoot; units of deg F per hour (always positive)
-extern double peakEstimate;      // to determine prediction error = (estimate - actual)
-extern unsigned long startTime;  // timing variables for enforcing min/max cycling times
-extern unsigned long stopTime;
-
-extern probe fridge, beer;  // external variables declared in globals.h
-extern double Output, heatSetpoint, heatOutput;
-extern const byte relay1, relay2;
-extern byte programState;
-extern PID heatPID;
-
-void updateFridge();  // core functions
-void tuneEstimator(double* estimator, double error);
-void updateFridgeState(byte state);
-void updateFridgeState(byte state0, byte state1);
-
-inline byte getFridgeState(byte index) { return fridgeState[index]; };  // inlines for accessing fridge variables
-inline double getPeakEstimator() { return peakEstimator; };
-inline double* getPeakEstimatorAddr() { return &peakEstimator; };
-inline unsigned long getStartTime() { return startTime; };
-inline unsigned long getStopTime() { return stopTime; };
+// COOL overshoot: after the compressor stops the evaporator keeps absorbing heat, so the air goes on
+// falling to a trough below the temperature at the stop.  the peakEstimator heuristic predicts the
+// overshoot as estimator * runtime and scales the estimator by 1.2-1.5 after each peak that misses.
+// coolModel predicts it as a linear function of what the fridge saw during the run
+//
+//   overshoot = theta . x,  x = { 1, runtime (h, to peakMaxTime), air fall rate since the start (deg C per
+//                                 6 min), (ambient - air) / 10 (deg C, 0 without an ambient probe) }
+//
+// and identifies theta by recursive least squares each time a peak is found, starting from the heuristic
+// (theta = { 0, estimator, 0, 0 }).  the controller stops COOL on the first sample that puts the predicted
+// trough on the bottom of the idle band: the stop with the least predicted error at the sample rate.
+class coolModel {
+    double _theta[coolModelInputs];
+    double _p[coolModelInputs][coolModelInputs];  // inverse input correlation (coefficient covariance)
+    byte _peaks;             // peaks learned, saturating
+
+    double _dot(const double* x);
+
+  public:
+    coolModel() { reset(0); }
+    void reset(double estimator);  // forget everything; start from the peakEstimator heuristic
+    double predict(const double* x) { return max(_dot(x), 0.0); }  // overshoot, deg C
+    void learn(const double* x, double overshoot);
+    byte getPeaks() { return _peaks; }
+    double getTheta(byte i) { return _theta[i]; }
+};
+
+class fridgeControl {  // COOLing with predictive differential, HEATing with time proportioned heatPID
+    probe* _air;             // chamber air probe
+    double* _output;         // fridge temperature target (mainPID output)
+    double* _heatInput;      // heatPID links (input: the air probe)
+    double* _heatSetpoint;
+    double* _heatOutput;
+    pidEngine* _heatPID;
+    byte* _programState;     // heatPID automatic flag is bit 0b010000, coolModel flag 0b1000000
+    byte _coolRelay;         // relay pins (active LOW)
+    byte _heatRelay;
+    settingsStore* _settings;  // peakEstimator changes are committed here, 0 = not persisted
+    probe* _ambient;         // room temperature for the coolModel, optional
+
+    byte _state[2];          // [0] - current fridge state; [1] - fridge state t - 1 history
+    double _peakEstimator;   // to predict COOL overshoot; units of deg C per hour (always positive)
+    double _peakEstimate;    // to determine prediction error = (estimate - actual)
+    coolModel _model;
+    double _modelInputs[coolModelInputs];  // at the last COOL stop, learned against its peak
+    double _startFilter;     // air at the COOL start
+    double _stopFilter;      // air at the COOL stop
+    double _peakPredicted;   // trough predicted by the controller in use at the stop
+    double _peakError;       // actual - predicted trough of the last peak
+    unsigned int _peaks;     // peaks found (or timed out)
+    unsigned long _startTime;  // timing variables for enforcing min/max cycling times
+    unsigned long _stopTime;
+
+    void _tuneEstimator(double error);
+    void _coolInputs(double runTime, double* x);
+    void _learnPeak(double peak);
+    void _setState(byte state) { _state[1] = _state[0]; _state[0] = state; }
+    void _setState(byte state0, byte state1) { _state[1] = state1; _state[0] = state0; }
+
+  public:
+    fridgeControl(probe* air, double* output, double* heatInput, double* heatSetpoint, double* heatOutput, pidEngine* heatPID,
+                  byte coolRelay, byte heatRelay, byte* programState, settingsStore* settings = 0);
+    void update() { update(millis()); }
+    void update(unsigned long now);  // maintain fridge at temperature set by mainPID; now in ms
+
+    void setAmbient(probe* ambient) { _ambient = ambient; }
+    probe* getAir() { return _air; }
+
+    byte getState(byte index) { return _state[index]; }
+    coolModel& getModel() { return _model; }
+    boolean modelActive();   // coolModel flag set and the model past its warmup
+    double getPeakError() { return _peakError; }
+    unsigned int getPeaks() { return _peaks; }
+    double getPeakEstimator() { return _peakEstimator; }
+    double* getPeakEstimatorAddr() { return &_peakEstimator; }
+    unsigned long getStartTime() { return _startTime; }
+    unsigned long getStopTime() { return _stopTime; }
+};
+
+extern fridgeControl& mainFridge;  // chamber 0's controller, declared in globals.h
+
+inline byte getFridgeState(byte index) { return mainFridge.getState(index); };  // inlines for accessing fridge variables
+inline double getPeakEstimator() { return mainFridge.getPeakEstimator(); };
+inline double* getPeakEstimatorAddr() { return mainFridge.getPeakEstimatorAddr(); };
+inline unsigned long getStartTime() { return mainFridge.getStartTime(); };
+inline unsigned long getStopTime() { return mainFridge.getStopTime(); };
 
 #endif
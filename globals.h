@@ -1,8 +1,6 @@
 #ifndef GLOBALS_H
 #define GLOBALS_H
 
-const int EEPROM_VER = 11;  // eeprom data tracking
-
 // custom characters for LCD
 const byte delta[8] = {
   B00000,
@@ -92,12 +90,6 @@ const byte degf[8] = {
   B00000
 };
 
-struct profileStep {  // struct to encapsulate temperature and duration for fermentation profiles
-  double temp;
-  double duration;
-  profileStep() : temp(0), duration(0) {}
-};
-
 // arduino pin declarations:
 const byte encoderPinA = 3;   // rotary encoder A channel **interrupt pin**
 const byte encoderPinB = 2;   // rotary encoder B channel **interrupt pin**
@@ -115,17 +107,31 @@ const byte pushButton = A0;   // rotary encoder pushbutton
 const byte onewireData = A1;  // one-wire data
 const byte relay1 = A2;       // relay 1 (fridge compressor)
 const byte relay2 = A3;       // relay 2 (heating element)
+#if CHAMBERS > 1
+const byte relay3 = A4;       // relay 3 (second chamber compressor)
+const byte relay4 = A5;       // relay 4 (second chamber heating element)
+#endif
 
-volatile char encoderPos;    // a counter for the rotary encoder dial
-volatile byte encoderState;  // 3 bit-flag encoder state (A Channel)(B Channel)(is rotating)
-#define CHAN_A   0b100
-#define CHAN_B   0b010
-#define DEBOUNCE 0b001
+rotaryEncoder knob(encoderPinA, encoderPinB);  // detents queued by encoderEdge()
+debouncedButton button(pushButton);
+char encoderPos;  // position of the dial within the active screen's list, kept by uiTask
 
 OneWire onewire(onewireData);  // declare instance of the OneWire class to communicate with onewire sensors
-probe beer(&onewire), fridge(&onewire);
+probeFilter beerFilter, fridgeFilter;                    // control probes filter in floating point
+probeFilterQ16 ambientFilter, vesselFilter, coilFilter;  // monitoring probes in fixed point
+probe beer(&beerFilter), fridge(&fridgeFilter);            // control probes
+probe ambient(&ambientFilter), vessel(&vesselFilter), coil(&coilFilter);  // optional probes, read when present on the bus
+#if CHAMBERS > 1
+probeFilter vesselAirFilter;
+probe vesselAir(&vesselAirFilter);  // second chamber air
+#endif
+probeBus sensors(&onewire, 64);  // ROM codes cached by role at EEPROM 64-127
+const byte beerResolution = 12;    // DS18B20 resolution (9-12 bit); the slowest sets the conversion deadline
+const byte fridgeResolution = 12;
+const unsigned int airStuckSamples = 3600;  // one air reading this many samples in a row is a stuck sensor (1 h); beer may rest longer
 
-byte programState;  // 6 bit-flag program state -- (mainPID manual/auto)(heatPID manual/auto)(temp C/F)(fermentation profile on/off)(data capture on/off)(file operations) = 0b000000
+byte programState;  // 7 bit-flag program state -- (COOL model/peakEstimator)(mainPID manual/auto)(heatPID manual/auto)(temp C/F)(fermentation profile on/off)(data capture on/off)(file operations) = 0b0000000
+#define COOL_MODEL    0b1000000
 #define MAIN_PID_MODE 0b100000
 #define HEAT_PID_MODE 0b010000
 #define DISPLAY_UNIT  0b001000
@@ -133,15 +139,88 @@ byte programState;  // 6 bit-flag program state -- (mainPID manual/auto)(heatPID
 #define DATA_LOGGING  0b000010
 #define FILE_OPS      0b000001
 
-double Input, Setpoint, Output, Kp, Ki, Kd;  // SP, PV, CO, tuning params for main PID
-double heatInput, heatOutput, heatSetpoint, heatKp, heatKi, heatKd;  // SP, PV, CO tuning params for HEAT PID
-PID mainPID(&Input, &Output, &Setpoint, Kp, Ki, Kd, DIRECT);  // main PID instance for beer temp control (DIRECT: beer temperature ~ fridge(air) temperature)
-PID heatPID(&heatInput, &heatOutput, &heatSetpoint, heatKp, heatKi, heatKd, DIRECT);   // create instance of PID class for cascading HEAT control (HEATing is a DIRECT process)
+double Kp, Ki, Kd, heatKp, heatKi, heatKd;  // tuning params for main and HEAT PID, run by every chamber
+settingsStore settings;  // settings record ring at EEPROM 128-4095
+chamber chambers[chamberCount] = {  // probes, PIDs, fridge controller and relays of each fermenter
+  { &beer, &fridge, relay1, relay2, &programState, &settings },  // the chamber of the display and menu; peakEstimator persisted with the settings (the coolModel relearns)
+#if CHAMBERS > 1
+  { &vessel, &vesselAir, relay3, relay4 },  // second fermenter: both PIDs automatic, setpoint by telemetry
+#endif
+};
+double& Input = chambers[0].input;  // SP, PV, CO for main PID
+double& Setpoint = chambers[0].setpoint;
+double& Output = chambers[0].output;
+double& heatInput = chambers[0].heatInput;  // SP, PV, CO for HEAT PID
+double& heatSetpoint = chambers[0].heatSetpoint;
+double& heatOutput = chambers[0].heatOutput;
+pidEngine& mainPID = chambers[0].mainPID;  // main PID for beer temp control
+pidEngine& heatPID = chambers[0].heatPID;  // cascading HEAT control
+fridgeControl& mainFridge = chambers[0].controller;  // fridge COOL/HEAT controller
+const int stackReserve = 512;  // SRAM left to the stack when counting the chambers that would still fit
 
 LiquidCrystal lcd(lcd_rs, lcd_enable, lcd_d4, lcd_d5, lcd_d6, lcd_d7);  // declare instance of the LiquidCrystal class for 20x4 LCD
+lcdFrame screen(&lcd);    // shadow frame buffer for the main display pages
+scheduler sched;          // cooperative task scheduler; loop() runs it
+byte displayTaskId;       // woken on page changes
+#if TELEMETRY == true
+telemetry telem;          // binary telemetry and remote commands on Serial
+byte snapshotTaskId;      // period set by CMD_STREAM
+boolean streaming = true; // state snapshots enabled
+#endif
+
+const unsigned long mainSampleMs = 1000;  // main PID sample time, ms (matches the 1 Hz probe sample rate)
+const unsigned int relayPeriodMs = 100;   // fridge state machine and HEAT window resolution, ms
+const unsigned int logPeriodMs = 1000;    // datalogging interval, ms (1 Hz)
+const unsigned int uiPeriodMs = 20;       // encoder and push button polling, ms
+const unsigned int settingsPollMs = 20;   // settings commit pacing, ms (settingsCellsPerPoll cells per release)
+const unsigned int traceTaskMs = 50;      // trace command polling and dump pacing, ms
+const unsigned int telemPollMs = 10;      // telemetry TX drain and command polling, ms (~115 bytes at 115200 baud)
+const unsigned int telemPeriodMs = 1000;  // default state snapshot period, ms
+
+enum tuneLoops {  // loop under a relay auto-tuning experiment
+  TUNE_NONE,
+  TUNE_MAIN,      // beer temperature -> fridge target (Output)
+  TUNE_HEAT,      // air temperature -> heater duty (heatOutput)
+};
+relayTuner tuner;
+byte tuneLoop;            // TUNE_NONE when no experiment runs (not persisted: a reset ends it)
+double tuneSaved[2];      // Output and heatOutput before the experiment
+const double tuneMainStep = 4;            // main relay: fridge target = Setpoint +/- 4 deg C
+const double tuneMainHysteresis = 0.05;   // deg C, beer
+const unsigned long tuneMainTimeout = 172800000;  // ms (48 h)
+const byte tuneMainRule = TUNE_TYREUS_LUYBEN;
+const double tuneHeatHysteresis = 0.1;    // deg C, air
+const unsigned long tuneHeatTimeout = 21600000;   // ms (6 h)
+const byte tuneHeatRule = TUNE_TYREUS_LUYBEN;
+
+enum uiEvent {   // events delivered to the active screen handler
+  UI_ENTER,      // screen opened
+  UI_TURN,       // encoder moved (encoderPos already constrained to the screen's list size)
+  UI_PUSH,       // push button pressed
+  UI_RESUME,     // menu: returning from an option screen
+  UI_CANCEL,     // option screen: long press, leaving without a change
+};
+typedef void (*uiHandler)(byte event);
+uiHandler uiActive;  // active screen: mainPages, menu or a menu option
+byte uiStep;         // stage within a multi-step screen
+char uiListSize;     // encoder positions of the active screen
+char uiLastPos;      // encoderPos at the last UI_TURN
+char uiItem;         // menu item opened
+struct uiValue {     // value being entered by editValue()
+  double* target;
+  double value;      // display units while editing
+  const __FlashStringHelper* name;
+  boolean limit;     // constrain to the main PID Output range
+  byte manual;       // programState PID mode bits cleared when the value is entered; a cancel keeps the mode
+};
+uiValue uiEditing;
 RTC_DS1307 RTC;           // declare instance of Real-time Clock class
-File LogFile;             // declare datalogging File object
+timeKeeper wallClock;     // RTC time kept by millis(); read it instead of RTC.now()
+datalog LogFile;          // declare binary datalog (file + sector staging buffer)
 File ProFile;                      // declare fermentation profile File object
-QueueList <profileStep> profile;   // dynamic queue (FIFO) linked list; contains steps for temperature profile
+profileTable profile;              // steps of the running temperature profile
+profileParser profileReader;       // streams ProFile into profile
+char profileName[9];               // base name of the running profile, kept in the settings record
+profileRunner profileRun(&profile);  // running step of the profile
 
 #endif
@@ -0,0 +1,308 @@
+// npid-bench -- micro benchmarks of the firmware's numeric kernels on the host, with the error of each
+// variant against the original implementation it replaces (pid: exits 2 if the engines diverge), and the
+// cost of the control tasks against the number of chambers they run
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "../../chamber.h"
+#include "../../iir.h"
+#include "../../PID_fixed.h"
+#include "../../probe.h"
+#include "../linux.h"
+
+static uint64_t cycles() {  // time stamp counter where there is one, else nanoseconds
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static std::vector<double> probeTrace(size_t n, unsigned seed) {  // DS18B20 readings at 1 Hz: drift, cycling, steps, 1/16 C steps
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0, 0.03);
+  std::vector<double> v(n);
+  double drift = 18;
+  for (size_t i = 0; i < n; i++) {
+    drift += noise(rng) * 0.1;
+    double t = drift + 1.5 * sin(i * 2 * M_PI / 1800) + ((i / 20000) % 2 ? 4 : 0) + noise(rng);
+    v[i] = round(t * 16) / 16;
+  }
+  return v;
+}
+
+template <typename T> struct legacyFilter {  // probe::_updateFilter() before the iir template, as T arithmetic
+  T temp[4], filt[4];
+  void reset(double v) { for (int i = 0; i < 4; i++) temp[i] = filt[i] = v; }
+  double update(double v) {
+    for (int i = 3; i > 0; i--) { temp[i] = temp[i - 1]; filt[i] = filt[i - 1]; }
+    temp[0] = v;
+    filt[0] = (temp[3] + temp[0] + 3 * (temp[2] + temp[1])) / (T)1.092799972e+03
+              + ((T)0.6600489526 * filt[3]) + ((T)-2.2533982563 * filt[2]) + ((T)2.5860286592 * filt[1]);
+    return filt[0];
+  }
+};
+
+struct result {
+  double cyclesPerSample, nsPerSample, maxErr, rmsErr;
+};
+
+template <class F> static result run(F& f, const std::vector<double>& in, const std::vector<double>& ref, int reps) {
+  result r = { 1e30, 1e30, 0, 0 };
+  std::vector<double> out(in.size());
+  for (int k = 0; k < reps; k++) {  // best of reps
+    f.reset(in[0]);
+    std::chrono::steady_clock::time_point w0 = std::chrono::steady_clock::now();
+    uint64_t c0 = cycles();
+    for (size_t i = 0; i < in.size(); i++) out[i] = f.update(in[i]);
+    uint64_t c1 = cycles();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - w0).count();
+    r.cyclesPerSample = std::min(r.cyclesPerSample, (double)(c1 - c0) / in.size());
+    r.nsPerSample = std::min(r.nsPerSample, ns / in.size());
+  }
+  double sq = 0;
+  for (size_t i = 0; i < in.size(); i++) {
+    double e = fabs(out[i] - ref[i]);
+    r.maxErr = std::max(r.maxErr, e);
+    sq += e * e;
+  }
+  r.rmsErr = sqrt(sq / in.size());
+  return r;
+}
+
+static void print(const char* name, const result& r) {
+  printf("%-34s %9.1f %9.2f %12.3e %12.3e\n", name, r.cyclesPerSample, r.nsPerSample, r.maxErr, r.rmsErr);
+}
+
+static void benchFilter(size_t n, unsigned seed, int reps) {
+  std::vector<double> in = probeTrace(n, seed), ref(n);
+  legacyFilter<double> refFilter;
+  refFilter.reset(in[0]);
+  for (size_t i = 0; i < n; i++) ref[i] = refFilter.update(in[i]);
+
+  printf("probe filter: %zu samples, error against the original hand coded filter in double\n", n);
+  printf("%-34s %9s %9s %12s %12s\n", "variant", "cyc/smp", "ns/smp", "max err C", "rms err C");
+  legacyFilter<double> ld;
+  legacyFilter<float> lf;
+  iirFilter<3, probeLowPass, double> td;
+  iirFilter<3, probeLowPass, float> tf;
+  iirFilter<3, probeLowPass, fix16> tq;
+  print("original, double", run(ld, in, ref, reps));
+  print("original, float (AVR double)", run(lf, in, ref, reps));
+  print("iirFilter<3, double>", run(td, in, ref, reps));
+  print("iirFilter<3, float>", run(tf, in, ref, reps));
+  print("iirFilter<3, fix16> (Q16.16)", run(tq, in, ref, reps));
+  tempFilter* virt = &tq;  // as probe calls it
+  struct viaBase { tempFilter* f; void reset(double v) { f->reset(v); } double update(double v) { return f->update(v); } } vb = { virt };
+  print("iirFilter<3, fix16> via tempFilter", run(vb, in, ref, reps));
+}
+
+struct pidCase {  // one controller configuration from setup()
+  const char* name;
+  double kp, ki, kd;
+  unsigned long sampleTime;
+  double outMin, outMax;
+  int type;
+  double filter;
+  byte slope;  // SLOPE_ENDPOINT or SLOPE_REGRESSION over the default 30 x 10 window
+};
+
+template <class E> static void configure(E& pid, const pidCase& c) {
+  pid.SetTunings(c.kp, c.ki, c.kd);
+  pid.SetSampleTime(c.sampleTime);
+  pid.SetOutputLimits(c.outMin, c.outMax);
+  pid.SetMode(AUTOMATIC);
+  pid.setOutputType(c.type);
+  pid.setFilterConstant(c.filter);
+  pid.initHistory();
+  pid.setHistory(pidHistoryMax, 10, c.slope);
+}
+
+template <class E> static double timePid(const pidCase& c, const std::vector<double>& in, const std::vector<double>& sp,
+                                         std::vector<double>& out, int reps, double& nsPer) {
+  double best = 1e30;
+  nsPer = 1e30;
+  for (int k = 0; k < reps; k++) {  // best of reps, each from a fresh controller
+    double input = in[0], setpoint = sp[0], output = sp[0];
+    E pid(&input, &output, &setpoint, c.kp, c.ki, c.kd, DIRECT);
+    configure(pid, c);
+    unsigned long now = 0;
+    std::chrono::steady_clock::time_point w0 = std::chrono::steady_clock::now();
+    uint64_t c0 = cycles();
+    for (size_t i = 0; i < in.size(); i++) {
+      input = in[i];
+      setpoint = sp[i];
+      now += c.sampleTime;
+      pid.Compute(now);
+      out[i] = output;
+    }
+    uint64_t c1 = cycles();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - w0).count();
+    best = std::min(best, (double)(c1 - c0) / in.size());
+    nsPer = std::min(nsPer, ns / in.size());
+  }
+  return best;
+}
+
+static bool benchPid(size_t n, unsigned seed, int reps, double tolerance) {  // fixed against double, identical inputs
+  const pidCase cases[] = {  // settingsDefaults() tunings with the setup() configuration
+    { "mainPID", 10, 5e-4, 500, 1000, 0.3, 38, FILTERED, 10, SLOPE_ENDPOINT },
+    { "heatPID", 3.7e5, 175, 5.5e7, 300000, 0, 300000, RAW, 1, SLOPE_ENDPOINT },
+    { "mainLS", 10, 5e-4, 500, 1000, 0.3, 38, FILTERED, 10, SLOPE_REGRESSION },
+    { "heatLS", 3.7e5, 175, 5.5e7, 300000, 0, 300000, RAW, 1, SLOPE_REGRESSION },
+  };
+  std::vector<double> in = probeTrace(n, seed), sp(n), ref(n), fix(n);
+  std::mt19937 rng(seed + 1);
+  std::uniform_real_distribution<double> u(2, 24);
+  double setpoint = 18;
+  for (size_t i = 0; i < n; i++) {  // setpoint steps every few hours, on top of the probe trace
+    if (i % 14400 == 0) setpoint = round(u(rng) * 10) / 10;
+    sp[i] = setpoint;
+  }
+  bool ok = true;
+  printf("PID engines: %zu computes per case, fixed point against double on identical input and setpoint traces\n", n);
+  printf("%-8s %10s %10s %10s %10s %12s %12s %10s\n", "case", "dbl cyc", "fix cyc", "dbl ns", "fix ns",
+         "max |diff|", "of span", "at sample");
+  for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++) {
+    const pidCase& c = cases[k];
+    double dblNs, fixNs;
+    double dblCyc = timePid<PID>(c, in, sp, ref, reps, dblNs);
+    double fixCyc = timePid<PIDfixed>(c, in, sp, fix, reps, fixNs);
+    double worst = 0;
+    size_t at = 0;
+    for (size_t i = 0; i < n; i++) {
+      double d = fabs(fix[i] - ref[i]);
+      if (d > worst) { worst = d; at = i; }
+    }
+    double rel = worst / (c.outMax - c.outMin);
+    printf("%-8s %10.1f %10.1f %10.2f %10.2f %12.3e %12.3e %10zu\n", c.name, dblCyc, fixCyc, dblNs, fixNs, worst, rel, at);
+    if (rel > tolerance) ok = false;
+  }
+  printf("%s (tolerance %.1e of the output span)\n", ok ? "equivalent" : "DIVERGED", tolerance);
+  return ok;
+}
+
+struct chamberRig {  // a chamber with its probes and a crude plant: air pulled by the relays, beer following the air
+  probeFilter beerFilter, airFilter;
+  probe beer, air;
+  chamber ch;
+  double beerTemp, airTemp;
+  byte coolPin, heatPin;
+  byte state;
+
+  chamberRig(byte i) : beer(&beerFilter), air(&airFilter), ch(&beer, &air, 22 + 2 * i, 23 + 2 * i),
+                         beerTemp(20), airTemp(20), coolPin(22 + 2 * i), heatPin(23 + 2 * i), state(IDLE) {
+    beerFilter.reset(beerTemp);
+    airFilter.reset(airTemp);
+    ch.openRelays();
+    ch.sample();
+    ch.setpoint = ch.output = 4 + 2 * (i % 8);  // lagers to ales, so the chambers cool and heat out of step
+    ch.begin(1000, 10, 5e-4, 500, 3.7e5, 175, 5.5e7);
+  }
+  void step(linuxBoard& board) {  // one second
+    airTemp += (20 - airTemp) / 2000 + (beerTemp - airTemp) / 1000;
+    if (board.gpio.level(coolPin) == LOW) airTemp -= 0.01;
+    if (board.gpio.level(heatPin) == LOW) airTemp += 0.01;
+    beerTemp += (airTemp - beerTemp) / 5000;
+  }
+};
+
+static void benchChamber(size_t n, int reps, unsigned maxCount) {  // the sketch's probe, pid and fridge tasks for N chambers
+  linuxBoard board("", 0);
+  hal::attach(board.get());
+  const int relayPasses = 1000 / 100;  // fridgeTask releases per pidTask release (relayPeriodMs)
+  printf("chamber: sizeof %zu bytes on this host (mainPID %zu, heatPID %zu, fridgeControl %zu of which coolModel %zu),\n",
+         sizeof(chamber), sizeof(pidEngine), sizeof(pidEngine), sizeof(fridgeControl), sizeof(coolModel));
+  printf("         plus %zu per probe with its filter; AVR halves doubles and pointers (DEBUG builds print the board's own)\n",
+         sizeof(probe) + sizeof(probeFilter));
+  printf("control: %zu s per count, 1 PID compute and %d fridge updates per chamber per second\n", n, relayPasses);
+  printf("%8s %12s %12s %14s %16s\n", "chambers", "cyc/s", "ns/s", "ns/s/chamber", "COOL+HEAT/day");
+  for (unsigned count = 1; count <= maxCount; count *= 2) {
+    double bestCyc = 1e30, bestNs = 1e30;
+    unsigned long starts = 0;  // relay cycles of every chamber, same in every rep
+    for (int k = 0; k < reps; k++) {  // best of reps, each from fresh chambers
+      std::vector<std::unique_ptr<chamberRig> > cs;
+      for (unsigned i = 0; i < count; i++) cs.emplace_back(new chamberRig(i));
+      uint64_t cyc = 0;
+      double ns = 0;
+      starts = 0;
+      unsigned long now = 0;
+      for (size_t s = 0; s < n; s++) {
+        for (unsigned i = 0; i < count; i++) cs[i]->step(board);
+        std::chrono::steady_clock::time_point w0 = std::chrono::steady_clock::now();
+        uint64_t c0 = cycles();
+        for (unsigned i = 0; i < count; i++) {  // probeTask: a new sample on every probe
+          chamberRig& b = *cs[i];
+          b.beerFilter.update(round(b.beerTemp * 16) / 16);
+          b.airFilter.update(round(b.airTemp * 16) / 16);
+          b.ch.sample();
+        }
+        now += 1000;
+        for (unsigned i = 0; i < count; i++) cs[i]->ch.compute(now);  // pidTask
+        for (int r = 0; r < relayPasses; r++)  // fridgeTask
+          for (unsigned i = 0; i < count; i++) cs[i]->ch.update(now + r * 100);
+        uint64_t c1 = cycles();
+        double d = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - w0).count();
+        cyc += c1 - c0;
+        ns += d;
+        for (unsigned i = 0; i < count; i++) {
+          byte st = cs[i]->ch.controller.getState(0);
+          if ((st != cs[i]->state) && (st != IDLE)) starts++;
+          cs[i]->state = st;
+        }
+      }
+      bestCyc = std::min(bestCyc, (double)cyc / n);
+      bestNs = std::min(bestNs, ns / n);
+    }
+    printf("%8u %12.0f %12.0f %14.0f %16.1f\n", count, bestCyc, bestNs, bestNs / count, starts * 86400.0 / n / count);
+  }
+  hal::attach(0);
+}
+
+static void usage() {
+  fprintf(stderr,
+    "usage: npid-bench [options] [filter|pid|chamber]\n"
+    "  -n N      samples (default 1000000; chamber: simulated seconds, default 86400)\n"
+    "  -r N      repetitions, best is reported (default 5)\n"
+    "  -S SEED   input trace seed (default 1)\n"
+    "  -t TOL    pid: largest allowed fixed/double difference as a fraction of the output span (default 1e-4)\n"
+    "  -c N      chamber: largest chamber count, doubling from 1 (default 16)\n"
+    "cycles are host time stamp counter ticks; AVR costs scale with the operation mix, not these numbers\n");
+}
+
+int main(int argc, char** argv) {
+  size_t n = 1000000;
+  int reps = 5;
+  unsigned seed = 1;
+  double tolerance = 1e-4;
+  unsigned maxCount = 16;
+  bool nSet = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:r:S:t:c:h")) != -1) {
+    switch (opt) {
+      case 'n': n = strtoul(optarg, 0, 10); nSet = true; break;
+      case 'r': reps = atoi(optarg); break;
+      case 'S': seed = atoi(optarg); break;
+      case 't': tolerance = atof(optarg); break;
+      case 'c': maxCount = atoi(optarg); break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (n < 1 || reps < 1 || maxCount < 1 || maxCount > 16) { usage(); return 1; }  // 16: relay pins 22-53
+  std::string which = optind < argc ? argv[optind] : "filter";
+  if (which == "filter") benchFilter(n, seed, reps);
+    else if (which == "pid") return benchPid(n, seed, reps, tolerance) ? 0 : 2;
+    else if (which == "chamber") benchChamber(nSet ? n : 86400, reps, maxCount);
+    else { usage(); return 1; }
+  return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+// off-target stand-in for the AVR Arduino core (ATmega2560 pin map); hardware access goes through hal::current()
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "binary.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PI 3.1415926535897932384626433832795
+
+#define NUM_DIGITAL_PINS 70
+static const uint8_t A0 = 54;
+static const uint8_t A1 = 55;
+static const uint8_t A2 = 56;
+static const uint8_t A3 = 57;
+static const uint8_t A4 = 58;
+static const uint8_t A5 = 59;
+static const uint8_t A6 = 60;
+static const uint8_t A7 = 61;
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+#define pgm_read_float(addr) (*(const float*)(addr))
+#define memcpy_P memcpy
+#define strlen_P strlen
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+
+template <typename A, typename B> inline auto min(A a, B b) -> decltype(0 ? A() : B()) { return (a < b) ? a : b; }
+template <typename A, typename B> inline auto max(A a, B b) -> decltype(0 ? A() : B()) { return (a > b) ? a : b; }
+template <typename T, typename L, typename H> inline T constrain(T x, L lo, H hi) { return (x < lo) ? lo : ((x > hi) ? hi : x); }
+template <typename T> inline T sq(T x) { return x * x; }
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t irq, void (*isr)(), int mode);
+void detachInterrupt(uint8_t irq);
+inline void interrupts() {}
+inline void noInterrupts() {}
+
+#include "Print.h"
+#include "HardwareSerial.h"
+
+#endif
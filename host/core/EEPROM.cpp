@@ -0,0 +1,8 @@
+#include "EEPROM.h"
+#include "../hal.h"
+
+EEPROMClass EEPROM;
+
+uint8_t EEPROMClass::read(int addr) { return hal::current().eeprom->read(addr); }
+void EEPROMClass::write(int addr, uint8_t v) { hal::current().eeprom->write(addr, v); }
+uint16_t EEPROMClass::length() { return hal::current().eeprom->size(); }
@@ -0,0 +1,15 @@
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include "Arduino.h"
+
+class EEPROMClass {
+  public:
+    uint8_t read(int addr);
+    void write(int addr, uint8_t v);
+    uint16_t length();
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,10 @@
+#include "HardwareSerial.h"
+#include "../hal.h"
+
+HardwareSerial Serial;
+
+void HardwareSerial::begin(unsigned long baud) { hal::current().serial->begin(baud); }
+int HardwareSerial::available() { return hal::current().serial->available(); }
+int HardwareSerial::read() { return hal::current().serial->read(); }
+int HardwareSerial::availableForWrite() { return hal::current().serial->availableForWrite(); }
+size_t HardwareSerial::write(uint8_t v) { return hal::current().serial->write(v); }
@@ -0,0 +1,21 @@
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include "Print.h"
+
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long baud);
+    void end() {}
+    int available();
+    int read();
+    int availableForWrite();
+    void flush() {}
+    size_t write(uint8_t);
+    using Print::write;
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
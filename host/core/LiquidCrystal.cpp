@@ -0,0 +1,85 @@
+#include "LiquidCrystal.h"
+#include "../hal.h"
+
+// HD44780 instruction set (subset used by the LiquidCrystal library)
+#define LCD_CLEARDISPLAY   0x01
+#define LCD_RETURNHOME     0x02
+#define LCD_ENTRYMODESET   0x04
+#define LCD_DISPLAYCONTROL 0x08
+#define LCD_CURSORSHIFT    0x10
+#define LCD_FUNCTIONSET    0x20
+#define LCD_SETCGRAMADDR   0x40
+#define LCD_SETDDRAMADDR   0x80
+
+#define LCD_ENTRYLEFT           0x02
+#define LCD_ENTRYSHIFTINCREMENT 0x01
+#define LCD_DISPLAYON 0x04
+#define LCD_CURSORON  0x02
+#define LCD_BLINKON   0x01
+#define LCD_DISPLAYMOVE 0x08
+#define LCD_MOVERIGHT   0x04
+#define LCD_MOVELEFT    0x00
+#define LCD_2LINE 0x08
+
+const unsigned int lcdByteUs = 240;    // 4-bit transfer: two nibbles, each followed by the library's 100us settle delay
+const unsigned int lcdHomeUs = 2000;   // clear()/home() execution time
+
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3)
+  : _displaycontrol(0), _displaymode(0), _numlines(1) {
+  for (int i = 0; i < 4; i++) _row_offsets[i] = 0;
+}
+
+void LiquidCrystal::begin(uint8_t cols, uint8_t lines) {
+  _numlines = lines;
+  _row_offsets[0] = 0x00;
+  _row_offsets[1] = 0x40;
+  _row_offsets[2] = 0x00 + cols;
+  _row_offsets[3] = 0x40 + cols;
+  hal::current().lcd->begin(cols, lines);
+  delayMicroseconds(50000);
+  command(LCD_FUNCTIONSET | LCD_2LINE);
+  _displaycontrol = LCD_DISPLAYON;
+  display();
+  clear();
+  _displaymode = LCD_ENTRYLEFT;
+  command(LCD_ENTRYMODESET | _displaymode);
+}
+
+void LiquidCrystal::clear() { command(LCD_CLEARDISPLAY); delayMicroseconds(lcdHomeUs); }
+void LiquidCrystal::home() { command(LCD_RETURNHOME); delayMicroseconds(lcdHomeUs); }
+
+void LiquidCrystal::setCursor(uint8_t col, uint8_t row) {
+  if (row >= 4) row = 3;
+  if (row >= _numlines) row = _numlines - 1;
+  command(LCD_SETDDRAMADDR | (col + _row_offsets[row]));
+}
+
+void LiquidCrystal::noDisplay() { _displaycontrol &= ~LCD_DISPLAYON; command(LCD_DISPLAYCONTROL | _displaycontrol); }
+void LiquidCrystal::display() { _displaycontrol |= LCD_DISPLAYON; command(LCD_DISPLAYCONTROL | _displaycontrol); }
+void LiquidCrystal::noCursor() { _displaycontrol &= ~LCD_CURSORON; command(LCD_DISPLAYCONTROL | _displaycontrol); }
+void LiquidCrystal::cursor() { _displaycontrol |= LCD_CURSORON; command(LCD_DISPLAYCONTROL | _displaycontrol); }
+void LiquidCrystal::noBlink() { _displaycontrol &= ~LCD_BLINKON; command(LCD_DISPLAYCONTROL | _displaycontrol); }
+void LiquidCrystal::blink() { _displaycontrol |= LCD_BLINKON; command(LCD_DISPLAYCONTROL | _displaycontrol); }
+void LiquidCrystal::scrollDisplayLeft() { command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVELEFT); }
+void LiquidCrystal::scrollDisplayRight() { command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVERIGHT); }
+void LiquidCrystal::leftToRight() { _displaymode |= LCD_ENTRYLEFT; command(LCD_ENTRYMODESET | _displaymode); }
+void LiquidCrystal::rightToLeft() { _displaymode &= ~LCD_ENTRYLEFT; command(LCD_ENTRYMODESET | _displaymode); }
+void LiquidCrystal::autoscroll() { _displaymode |= LCD_ENTRYSHIFTINCREMENT; command(LCD_ENTRYMODESET | _displaymode); }
+void LiquidCrystal::noAutoscroll() { _displaymode &= ~LCD_ENTRYSHIFTINCREMENT; command(LCD_ENTRYMODESET | _displaymode); }
+
+void LiquidCrystal::createChar(uint8_t location, uint8_t charmap[]) {
+  location &= 0x7;
+  command(LCD_SETCGRAMADDR | (location << 3));
+  for (int i = 0; i < 8; i++) write(charmap[i]);
+}
+
+void LiquidCrystal::command(uint8_t value) {
+  hal::current().lcd->command(value);
+  delayMicroseconds(lcdByteUs);
+}
+
+size_t LiquidCrystal::write(uint8_t value) {
+  hal::current().lcd->data(value);
+  delayMicroseconds(lcdByteUs);
+  return 1;
+}
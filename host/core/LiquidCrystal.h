@@ -0,0 +1,37 @@
+#ifndef LiquidCrystal_h
+#define LiquidCrystal_h
+
+#include "Arduino.h"
+
+class LiquidCrystal : public Print {  // HD44780 in 4-bit mode; instruction/data bytes go to hal::lcdPanel
+  public:
+    LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3);
+    void begin(uint8_t cols, uint8_t rows);
+    void clear();
+    void home();
+    void noDisplay();
+    void display();
+    void noBlink();
+    void blink();
+    void noCursor();
+    void cursor();
+    void scrollDisplayLeft();
+    void scrollDisplayRight();
+    void leftToRight();
+    void rightToLeft();
+    void autoscroll();
+    void noAutoscroll();
+    void createChar(uint8_t location, uint8_t charmap[]);
+    void setCursor(uint8_t col, uint8_t row);
+    virtual size_t write(uint8_t);
+    void command(uint8_t);
+    using Print::write;
+
+  private:
+    uint8_t _displaycontrol;
+    uint8_t _displaymode;
+    uint8_t _numlines;
+    uint8_t _row_offsets[4];
+};
+
+#endif
@@ -0,0 +1,39 @@
+#include "OneWire.h"
+#include "../hal.h"
+
+uint8_t OneWire::reset() { return hal::current().wire->reset(); }
+
+void OneWire::select(const uint8_t rom[8]) {
+  write(0x55);  // MATCH ROM
+  for (uint8_t i = 0; i < 8; i++) write(rom[i]);
+}
+
+void OneWire::skip() { write(0xCC); }  // SKIP ROM
+void OneWire::write(uint8_t v, uint8_t power) { hal::current().wire->writeByte(v); }
+
+void OneWire::write_bytes(const uint8_t* buf, uint16_t count, bool power) {
+  for (uint16_t i = 0; i < count; i++) write(buf[i]);
+}
+
+uint8_t OneWire::read() { return hal::current().wire->readByte(); }
+
+void OneWire::read_bytes(uint8_t* buf, uint16_t count) {
+  for (uint16_t i = 0; i < count; i++) buf[i] = read();
+}
+
+void OneWire::reset_search() { hal::current().wire->resetSearch(); }
+uint8_t OneWire::search(uint8_t* newAddr) { return hal::current().wire->search(newAddr); }
+
+uint8_t OneWire::crc8(const uint8_t* addr, uint8_t len) {  // Dallas/Maxim CRC-8, x^8 + x^5 + x^4 + 1
+  uint8_t crc = 0;
+  while (len--) {
+    uint8_t inbyte = *addr++;
+    for (uint8_t i = 8; i; i--) {
+      uint8_t mix = (crc ^ inbyte) & 0x01;
+      crc >>= 1;
+      if (mix) crc ^= 0x8C;
+      inbyte >>= 1;
+    }
+  }
+  return crc;
+}
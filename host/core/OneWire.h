@@ -0,0 +1,25 @@
+#ifndef OneWire_h
+#define OneWire_h
+
+#include "Arduino.h"
+
+class OneWire {  // 1-wire master; byte level transactions are delegated to hal::oneWireBus
+  public:
+    OneWire(uint8_t pin) : _pin(pin) {}
+    uint8_t reset();
+    void select(const uint8_t rom[8]);
+    void skip();
+    void write(uint8_t v, uint8_t power = 0);
+    void write_bytes(const uint8_t* buf, uint16_t count, bool power = 0);
+    uint8_t read();
+    void read_bytes(uint8_t* buf, uint16_t count);
+    void depower() {}
+    void reset_search();
+    uint8_t search(uint8_t* newAddr);
+    static uint8_t crc8(const uint8_t* addr, uint8_t len);
+
+  private:
+    uint8_t _pin;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef _QUEUELIST_H
+#define _QUEUELIST_H
+
+#include "Arduino.h"
+
+template <typename T> class QueueList {  // FIFO linked list with the interface of the Arduino QueueList library
+    struct node { T item; node* next; };
+    node* head;
+    node* tail;
+    int size;
+
+  public:
+    QueueList() : head(0), tail(0), size(0) {}
+    ~QueueList() { while (!isEmpty()) pop(); }
+
+    void push(const T i) {
+      node* n = new node;
+      n->item = i;
+      n->next = 0;
+      if (tail) tail->next = n;
+        else head = n;
+      tail = n;
+      size++;
+    }
+
+    T pop() {
+      if (isEmpty()) return T();
+      node* n = head;
+      T item = n->item;
+      head = n->next;
+      if (!head) tail = 0;
+      delete n;
+      size--;
+      return item;
+    }
+
+    T peek() const { return isEmpty() ? T() : head->item; }
+    bool isEmpty() const { return head == 0; }
+    int count() const { return size; }
+};
+
+#endif
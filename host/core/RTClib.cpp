@@ -0,0 +1,61 @@
+#include "RTClib.h"
+#include "../hal.h"
+
+#define SECONDS_FROM_1970_TO_2000 946684800
+
+static const uint8_t daysInMonth[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+static uint16_t date2days(uint16_t y, uint8_t m, uint8_t d) {
+  if (y >= 2000) y -= 2000;
+  uint16_t days = d;
+  for (uint8_t i = 1; i < m; ++i) days += daysInMonth[i - 1];
+  if (m > 2 && y % 4 == 0) ++days;
+  return days + 365 * y + (y + 3) / 4 - 1;
+}
+
+static long time2long(uint16_t days, uint8_t h, uint8_t m, uint8_t s) {
+  return ((days * 24L + h) * 60 + m) * 60 + s;
+}
+
+DateTime::DateTime(uint32_t t) {
+  if (t < SECONDS_FROM_1970_TO_2000) t = SECONDS_FROM_1970_TO_2000;
+  t -= SECONDS_FROM_1970_TO_2000;
+  ss = t % 60;
+  t /= 60;
+  mm = t % 60;
+  t /= 60;
+  hh = t % 24;
+  uint16_t days = t / 24;
+  uint8_t leap;
+  for (yOff = 0; ; ++yOff) {
+    leap = yOff % 4 == 0;
+    if (days < 365 + leap) break;
+    days -= 365 + leap;
+  }
+  for (m = 1; ; ++m) {
+    uint8_t daysPerMonth = daysInMonth[m - 1];
+    if (leap && m == 2) ++daysPerMonth;
+    if (days < daysPerMonth) break;
+    days -= daysPerMonth;
+  }
+  d = days + 1;
+}
+
+DateTime::DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t min, uint8_t sec) {
+  if (year >= 2000) year -= 2000;
+  yOff = year;
+  m = month;
+  d = day;
+  hh = hour;
+  mm = min;
+  ss = sec;
+}
+
+uint8_t DateTime::dayOfWeek() const { return (date2days(yOff, m, d) + 6) % 7; }  // Jan 1, 2000 is a Saturday
+
+uint32_t DateTime::unixtime() const {
+  return time2long(date2days(yOff, m, d), hh, mm, ss) + SECONDS_FROM_1970_TO_2000;
+}
+
+void RTC_DS1307::adjust(const DateTime& dt) { hal::current().rtc->adjust(dt.unixtime()); }
+DateTime RTC_DS1307::now() { return DateTime(hal::current().rtc->now()); }
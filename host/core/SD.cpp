@@ -0,0 +1,112 @@
+#include "SD.h"
+#include "../hal.h"
+
+SDClass SD;
+void (*SdFile::_dateTime)(uint16_t* date, uint16_t* time) = 0;
+
+static hal::fileSystem& fs() { return *hal::current().fs; }
+
+boolean SDClass::begin(uint8_t csPin, int8_t mosi, int8_t miso, int8_t sck) { return fs().begin(); }
+static void stampDateTime() {  // SdFat asks for a timestamp whenever it creates or syncs a directory entry
+  if (!SdFile::_dateTime) return;
+  uint16_t date, time;
+  SdFile::_dateTime(&date, &time);
+}
+
+File SDClass::open(const char* filepath, uint8_t mode) {
+  bool created = (mode & O_CREAT) && !fs().exists(filepath);
+  File f(fs().open(filepath, mode));
+  if (f && created) stampDateTime();
+  return f;
+}
+boolean SDClass::exists(const char* filepath) { return fs().exists(filepath); }
+boolean SDClass::mkdir(const char* filepath) { return fs().mkdir(filepath); }
+boolean SDClass::remove(const char* filepath) { return fs().remove(filepath); }
+
+size_t File::write(uint8_t v) { return write(&v, 1); }
+
+size_t File::write(const uint8_t* buf, size_t size) {
+  if (_h < 0) return 0;
+  return fs().write(_h, buf, size);
+}
+
+int File::read() {
+  uint8_t v;
+  return read(&v, 1) == 1 ? v : -1;
+}
+
+int File::read(void* buf, uint16_t nbyte) {
+  if (_h < 0) return -1;
+  return fs().read(_h, (uint8_t*)buf, nbyte);
+}
+
+int File::peek() { return _h < 0 ? -1 : fs().peek(_h); }
+int File::available() { return _h < 0 ? 0 : (int)(size() - position()); }
+void File::flush() {
+  if (_h < 0) return;
+  stampDateTime();
+  fs().flush(_h);
+}
+boolean File::seek(uint32_t pos) { return _h >= 0 && fs().seek(_h, pos); }
+uint32_t File::position() { return _h < 0 ? 0 : fs().position(_h); }
+uint32_t File::size() { return _h < 0 ? 0 : fs().size(_h); }
+
+void File::close() {
+  if (_h >= 0) fs().close(_h);
+  _h = -1;
+}
+
+char* File::name() { return (char*)(_h < 0 ? "" : fs().name(_h)); }
+boolean File::isDirectory() { return _h >= 0 && fs().isDirectory(_h); }
+File File::openNextFile(uint8_t mode) { return File(_h < 0 ? -1 : fs().openNext(_h, mode)); }
+void File::rewindDirectory() { if (_h >= 0) fs().rewindDirectory(_h); }
+
+uint8_t Sd2Card::init(uint8_t sckRateID, uint8_t chipSelectPin, int8_t mosi, int8_t miso, int8_t sck) { return fs().begin(); }
+uint8_t Sd2Card::readBlock(uint32_t block, uint8_t* dst) { return fs().readBlock(block, dst); }
+uint8_t Sd2Card::writeStart(uint32_t blockNumber, uint32_t eraseCount) { return fs().writeStart(blockNumber, eraseCount); }
+uint8_t Sd2Card::writeData(const uint8_t* src) { return fs().writeData(src); }
+uint8_t Sd2Card::writeStop() { return fs().writeStop(); }
+uint8_t Sd2Card::erase(uint32_t firstBlock, uint32_t lastBlock) { return fs().erase(firstBlock, lastBlock); }
+
+uint8_t SdFile::open(SdFile* dirFile, const char* fileName, uint8_t oflag) {
+  if (isOpen() || !dirFile || !dirFile->_root) return false;
+  bool created = (oflag & O_CREAT) && !fs().exists(fileName);
+  _h = fs().open(fileName, oflag);
+  if (_h >= 0 && created) stampDateTime();
+  return _h >= 0;
+}
+
+uint8_t SdFile::createContiguous(SdFile* dirFile, const char* fileName, uint32_t size) {
+  if (isOpen() || !dirFile || !dirFile->_root) return false;
+  _h = fs().createContiguous(fileName, size);
+  if (_h >= 0) stampDateTime();
+  return _h >= 0;
+}
+
+uint8_t SdFile::contiguousRange(uint32_t* bgnBlock, uint32_t* endBlock) { return _h >= 0 && fs().extent(_h, bgnBlock, endBlock); }
+
+uint8_t SdFile::close() {
+  if (_h >= 0) fs().close(_h);
+  _h = -1;
+  _root = false;
+  return true;
+}
+
+uint32_t SdFile::fileSize() const { return _h < 0 ? 0 : fs().size(_h); }
+uint32_t SdFile::curPosition() const { return _h < 0 ? 0 : fs().position(_h); }
+uint8_t SdFile::seekSet(uint32_t pos) { return _h >= 0 && fs().seek(_h, pos); }
+int16_t SdFile::read(void* buf, uint16_t nbyte) { return _h < 0 ? -1 : fs().read(_h, (uint8_t*)buf, nbyte); }
+size_t SdFile::write(const uint8_t* buf, size_t nbyte) { return _h < 0 ? 0 : fs().write(_h, buf, nbyte); }
+
+uint8_t SdFile::sync() {
+  if (_h < 0) return false;
+  stampDateTime();
+  fs().flush(_h);
+  return true;
+}
+
+uint8_t SdFile::truncate(uint32_t size) {
+  if (_h < 0) return false;
+  stampDateTime();
+  return fs().truncate(_h, size);
+}
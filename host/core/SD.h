@@ -0,0 +1,108 @@
+#ifndef __SD_H__
+#define __SD_H__
+
+#include "Arduino.h"
+
+#define O_READ   0x01
+#define O_RDONLY O_READ
+#define O_WRITE  0x02
+#define O_WRONLY O_WRITE
+#define O_RDWR   (O_READ | O_WRITE)
+#define O_APPEND 0x04
+#define O_SYNC   0x08
+#define O_CREAT  0x10
+#define O_EXCL   0x20
+#define O_TRUNC  0x40
+
+#define FILE_READ  O_READ
+#define FILE_WRITE (O_READ | O_WRITE | O_CREAT | O_APPEND)
+
+#define FAT_DATE(year, month, day) (uint16_t)(((year) - 1980) << 9 | (month) << 5 | (day))
+#define FAT_TIME(hour, minute, second) (uint16_t)((hour) << 11 | (minute) << 5 | (second) >> 1)
+
+#define SPI_FULL_SPEED    0
+#define SPI_HALF_SPEED    1
+#define SPI_QUARTER_SPEED 2
+
+class Sd2Card {  // raw block access; multi-block writes stream straight into pre-allocated files
+  public:
+    uint8_t init(uint8_t sckRateID = SPI_FULL_SPEED, uint8_t chipSelectPin = 10, int8_t mosi = -1, int8_t miso = -1, int8_t sck = -1);
+    uint8_t readBlock(uint32_t block, uint8_t* dst);
+    uint8_t writeStart(uint32_t blockNumber, uint32_t eraseCount);
+    uint8_t writeData(const uint8_t* src);
+    uint8_t writeStop();
+    uint8_t erase(uint32_t firstBlock, uint32_t lastBlock);
+};
+
+class SdVolume {
+  public:
+    uint8_t init(Sd2Card* dev) { return dev != 0; }
+};
+
+class SdFile : public Print {  // SdFat file; only the root directory is modelled
+  public:
+    SdFile() : _h(-1), _root(false) {}
+    uint8_t openRoot(SdVolume* vol) { _root = true; return vol != 0; }
+    uint8_t open(SdFile* dirFile, const char* fileName, uint8_t oflag);
+    uint8_t createContiguous(SdFile* dirFile, const char* fileName, uint32_t size);
+    uint8_t contiguousRange(uint32_t* bgnBlock, uint32_t* endBlock);
+    uint8_t close();
+    uint8_t isOpen() const { return _h >= 0 || _root; }
+    uint32_t fileSize() const;
+    uint32_t curPosition() const;
+    uint8_t seekSet(uint32_t pos);
+    int16_t read(void* buf, uint16_t nbyte);
+    virtual size_t write(uint8_t v) { return write(&v, 1); }
+    virtual size_t write(const uint8_t* buf, size_t nbyte);
+    using Print::write;
+    uint8_t sync();
+    uint8_t truncate(uint32_t size);
+
+    static void dateTimeCallback(void (*dateTime)(uint16_t* date, uint16_t* time)) { _dateTime = dateTime; }
+    static void dateTimeCallbackCancel() { _dateTime = 0; }
+    static void (*_dateTime)(uint16_t* date, uint16_t* time);
+
+  private:
+    int _h;
+    bool _root;
+};
+
+class File : public Print {  // handle onto a hal::fileSystem entry; copies share the same open file
+  public:
+    File() : _h(-1) {}
+    explicit File(int h) : _h(h) {}
+    virtual size_t write(uint8_t);
+    virtual size_t write(const uint8_t* buf, size_t size);
+    using Print::write;
+    int read();
+    int read(void* buf, uint16_t nbyte);
+    int peek();
+    int available();
+    void flush();
+    boolean seek(uint32_t pos);
+    uint32_t position();
+    uint32_t size();
+    void close();
+    operator bool() const { return _h >= 0; }
+    char* name();
+    boolean isDirectory();
+    File openNextFile(uint8_t mode = O_RDONLY);
+    void rewindDirectory();
+
+  private:
+    int _h;
+};
+
+class SDClass {
+  public:
+    boolean begin(uint8_t csPin = 10, int8_t mosi = -1, int8_t miso = -1, int8_t sck = -1);
+    File open(const char* filepath, uint8_t mode = FILE_READ);
+    boolean exists(const char* filepath);
+    boolean mkdir(const char* filepath);
+    boolean remove(const char* filepath);
+    boolean rmdir(const char* filepath) { return remove(filepath); }
+};
+
+extern SDClass SD;
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef _SPI_H_INCLUDED
+#define _SPI_H_INCLUDED
+
+#include "Arduino.h"
+
+class SPIClass {
+  public:
+    static void begin() {}
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef Serial_h
+#define Serial_h
+
+#include "Arduino.h"
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include "Arduino.h"
+
+class TwoWire {  // RTC traffic is modelled by hal::rtcSource; the bus itself needs no state off-target
+  public:
+    void begin() {}
+};
+
+extern TwoWire Wire;
+
+#endif
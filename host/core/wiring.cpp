@@ -0,0 +1,23 @@
+#include "Arduino.h"
+#include "avr/wdt.h"
+#include "Wire.h"
+#include "SPI.h"
+#include "../hal.h"
+
+TwoWire Wire;
+SPIClass SPI;
+
+unsigned long millis() { return (uint32_t)(hal::current().clock->micros() / 1000); }  // wraps after ~49.7 days like the AVR core
+unsigned long micros() { return (uint32_t)hal::current().clock->micros(); }
+void delay(unsigned long ms) { hal::current().clock->advance((uint64_t)ms * 1000); }
+void delayMicroseconds(unsigned int us) { hal::current().clock->advance(us); }
+
+void pinMode(uint8_t pin, uint8_t mode) { hal::current().gpio->pinMode(pin, mode); }
+void digitalWrite(uint8_t pin, uint8_t level) { hal::current().gpio->write(pin, level); }
+int digitalRead(uint8_t pin) { return hal::current().gpio->read(pin); }
+void attachInterrupt(uint8_t irq, void (*isr)(), int mode) { hal::current().gpio->attachInterrupt(irq, isr, mode); }
+void detachInterrupt(uint8_t irq) { hal::current().gpio->detachInterrupt(irq); }
+
+void wdt_enable(uint8_t timeout) { hal::current().wdt->enable(timeout); }
+void wdt_reset() { hal::current().wdt->reset(); }
+void wdt_disable() { hal::current().wdt->disable(); }
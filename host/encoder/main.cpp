@@ -0,0 +1,248 @@
+// npid-encoder -- rotary encoder and push button input test: drives bouncy contact sequences onto the
+// encoder pins (through the pin interrupts, as the sketch attaches them) and the push button pin, polls
+// both at uiPeriodMs as uiTask does, and checks the detents, pushes and holds against what the sequence
+// was made of (exits 1 on any difference or a dropped detent).
+//
+// sequences are generated from a seed: runs of detents in either direction at random speeds, every
+// contact change followed by a burst of bounce, and short and long presses of the button with bounce on
+// press and release.  -w writes the generated sequence as an edge file; -f replays one instead, e.g. a
+// capture from a logic analyser.  an edge file has one line per change, "us A B button" with the pin
+// levels from that time on (0/1), and a "# expect cw=N ccw=N pushes=N holds=N" line.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <random>
+#include <vector>
+#include "../../encoder.h"
+#include "../linux.h"
+
+static const byte pinA = 3, pinB = 2, pinButton = A0;  // encoderPinA, encoderPinB and pushButton
+static const unsigned int pollMs = 20;                // uiPeriodMs
+
+static rotaryEncoder knob(pinA, pinB);
+static debouncedButton button(pinButton);
+static void encoderEdge() { knob.edge(); }
+
+struct edge {
+  uint64_t us;
+  byte a, b, button;
+};
+
+struct counts {
+  long cw, ccw, pushes, holds;
+};
+
+static void usage() {
+  fprintf(stderr,
+    "usage: npid-encoder [options]\n"
+    "  -n N     detents to generate (default 2000), with about one press per 20 detents\n"
+    "  -b US    longest bounce burst after a contact change, us (default 1500)\n"
+    "  -s SEED  random seed (default 1)\n"
+    "  -w FILE  write the generated sequence as an edge file\n"
+    "  -f FILE  replay an edge file instead of generating\n"
+    "  -v       print every event as it is decoded\n");
+}
+
+class generator {  // edges of a sequence, in time order, and what it should decode to
+    std::mt19937 _rng;
+    uint64_t _bounceUs;
+    uint64_t _t;
+    byte _a, _b, _button;
+
+    unsigned long uniform(unsigned long lo, unsigned long hi) { return lo + _rng() % (hi - lo + 1); }
+    void emit() { edges.push_back((edge){ _t, _a, _b, _button }); }
+    void change(byte& pin, byte level) {  // a contact closing or opening: chatter for a while, then settle
+      uint64_t end = _t + uniform(0, _bounceUs);
+      while (_t < end) {
+        pin = !pin;
+        emit();
+        _t += uniform(10, 300);
+      }
+      if (pin != level) {
+        pin = level;
+        emit();
+      }
+    }
+
+  public:
+    std::vector<edge> edges;
+    counts expect;
+
+    generator(unsigned seed, uint64_t bounceUs) : _rng(seed), _bounceUs(bounceUs), _t(1000000), _a(1), _b(1), _button(1) {
+      memset(&expect, 0, sizeof(expect));
+      emit();
+    }
+    void detent(boolean cw, unsigned long quarterUs) {  // 11 01 00 10 11 clockwise (A leads B), reversed ccw
+      static const byte seq[4][2] = { { 0, 1 }, { 0, 0 }, { 1, 0 }, { 1, 1 } };
+      for (byte i = 0; i < 4; i++) {
+        byte k = cw ? i : (2 - i) & 3;
+        byte a = seq[k][0], b = seq[k][1];
+        if (a != _a) change(_a, a);
+        if (b != _b) change(_b, b);
+        _t += quarterUs;
+      }
+      if (cw) expect.cw++;
+        else expect.ccw++;
+    }
+    void press(unsigned long ms) {
+      change(_button, 0);
+      _t += ms * 1000;
+      change(_button, 1);
+      if (ms > buttonHoldMs) expect.holds++;  // run() keeps clear of the threshold
+        else expect.pushes++;
+    }
+    void pause(unsigned long ms) { _t += ms * 1000; }
+    void run(long detents) {
+      while (detents > 0) {
+        long n = std::min(detents, (long)uniform(1, 40));
+        boolean cw = _rng() & 1;
+        unsigned long quarterUs = uniform(_bounceUs + 500, 25000);  // up to ~100 detents/s between the bursts
+        for (long i = 0; i < n; i++) detent(cw, quarterUs);
+        detents -= n;
+        pause(uniform(2 * pollMs, 500));  // direction changes fall into different polls
+        if (uniform(0, 1)) {
+          press(uniform(0, 3) ? uniform(80, 600) : uniform(1300, 3000));
+          pause(uniform(2 * pollMs, 300));
+        }
+      }
+      pause(buttonHoldMs);
+      emit();  // the last levels hold until the end
+    }
+};
+
+static boolean readEdges(const char* path, std::vector<edge>& edges, counts& expect) {
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  memset(&expect, -1, sizeof(expect));
+  char line[200];
+  int n = 0;
+  while (fgets(line, sizeof(line), f)) {
+    n++;
+    if (line[0] == '#') {
+      sscanf(line, "# expect cw=%ld ccw=%ld pushes=%ld holds=%ld", &expect.cw, &expect.ccw, &expect.pushes, &expect.holds);
+      continue;
+    }
+    unsigned long long us;
+    int a, b, s;
+    if (sscanf(line, "%llu %d %d %d", &us, &a, &b, &s) != 4) {
+      if (strspn(line, " \t\r\n") == strlen(line)) continue;
+      fprintf(stderr, "%s:%d: expected \"us A B button\"\n", path, n);
+      fclose(f);
+      return false;
+    }
+    if (!edges.empty() && (us < edges.back().us)) {
+      fprintf(stderr, "%s:%d: time goes backwards\n", path, n);
+      fclose(f);
+      return false;
+    }
+    edges.push_back((edge){ us, (byte)!!a, (byte)!!b, (byte)!!s });
+  }
+  fclose(f);
+  return true;
+}
+
+static void writeEdges(const char* path, const std::vector<edge>& edges, const counts& expect) {
+  FILE* f = fopen(path, "w");
+  if (!f) {
+    perror(path);
+    return;
+  }
+  fprintf(f, "# npid-encoder edge file: us A B button\n");
+  fprintf(f, "# expect cw=%ld ccw=%ld pushes=%ld holds=%ld\n", expect.cw, expect.ccw, expect.pushes, expect.holds);
+  for (size_t i = 0; i < edges.size(); i++)
+    fprintf(f, "%llu %d %d %d\n", (unsigned long long)edges[i].us, edges[i].a, edges[i].b, edges[i].button);
+  fclose(f);
+}
+
+int main(int argc, char** argv) {
+  long detents = 2000;
+  unsigned long bounceUs = 1500;
+  unsigned seed = 1;
+  const char* in = 0;
+  const char* out = 0;
+  bool verbose = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:b:s:w:f:vh")) != -1) {
+    switch (opt) {
+      case 'n': detents = atol(optarg); break;
+      case 'b': bounceUs = strtoul(optarg, 0, 10); break;
+      case 's': seed = strtoul(optarg, 0, 10); break;
+      case 'w': out = optarg; break;
+      case 'f': in = optarg; break;
+      case 'v': verbose = true; break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  std::vector<edge> edges;
+  counts expect;
+  if (in) {
+    if (!readEdges(in, edges, expect)) return 1;
+  }
+  else {
+    generator g(seed, bounceUs);
+    g.run(detents);
+    edges.swap(g.edges);
+    expect = g.expect;
+    if (out) writeEdges(out, edges, expect);
+  }
+  if (edges.empty()) {
+    fprintf(stderr, "no edges\n");
+    return 1;
+  }
+
+  linuxBoard board("", 0);
+  hal::attach(board.get());
+  pinBank& gpio = board.gpio;
+  board.clock.advance(edges[0].us);
+  knob.begin();
+  button.begin();
+  gpio.drive(pinA, edges[0].a);  // levels when the sketch starts
+  gpio.drive(pinB, edges[0].b);
+  gpio.drive(pinButton, edges[0].button);
+  attachInterrupt(0, encoderEdge, CHANGE);  // as setup()
+  attachInterrupt(1, encoderEdge, CHANGE);
+
+  counts got;
+  memset(&got, 0, sizeof(got));
+  unsigned long changes = 0, polls = 0;
+  uint64_t nextPoll = edges[0].us;
+  for (size_t i = 1; i <= edges.size(); i++) {
+    uint64_t until = (i < edges.size()) ? edges[i].us : edges.back().us;
+    while (nextPoll <= until) {  // uiTask passes before the next change
+      board.clock.advance(nextPoll - board.clock.micros());
+      char d = knob.read();
+      if (d > 0) got.cw += d;
+        else got.ccw -= d;
+      byte ev = button.poll(millis());
+      if (ev == BUTTON_PUSH) got.pushes++;
+      if (ev == BUTTON_HOLD) got.holds++;
+      if (verbose && (d || ev)) printf("%10.3f s  detents %+d%s\n", nextPoll / 1e6, d, ev == BUTTON_PUSH ? "  push" : ev == BUTTON_HOLD ? "  hold" : "");
+      polls++;
+      nextPoll += pollMs * 1000;
+    }
+    if (i == edges.size()) break;
+    board.clock.advance(edges[i].us - board.clock.micros());
+    changes += (gpio.read(pinA) != edges[i].a) + (gpio.read(pinB) != edges[i].b) + (gpio.read(pinButton) != edges[i].button);
+    gpio.drive(pinA, edges[i].a);  // one pin per line in practice; A first if both
+    gpio.drive(pinB, edges[i].b);
+    gpio.drive(pinButton, edges[i].button);
+  }
+
+  printf("%lu pin changes over %.1f s, %lu polls\n", changes, (edges.back().us - edges[0].us) / 1e6, polls);
+  printf("detents cw %ld ccw %ld, pushes %ld, holds %ld, dropped %u\n", got.cw, got.ccw, got.pushes, got.holds, knob.getDropped());
+  boolean ok = (knob.getDropped() == 0);
+  const char* names[4] = { "cw", "ccw", "pushes", "holds" };
+  const long* e = &expect.cw;
+  const long* g = &got.cw;
+  for (int k = 0; k < 4; k++) {
+    if ((e[k] < 0) || (e[k] == g[k])) continue;
+    printf("%s: expected %ld, decoded %ld\n", names[k], e[k], g[k]);
+    ok = false;
+  }
+  printf("%s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
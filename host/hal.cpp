@@ -0,0 +1,23 @@
+#include "hal.h"
+#include "linux.h"
+
+namespace hal {
+
+static thread_local board* attached = 0;
+static board* fallback = 0;
+
+board& current() {
+  if (attached) return *attached;
+  if (fallback) return *fallback;
+  return *hostBoard().get();
+}
+
+void attach(board* b) { attached = b; }
+void setDefault(board* b) { fallback = b; }
+
+}
+
+linuxBoard& hostBoard() {  // built on first use, so firmware globals constructed before main() already see it
+  static linuxBoard b;
+  return b;
+}
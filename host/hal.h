@@ -0,0 +1,123 @@
+#ifndef HAL_H
+#define HAL_H
+
+// hardware abstraction layer for off-target builds.  the Arduino core and library shims in host/core/
+// forward every hardware access (millis(), digitalWrite(), OneWire, SD, RTC_DS1307, EEPROM, LiquidCrystal,
+// Serial) to the backends collected in a hal::board.  a board may be attached per thread so several
+// independent controllers can run side by side; threads without one use the process default board.
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace hal {
+
+struct clockSource {  // monotonic time base; all timing in the firmware derives from micros()
+  virtual ~clockSource() {}
+  virtual uint64_t micros() = 0;         // elapsed time since boot (us), never wraps
+  virtual void advance(uint64_t us) = 0; // consume time (delay(), bus transactions, blocking peripherals)
+};
+
+struct gpioBank {  // digital pins and external interrupts
+  virtual ~gpioBank() {}
+  virtual void pinMode(uint8_t pin, uint8_t mode) = 0;
+  virtual void write(uint8_t pin, uint8_t level) = 0;
+  virtual uint8_t read(uint8_t pin) = 0;
+  virtual void attachInterrupt(uint8_t irq, void (*isr)(), uint8_t mode) = 0;
+  virtual void detachInterrupt(uint8_t irq) = 0;
+};
+
+struct oneWireBus {  // transaction level model of a 1-wire master
+  virtual ~oneWireBus() {}
+  virtual uint8_t reset() = 0;                // returns 1 if a presence pulse was seen
+  virtual void writeByte(uint8_t v) = 0;
+  virtual uint8_t readByte() = 0;
+  virtual void resetSearch() = 0;
+  virtual uint8_t search(uint8_t* rom) = 0;   // next ROM code on the bus, 0 when exhausted
+};
+
+struct rtcSource {  // battery backed wall clock (DS1307 over I2C)
+  virtual ~rtcSource() {}
+  virtual uint32_t now() = 0;                 // seconds since 1970-01-01
+  virtual void adjust(uint32_t t) = 0;
+};
+
+struct eepromStore {
+  virtual ~eepromStore() {}
+  virtual uint16_t size() = 0;
+  virtual uint8_t read(uint16_t addr) = 0;
+  virtual void write(uint16_t addr, uint8_t v) = 0;
+};
+
+struct fileSystem {  // SD card; handles are small non-negative integers, -1 on failure
+  virtual ~fileSystem() {}
+  virtual bool begin() = 0;
+  virtual int open(const char* path, uint8_t mode) = 0;
+  virtual void close(int h) = 0;
+  virtual bool isDirectory(int h) = 0;
+  virtual const char* name(int h) = 0;
+  virtual int read(int h, uint8_t* buf, size_t n) = 0;
+  virtual int peek(int h) = 0;
+  virtual size_t write(int h, const uint8_t* buf, size_t n) = 0;
+  virtual void flush(int h) = 0;
+  virtual bool seek(int h, uint32_t pos) = 0;
+  virtual uint32_t position(int h) = 0;
+  virtual uint32_t size(int h) = 0;
+  virtual int openNext(int dir, uint8_t mode) = 0;
+  virtual void rewindDirectory(int dir) = 0;
+  virtual bool exists(const char* path) = 0;
+  virtual bool mkdir(const char* path) = 0;
+  virtual bool remove(const char* path) = 0;
+
+  // raw card access (Sd2Card/SdFile level) for streaming into pre-allocated contiguous files
+  virtual int createContiguous(const char* path, uint32_t size) = 0;  // new file of size bytes in one run of clusters
+  virtual bool extent(int h, uint32_t* first, uint32_t* last) = 0;     // card blocks holding the file
+  virtual bool truncate(int h, uint32_t size) = 0;                     // shorten, freeing clusters past size
+  virtual bool readBlock(uint32_t block, uint8_t* buf) = 0;
+  virtual bool writeStart(uint32_t block, uint32_t count) = 0;         // begin a multi-block write (CMD25)
+  virtual bool writeData(const uint8_t* buf) = 0;                      // next 512 byte block of the stream
+  virtual bool writeStop() = 0;
+  virtual bool erase(uint32_t first, uint32_t last) = 0;
+};
+
+struct lcdPanel {  // HD44780 character display
+  virtual ~lcdPanel() {}
+  virtual void begin(uint8_t cols, uint8_t rows) = 0;
+  virtual void command(uint8_t cmd) = 0;
+  virtual void data(uint8_t v) = 0;
+};
+
+struct serialPort {  // UART0
+  virtual ~serialPort() {}
+  virtual void begin(unsigned long baud) = 0;
+  virtual size_t write(uint8_t v) = 0;
+  virtual int availableForWrite() = 0;
+  virtual int available() = 0;
+  virtual int read() = 0;
+};
+
+struct watchdog {
+  virtual ~watchdog() {}
+  virtual void enable(uint8_t timeout) = 0;
+  virtual void reset() = 0;
+  virtual void disable() = 0;
+};
+
+struct board {  // one complete set of backends
+  clockSource* clock;
+  gpioBank* gpio;
+  oneWireBus* wire;
+  rtcSource* rtc;
+  eepromStore* eeprom;
+  fileSystem* fs;
+  lcdPanel* lcd;
+  serialPort* serial;
+  watchdog* wdt;
+};
+
+board& current();              // board attached to the calling thread, else the process default
+void attach(board* b);         // attach b to the calling thread (0 detaches)
+void setDefault(board* b);     // replace the process default board (0 restores the built in linux board)
+
+}
+
+#endif
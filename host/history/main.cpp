@@ -0,0 +1,635 @@
+// npid-history -- fermentation history over many data logs.  ingest reads binary LOGGERnn.BIN logs and CSV
+// logs (the old LOGnn.CSV text logger, or npid-log output: same columns) into one columnar store file
+// (store.h), sorted by time and indexed by day; the queries map the store and scan the columns they need
+// on all cores:
+//
+//   duty       compressor and heater duty per day, and COOL starts
+//   band       time the beer filter spent within -b of the setpoint per day, mean and worst error
+//   cycles     every COOL run: runtime, air at the stop, the trough after it, overshoot against the
+//              peakEstimator prediction
+//   estimator  peakEstimator per day and where it settled: the first cycle after which it kept within -e
+//              (relative) for 10 predicted stops
+//
+// synth writes a synthetic history (a store or, with -c, a CSV log) from a crude chamber model, and bench
+// times the queries on a store at 1, 2, 4 .. -j threads.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "store.h"
+#include "query.h"
+#include "../../datalog.h"
+#include "../../fridge.h"
+
+static void usage() {
+  fprintf(stderr,
+    "usage: npid-history ingest [-q] STORE LOG...\n"
+    "       npid-history info STORE\n"
+    "       npid-history duty|band|cycles|estimator [options] STORE\n"
+    "       npid-history synth [-d DAYS] [-p SEC] [-s SEED] [-c] OUT\n"
+    "       npid-history bench [-j N] STORE\n"
+    "  LOG      LOGGERnn.BIN, or a CSV log with the millis,datetime,... header\n"
+    "  -f DATE  from DATE (YYYY-MM-DD[ hh:mm[:ss]], RTC time)\n"
+    "  -t DATE  to DATE (exclusive)\n"
+    "  -j N     threads (default: all cores)\n"
+    "  -g SEC   longest interval a sample stands for; longer gaps are unlogged time (default 60)\n"
+    "  -b BAND  band: deg C around the setpoint (default 0.5)\n"
+    "  -e TOL   estimator: relative change counted as settled (default 0.05)\n"
+    "  -d DAYS  synth: days of history (default 365)\n"
+    "  -p SEC   synth: sample period (default 1, the logger's)\n"
+    "  -s SEED  synth: random seed (default 1)\n"
+    "  -c       synth: write a CSV log instead of a store\n"
+    "  -q       ingest: no per-file summary\n");
+}
+
+static double seconds(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+static int64_t daysFromCivil(int y, unsigned m, unsigned d) {  // days since 1970-01-01, proleptic Gregorian
+  y -= m <= 2;
+  int64_t era = (y >= 0 ? y : y - 399) / 400;
+  unsigned yoe = (unsigned)(y - era * 400);
+  unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int64_t)doe - 719468;
+}
+
+static bool parseDate(const char* s, uint32_t& t) {  // YYYY-MM-DD[ hh:mm[:ss]] or YYYY/M/D h:m:s
+  int y, mo, d, h = 0, mi = 0, sec = 0;
+  char sep;
+  int n = sscanf(s, "%d%*[-/]%d%*[-/]%d%c%d:%d:%d", &y, &mo, &d, &sep, &h, &mi, &sec);
+  if ((n < 3) || (mo < 1) || (mo > 12) || (d < 1) || (d > 31) || (h > 23) || (mi > 59) || (sec > 60)) return false;
+  t = daysFromCivil(y, mo, d) * 86400 + h * 3600 + mi * 60 + sec;
+  return true;
+}
+
+static const char* dateText(uint32_t t, char* buf, bool clock) {
+  time_t tt = t;
+  struct tm tm;
+  gmtime_r(&tt, &tm);  // RTC wall time, no zone
+  if (clock) strftime(buf, 20, "%Y-%m-%d %H:%M", &tm);
+    else strftime(buf, 20, "%Y-%m-%d", &tm);
+  return buf;
+}
+
+// ingest ************************************************************************************************
+
+struct ingestStats {
+  unsigned long rows, bad;
+};
+
+static bool ingestBin(FILE* in, storeWriter& w, ingestStats& st) {  // as npid-log
+  byte block[512];
+  if ((fread(block, 1, sizeof(block), in) != sizeof(block)) || !datalog::checkHeader(block)) return false;
+  bool contiguous = block[12] & logContiguous;
+  while (fread(block, 1, sizeof(block), in) == sizeof(block)) {
+    logRecord first;
+    if (contiguous && !datalog::unpack(block, first)) break;  // end of an unclosed pre-allocated log
+    for (size_t i = 0; i < sizeof(block); i += logRecordSize) {
+      logRecord rec;
+      if (!datalog::unpack(block + i, rec)) {
+        if (block[i] == logSync) st.bad++;
+        continue;
+      }
+      storeRow r;
+      r.time = rec.time;
+      r.ms = rec.ms;
+      const double v[] = { rec.fridgeTemp, rec.fridgeFilter, rec.beerTemp, rec.beerFilter, rec.setpoint, rec.output,
+                           rec.heatSetpoint, rec.heatOutput, rec.peakEstimator };
+      for (int c = 0; c < C_STATE - C_FRIDGE; c++) r.v[c] = v[c];
+      r.state = rec.state;
+      w.add(r);
+      st.rows++;
+    }
+  }
+  return true;
+}
+
+static bool parseCsvLine(char* p, storeRow& r) {  // millis,Y/M/D h:m:s,10 values,state
+  char* end;
+  r.ms = strtoul(p, &end, 10);
+  if (*end != ',') return false;
+  p = end + 1;
+  int y = strtol(p, &end, 10), mo, d, h, mi, s;
+  if (*end != '/') return false;
+  mo = strtol(end + 1, &end, 10);
+  if (*end != '/') return false;
+  d = strtol(end + 1, &end, 10);
+  if (*end != ' ') return false;
+  h = strtol(end + 1, &end, 10);
+  if (*end != ':') return false;
+  mi = strtol(end + 1, &end, 10);
+  if (*end != ':') return false;
+  s = strtol(end + 1, &end, 10);
+  if ((*end != ',') || (mo < 1) || (mo > 12)) return false;
+  r.time = daysFromCivil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s;
+  p = end + 1;
+  for (int c = 0; c < C_STATE - C_FRIDGE; c++) {
+    r.v[c] = strtod(p, &end);
+    if ((end == p) || (*end != ',')) return false;
+    p = end + 1;
+  }
+  unsigned long state = strtoul(p, &end, 10);
+  if ((end == p) || (state > HEAT)) return false;
+  r.state = state;
+  return true;
+}
+
+static bool ingestCsv(FILE* in, storeWriter& w, ingestStats& st) {
+  std::vector<char> buf(1 << 20);
+  size_t have = 0;
+  bool header = false;
+  while (true) {
+    size_t n = fread(buf.data() + have, 1, buf.size() - have - 1, in);
+    have += n;
+    if (!have) break;
+    buf[have] = 0;
+    char* line = buf.data();
+    char* stop = buf.data() + have;
+    while (line < stop) {
+      char* nl = (char*)memchr(line, '\n', stop - line);
+      if (!nl) {
+        if (n) break;  // partial line: read more
+        nl = stop;     // last line without a newline
+      }
+      *nl = 0;
+      if (!header) {
+        if (strncmp(line, "millis,datetime,", 16)) return false;
+        header = true;
+      }
+      else if (*line && (*line != '\r')) {
+        storeRow r;
+        if (parseCsvLine(line, r)) {
+          w.add(r);
+          st.rows++;
+        }
+        else st.bad++;
+      }
+      line = nl + 1;
+    }
+    size_t left = (line < stop) ? stop - line : 0;
+    if (!n && !left) break;
+    if (left == buf.size() - 1) buf.resize(buf.size() * 2);  // a line longer than the buffer
+    memmove(buf.data(), line, left);
+    have = left;
+  }
+  return header;
+}
+
+static int ingest(int argc, char** argv) {
+  bool quiet = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "qh")) != -1) {
+    switch (opt) {
+      case 'q': quiet = true; break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (argc - optind < 2) {
+    usage();
+    return 1;
+  }
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  storeWriter w(argv[optind]);
+  std::string error;
+  if (!w.begin(error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  ingestStats total = { 0, 0 };
+  for (int i = optind + 1; i < argc; i++) {
+    FILE* in = fopen(argv[i], "rb");
+    if (!in) {
+      perror(argv[i]);
+      return 1;
+    }
+    ingestStats st = { 0, 0 };
+    bool ok = ingestBin(in, w, st);
+    if (!ok && !st.rows) {
+      rewind(in);
+      ok = ingestCsv(in, w, st);
+    }
+    fclose(in);
+    if (!ok) {
+      fprintf(stderr, "%s: neither a version %u binary log nor a CSV log\n", argv[i], logVersion);
+      return 1;
+    }
+    if (!quiet) printf("%s: %lu rows, %lu damaged\n", argv[i], st.rows, st.bad);
+    total.rows += st.rows;
+    total.bad += st.bad;
+  }
+  if (!w.finish(error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  printf("%s: %lu rows, %lu damaged, %.1f s\n", argv[optind], total.rows, total.bad, seconds(t0));
+  return total.bad ? 2 : 0;
+}
+
+// synthetic history *************************************************************************************
+
+class chamberModel {  // crude fridge + beer model under the firmware's fridge rules, one row per call
+    std::mt19937 _rng;
+    std::normal_distribution<float> _noise;
+    double _dt, _t;
+    double _air, _beer, _evap, _ambient, _setpoint;
+    byte _state;
+    double _start, _stop, _stopAir, _estimate, _trough, _estimator, _heatCO;
+    bool _waiting;
+    uint32_t _ms;
+
+    double _quantize(double v) { return round((v + _noise(_rng)) * 16) / 16; }  // DS18B20, 1/16 deg C
+
+  public:
+    chamberModel(unsigned seed, double dt, uint32_t t0)
+      : _rng(seed), _noise(0, 0.04), _dt(dt), _t(t0), _air(20), _beer(20), _evap(0), _ambient(22), _setpoint(20),
+        _state(IDLE), _start(0), _stop(0), _stopAir(0), _estimate(0), _trough(0), _estimator(5), _heatCO(0),
+        _waiting(false), _ms(0) {}
+
+    void step(storeRow& r) {
+      double day = fmod(_t, 86400) / 86400;
+      _ambient = 22 + 4 * sin(2 * M_PI * (day - 0.3));
+      if (fmod(_t, 86400 * 14) < _dt) _setpoint = (_rng() % 3) ? 12 + _rng() % 10 : 2;  // a new beer fortnightly
+      double output = constrain(_setpoint + 5 * (_setpoint - _beer), 0.3, 38);  // the main PID, roughly
+
+      _evap += ((_state == COOL ? 1 : 0) - _evap) * _dt / 400;  // evaporator lag: the overshoot
+      double heat = (_state == HEAT) && (fmod(_t - _start, heatWindow / 1000.0) < _heatCO / 1000) ? 1 : 0;
+      _air += ((_ambient - _air) / 5000 + (_beer - _air) / 1500 - _evap * 0.012 + heat * 0.004) * _dt;
+      _beer += (_air - _beer) / 30000 * _dt;
+
+      switch (_state) {  // fridgeControl, without the minimum times' fine print
+        case IDLE:
+          if (_waiting) {
+            _trough = std::min(_trough, _air);
+            if ((_air > _trough + 0.1) || (_t - _stop > peakMaxWait)) {
+              double error = _estimate - _trough;
+              if (fabs(error) > fridgePeakDiff) {
+                double k = constrain(1.2 + 0.03 * fabs(error), 1.2, 1.5);
+                _estimator = (error > 0) ? _estimator * k : std::max(0.05, _estimator / k);
+              }
+              _waiting = false;
+            }
+          }
+          else if ((_air > output + fridgeIdleDiff) && (_t - _stop > coolMinOff)) {
+            _state = COOL;
+            _start = _t;
+          }
+          else if ((_air < output - fridgeIdleDiff) && (_t - _stop > heatMinOff)) {
+            _state = HEAT;
+            _start = _t;
+          }
+          break;
+        case COOL: {
+          double run = _t - _start;
+          if (run < coolMinOn) break;
+          _estimate = _air - std::min(run, (double)peakMaxTime) / 3600 * _estimator;
+          if ((_estimate < output - fridgeIdleDiff) || (run > coolMaxOn)) {
+            _state = IDLE;
+            _stop = _t;
+            _waiting = run <= coolMaxOn;
+            _trough = _air;
+          }
+          break; }
+        case HEAT:
+          _heatCO = constrain((output - _air) * 200000, 0, heatWindow);
+          if (_air > output + fridgeIdleDiff) {
+            _state = IDLE;
+            _stop = _t;
+          }
+          break;
+      }
+
+      r.time = (uint32_t)_t;
+      r.ms = _ms;
+      r.v[C_FRIDGE - C_FRIDGE] = _quantize(_air);
+      r.v[C_FRIDGE_FILTER - C_FRIDGE] = _air;
+      r.v[C_BEER - C_FRIDGE] = _quantize(_beer);
+      r.v[C_BEER_FILTER - C_FRIDGE] = _beer;
+      r.v[C_SETPOINT - C_FRIDGE] = _setpoint;
+      r.v[C_OUTPUT - C_FRIDGE] = output;
+      r.v[C_HEAT_SETPOINT - C_FRIDGE] = output;
+      r.v[C_HEAT_OUTPUT - C_FRIDGE] = _heatCO;
+      r.v[C_ESTIMATOR - C_FRIDGE] = _estimator;
+      r.state = _state;
+      _t += _dt;
+      _ms += _dt * 1000;
+    }
+};
+
+static int synth(int argc, char** argv) {
+  double days = 365, period = 1;
+  unsigned seed = 1;
+  bool csv = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "d:p:s:ch")) != -1) {
+    switch (opt) {
+      case 'd': days = atof(optarg); break;
+      case 'p': period = atof(optarg); break;
+      case 's': seed = strtoul(optarg, 0, 10); break;
+      case 'c': csv = true; break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if ((optind != argc - 1) || (period < 1)) {
+    usage();
+    return 1;
+  }
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  uint64_t rows = days * 86400 / period;
+  chamberModel model(seed, period, daysFromCivil(2024, 1, 1) * 86400);
+  storeRow r;
+  std::string error;
+  if (csv) {
+    FILE* out = fopen(argv[optind], "w");
+    if (!out) {
+      perror(argv[optind]);
+      return 1;
+    }
+    fprintf(out, "millis,datetime,fridge actual,fridge filter,beer actual,beer filter,mainSP,mainCO,heatSP,heatCO,peak estimator,fridge state\n");
+    for (uint64_t i = 0; i < rows; i++) {
+      model.step(r);
+      time_t t = r.time;
+      struct tm tm;
+      gmtime_r(&t, &tm);
+      fprintf(out, "%u,%d/%d/%d %d:%d:%d,%.10f,%.10f,%.10f,%.10f,%.10f,%.10f,%.10f,%.10f,%.2f,%u\n", r.ms,
+              tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+              r.v[0], r.v[1], r.v[2], r.v[3], r.v[4], r.v[5], r.v[6], r.v[7], r.v[8], r.state);
+    }
+    if (fclose(out)) {
+      perror(argv[optind]);
+      return 1;
+    }
+  }
+  else {
+    storeWriter w(argv[optind]);
+    if (!w.begin(error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    for (uint64_t i = 0; i < rows; i++) {
+      model.step(r);
+      w.add(r);
+    }
+    if (!w.finish(error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+  }
+  printf("%s: %llu rows over %.0f days, %.1f s\n", argv[optind], (unsigned long long)rows, days, seconds(t0));
+  return 0;
+}
+
+// queries ***********************************************************************************************
+
+struct queryOptions {
+  uint32_t from, to;
+  bool hasFrom, hasTo;
+  int threads;
+  uint32_t maxGap;
+  float band, tolerance;
+};
+
+static bool openStore(columnStore& s, const char* path) {
+  std::string error;
+  if (s.open(path, error)) return true;
+  fprintf(stderr, "%s\n", error.c_str());
+  return false;
+}
+
+static queryRange range(const columnStore& s, const queryOptions& o) {
+  queryRange r;
+  r.begin = o.hasFrom ? s.lowerBound(o.from) : 0;
+  r.end = o.hasTo ? s.lowerBound(o.to) : s.rows();
+  if (r.end < r.begin) r.end = r.begin;
+  r.maxGap = o.maxGap;
+  r.threads = o.threads;
+  return r;
+}
+
+static void printDuty(const std::vector<dayDuty>& days, uint32_t day0) {
+  printf("day         logged h   cool %%   heat %%  heater %%  cool starts\n");
+  dayDuty sum = { 0, 0, 0, 0, 0 };
+  char buf[20];
+  for (size_t i = 0; i < days.size(); i++) {
+    const dayDuty& d = days[i];
+    if (d.logged <= 0) continue;
+    printf("%s  %8.1f  %7.1f  %7.1f  %8.1f  %11u\n", dateText((day0 + i) * 86400, buf, false), d.logged / 3600,
+           100 * d.cool / d.logged, 100 * d.heat / d.logged, 100 * d.heater / d.logged, d.coolStarts);
+    sum.logged += d.logged;
+    sum.cool += d.cool;
+    sum.heat += d.heat;
+    sum.heater += d.heater;
+    sum.coolStarts += d.coolStarts;
+  }
+  if (sum.logged > 0)
+    printf("all         %8.1f  %7.1f  %7.1f  %8.1f  %11u\n", sum.logged / 3600, 100 * sum.cool / sum.logged,
+           100 * sum.heat / sum.logged, 100 * sum.heater / sum.logged, sum.coolStarts);
+}
+
+static void printBand(const std::vector<dayBand>& days, uint32_t day0, float band) {
+  printf("day         logged h  within %.2f %%  mean error  worst error\n", band);
+  dayBand sum = { 0, 0, 0, 0 };
+  char buf[20];
+  for (size_t i = 0; i < days.size(); i++) {
+    const dayBand& d = days[i];
+    if (d.logged <= 0) continue;
+    printf("%s  %8.1f  %13.1f  %10.3f  %11.3f\n", dateText((day0 + i) * 86400, buf, false), d.logged / 3600,
+           100 * d.inBand / d.logged, d.absError / d.logged, d.maxError);
+    sum.logged += d.logged;
+    sum.inBand += d.inBand;
+    sum.absError += d.absError;
+    sum.maxError = std::max(sum.maxError, d.maxError);
+  }
+  if (sum.logged > 0)
+    printf("all         %8.1f  %13.1f  %10.3f  %11.3f\n", sum.logged / 3600, 100 * sum.inBand / sum.logged,
+           sum.absError / sum.logged, sum.maxError);
+}
+
+static void printCycles(const std::vector<coolCycle>& cycles) {
+  printf("start             run min  stop air   trough  overshoot  predicted   error  estimator\n");
+  unsigned long n = 0;
+  double over = 0, err = 0;
+  char buf[20];
+  for (size_t i = 0; i < cycles.size(); i++) {
+    const coolCycle& c = cycles[i];
+    double overshoot = c.stopAir - c.trough;
+    printf("%s  %7.1f  %8.2f  %7.2f  %9.2f  %9.2f  %6.2f  %9.2f%s\n", dateText(c.start, buf, true),
+           (c.stop - c.start) / 60.0, c.stopAir, c.trough, overshoot, c.predicted, c.predicted - overshoot, c.estimator,
+           c.peak ? "" : "  (not a predicted stop)");
+    if (!c.peak) continue;
+    n++;
+    over += overshoot;
+    err += fabs(c.predicted - overshoot);
+  }
+  printf("%lu cycles, %lu predicted stops", (unsigned long)cycles.size(), n);
+  if (n) printf(": mean overshoot %.2f deg C, mean |error| %.2f deg C", over / n, err / n);
+  printf("\n");
+}
+
+static void printEstimator(const std::vector<coolCycle>& cycles, float tol) {
+  const unsigned settleCycles = 10;
+  std::vector<const coolCycle*> stops;  // the estimator only learns from predicted stops
+  for (size_t i = 0; i < cycles.size(); i++)
+    if (cycles[i].peak) stops.push_back(&cycles[i]);
+  printf("day         stops  estimator  mean |change| %%  mean |error|\n");
+  char buf[20];
+  for (size_t i = 0; i < stops.size();) {
+    uint32_t day = stops[i]->stop / 86400;
+    unsigned n = 0;
+    double change = 0, err = 0;
+    size_t j = i;
+    for (; (j < stops.size()) && (stops[j]->stop / 86400 == day); j++, n++) {
+      if (j) change += fabs(stops[j]->estimator / stops[j - 1]->estimator - 1);
+      err += fabs(stops[j]->predicted - (stops[j]->stopAir - stops[j]->trough));
+    }
+    printf("%s  %5u  %9.2f  %15.1f  %12.2f\n", dateText(day * 86400, buf, false), n, stops[j - 1]->estimator,
+           100 * change / n, err / n);
+    i = j;
+  }
+  size_t settled = stops.size(), quiet = 0;
+  for (size_t i = 1; i < stops.size(); i++) {  // the first stop followed by settleCycles small changes
+    if (fabs(stops[i]->estimator / stops[i - 1]->estimator - 1) > tol) quiet = 0;
+      else if (++quiet == settleCycles) {
+        settled = i - settleCycles;
+        break;
+      }
+  }
+  if (settled < stops.size())
+    printf("settled at stop %lu of %lu (%s), estimator %.2f\n", (unsigned long)settled + 1, (unsigned long)stops.size(),
+           dateText(stops[settled]->stop, buf, true), stops[settled]->estimator);
+  else printf("not settled: no %u predicted stops in a row within %.0f %%\n", settleCycles, 100 * tol);
+}
+
+static int query(const char* what, int argc, char** argv) {
+  queryOptions o;
+  o.hasFrom = o.hasTo = false;
+  o.from = o.to = 0;
+  o.threads = std::max(1u, std::thread::hardware_concurrency());
+  o.maxGap = 60;
+  o.band = 0.5;
+  o.tolerance = 0.05;
+  int opt;
+  while ((opt = getopt(argc, argv, "f:t:j:g:b:e:h")) != -1) {
+    switch (opt) {
+      case 'f': o.hasFrom = parseDate(optarg, o.from); if (!o.hasFrom) { usage(); return 1; } break;
+      case 't': o.hasTo = parseDate(optarg, o.to); if (!o.hasTo) { usage(); return 1; } break;
+      case 'j': o.threads = std::max(1, atoi(optarg)); break;
+      case 'g': o.maxGap = strtoul(optarg, 0, 10); break;
+      case 'b': o.band = atof(optarg); break;
+      case 'e': o.tolerance = atof(optarg); break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1) {
+    usage();
+    return 1;
+  }
+  columnStore s;
+  if (!openStore(s, argv[optind])) return 1;
+  queryRange r = range(s, o);
+  if (r.end == r.begin) {
+    printf("no rows in the range\n");
+    return 0;
+  }
+  uint32_t day0 = s.time()[r.begin] / 86400;
+  if (!strcmp(what, "duty")) {
+    std::vector<dayDuty> days;
+    dutyQuery(s, r, days);
+    printDuty(days, day0);
+  }
+  else if (!strcmp(what, "band")) {
+    std::vector<dayBand> days;
+    bandQuery(s, r, o.band, days);
+    printBand(days, day0, o.band);
+  }
+  else {
+    std::vector<coolCycle> cycles;
+    cycleQuery(s, r, cycles);
+    if (!strcmp(what, "cycles")) printCycles(cycles);
+      else printEstimator(cycles, o.tolerance);
+  }
+  return 0;
+}
+
+static int info(int argc, char** argv) {
+  if (argc != 2) {
+    usage();
+    return 1;
+  }
+  columnStore s;
+  if (!openStore(s, argv[1])) return 1;
+  char a[20], b[20];
+  printf("%llu rows, %.1f MB", (unsigned long long)s.rows(), s.bytes() / 1e6);
+  if (s.rows()) printf(", %s to %s over %u days", dateText(s.time()[0], a, true), dateText(s.time()[s.rows() - 1], b, true), s.days());
+  printf("\n");
+  for (int c = 0; c < C_COLUMNS; c++) printf("  %-15s %u bytes\n", columnName(c), (unsigned)columnWidth(c));
+  return 0;
+}
+
+static int bench(int argc, char** argv) {
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  int opt;
+  while ((opt = getopt(argc, argv, "j:h")) != -1) {
+    switch (opt) {
+      case 'j': threads = std::max(1, atoi(optarg)); break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1) {
+    usage();
+    return 1;
+  }
+  columnStore s;
+  if (!openStore(s, argv[optind])) return 1;
+  queryRange r = { 0, s.rows(), 60, 1 };
+  const char* names[3] = { "duty", "band", "cycles" };
+  printf("%llu rows, %.1f MB, %u cores\n", (unsigned long long)s.rows(), s.bytes() / 1e6, std::thread::hardware_concurrency());
+  printf("query   threads  first s   best s  Mrows/s\n");
+  for (int q = 0; q < 3; q++) {
+    for (int n = 1; ; n = std::min(n * 2, threads)) {
+      r.threads = n;
+      double first = 0, best = 1e9;
+      for (int k = 0; k < 3; k++) {  // the first pass may read from the disk, the others from the page cache
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        std::vector<dayDuty> duty;
+        std::vector<dayBand> band;
+        std::vector<coolCycle> cycles;
+        if (q == 0) dutyQuery(s, r, duty);
+          else if (q == 1) bandQuery(s, r, 0.5, band);
+          else cycleQuery(s, r, cycles);
+        double t = seconds(t0);
+        if (!k) first = t;
+        best = std::min(best, t);
+      }
+      printf("%-7s %7d  %7.3f  %7.3f  %7.1f\n", names[q], n, first, best, s.rows() / best / 1e6);
+      if (n == threads) break;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    usage();
+    return 1;
+  }
+  const char* cmd = argv[1];
+  argc--;
+  argv++;
+  if (!strcmp(cmd, "ingest")) return ingest(argc, argv);
+  if (!strcmp(cmd, "synth")) return synth(argc, argv);
+  if (!strcmp(cmd, "info")) return info(argc, argv);
+  if (!strcmp(cmd, "bench")) return bench(argc, argv);
+  if (!strcmp(cmd, "duty") || !strcmp(cmd, "band") || !strcmp(cmd, "cycles") || !strcmp(cmd, "estimator"))
+    return query(cmd, argc, argv);
+  usage();
+  return strcmp(cmd, "-h") ? 1 : 0;
+}
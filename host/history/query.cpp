@@ -0,0 +1,135 @@
+#include "query.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include "../../fridge.h"
+
+static int slices(const queryRange& r) {  // small ranges on one thread
+  return std::max(1, std::min<int>(r.threads, (r.end - r.begin) / 65536 + 1));
+}
+
+static void parallel(const queryRange& r, const std::function<void(int, uint64_t, uint64_t)>& scan) {
+  int n = slices(r);
+  std::vector<std::thread> pool;
+  for (int k = 0; k < n; k++) {
+    uint64_t from = r.begin + (r.end - r.begin) * k / n, to = r.begin + (r.end - r.begin) * (k + 1) / n;
+    if (k == n - 1) scan(k, from, to);  // the calling thread takes the last slice
+      else pool.push_back(std::thread(scan, k, from, to));
+  }
+  for (size_t k = 0; k < pool.size(); k++) pool[k].join();
+}
+
+static size_t dayCount(const columnStore& s, const queryRange& r) {
+  if (r.end <= r.begin) return 0;
+  return s.time()[r.end - 1] / 86400 - s.time()[r.begin] / 86400 + 1;
+}
+
+static double interval(const columnStore& s, const queryRange& r, uint64_t i) {  // time row i stands for, s
+  if (i + 1 >= s.rows()) return 0;
+  return std::min(s.time()[i + 1] - s.time()[i], r.maxGap);
+}
+
+void dutyQuery(const columnStore& s, const queryRange& r, std::vector<dayDuty>& days) {
+  size_t n = dayCount(s, r);
+  std::vector<std::vector<dayDuty> > part(slices(r), std::vector<dayDuty>(n));
+  const uint32_t* ts = s.time();
+  const uint8_t* st = s.state();
+  const float* heatCO = s.value(C_HEAT_OUTPUT);
+  uint32_t day0 = n ? ts[r.begin] / 86400 : 0;
+  parallel(r, [&](int k, uint64_t from, uint64_t to) {
+    std::vector<dayDuty>& d = part[k];
+    for (uint64_t i = from; i < to; i++) {
+      dayDuty& a = d[ts[i] / 86400 - day0];
+      double dt = interval(s, r, i);
+      a.logged += dt;
+      if (st[i] == COOL) {
+        a.cool += dt;
+        if ((i > r.begin) && (st[i - 1] != COOL)) a.coolStarts++;
+      }
+      else if (st[i] == HEAT) {
+        a.heat += dt;
+        a.heater += dt * std::min(std::max(heatCO[i] / heatWindow, 0.0f), 1.0f);
+      }
+    }
+  });
+  days.assign(n, dayDuty());
+  for (size_t k = 0; k < part.size(); k++) {
+    for (size_t i = 0; i < n; i++) {
+      days[i].logged += part[k][i].logged;
+      days[i].cool += part[k][i].cool;
+      days[i].heat += part[k][i].heat;
+      days[i].heater += part[k][i].heater;
+      days[i].coolStarts += part[k][i].coolStarts;
+    }
+  }
+}
+
+void bandQuery(const columnStore& s, const queryRange& r, float band, std::vector<dayBand>& days) {
+  size_t n = dayCount(s, r);
+  std::vector<std::vector<dayBand> > part(slices(r), std::vector<dayBand>(n));
+  const uint32_t* ts = s.time();
+  const float* beer = s.value(C_BEER_FILTER);
+  const float* sp = s.value(C_SETPOINT);
+  uint32_t day0 = n ? ts[r.begin] / 86400 : 0;
+  parallel(r, [&](int k, uint64_t from, uint64_t to) {
+    std::vector<dayBand>& d = part[k];
+    for (uint64_t i = from; i < to; i++) {
+      dayBand& a = d[ts[i] / 86400 - day0];
+      double dt = interval(s, r, i);
+      float e = fabsf(beer[i] - sp[i]);
+      a.logged += dt;
+      if (e <= band) a.inBand += dt;
+      a.absError += e * dt;
+      a.maxError = std::max(a.maxError, e);
+    }
+  });
+  days.assign(n, dayBand());
+  for (size_t k = 0; k < part.size(); k++) {
+    for (size_t i = 0; i < n; i++) {
+      days[i].logged += part[k][i].logged;
+      days[i].inBand += part[k][i].inBand;
+      days[i].absError += part[k][i].absError;
+      days[i].maxError = std::max(days[i].maxError, part[k][i].maxError);
+    }
+  }
+}
+
+void cycleQuery(const columnStore& s, const queryRange& r, std::vector<coolCycle>& cycles) {
+  std::vector<std::vector<coolCycle> > part(slices(r));
+  const uint32_t* ts = s.time();
+  const uint8_t* st = s.state();
+  const float* air = s.value(C_FRIDGE_FILTER);
+  const float* est = s.value(C_ESTIMATOR);
+  const float* output = s.value(C_OUTPUT);
+  parallel(r, [&](int k, uint64_t from, uint64_t to) {
+    uint64_t i = from;
+    if ((i > r.begin) && (st[i - 1] == COOL))  // the previous slice owns the run in progress
+      while ((i < to) && (st[i] == COOL)) i++;
+    while (true) {
+      while ((i < to) && (st[i] != COOL)) i++;
+      if (i >= to) break;
+      uint64_t j = i;
+      while ((j < r.end) && (st[j] == COOL)) j++;  // may read on into the next slice
+      if ((j >= r.end) || (i == r.begin)) {  // cut by the range: not a whole run
+        i = j;
+        continue;
+      }
+      coolCycle c;
+      c.start = ts[i];
+      c.stop = ts[j];
+      c.stopAir = c.trough = air[j];
+      c.estimator = est[j - 1];
+      double runTime = c.stop - c.start;
+      c.predicted = est[j - 1] * std::min(runTime, (double)peakMaxTime) / 3600;
+      c.peak = (runTime <= coolMaxOn) && (c.stopAir >= output[j - 1] - fridgeIdleDiff);
+      for (uint64_t m = j; (m < r.end) && (st[m] == IDLE) && (ts[m] - c.stop <= peakMaxWait); m++)
+        c.trough = std::min(c.trough, air[m]);
+      part[k].push_back(c);
+      i = j;
+    }
+  });
+  cycles.clear();
+  for (size_t k = 0; k < part.size(); k++) cycles.insert(cycles.end(), part[k].begin(), part[k].end());
+}
@@ -0,0 +1,44 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+// range queries over a columnStore.  each query splits its rows into one contiguous slice per thread and
+// scans the slices in parallel into per-thread partial results, merged afterwards: sums per day for the
+// day tables, and for the cycle tables the cycles that start in the slice (a slice looks back past its
+// start to skip a cycle already running and reads on past its end to finish its last one).  every row
+// stands for the time to the next row, capped at maxGap so that power cuts and log pauses count as
+// unlogged rather than as time in the last state.
+
+#include <stdint.h>
+#include <vector>
+#include "store.h"
+
+struct queryRange {
+  uint64_t begin, end;            // rows
+  uint32_t maxGap;                // longest interval a row stands for, s
+  int threads;
+};
+
+struct dayDuty {                  // time per day, s
+  double logged, cool, heat, heater;  // heater: HEAT time weighted by the heat PID duty
+  uint32_t coolStarts;
+};
+
+struct dayBand {
+  double logged, inBand;          // s
+  double absError;                // integral of |beer filter - mainSP|, deg C * s
+  float maxError;                 // deg C
+};
+
+struct coolCycle {                // one COOL run and the air trough after it
+  uint32_t start, stop;           // RTC time
+  float stopAir, trough;          // air filter at the stop, lowest air filter before the next run or peakMaxWait
+  float predicted;                // peakEstimator overshoot: estimator * runtime (to peakMaxTime)
+  float estimator;                // at the stop
+  bool peak;                      // the run stopped on the prediction (else a maximum runtime or setpoint stop)
+};
+
+void dutyQuery(const columnStore& s, const queryRange& r, std::vector<dayDuty>& days);  // day firstDay + i
+void bandQuery(const columnStore& s, const queryRange& r, float band, std::vector<dayBand>& days);
+void cycleQuery(const columnStore& s, const queryRange& r, std::vector<coolCycle>& cycles);  // in time order
+
+#endif
@@ -0,0 +1,202 @@
+#include "store.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+
+static const char* names[C_COLUMNS] = { "time", "millis", "fridge", "fridge filter", "beer", "beer filter", "mainSP",
+                                        "mainCO", "heatSP", "heatCO", "peak estimator", "fridge state" };
+
+size_t columnWidth(int c) { return c == C_STATE ? 1 : 4; }
+const char* columnName(int c) { return names[c]; }
+
+static uint64_t pageUp(uint64_t n) { return (n + storePage - 1) / storePage * storePage; }
+
+static std::string sysError(const std::string& what) { return what + ": " + strerror(errno); }
+
+// mapped store ******************************************************************************************
+
+bool columnStore::open(const std::string& path, std::string& error) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error = sysError(path);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || (st.st_size < (off_t)storePage)) {
+    ::close(fd);
+    error = path + ": not a store";
+    return false;
+  }
+  _map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (_map == MAP_FAILED) {
+    _map = 0;
+    error = sysError(path);
+    return false;
+  }
+  _size = st.st_size;
+  memcpy(&_h, _map, sizeof(_h));
+  bool ok = (_h.magic == storeMagic) && (_h.version == storeVersion) && (_h.size == _size) &&
+            (_h.index + (_h.days + 1) * 8 <= _size);
+  for (int c = 0; ok && (c < C_COLUMNS); c++) ok = _h.column[c] + _h.rows * columnWidth(c) <= _size;
+  if (!ok) {
+    close();
+    error = path + ": not a version " + std::to_string(storeVersion) + " store";
+    return false;
+  }
+  madvise(_map, _size, MADV_SEQUENTIAL);
+  return true;
+}
+
+void columnStore::close() {
+  if (_map) munmap(_map, _size);
+  _map = 0;
+  _size = 0;
+  memset(&_h, 0, sizeof(_h));
+}
+
+uint64_t columnStore::dayRow(int32_t day) const {
+  if (!_h.days || (day < _h.firstDay)) return 0;
+  if (day >= _h.firstDay + (int32_t)_h.days) return _h.rows;
+  return ((const uint64_t*)((const char*)_map + _h.index))[day - _h.firstDay];
+}
+
+uint64_t columnStore::lowerBound(uint32_t t) const {  // the day's rows from the index, then a binary search
+  int32_t day = t / 86400;
+  const uint32_t* ts = time();
+  return std::lower_bound(ts + dayRow(day), ts + dayRow(day + 1), t) - ts;
+}
+
+// ingest ************************************************************************************************
+
+storeWriter::storeWriter(const std::string& path) : _path(path), _rows(0), _sorted(true), _last(0) {
+  for (int c = 0; c < C_COLUMNS; c++) _tmp[c] = 0;
+}
+
+storeWriter::~storeWriter() {
+  for (int c = 0; c < C_COLUMNS; c++) {
+    if (!_tmp[c]) continue;
+    fclose(_tmp[c]);
+    unlink((_path + ".col" + std::to_string(c)).c_str());
+  }
+}
+
+bool storeWriter::begin(std::string& error) {  // columns are spooled to a file each until finish()
+  for (int c = 0; c < C_COLUMNS; c++) {
+    std::string name = _path + ".col" + std::to_string(c);
+    if (!(_tmp[c] = fopen(name.c_str(), "w+b"))) {
+      error = sysError(name);
+      return false;
+    }
+    _buf[c].reserve(1 << 20);
+  }
+  return true;
+}
+
+void storeWriter::add(const storeRow& r) {
+  if (_rows && (r.time < _last)) _sorted = false;  // an RTC adjustment, or files given out of order
+  _last = r.time;
+  _buf[C_TIME].insert(_buf[C_TIME].end(), (const char*)&r.time, (const char*)(&r.time + 1));
+  _buf[C_MILLIS].insert(_buf[C_MILLIS].end(), (const char*)&r.ms, (const char*)(&r.ms + 1));
+  for (int c = C_FRIDGE; c < C_STATE; c++)
+    _buf[c].insert(_buf[c].end(), (const char*)&r.v[c - C_FRIDGE], (const char*)(&r.v[c - C_FRIDGE] + 1));
+  _buf[C_STATE].push_back(r.state);
+  _rows++;
+  if (_buf[C_TIME].size() >= (1 << 20)) _flush();
+}
+
+void storeWriter::_flush() {
+  for (int c = 0; c < C_COLUMNS; c++) {
+    fwrite(_buf[c].data(), 1, _buf[c].size(), _tmp[c]);
+    _buf[c].clear();
+  }
+}
+
+bool storeWriter::finish(std::string& error) {
+  _flush();
+  storeHeader h;
+  memset(&h, 0, sizeof(h));
+  h.magic = storeMagic;
+  h.version = storeVersion;
+  h.rows = _rows;
+  uint64_t at = storePage;
+  for (int c = 0; c < C_COLUMNS; c++) {
+    if (fflush(_tmp[c])) {
+      error = sysError("spool");
+      return false;
+    }
+    h.column[c] = at;
+    at = pageUp(at + _rows * columnWidth(c));
+  }
+
+  std::vector<const char*> spool(C_COLUMNS, (const char*)0);  // spooled columns, mapped
+  for (int c = 0; (c < C_COLUMNS) && _rows; c++) {
+    void* m = mmap(0, _rows * columnWidth(c), PROT_READ, MAP_SHARED, fileno(_tmp[c]), 0);
+    if (m == MAP_FAILED) {
+      error = sysError("spool");
+      for (int k = 0; k < c; k++) munmap((void*)spool[k], _rows * columnWidth(k));
+      return false;
+    }
+    spool[c] = (const char*)m;
+  }
+  const uint32_t* ts = (const uint32_t*)spool[C_TIME];
+
+  std::vector<uint32_t> order;  // rows in time order (stable: equal times keep the log order)
+  if (!_sorted) {
+    order.resize(_rows);
+    for (uint64_t i = 0; i < _rows; i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [ts](uint32_t a, uint32_t b) { return ts[a] < ts[b]; });
+  }
+  if (_rows) {
+    h.firstDay = (_sorted ? ts[0] : ts[order[0]]) / 86400;
+    h.days = (_sorted ? ts[_rows - 1] : ts[order[_rows - 1]]) / 86400 - h.firstDay + 1;
+  }
+  h.index = at;
+  h.size = pageUp(at + (h.days + 1) * 8);
+
+  std::string tmp = _path + ".tmp";
+  int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  bool ok = (fd >= 0) && !ftruncate(fd, h.size);
+  char* out = ok ? (char*)mmap(0, h.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : (char*)MAP_FAILED;
+  if (out == MAP_FAILED) {
+    error = sysError(tmp);
+    if (fd >= 0) {
+      ::close(fd);
+      unlink(tmp.c_str());
+    }
+    for (int c = 0; (c < C_COLUMNS) && _rows; c++) munmap((void*)spool[c], _rows * columnWidth(c));
+    return false;
+  }
+  for (int c = 0; (c < C_COLUMNS) && _rows; c++) {
+    size_t w = columnWidth(c);
+    char* dst = out + h.column[c];
+    if (_sorted) memcpy(dst, spool[c], _rows * w);
+      else if (w == 4) for (uint64_t i = 0; i < _rows; i++) ((uint32_t*)dst)[i] = ((const uint32_t*)spool[c])[order[i]];
+      else for (uint64_t i = 0; i < _rows; i++) dst[i] = spool[c][order[i]];
+    munmap((void*)spool[c], _rows * w);
+  }
+  const uint32_t* sorted = (const uint32_t*)(out + h.column[C_TIME]);
+  uint64_t* index = (uint64_t*)(out + h.index);
+  uint64_t row = 0;
+  for (uint32_t d = 0; d < h.days; d++) {  // first row of each day; a day without samples gets the next day's
+    while ((row < _rows) && (sorted[row] / 86400 < h.firstDay + d)) row++;
+    index[d] = row;
+  }
+  index[h.days] = _rows;
+  memcpy(out, &h, sizeof(h));
+  ok = !msync(out, h.size, MS_SYNC);
+  munmap(out, h.size);
+  ok = !::close(fd) && ok;
+  if (!ok || rename(tmp.c_str(), _path.c_str())) {
+    error = sysError(_path);
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
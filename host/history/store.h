@@ -0,0 +1,93 @@
+#ifndef STORE_H
+#define STORE_H
+
+// columnar store of data log samples for npid-history.  one file: a header page, then one column per
+// field, each a plain array of rows values starting on a page boundary, then the time index.  rows are in
+// time order, so a time range is a contiguous run of rows in every column; the index holds the first row
+// of every day from the first to the last, so a range query finds its rows with two lookups and a short
+// binary search, and per-day aggregation knows each day's rows without a scan.  the file is mapped read
+// only and queries work straight on the mapped columns; a scan touches only the columns it reads.
+//
+// times are the RTC's, which keeps local wall time, as seconds since 1970-01-01 without a zone.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+enum storeColumn {  // the data log's columns; C_STATE is a byte, the times uint32_t, the rest float
+  C_TIME,           // RTC time, s
+  C_MILLIS,         // millis() at the sample
+  C_FRIDGE, C_FRIDGE_FILTER, C_BEER, C_BEER_FILTER,
+  C_SETPOINT, C_OUTPUT, C_HEAT_SETPOINT, C_HEAT_OUTPUT,
+  C_ESTIMATOR,
+  C_STATE,          // opState
+  C_COLUMNS
+};
+
+const uint32_t storeMagic = 0x4C4F4350;  // "PCOL"
+const uint32_t storeVersion = 1;
+const size_t storePage = 4096;
+
+struct storeHeader {
+  uint32_t magic, version;
+  uint64_t rows;
+  int32_t firstDay;               // day number (time / 86400) of the first row
+  uint32_t days;                  // index entries: firstDay .. firstDay + days - 1
+  uint64_t column[C_COLUMNS];     // file offset of each column
+  uint64_t index;                 // file offset of the time index: days + 1 row numbers (uint64_t)
+  uint64_t size;                  // file size
+};
+
+size_t columnWidth(int c);        // bytes per value
+const char* columnName(int c);
+
+class columnStore {  // a mapped store, read only
+    void* _map;
+    size_t _size;
+    storeHeader _h;
+
+  public:
+    columnStore() : _map(0), _size(0) {}
+    ~columnStore() { close(); }
+    bool open(const std::string& path, std::string& error);
+    void close();
+
+    uint64_t rows() const { return _h.rows; }
+    int32_t firstDay() const { return _h.firstDay; }
+    uint32_t days() const { return _h.days; }
+    size_t bytes() const { return _size; }
+    const uint32_t* time() const { return (const uint32_t*)((const char*)_map + _h.column[C_TIME]); }
+    const uint32_t* millis() const { return (const uint32_t*)((const char*)_map + _h.column[C_MILLIS]); }
+    const float* value(int c) const { return (const float*)((const char*)_map + _h.column[c]); }
+    const uint8_t* state() const { return (const uint8_t*)_map + _h.column[C_STATE]; }
+    uint64_t dayRow(int32_t day) const;  // first row at or after the start of day (clamped to the store)
+    uint64_t lowerBound(uint32_t t) const;  // first row with time >= t
+};
+
+struct storeRow {  // one sample on its way into the store
+  uint32_t time, ms;
+  float v[C_STATE - C_FRIDGE];    // C_FRIDGE .. C_ESTIMATOR
+  uint8_t state;
+};
+
+class storeWriter {  // rows in any order; finish() sorts them by time and writes the store
+    std::string _path;
+    FILE* _tmp[C_COLUMNS];
+    uint64_t _rows;
+    bool _sorted;
+    uint32_t _last;
+    std::vector<char> _buf[C_COLUMNS];
+
+    void _flush();
+
+  public:
+    explicit storeWriter(const std::string& path);
+    ~storeWriter();
+    bool begin(std::string& error);
+    void add(const storeRow& r);
+    bool finish(std::string& error);  // false leaves no store behind
+    uint64_t rows() const { return _rows; }
+};
+
+#endif
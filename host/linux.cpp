@@ -0,0 +1,698 @@
+#include <math.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "linux.h"
+#include "core/OneWire.h"
+
+static const int hostOpenRdwr = O_RDWR;  // core/SD.h replaces the fcntl O_* flags with the SdFat ones
+#undef O_RDONLY
+#undef O_WRONLY
+#undef O_RDWR
+#undef O_APPEND
+#undef O_SYNC
+#undef O_CREAT
+#undef O_EXCL
+#undef O_TRUNC
+#include "core/SD.h"
+
+// bus/peripheral timing model (us); figures follow the libraries' bit-banged timings and the datasheets
+const uint32_t oneWireResetUs = 960;     // reset pulse + presence detect
+const uint32_t oneWireByteUs = 560;      // 8 time slots of ~70 us
+const uint32_t oneWireSearchUs = 13440;  // 64 ROM bits x 3 slots
+const uint32_t rtcReadUs = 900;          // DS1307 7 byte read at 100 kHz I2C
+const uint32_t eepromWriteUs = 3400;     // ATmega2560 EEPROM erase + write
+const uint32_t sdOpenUs = 2000;          // directory scan on open
+const uint32_t sdBlockUs = 2500;         // single 512 byte block write (CMD24 + busy)
+const uint32_t sdClusterBytes = 32768;   // FAT16 cluster size on a 2 GB card
+const uint32_t sdReadUs = 1500;          // single block read (CMD17)
+const uint32_t sdStreamStartUs = 400;    // CMD25 (+ ACMD23 pre-erase hint)
+const uint32_t sdStreamBlockUs = 1100;   // data token + 512 bytes + CRC at half speed SPI, short busy
+const uint32_t sdStreamStopUs = 700;     // stop token + programming busy
+const uint32_t sdEraseUs = 250000;       // CMD32/33/38 erase of a block range
+const unsigned long uartFrameBits = 10;  // 8N1
+
+void virtualClock::advance(uint64_t us) {
+  _now += us;
+  for (size_t i = 0; i < listeners.size(); i++) listeners[i](_now);
+}
+
+// digital pins *****************************************************************************************
+
+static const uint8_t irqPin[6] = { 2, 3, 21, 20, 19, 18 };
+
+pinBank::pinBank() {
+  memset(_mode, INPUT, sizeof(_mode));
+  memset(_level, LOW, sizeof(_level));
+  memset(_isrMode, 0, sizeof(_isrMode));
+  for (int i = 0; i < 6; i++) _isr[i] = 0;
+}
+
+void pinBank::pinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= 70) return;
+  _mode[pin] = mode;
+  if (mode == INPUT_PULLUP) _level[pin] = HIGH;  // idle level of an undriven pulled-up input
+}
+
+void pinBank::write(uint8_t pin, uint8_t level) {
+  if (pin >= 70) return;
+  level = level ? HIGH : LOW;
+  if (_mode[pin] != OUTPUT) return;
+  bool changed = _level[pin] != level;
+  _level[pin] = level;
+  if (changed && onWrite) onWrite(pin, level);
+}
+
+uint8_t pinBank::read(uint8_t pin) { return pin < 70 ? _level[pin] : LOW; }
+
+void pinBank::attachInterrupt(uint8_t irq, void (*isr)(), uint8_t mode) {
+  if (irq >= 6) return;
+  _isr[irq] = isr;
+  _isrMode[irq] = mode;
+}
+
+void pinBank::detachInterrupt(uint8_t irq) { if (irq < 6) _isr[irq] = 0; }
+
+void pinBank::drive(uint8_t pin, uint8_t level) {
+  if (pin >= 70) return;
+  level = level ? HIGH : LOW;
+  if (_level[pin] == level) return;
+  _level[pin] = level;
+  for (int i = 0; i < 6; i++) {
+    if (irqPin[i] != pin || !_isr[i]) continue;
+    if (_isrMode[i] == CHANGE || (_isrMode[i] == RISING && level) || (_isrMode[i] == FALLING && !level)) _isr[i]();
+  }
+}
+
+// one-wire bus with DS18B20 devices ********************************************************************
+
+ds18b20Bus::ds18b20Bus(hal::clockSource* clock)
+  : conversionFactor(0.8), transactions(0), _clock(clock), _state(IDLE), _skip(false), _match(-1), _count(0), _searchIndex(0),
+    _garble(false), _rng(1) {}
+
+static const uint8_t powerOnScratch[8] = { 0x50, 0x05, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10 };  // 85.0 deg C, 12 bit
+
+uint32_t ds18b20Bus::_convUs(uint8_t config) {  // datasheet maximum conversion time for the configured resolution
+  return 93750UL << ((config >> 5) & 0x03);
+}
+
+ds18b20& ds18b20Bus::add(double temp) {
+  ds18b20 d;
+  uint8_t serial = (uint8_t)_devices.size();
+  const uint8_t rom[7] = { 0x28, (uint8_t)(0xA0 + serial), 0x3C, 0x19, 0x04, 0x00, 0x00 };
+  memcpy(d.rom, rom, 7);
+  d.rom[7] = OneWire::crc8(d.rom, 7);
+  memcpy(d.scratch, powerOnScratch, 8);
+  d.scratch[8] = OneWire::crc8(d.scratch, 8);
+  d.temp = temp;
+  d.converting = false;
+  d.convDone = 0;
+  d.present = true;
+  d.stuck = d.resets = false;
+  d.corrupt = 0;
+  _devices.push_back(d);
+  return _devices.back();
+}
+
+void ds18b20Bus::_service(ds18b20& d) {  // latch the result of a finished conversion into the scratchpad
+  if (!d.converting || _clock->micros() < d.convDone) return;
+  d.converting = false;
+  if (d.stuck) return;
+  if (d.resets) {
+    memcpy(d.scratch, powerOnScratch, 8);
+    d.scratch[8] = OneWire::crc8(d.scratch, 8);
+    return;
+  }
+  double t = std::max(-55.0, std::min(125.0, d.temp));
+  int16_t raw = (int16_t)lround(t * 16);
+  int bits = 9 + ((d.scratch[4] >> 5) & 0x03);
+  raw &= ~((1 << (12 - bits)) - 1);  // undefined low bits read as zero at reduced resolution
+  d.scratch[0] = raw & 0xFF;
+  d.scratch[1] = (raw >> 8) & 0xFF;
+  d.scratch[8] = OneWire::crc8(d.scratch, 8);
+}
+
+uint8_t ds18b20Bus::reset() {
+  transactions++;
+  _clock->advance(oneWireResetUs);
+  _state = ROM_CMD;
+  _skip = false;
+  _match = -1;
+  for (size_t i = 0; i < _devices.size(); i++) if (_devices[i].present) return 1;
+  return 0;
+}
+
+void ds18b20Bus::writeByte(uint8_t v) {
+  _clock->advance(oneWireByteUs);
+  switch (_state) {
+    case ROM_CMD:
+      if (v == 0xCC) { _skip = true; _state = FUNCTION; }
+        else if (v == 0x55) { _count = 0; _state = MATCH_ROM; }
+        else _state = IDLE;
+      break;
+
+    case MATCH_ROM:
+      _romBuf[_count++] = v;
+      if (_count == 8) {
+        _match = -2;
+        for (size_t i = 0; i < _devices.size(); i++) if (!memcmp(_devices[i].rom, _romBuf, 8)) _match = (int)i;
+        _state = FUNCTION;
+      }
+      break;
+
+    case FUNCTION:
+      _count = 0;
+      if (v == 0x44) {  // CONVERT T
+        for (size_t i = 0; i < _devices.size(); i++) {
+          if (!_selected(i) || !_devices[i].present) continue;
+          _service(_devices[i]);
+          _devices[i].converting = true;
+          _devices[i].convDone = _clock->micros() + (uint64_t)(_convUs(_devices[i].scratch[4]) * conversionFactor);
+        }
+        _state = CONVERT;
+      }
+      else if (v == 0xBE) {
+        _state = READ_SCRATCH;
+        _garble = false;
+        for (size_t i = 0; i < _devices.size(); i++) {
+          if (!_selected(i) || !_devices[i].present || _devices[i].corrupt <= 0) continue;
+          _rng = _rng * 1103515245 + 12345;
+          if ((_rng >> 8) < _devices[i].corrupt * (1 << 24)) _garble = true;
+        }
+      }
+      else if (v == 0x4E) _state = WRITE_SCRATCH;
+      else _state = IDLE;
+      break;
+
+    case WRITE_SCRATCH:  // TH, TL, configuration
+      for (size_t i = 0; i < _devices.size(); i++) {
+        if (!_selected(i) || !_devices[i].present) continue;
+        _devices[i].scratch[2 + _count] = (_count == 2) ? ((v & 0x60) | 0x1F) : v;
+        _devices[i].scratch[8] = OneWire::crc8(_devices[i].scratch, 8);
+      }
+      if (++_count == 3) _state = IDLE;
+      break;
+
+    default:
+      break;
+  }
+}
+
+uint8_t ds18b20Bus::readByte() {
+  _clock->advance(oneWireByteUs);
+  uint8_t v = 0xFF;  // released bus reads as ones
+  switch (_state) {
+    case CONVERT:  // devices hold the line low while converting
+      for (size_t i = 0; i < _devices.size(); i++) {
+        if (!_selected(i) || !_devices[i].present) continue;
+        _service(_devices[i]);
+        if (_devices[i].converting) v = 0x00;
+      }
+      break;
+
+    case READ_SCRATCH:  // wired-AND of every selected device
+      for (size_t i = 0; i < _devices.size(); i++) {
+        if (!_selected(i) || !_devices[i].present) continue;
+        _service(_devices[i]);
+        if (_count < 9) v &= _devices[i].scratch[_count];
+      }
+      if (_garble && (_count == 0)) v ^= 0x04;  // a flipped bit the CRC catches
+      _count++;
+      break;
+
+    default:
+      break;
+  }
+  return v;
+}
+
+uint8_t ds18b20Bus::search(uint8_t* rom) {
+  _clock->advance(oneWireResetUs + oneWireSearchUs);
+  while (_searchIndex < _devices.size()) {
+    ds18b20& d = _devices[_searchIndex++];
+    if (!d.present) continue;
+    memcpy(rom, d.rom, 8);
+    return 1;
+  }
+  _searchIndex = 0;  // like the OneWire library, an exhausted search starts over on the next call
+  return 0;
+}
+
+// real time clock **************************************************************************************
+
+uint32_t simRtc::now() {
+  reads++;
+  _clock->advance(rtcReadUs);
+  return (uint32_t)floor(exact());
+}
+
+double simRtc::exact() const { return _epoch + _clock->micros() / 1e6 * (1 + ppm * 1e-6); }
+
+void simRtc::adjust(uint32_t t) { _epoch = t - _clock->micros() / 1e6 * (1 + ppm * 1e-6); }  // the DS1307 restarts its second on the write
+
+// EEPROM ***********************************************************************************************
+
+ramEeprom::ramEeprom(hal::clockSource* clock) : wear(4096, 0), powerCut(-1), _clock(clock), _cells(4096, 0xFF) {}
+
+uint8_t ramEeprom::read(uint16_t addr) { return addr < _cells.size() ? _cells[addr] : 0xFF; }
+
+void ramEeprom::write(uint16_t addr, uint8_t v) {
+  if ((addr >= _cells.size()) || !powerCut) return;  // no power
+  _clock->advance(eepromWriteUs);
+  if ((powerCut > 0) && !--powerCut) v = 0xFF;  // cut between the erase and the write
+  _cells[addr] = v;
+  wear[addr]++;
+}
+
+bool ramEeprom::load(const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  size_t n = fread(&_cells[0], 1, _cells.size(), f);
+  fclose(f);
+  return n > 0;
+}
+
+bool ramEeprom::save(const char* path) const {
+  FILE* f = fopen(path, "wb");
+  if (!f) return false;
+  size_t n = fwrite(&_cells[0], 1, _cells.size(), f);
+  fclose(f);
+  return n == _cells.size();
+}
+
+// SD card **********************************************************************************************
+
+dirFileSystem::dirFileSystem(hal::clockSource* clock, const std::string& rootDir)
+  : root(rootDir), inserted(true), blockWrites(0), fatWrites(0), streamBlocks(0), _clock(clock), _nextBlock(0),
+    _streaming(false), _streamBlock(0), _next(0) {}
+
+bool dirFileSystem::begin() {
+  if (!inserted) return false;
+  ::mkdir(root.c_str(), 0755);
+  struct stat st;
+  return stat(root.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+std::string dirFileSystem::_hostPath(const char* path) const {
+  std::string p(path ? path : "");
+  while (!p.empty() && p[0] == '/') p.erase(0, 1);
+  while (!p.empty() && p[p.size() - 1] == '/') p.erase(p.size() - 1);
+  return p.empty() ? root : root + "/" + p;
+}
+
+dirFileSystem::entry* dirFileSystem::_get(int h) {
+  std::map<int, entry>::iterator it = _open.find(h);
+  return it == _open.end() ? 0 : &it->second;
+}
+
+int dirFileSystem::open(const char* path, uint8_t mode) {
+  if (!inserted) return -1;
+  _clock->advance(sdOpenUs);
+  entry e;
+  e.path = _hostPath(path);
+  e.name = e.path.substr(e.path.find_last_of('/') + 1);
+  e.file = 0;
+  e.dir = false;
+  e.next = 0;
+  e.dirty = 0;
+  e.modified = false;
+  e.allocated = 0;
+  struct stat st;
+  bool found = stat(e.path.c_str(), &st) == 0;
+  if (found && S_ISDIR(st.st_mode)) {
+    e.dir = true;
+    DIR* d = opendir(e.path.c_str());
+    if (!d) return -1;
+    while (struct dirent* de = readdir(d)) {
+      if (de->d_name[0] != '.') e.children.push_back(de->d_name);
+    }
+    closedir(d);
+    std::sort(e.children.begin(), e.children.end());
+  }
+  else if (mode & O_WRITE) {
+    if (!found && !(mode & O_CREAT)) return -1;
+    e.file = fopen(e.path.c_str(), (found && !(mode & O_TRUNC)) ? "r+b" : "w+b");
+    if (!e.file) return -1;
+    if (!found) fatWrites++;  // new directory entry
+    if (mode & O_APPEND) fseek(e.file, 0, SEEK_END);
+    e.allocated = (uint32_t)((ftell(e.file) + sdClusterBytes - 1) / sdClusterBytes * sdClusterBytes);
+  }
+  else {
+    if (!found) return -1;
+    e.file = fopen(e.path.c_str(), "rb");
+    if (!e.file) return -1;
+  }
+  int h = _next++;
+  _open[h] = e;
+  return h;
+}
+
+void dirFileSystem::close(int h) {
+  flush(h);
+  entry* e = _get(h);
+  if (!e) return;
+  if (e->file) fclose(e->file);
+  _open.erase(h);
+}
+
+bool dirFileSystem::isDirectory(int h) { entry* e = _get(h); return e && e->dir; }
+const char* dirFileSystem::name(int h) { entry* e = _get(h); return e ? e->name.c_str() : ""; }
+
+int dirFileSystem::read(int h, uint8_t* buf, size_t n) {
+  entry* e = _get(h);
+  if (!e || !e->file) return -1;
+  return (int)fread(buf, 1, n, e->file);
+}
+
+int dirFileSystem::peek(int h) {
+  entry* e = _get(h);
+  if (!e || !e->file) return -1;
+  int c = fgetc(e->file);
+  if (c != EOF) ungetc(c, e->file);
+  return c == EOF ? -1 : c;
+}
+
+void dirFileSystem::_commitBlock(entry& e) {
+  _clock->advance(sdBlockUs);
+  blockWrites++;
+}
+
+size_t dirFileSystem::write(int h, const uint8_t* buf, size_t n) {  // bytes fill the library's 512 byte block cache
+  entry* e = _get(h);
+  if (!e || !e->file) return 0;
+  size_t w = fwrite(buf, 1, n, e->file);
+  uint32_t pos = (uint32_t)ftell(e->file);
+  e->dirty += (uint32_t)w;
+  e->modified = true;
+  while (e->dirty >= 512) {
+    _commitBlock(*e);
+    e->dirty -= 512;
+  }
+  while (pos > e->allocated) {  // new cluster: both FAT copies are rewritten
+    e->allocated += sdClusterBytes;
+    _clock->advance(2 * sdBlockUs);
+    fatWrites += 2;
+  }
+  return w;
+}
+
+void dirFileSystem::flush(int h) {  // commit the cached block and rewrite the directory entry (size/date)
+  entry* e = _get(h);
+  if (!e || !e->file) return;
+  fflush(e->file);
+  if (!e->modified) return;
+  if (e->dirty) _commitBlock(*e);
+  e->dirty = 0;
+  e->modified = false;
+  _clock->advance(sdBlockUs);
+  fatWrites++;
+}
+
+bool dirFileSystem::seek(int h, uint32_t pos) {
+  entry* e = _get(h);
+  return e && e->file && fseek(e->file, pos, SEEK_SET) == 0;
+}
+
+uint32_t dirFileSystem::position(int h) {
+  entry* e = _get(h);
+  return (e && e->file) ? (uint32_t)ftell(e->file) : 0;
+}
+
+uint32_t dirFileSystem::size(int h) {
+  entry* e = _get(h);
+  if (!e || !e->file) return 0;
+  fflush(e->file);
+  struct stat st;
+  return fstat(fileno(e->file), &st) == 0 ? (uint32_t)st.st_size : 0;
+}
+
+int dirFileSystem::openNext(int dir, uint8_t mode) {
+  entry* e = _get(dir);
+  if (!e || !e->dir || e->next >= e->children.size()) return -1;
+  std::string child = e->path.substr(root.size()) + "/" + e->children[e->next++];
+  return open(child.c_str(), mode);
+}
+
+void dirFileSystem::rewindDirectory(int dir) {
+  entry* e = _get(dir);
+  if (e) e->next = 0;
+}
+
+bool dirFileSystem::exists(const char* path) {
+  struct stat st;
+  return inserted && stat(_hostPath(path).c_str(), &st) == 0;
+}
+
+bool dirFileSystem::mkdir(const char* path) { return inserted && ::mkdir(_hostPath(path).c_str(), 0755) == 0; }
+bool dirFileSystem::remove(const char* path) {
+  std::map<std::string, run>::iterator it = _runs.find(_hostPath(path));
+  if (it != _runs.end()) {
+    if (it->second.fd >= 0) ::close(it->second.fd);
+    _runs.erase(it);
+  }
+  return inserted && ::remove(_hostPath(path).c_str()) == 0;
+}
+
+void dirFileSystem::_fatUpdate(uint32_t clusters) {  // FAT16: 256 entries per FAT sector, two FAT copies
+  uint32_t sectors = 2 * ((clusters + 255) / 256);
+  _clock->advance(sectors * sdBlockUs);
+  fatWrites += sectors;
+}
+
+dirFileSystem::run* dirFileSystem::_map(const std::string& path, uint32_t bytes) {  // block run for path, allocated on first use
+  std::map<std::string, run>::iterator it = _runs.find(path);
+  if (it != _runs.end()) return &it->second;
+  uint32_t clusters = std::max<uint32_t>(1, (bytes + sdClusterBytes - 1) / sdClusterBytes);
+  run r = { _nextBlock, clusters * (sdClusterBytes / 512), ::open(path.c_str(), hostOpenRdwr) };
+  if (r.fd < 0) return 0;
+  _nextBlock += r.blocks;
+  return &(_runs[path] = r);
+}
+
+dirFileSystem::run* dirFileSystem::_find(uint32_t block, off_t& offset) {
+  for (std::map<std::string, run>::iterator it = _runs.begin(); it != _runs.end(); ++it) {
+    run& r = it->second;
+    if (block >= r.first && block < r.first + r.blocks) {
+      offset = (off_t)(block - r.first) * 512;
+      return &r;
+    }
+  }
+  return 0;
+}
+
+int dirFileSystem::createContiguous(const char* path, uint32_t size) {  // SdFile::createContiguous()
+  if (!inserted || exists(path) || !size) return -1;
+  int h = open(path, O_READ | O_WRITE | O_CREAT);
+  if (h < 0) return -1;
+  entry* e = _get(h);
+  if (ftruncate(fileno(e->file), size) != 0) { close(h); remove(path); return -1; }
+  e->allocated = (size + sdClusterBytes - 1) / sdClusterBytes * sdClusterBytes;
+  _fatUpdate(e->allocated / sdClusterBytes);
+  _clock->advance(sdBlockUs);  // directory entry with the final size
+  fatWrites++;
+  if (!_map(e->path, size)) { close(h); return -1; }
+  return h;
+}
+
+bool dirFileSystem::extent(int h, uint32_t* first, uint32_t* last) {  // SdFile::contiguousRange()
+  entry* e = _get(h);
+  if (!e || !e->file) return false;
+  uint32_t bytes = std::max(size(h), e->allocated);
+  run* r = _map(e->path, bytes);
+  if (!r) return false;
+  *first = r->first;
+  *last = r->first + std::max<uint32_t>(1, (size(h) + 511) / 512) - 1;
+  return true;
+}
+
+bool dirFileSystem::truncate(int h, uint32_t length) {  // SdFile::truncate(): frees the clusters past length
+  entry* e = _get(h);
+  if (!e || !e->file) return false;
+  fflush(e->file);
+  if (ftruncate(fileno(e->file), length) != 0) return false;
+  uint32_t keep = (length + sdClusterBytes - 1) / sdClusterBytes * sdClusterBytes;
+  if (keep < e->allocated) _fatUpdate((e->allocated - keep) / sdClusterBytes);
+  e->allocated = std::min(e->allocated, keep);
+  std::map<std::string, run>::iterator it = _runs.find(e->path);
+  if (it != _runs.end()) it->second.blocks = std::max<uint32_t>(keep / 512, sdClusterBytes / 512);
+  _clock->advance(sdBlockUs);  // directory entry
+  fatWrites++;
+  e->modified = false;
+  return true;
+}
+
+bool dirFileSystem::readBlock(uint32_t block, uint8_t* buf) {  // Sd2Card::readBlock(); unmapped blocks read as erased
+  if (!inserted || _streaming) return false;
+  _clock->advance(sdReadUs);
+  memset(buf, 0, 512);
+  off_t offset;
+  run* r = _find(block, offset);
+  if (r && pread(r->fd, buf, 512, offset) < 0) return false;
+  return true;
+}
+
+bool dirFileSystem::writeStart(uint32_t block, uint32_t count) {  // Sd2Card::writeStart()
+  if (!inserted || _streaming) return false;
+  _clock->advance(sdStreamStartUs);
+  _streaming = true;
+  _streamBlock = block;
+  return true;
+}
+
+bool dirFileSystem::writeData(const uint8_t* buf) {  // Sd2Card::writeData(); the stream may only cover mapped files
+  if (!_streaming) return false;
+  _clock->advance(sdStreamBlockUs);
+  off_t offset;
+  run* r = _find(_streamBlock, offset);
+  if (!r || pwrite(r->fd, buf, 512, offset) != 512) return false;
+  _streamBlock++;
+  blockWrites++;
+  streamBlocks++;
+  return true;
+}
+
+bool dirFileSystem::writeStop() {  // Sd2Card::writeStop()
+  if (!_streaming) return false;
+  _clock->advance(sdStreamStopUs);
+  _streaming = false;
+  return true;
+}
+
+bool dirFileSystem::erase(uint32_t first, uint32_t last) {  // Sd2Card::erase(); this card reads back zeros
+  if (!inserted || _streaming || last < first) return false;
+  _clock->advance(sdEraseUs);
+  for (std::map<std::string, run>::iterator it = _runs.begin(); it != _runs.end(); ++it) {
+    run& r = it->second;
+    uint32_t lo = std::max(first, r.first), hi = std::min(last, r.first + r.blocks - 1);
+    if (lo > hi) continue;
+    off_t offset = (off_t)(lo - r.first) * 512, len = (off_t)(hi - lo + 1) * 512;
+    if (fallocate(r.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, len) == 0) continue;
+    std::vector<uint8_t> zero(len, 0);  // no hole punching on this host filesystem
+    if (pwrite(r.fd, &zero[0], len, offset) != len) return false;
+  }
+  return true;
+}
+
+// character LCD ****************************************************************************************
+
+hd44780::hd44780() : bytes(0), _addr(0), _cg(false), _cols(20), _rows(4) {
+  memset(_ddram, ' ', sizeof(_ddram));
+  memset(_cgram, 0, sizeof(_cgram));
+}
+
+void hd44780::command(uint8_t cmd) {
+  bytes++;
+  if (cmd & 0x80) { _addr = cmd & 0x7F; _cg = false; }
+    else if (cmd & 0x40) { _addr = cmd & 0x3F; _cg = true; }
+    else if (cmd == 0x01) { memset(_ddram, ' ', sizeof(_ddram)); _addr = 0; _cg = false; }
+    else if (cmd == 0x02) { _addr = 0; _cg = false; }
+}
+
+void hd44780::data(uint8_t v) {
+  bytes++;
+  if (_cg) {
+    _cgram[_addr & 0x3F] = v;
+    _addr = (_addr + 1) & 0x3F;
+    return;
+  }
+  _ddram[_addr & 0x7F] = v;
+  _addr++;
+  if (_addr == 0x28) _addr = 0x40;  // 2-line addressing: 0x00-0x27, 0x40-0x67
+    else if (_addr == 0x68) _addr = 0x00;
+}
+
+std::string hd44780::row(uint8_t r) const {
+  static const uint8_t offset[4] = { 0x00, 0x40, 0x14, 0x54 };
+  std::string s;
+  for (uint8_t c = 0; c < _cols && r < 4; c++) s += (char)_ddram[(offset[r] + c) & 0x7F];
+  return s;
+}
+
+// UART *************************************************************************************************
+
+uartSink::uartSink(hal::clockSource* clock)
+  : out(0), fd(-1), txBytes(0), blockedUs(0), _clock(clock), _baud(0), _lastDrain(0), _queued(0) {}
+
+void uartSink::begin(unsigned long baud) {
+  _baud = baud;
+  _queued = 0;
+  _lastDrain = _clock->micros();
+}
+
+void uartSink::_drain() {
+  uint64_t now = _clock->micros();
+  if (_baud) _queued = std::max(0.0, _queued - (double)(now - _lastDrain) * _baud / uartFrameBits / 1e6);
+  _lastDrain = now;
+}
+
+int uartSink::availableForWrite() {
+  _drain();
+  return std::max(0, 63 - (int)ceil(_queued));
+}
+
+size_t uartSink::write(uint8_t v) {
+  if (_baud) {
+    _drain();
+    if (_queued >= 63) {  // HardwareSerial::write() spins until the ISR frees a slot
+      uint64_t wait = (uint64_t)ceil((_queued - 62) * uartFrameBits * 1e6 / _baud);
+      _clock->advance(wait);
+      blockedUs += wait;
+      _drain();
+    }
+    _queued += 1;
+  }
+  txBytes++;
+  if (out) fputc(v, out);
+  if (fd >= 0 && ::write(fd, &v, 1) < 0 && errno != EAGAIN && errno != EIO) fd = -1;  // full or no reader: byte lost
+  return 1;
+}
+
+int uartSink::available() {
+  uint8_t buf[64];
+  ssize_t n;
+  if (fd >= 0 && rx.size() < 64 && (n = ::read(fd, buf, 64 - rx.size())) > 0) rx.insert(rx.end(), buf, buf + n);  // 64 byte RX buffer
+  return (int)rx.size();
+}
+
+int uartSink::read() {
+  if (!available()) return -1;
+  uint8_t v = rx.front();
+  rx.pop_front();
+  return v;
+}
+
+// watchdog *********************************************************************************************
+
+void hostWatchdog::enable(uint8_t timeout) {
+  static const uint16_t ms[10] = { 15, 30, 60, 120, 250, 500, 1000, 2000, 4000, 8000 };
+  timeoutUs = (uint64_t)ms[timeout < 10 ? timeout : 9] * 1000;
+  _last = _clock->micros();
+}
+
+void hostWatchdog::reset() {
+  uint64_t now = _clock->micros();
+  if (timeoutUs) maxGapUs = std::max(maxGapUs, now - _last);
+  _last = now;
+}
+
+bool hostWatchdog::expired() { return timeoutUs && _clock->micros() - _last > timeoutUs; }
+
+// board ************************************************************************************************
+
+linuxBoard::linuxBoard(const std::string& sdRoot, int probes)
+  : wire(&clock), rtc(&clock, 1767225600UL), eeprom(&clock), fs(&clock, sdRoot), serial(&clock), wdt(&clock) {
+  for (int i = 0; i < probes; i++) wire.add(20.0);
+  _board.clock = &clock;
+  _board.gpio = &gpio;
+  _board.wire = &wire;
+  _board.rtc = &rtc;
+  _board.eeprom = &eeprom;
+  _board.fs = &fs;
+  _board.lcd = &lcd;
+  _board.serial = &serial;
+  _board.wdt = &wdt;
+}
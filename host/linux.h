@@ -0,0 +1,266 @@
+#ifndef LINUX_H
+#define LINUX_H
+
+// in-process linux backends for the hal.  nothing here touches real hardware: time is a virtual clock
+// that only moves when the firmware consumes it, so a run proceeds as fast as the host can execute it.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "hal.h"
+
+class virtualClock : public hal::clockSource {
+  public:
+    virtualClock() : _now(0) {}
+    uint64_t micros() { return _now; }
+    void advance(uint64_t us);
+    void set(uint64_t us) { _now = us; }
+    std::vector<std::function<void(uint64_t)> > listeners;  // called after every advance with the new time
+
+  private:
+    uint64_t _now;
+};
+
+class pinBank : public hal::gpioBank {  // ATmega2560 digital pins; external interrupts 0-5 on pins 2, 3, 21, 20, 19, 18
+  public:
+    pinBank();
+    void pinMode(uint8_t pin, uint8_t mode);
+    void write(uint8_t pin, uint8_t level);
+    uint8_t read(uint8_t pin);
+    void attachInterrupt(uint8_t irq, void (*isr)(), uint8_t mode);
+    void detachInterrupt(uint8_t irq);
+
+    void drive(uint8_t pin, uint8_t level);  // external stimulus on an input pin; fires attached interrupts
+    uint8_t level(uint8_t pin) const { return pin < 70 ? _level[pin] : 0; }
+    std::function<void(uint8_t pin, uint8_t level)> onWrite;  // called when firmware changes an output
+
+  private:
+    uint8_t _mode[70];
+    uint8_t _level[70];
+    void (*_isr[6])();
+    uint8_t _isrMode[6];
+};
+
+struct ds18b20 {  // one emulated sensor on the bus
+  uint8_t rom[8];
+  double temp;           // current sensor temperature, deg C (driven by the caller/simulator)
+  uint8_t scratch[9];    // scratchpad as read by READ SCRATCHPAD (0xBE)
+  bool converting;
+  uint64_t convDone;     // clock time at which the running conversion completes
+  bool present;          // false: device does not answer (disconnected)
+  bool stuck;            // fault: conversions leave the scratchpad as it was
+  bool resets;           // fault: browns out during each conversion and keeps its power-on scratchpad
+  double corrupt;        // fault: share of scratchpad reads with a bit flipped on the wire
+};
+
+class ds18b20Bus : public hal::oneWireBus {
+  public:
+    explicit ds18b20Bus(hal::clockSource* clock);
+    uint8_t reset();
+    void writeByte(uint8_t v);
+    uint8_t readByte();
+    void resetSearch() { _searchIndex = 0; }
+    uint8_t search(uint8_t* rom);
+
+    ds18b20& add(double temp);                 // attach a new sensor (serial number derived from its index)
+    ds18b20& device(size_t i) { return _devices[i]; }
+    size_t count() const { return _devices.size(); }
+    double conversionFactor;                   // fraction of the datasheet maximum a conversion takes
+    unsigned long transactions;                // reset pulses seen (one per bus transaction)
+
+  private:
+    enum { ROM_CMD, MATCH_ROM, FUNCTION, WRITE_SCRATCH, CONVERT, READ_SCRATCH, IDLE };
+    void _service(ds18b20& d);
+    bool _selected(size_t i) const { return _skip || _match == (int)i; }
+    static uint32_t _convUs(uint8_t config);
+
+    hal::clockSource* _clock;
+    std::vector<ds18b20> _devices;
+    int _state;
+    bool _skip;
+    int _match;
+    uint8_t _romBuf[8];
+    int _count;
+    size_t _searchIndex;
+    bool _garble;          // this READ SCRATCHPAD is corrupted
+    uint32_t _rng;         // corruption draws, deterministic
+};
+
+class simRtc : public hal::rtcSource {  // DS1307 tracking the virtual clock
+  public:
+    simRtc(hal::clockSource* clock, uint32_t epoch) : reads(0), ppm(0), _clock(clock), _epoch(epoch) {}
+    uint32_t now();
+    void adjust(uint32_t t);
+    double exact() const;  // time with its fraction, without a bus transaction (host checks)
+    unsigned long reads;  // I2C read transactions
+    double ppm;           // rate error of the board clock against the RTC: millis() runs ppm slow
+
+  private:
+    hal::clockSource* _clock;
+    double _epoch;
+};
+
+class ramEeprom : public hal::eepromStore {  // ATmega2560 EEPROM (4 KB); each written cell costs 3.4 ms
+  public:
+    explicit ramEeprom(hal::clockSource* clock);
+    uint16_t size() { return (uint16_t)_cells.size(); }
+    uint8_t read(uint16_t addr);
+    void write(uint16_t addr, uint8_t v);
+    bool load(const char* path);
+    bool save(const char* path) const;
+    std::vector<unsigned long> wear;  // write count per cell
+    long powerCut;  // > 0: power fails during that many'th next write, leaving the cell erased (0xFF) and
+                    // dropping every later write; -1: never
+
+  private:
+    hal::clockSource* _clock;
+    std::vector<uint8_t> _cells;
+};
+
+class dirFileSystem : public hal::fileSystem {  // SD card backed by a host directory
+  public:
+    dirFileSystem(hal::clockSource* clock, const std::string& root);
+    bool begin();
+    int open(const char* path, uint8_t mode);
+    void close(int h);
+    bool isDirectory(int h);
+    const char* name(int h);
+    int read(int h, uint8_t* buf, size_t n);
+    int peek(int h);
+    size_t write(int h, const uint8_t* buf, size_t n);
+    void flush(int h);
+    bool seek(int h, uint32_t pos);
+    uint32_t position(int h);
+    uint32_t size(int h);
+    int openNext(int dir, uint8_t mode);
+    void rewindDirectory(int dir);
+    bool exists(const char* path);
+    bool mkdir(const char* path);
+    bool remove(const char* path);
+    int createContiguous(const char* path, uint32_t size);
+    bool extent(int h, uint32_t* first, uint32_t* last);
+    bool truncate(int h, uint32_t size);
+    bool readBlock(uint32_t block, uint8_t* buf);
+    bool writeStart(uint32_t block, uint32_t count);
+    bool writeData(const uint8_t* buf);
+    bool writeStop();
+    bool erase(uint32_t first, uint32_t last);
+
+    std::string root;
+    bool inserted;             // false: begin() fails as with no card
+    unsigned long blockWrites; // 512 byte data blocks committed to the card
+    unsigned long fatWrites;   // directory/FAT sector updates
+    unsigned long streamBlocks;// blocks written inside multi-block writes (also counted in blockWrites)
+
+  private:
+    struct entry {
+      FILE* file;
+      std::string path;
+      std::string name;
+      bool dir;
+      std::vector<std::string> children;
+      size_t next;
+      uint32_t dirty;          // bytes written since the last block commit
+      bool modified;           // written since the last directory entry update
+      uint32_t allocated;      // bytes covered by allocated clusters
+    };
+    struct run {               // card blocks mapped onto a host file (every host file is contiguous)
+      uint32_t first, blocks;
+      int fd;
+    };
+    std::string _hostPath(const char* path) const;
+    entry* _get(int h);
+    void _commitBlock(entry& e);
+    void _fatUpdate(uint32_t clusters);  // both FAT copies for a chain of clusters
+    run* _map(const std::string& path, uint32_t bytes);
+    run* _find(uint32_t block, off_t& offset);
+    hal::clockSource* _clock;
+    std::map<int, entry> _open;
+    std::map<std::string, run> _runs;
+    uint32_t _nextBlock;       // first card block not yet mapped to a file
+    bool _streaming;
+    uint32_t _streamBlock;
+    int _next;
+};
+
+class hd44780 : public hal::lcdPanel {  // character display contents (DDRAM) for inspection
+  public:
+    hd44780();
+    void begin(uint8_t cols, uint8_t rows) { _cols = cols; _rows = rows; }
+    void command(uint8_t cmd);
+    void data(uint8_t v);
+    std::string row(uint8_t r) const;  // printable text of one display row
+    unsigned long bytes;               // instruction + data bytes transferred
+
+  private:
+    uint8_t _ddram[128];
+    uint8_t _cgram[64];
+    uint8_t _addr;
+    bool _cg;
+    uint8_t _cols, _rows;
+};
+
+class uartSink : public hal::serialPort {  // UART0 with a 64 byte TX buffer draining at the configured baud rate
+  public:
+    explicit uartSink(hal::clockSource* clock);
+    void begin(unsigned long baud);
+    size_t write(uint8_t v);
+    int availableForWrite();
+    int available();
+    int read();
+
+    FILE* out;                 // where transmitted bytes go (0 discards)
+    int fd;                    // alternatively a raw non-blocking descriptor, e.g. a pty master (-1 unused); also read
+    std::deque<uint8_t> rx;    // bytes waiting to be received by the firmware
+    unsigned long txBytes;
+    uint64_t blockedUs;        // time the firmware spent stalled on a full TX buffer
+
+  private:
+    void _drain();
+    hal::clockSource* _clock;
+    unsigned long _baud;
+    uint64_t _lastDrain;
+    double _queued;
+};
+
+class hostWatchdog : public hal::watchdog {
+  public:
+    explicit hostWatchdog(hal::clockSource* clock) : timeoutUs(0), maxGapUs(0), _clock(clock), _last(0) {}
+    void enable(uint8_t timeout);
+    void reset();
+    void disable() { timeoutUs = 0; }
+    bool expired();            // true if the firmware has not kicked the watchdog within the timeout
+    uint64_t timeoutUs;
+    uint64_t maxGapUs;         // longest interval between kicks seen so far
+
+  private:
+    hal::clockSource* _clock;
+    uint64_t _last;
+};
+
+class linuxBoard {  // complete in-process board: Mega 2560 + data logging shield + LCD + two DS18B20
+  public:
+    explicit linuxBoard(const std::string& sdRoot = "sd", int probes = 2);
+    hal::board* get() { return &_board; }
+
+    virtualClock clock;
+    pinBank gpio;
+    ds18b20Bus wire;
+    simRtc rtc;
+    ramEeprom eeprom;
+    dirFileSystem fs;
+    hd44780 lcd;
+    uartSink serial;
+    hostWatchdog wdt;
+
+  private:
+    hal::board _board;
+};
+
+linuxBoard& hostBoard();  // process default board (used by every thread without an attached board)
+
+#endif
@@ -0,0 +1,70 @@
+// npid-log -- converts binary LOGGERnn.BIN data logs back to the CSV column set of the old text logger
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../../datalog.h"
+
+static void usage() {
+  fprintf(stderr,
+    "usage: npid-log [options] LOGFILE\n"
+    "  -o FILE   write CSV to FILE instead of stdout\n"
+    "  -q        no summary on stderr\n");
+}
+
+int main(int argc, char** argv) {
+  const char* outPath = 0;
+  bool quiet = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "o:qh")) != -1) {
+    switch (opt) {
+      case 'o': outPath = optarg; break;
+      case 'q': quiet = true; break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1) { usage(); return 1; }
+
+  FILE* in = fopen(argv[optind], "rb");
+  if (!in) { perror(argv[optind]); return 1; }
+  byte block[512];
+  if (fread(block, 1, sizeof(block), in) != sizeof(block) || !datalog::checkHeader(block)) {
+    fprintf(stderr, "%s: not a version %u notoriousPID log\n", argv[optind], logVersion);
+    return 1;
+  }
+  bool contiguous = block[12] & logContiguous;  // an unclosed pre-allocated log ends at its first erased block
+  FILE* out = stdout;
+  if (outPath && !(out = fopen(outPath, "w"))) { perror(outPath); return 1; }
+
+  fprintf(out, "millis,datetime,fridge actual,fridge filter,beer actual,beer filter,mainSP,mainCO,heatSP,heatCO,peak estimator,fridge state\n");
+  unsigned long records = 0, bad = 0, gaps = 0, blocks = 0;
+  int lastSeq = -1;
+  size_t n;
+  while ((n = fread(block, 1, sizeof(block), in)) > 0) {
+    logRecord first;
+    if (contiguous && !datalog::unpack(block, first)) break;
+    blocks++;
+    for (size_t i = 0; i + logRecordSize <= n; i += logRecordSize) {
+      logRecord rec;
+      if (!datalog::unpack(block + i, rec)) {
+        if (block[i] == logSync) bad++;  // unused slots are erased (0xFF); a sync byte means a damaged record
+        continue;
+      }
+      if (lastSeq >= 0 && rec.seq != (byte)(lastSeq + 1)) gaps++;
+      lastSeq = rec.seq;
+      time_t t = rec.time;
+      struct tm tm;
+      gmtime_r(&t, &tm);  // the DS1307 keeps local wall time; no zone conversion
+      fprintf(out, "%lu,%d/%d/%d %d:%d:%d,%.10f,%.10f,%.10f,%.10f,%.10f,%.10f,%.10f,%.10f,%.2f,%u\n", rec.ms,
+              tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+              rec.fridgeTemp, rec.fridgeFilter, rec.beerTemp, rec.beerFilter, rec.setpoint, rec.output,
+              rec.heatSetpoint, rec.heatOutput, rec.peakEstimator, rec.state);
+      records++;
+    }
+  }
+  fclose(in);
+  if (out != stdout) fclose(out);
+  if (!quiet)
+    fprintf(stderr, "%lu records in %lu data blocks, %lu damaged, %lu sequence gaps\n", records, blocks, bad, gaps);
+  return bad ? 2 : 0;
+}
@@ -0,0 +1,182 @@
+// npid -- runs the notoriousPID sketch (setup()/loop()) natively against the in-process linux board
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <chrono>
+#include <thread>
+#include <string>
+#include "Arduino.h"
+#include "linux.h"
+#include "../probeBus.h"
+#include "../lcdFrame.h"
+#include "../scheduler.h"
+#include "../trace.h"
+#include "../telemetry.h"
+
+void setup();  // provided by notoriousPID.ino
+void loop();
+extern probeBus sensors;
+extern lcdFrame screen;
+extern scheduler sched;
+
+static void usage() {
+  fprintf(stderr,
+    "usage: npid [options]\n"
+    "  -t SEC   virtual run time in seconds (default 3600)\n"
+    "  -l US    CPU time charged per loop() pass in us (default 500)\n"
+    "  -d DIR   directory used as the SD card (default ./sd)\n"
+    "  -e FILE  EEPROM image, loaded at start and saved on exit\n"
+    "  -b TEMP  beer probe temperature, deg C (default 20)\n"
+    "  -f TEMP  fridge probe temperature, deg C (default 20)\n"
+    "  -n N     DS18B20 sensors on the bus (default 2; roles beer, fridge, ambient, vessel, coil)\n"
+    "  -s       echo Serial output to stdout\n"
+    "  -p       connect Serial to a new pty (its name is printed) and run in real time, e.g. for npid-telem\n"
+    "  -T FILE  at the end of the run send the trace dump command and capture the serial output to FILE\n"
+    "  -v       print the LCD contents on exit\n");
+}
+
+static std::string lcdRow(const hd44780& lcd, int r) {  // render the sketch's custom characters as ascii
+  static const char glyph[8] = { '^', '>', '*', 'o', '.', '#', 'C', 'F' };
+  std::string s = lcd.row(r);
+  for (size_t i = 0; i < s.size(); i++) {
+    if ((uint8_t)s[i] < 16) s[i] = glyph[(uint8_t)s[i] & 7];  // CGRAM 0-7, mirrored at 8-15
+      else if ((uint8_t)s[i] == 0xDF) s[i] = '\'';
+  }
+  return s;
+}
+
+int main(int argc, char** argv) {
+  double seconds = 3600, beerTemp = 20, fridgeTemp = 20;
+  unsigned long loopUs = 500;
+  const char* sdRoot = "sd";
+  const char* eepromFile = 0;
+  const char* traceFile = 0;
+  int probes = 2;
+  bool echo = false, verbose = false, pty = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:l:d:e:b:f:n:spT:vh")) != -1) {
+    switch (opt) {
+      case 't': seconds = atof(optarg); break;
+      case 'l': loopUs = strtoul(optarg, 0, 10); break;
+      case 'd': sdRoot = optarg; break;
+      case 'e': eepromFile = optarg; break;
+      case 'b': beerTemp = atof(optarg); break;
+      case 'f': fridgeTemp = atof(optarg); break;
+      case 'n': probes = atoi(optarg); break;
+      case 's': echo = true; break;
+      case 'p': pty = true; break;
+      case 'T': traceFile = optarg; break;
+      case 'v': verbose = true; break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  linuxBoard& board = hostBoard();  // the sketch's globals were constructed against this board before main()
+  board.fs.root = sdRoot;
+  board.wire.device(0).temp = beerTemp;    // first device found is bound to the beer probe
+  board.wire.device(1).temp = fridgeTemp;
+  for (int i = (int)board.wire.count(); i < probes; i++) board.wire.add(20.0);  // enumerated by sensors.begin() in setup()
+  if (echo) board.serial.out = stdout;
+  if (eepromFile) board.eeprom.load(eepromFile);
+  if (pty) {  // the board end of a serial cable
+    int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (master < 0 || grantpt(master) || unlockpt(master)) { perror("pty"); return 1; }
+    fprintf(stderr, "serial port: %s\n", ptsname(master));
+    board.serial.fd = master;
+  }
+
+  typedef std::chrono::steady_clock wall;
+  wall::time_point start = wall::now();
+  setup();
+
+  uint64_t end = board.clock.micros() + (uint64_t)(seconds * 1e6);
+  unsigned long loops = 0;
+  double hostNs = 0, hostMaxNs = 0;
+  uint64_t virtMaxUs = 0, virtTotalUs = 0;
+  while (board.clock.micros() < end) {
+    uint64_t v0 = board.clock.micros();
+    wall::time_point t0 = wall::now();
+    loop();
+    double ns = std::chrono::duration<double, std::nano>(wall::now() - t0).count();
+    uint64_t vus = board.clock.micros() - v0;
+    hostNs += ns;
+    if (ns > hostMaxNs) hostMaxNs = ns;
+    virtTotalUs += vus;
+    if (vus > virtMaxUs) virtMaxUs = vus;
+    board.clock.advance(loopUs);
+    loops++;
+    if (pty) {  // hold virtual time to wall time so that a terminal program sees a live board
+      std::chrono::duration<double> ahead = std::chrono::microseconds(board.clock.micros()) - (wall::now() - start);
+      if (ahead.count() > 0.001) std::this_thread::sleep_for(ahead);
+    }
+    if (board.wdt.expired()) {
+      fprintf(stderr, "watchdog expired at %.3f s\n", board.clock.micros() / 1e6);
+      break;
+    }
+  }
+  double wallSec = std::chrono::duration<double>(wall::now() - start).count();
+
+  if (traceFile) {  // the dump command as it would arrive from a terminal; the sketch answers within its tasks
+#if TRACE == true
+    FILE* cap = fopen(traceFile, "wb");
+    if (!cap) { perror(traceFile); return 1; }
+    FILE* echoed = board.serial.out;
+    board.serial.out = cap;
+#if TELEMETRY == true
+    byte cmd = traceDumpCmd, frame[telemMaxFrame];
+    byte n = telemetry::encode(CMD_TRACE, 0, &cmd, 1, frame);
+    board.serial.rx.insert(board.serial.rx.end(), frame, frame + n);
+#else
+    board.serial.rx.push_back(traceDumpCmd);
+#endif
+    uint64_t drained = 0;  // then half a second more for queued frames to leave the UART
+    while (!board.serial.rx.empty() || trace.dumping() || board.clock.micros() < drained) {
+      loop();
+      board.clock.advance(loopUs);
+      if (!drained && board.serial.rx.empty() && !trace.dumping()) drained = board.clock.micros() + 500000;
+    }
+    board.serial.out = echoed;
+    fclose(cap);
+#else
+    fprintf(stderr, "npid was built with TRACE=false; no trace dump\n");
+#endif
+  }
+  double virtSec = board.clock.micros() / 1e6;
+
+  if (eepromFile) board.eeprom.save(eepromFile);
+  if (verbose) {
+    for (int r = 0; r < 4; r++) printf("|%s|\n", lcdRow(board.lcd, r).c_str());
+  }
+  printf("virtual %.1f s in %.3f s wall (%.0fx real time), %lu loop passes\n", virtSec, wallSec, virtSec / wallSec, loops);
+  if (loops) {
+    printf("loop() host time: mean %.0f ns, max %.0f ns\n", hostNs / loops, hostMaxNs);
+    printf("loop() modelled AVR time: mean %.0f us, max %llu us (plus %lu us charged per pass)\n",
+           (double)virtTotalUs / loops, (unsigned long long)virtMaxUs, loopUs);
+  }
+  const convStats& conv = sensors.getConvStats();
+  if (conv.count)
+    printf("DS18B20 conversion: %lu samples, latency min %u / mean %.1f / max %u ms, %lu late polls, %lu timeouts\n",
+           conv.count, conv.min, (double)conv.total / conv.count, conv.max, conv.late, conv.timeouts);
+  for (byte i = 0; i < busMaxProbes; i++) {
+    probe* p = sensors.getProbe(i);
+    if (!p || !p->isPresent()) continue;
+    const probeHealth& h = p->getHealth();
+    printf("  role %u: %lu reads, %lu CRC errors, %lu missed samples; rejected %lu range, %lu rate, %lu stuck\n", i,
+           h.reads, h.crcErrors, h.misses, h.rangeErrors, h.rateErrors, h.stuckErrors);
+  }
+  const lcdFrameStats& lcd = screen.getStats();
+  if (lcd.frames)
+    printf("LCD: %lu frames, %lu bytes pushed (mean %.1f, max %u per frame), %lu bytes on the bus in total\n",
+           lcd.frames, lcd.bytes, (double)lcd.bytes / lcd.frames, lcd.max, board.lcd.bytes);
+  printf("tasks: %-5s %7s %9s %9s %9s %6s %8s\n", "name", "period", "runs", "mean us", "max us", "late", "overruns");
+  for (byte id = 0; id < sched.getSlots(); id++) {
+    const task* t = sched.getTask(id);
+    if (!t->period) continue;
+    printf("       %-5s %5lums %9lu %9.1f %9lu %6lu %8lu\n", (const char*)t->name, t->period, t->stats.runs,
+           t->stats.runs ? (double)t->stats.totalUs / t->stats.runs : 0.0, t->stats.maxUs, t->stats.late, t->stats.overruns);
+  }
+  printf("watchdog: longest kick interval %.1f ms\n", board.wdt.maxGapUs / 1000.0);
+  printf("relays: compressor %s, heater %s\n", board.gpio.level(A2) ? "off" : "on", board.gpio.level(A3) ? "off" : "on");
+  return 0;
+}
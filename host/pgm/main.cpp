@@ -0,0 +1,60 @@
+// npid-pgm -- checks temperature profiles (.PGM) with the firmware's parser before they go on the SD card
+#include <stdio.h>
+#include <unistd.h>
+#include "../../profile.h"
+
+static void usage() {
+  fprintf(stderr,
+    "usage: npid-pgm [options] FILE...\n"
+    "  -q        print errors only\n");
+}
+
+static const char* segmentText[] = { "hold", "ramp", "exp", "wait" };
+static const char* errorText[] = { "ok", "syntax error", "more than three fields", "number too long",
+                                   "temperature or duration out of range", "too many steps", "no steps",
+                                   "read error" };
+
+int main(int argc, char** argv) {
+  bool quiet = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "qh")) != -1) {
+    switch (opt) {
+      case 'q': quiet = true; break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc) { usage(); return 1; }
+
+  int failed = 0;
+  for (int f = optind; f < argc; f++) {
+    FILE* in = fopen(argv[f], "rb");
+    if (!in) { perror(argv[f]); failed++; continue; }
+    profileTable table;
+    profileParser parser;
+    parser.begin(&table);
+    char buf[profileBlockSize];  // same block size as the sketch
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0 && parser.feed(buf, n)) {}
+    if (ferror(in)) parser.fail(PROFILE_READ);
+    fclose(in);
+    byte error = parser.finish();
+    if (error) {
+      fprintf(stderr, "%s:%u: %s\n", argv[f], parser.line(), errorText[error]);
+      failed++;
+      continue;
+    }
+    if (quiet) continue;
+    printf("%s: %u steps\n", argv[f], table.count());
+    unsigned long minutes = 0;
+    bool waits = false;
+    for (byte i = 0; i < table.count(); i++) {
+      const profileStep& s = table.step(i);
+      printf("  %2u  %-4s  %6.2f C  %7.2f h  (starts at %s%.2f h)\n", i + 1, segmentText[s.segment],
+             profileTable::toTemp(s.temp), s.minutes / 60.0, waits ? ">= " : "", minutes / 60.0);
+      if (s.segment == SEGMENT_WAIT) waits = true;  // ends when the beer gets there: later times are lower bounds
+        else minutes += s.minutes;
+    }
+    printf("  total %s%.2f h (%.1f days)\n", waits ? ">= " : "", minutes / 60.0, minutes / 1440.0);
+  }
+  return failed ? 1 : 0;
+}
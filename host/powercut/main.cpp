@@ -0,0 +1,220 @@
+// npid-powercut -- settings store power loss test: cuts the power at every EEPROM cell of every commit and
+// checks the next start recovers the previous or the new record (exits 1 on any other outcome)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <random>
+#include "../linux.h"
+#include "../../settings.h"
+
+static void usage() {
+  fprintf(stderr,
+    "usage: npid-powercut [options]\n"
+    "  -n N     commits (default 200: the ring wraps about three times)\n"
+    "  -s SEED  random seed for the settings changes (default 1)\n"
+    "  -v       print every failed cut\n");
+}
+
+static settingsRecord live;  // what the sketch would capture
+static void capture(settingsRecord& r) { r = live; }
+
+static bool same(const settingsRecord& a, const settingsRecord& b) {  // as stored (floats)
+  byte pa[settingsSlotSize], pb[settingsSlotSize];
+  settingsStore::pack(a, 0, pa);
+  settingsStore::pack(b, 0, pb);
+  return !memcmp(pa, pb, settingsSlotSize);
+}
+
+static void change(settingsRecord& r, std::mt19937& rng) {  // one to three settings, as from the menu
+  int n = 1 + rng() % 3;
+  for (int i = 0; i < n; i++) {
+    switch (rng() % 8) {
+      case 0: r.setpoint = (rng() % 320) / 16.0; break;
+      case 1: r.output = (rng() % 380) / 10.0; break;
+      case 2: r.kp = (rng() % 2000) / 100.0; r.ki = (rng() % 100) * 1e-5; r.kd = rng() % 1000; break;
+      case 3: r.heatOutput = rng() % 300000; break;
+      case 4: r.peakEstimator = (rng() % 1000) / 100.0; break;
+      case 5: r.programState = rng() & 0x3E; break;
+      case 6: r.logFile = rng() % 100; break;
+      case 7:
+        for (int c = 0; c < 8; c++) r.profile[c] = (c < 5) ? 'A' + rng() % 26 : 0;
+        r.profileStep = rng() % 20;
+        r.profileStart = rng();
+        r.profileFrom = (int)(rng() % 4000) - 1000;
+        break;
+    }
+  }
+}
+
+static void writeLegacy(ramEeprom& e, const settingsRecord& r) {  // EEPROM_VER 11 fixed address layout
+  e.write(0, settingsLegacyVer);
+  e.write(1, r.programState);
+  const double v[10] = { r.setpoint, r.output, r.kp, r.ki, r.kd, r.heatOutput, r.heatKp, r.heatKi, r.heatKd,
+                         r.peakEstimator };
+  for (int i = 0; i < 10; i++) {
+    float f = v[i];
+    byte b[4];
+    memcpy(b, &f, 4);
+    for (int k = 0; k < 4; k++) e.write(2 + 4 * i + k, b[k]);
+  }
+  e.write(42, '0' + r.logFile / 10);
+  e.write(43, '0' + r.logFile % 10);
+  for (int i = 0; i < 8; i++) e.write(44 + i, r.profile[i]);
+  e.write(52, r.profileStep & 0xFF);
+  e.write(53, r.profileStep >> 8);
+}
+
+int main(int argc, char** argv) {
+  long commits = 200;
+  unsigned seed = 1;
+  bool verbose = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:vh")) != -1) {
+    switch (opt) {
+      case 'n': commits = atol(optarg); break;
+      case 's': seed = strtoul(optarg, 0, 10); break;
+      case 'v': verbose = true; break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  linuxBoard board("", 2);
+  hal::attach(board.get());
+  ramEeprom& eeprom = board.eeprom;
+  std::mt19937 rng(seed);
+  unsigned long failures = 0;
+
+  memset(&live, 0, sizeof(live));  // the settingsDefaults() values of the legacy firmware
+  live.programState = 0b001000;
+  live.setpoint = live.output = 20;
+  live.kp = 10; live.ki = 5e-4; live.kd = 500;
+  live.heatKp = 5; live.heatKi = 0.25; live.heatKd = 1.15;  // the old heat gains, replaced on migration
+  live.peakEstimator = 5;
+  live.logFile = 7;
+  strcpy(live.profile, "LAGER");
+  live.profileStep = 3;
+
+  settingsRecord upgraded = live;  // what an older record loads as: heat gains from before schema 3 are replaced
+  upgraded.heatKp = settingsHeatKp;
+  upgraded.heatKi = settingsHeatKi;
+  upgraded.heatKd = settingsHeatKd;
+  const settingsRecord legacy = live;
+
+  {  // legacy import: fixed addresses in, a ring record out
+    writeLegacy(eeprom, legacy);
+    settingsStore store;
+    settingsRecord r;
+    byte source = store.begin(r, capture);
+    live = r;  // as settingsApply()
+    store.flush();
+    settingsStore again;
+    settingsRecord r2;
+    byte source2 = again.begin(r2, capture);
+    bool ok = (source == SETTINGS_LEGACY) && same(r, upgraded) && (source2 == SETTINGS_RING) && same(r2, upgraded);
+    printf("legacy import: %s\n", ok ? "ok" : "FAILED");
+    if (!ok) failures++;
+  }
+
+  for (byte schema = 1; schema < settingsSchema; schema++) {  // older record: read with its layout, rewritten in the current schema
+    eeprom = ramEeprom(&board.clock);
+    byte slot[settingsSlotSize];
+    settingsStore::pack(legacy, 9, slot);
+    slot[1] = schema;
+    if (schema == 1) memset(slot + 56, 0, 6);  // schema 1 ended at byte 55
+    uint16_t crc = settingsStore::crc16(slot, settingsSlotSize - 2);
+    slot[settingsSlotSize - 2] = crc & 0xFF;
+    slot[settingsSlotSize - 1] = crc >> 8;
+    for (int i = 0; i < settingsSlotSize; i++) eeprom.write(settingsBase + i, slot[i]);
+    settingsStore store;
+    settingsRecord r;
+    byte source = store.begin(r, capture);
+    live = r;
+    store.flush();
+    settingsStore again;
+    settingsRecord r2;
+    byte source2 = again.begin(r2, capture);
+    settingsRecord expect = upgraded;
+    if (schema == 1) expect.profileStart = expect.profileFrom = 0;
+    bool ok = (source == SETTINGS_MIGRATED) && same(r, expect) && (source2 == SETTINGS_RING) && same(r2, expect);
+    printf("schema %u migration: %s\n", schema, ok ? "ok" : "FAILED");
+    if (!ok) failures++;
+  }
+  live = upgraded;
+
+  eeprom = ramEeprom(&board.clock);  // blank, with one record just short of the sequence number wrap
+  byte slot[settingsSlotSize];
+  settingsStore::pack(live, 0xFFFF - commits / 2, slot);
+  for (int i = 0; i < settingsSlotSize; i++) eeprom.write(settingsBase + 5 * settingsSlotSize + i, slot[i]);
+  std::fill(eeprom.wear.begin(), eeprom.wear.end(), 0);
+
+  settingsStore store;
+  settingsRecord r;
+  if ((store.begin(r, capture) != SETTINGS_RING) || !same(r, live)) {
+    printf("seeded record not found\n");
+    return 1;
+  }
+  unsigned long cuts = 0, old = 0, recent = 0, torn = 0;
+  for (long k = 0; k < commits; k++) {
+    settingsRecord prev = live;
+    change(live, rng);
+    ramEeprom before = eeprom;
+    unsigned long cells = store.getStats().cells;
+    store.change();
+    store.flush();
+    cells = store.getStats().cells - cells;
+    ramEeprom after = eeprom;
+
+    for (unsigned long cut = 1; cut <= cells; cut++) {  // replay the commit from a fresh start, cut at each cell
+      eeprom = before;
+      settingsStore s;
+      settingsRecord got;
+      s.begin(got, capture);
+      eeprom.powerCut = cut;
+      s.change();
+      s.flush();
+      eeprom.powerCut = -1;
+
+      settingsStore restart;  // power back
+      byte source = restart.begin(got, capture);
+      cuts++;
+      if (same(got, prev)) old++;
+      else if (same(got, live) && (cut == cells)) recent++;  // only the last cell may complete the new record
+      else {
+        failures++;
+        if (verbose) printf("commit %ld cut at cell %lu: recovered neither record (source %d)\n", k, cut, source);
+        continue;
+      }
+      torn += restart.getStats().badSlots;
+
+      settingsRecord next = live;  // the store keeps working after the torn slot
+      live.setpoint += 1;
+      restart.change();
+      restart.flush();
+      settingsStore check;
+      check.begin(got, capture);
+      if (!same(got, live)) {
+        failures++;
+        if (verbose) printf("commit %ld cut at cell %lu: next commit lost\n", k, cut);
+      }
+      live = next;
+    }
+    eeprom = after;
+  }
+
+  const settingsStats& st = store.getStats();
+  unsigned long lo = ~0UL, hi = 0, sum = 0;
+  for (unsigned int a = settingsBase; a < settingsBase + settingsSlots * settingsSlotSize; a++) {
+    lo = std::min(lo, eeprom.wear[a]);
+    hi = std::max(hi, eeprom.wear[a]);
+    sum += eeprom.wear[a];
+  }
+  printf("commits %lu, %lu cells written (%.1f per commit, %.0f ms each)\n", st.commits, st.cells,
+         (double)st.cells / st.commits, 3.4 * st.cells / st.commits);
+  printf("power cuts %lu: %lu recovered the previous record, %lu the new one; %lu torn slots detected\n", cuts, old,
+         recent, torn);
+  printf("ring wear per cell: min %lu, mean %.2f, max %lu writes (%lu commits)\n", lo,
+         (double)sum / (settingsSlots * settingsSlotSize), hi, st.commits);
+  printf("%s: %lu failures\n", failures ? "FAILED" : "ok", failures);
+  hal::attach(0);
+  return failures ? 1 : 0;
+}
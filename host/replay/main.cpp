@@ -0,0 +1,352 @@
+// npid-replay -- re-runs the controller on a binary data log.  the logged probe readings, setpoints and
+// modes are fed through the firmware's probe filters, PIDs and fridge state machine on a virtual clock (the
+// logged millis()), and what they compute is checked against what the board logged, record by record.
+// the first record that disagrees is reported with both sets of values; the log is streamed a block at a
+// time, so memory does not grow with its length.
+//
+// the log holds the controller's outputs but not its memory (integral terms, slope history, fridge timers),
+// and setpoints and outputs only to 1/128 deg C, so the replay picks up a running controller: it starts on
+// the first record's values and settles for a while, taking the logged PID outputs as it goes (bumpless,
+// setOutput()), until the fridge enters COOL or HEAT on the same record as the log.  from there each record
+// is one step of the controller from the logged state: the outputs and the peak estimator are compared and
+// then set to the logged values, so the log's rounding does not build up in the integral terms.  with -f
+// the replay runs free after settling and a divergence is anything that has built up since.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include <memory>
+#include "../../chamber.h"
+#include "../../datalog.h"
+#include "../linux.h"
+
+static const byte coolPin = A2, heatPin = A3;  // relay1 and relay2
+static const unsigned long sampleMs = 1000;      // mainSampleMs
+static const unsigned int relayMs = 100;         // relayPeriodMs
+
+enum { F_FRIDGE, F_BEER, F_OUTPUT, F_HEAT_SP, F_HEAT_OUT, F_ESTIMATOR, F_STATE, FIELDS };
+static const char* fieldName[FIELDS] = { "fridge filter", "beer filter", "mainCO", "heatSP", "heatCO",
+                                         "peak estimator", "fridge state" };
+
+struct tunings {
+  double kp, ki, kd, heatKp, heatKi, heatKd;
+};
+
+struct replayRig {  // the sketch's chamber 0 with its probes, driven by log records instead of the bus and the menu
+  probeFilter beerFilter, airFilter;
+  probe beer, air;
+  byte programState;
+  byte model;              // COOL_MODEL, not logged
+  chamber ch;
+  unsigned long pidClock;  // pidTask release times
+  boolean beerAhead;       // the beer probe was read, the air probe not yet: no bus sample until it is
+  byte quiet;              // records without a reading of either probe
+  byte lost;               // chamber's lost probes
+  byte sinceLost;          // records since they changed, saturating
+
+  byte modes(byte flags) {  // program state bits of the logged modes
+    return ((flags & logMainAuto) ? 0b100000 : 0) | ((flags & logHeatAuto) ? 0b010000 : 0) | model;
+  }
+
+  replayRig(const logRecord& r, const tunings& k, bool coolModel) : beer(&beerFilter), air(&airFilter),
+      model(coolModel ? 0b1000000 : 0), ch(&beer, &air, coolPin, heatPin, &programState), pidClock(r.ms), beerAhead(false), quiet(0), lost(0), sinceLost(255) {  // picks up at r: filters and PIDs settled on its values
+    programState = modes(r.flags);
+    beerFilter.reset(r.beerFilter);
+    airFilter.reset(r.fridgeFilter);
+    ch.openRelays();
+    ch.sample();
+    ch.setpoint = r.setpoint;
+    ch.output = r.output;
+    ch.heatSetpoint = r.heatSetpoint;
+    ch.heatOutput = r.heatOutput;
+    *ch.controller.getPeakEstimatorAddr() = r.peakEstimator;
+    ch.begin(sampleMs, k.kp, k.ki, k.kd, k.heatKp, k.heatKi, k.heatKd);
+  }
+
+  void read(const logRecord& r) {  // probeTask: the bus reads beer, then air, then hands the chamber a sample
+    byte beerReads = r.flags & logBeerReads, airReads = (r.flags & logAirReads) >> 2;
+    byte samples = max(beerReads, airReads);  // bus samples in the record, as far as the probes read tell
+    if (!samples) samples = quiet++ ? 1 : 0;  // a late sample, or from the second record without one, both probes missing
+      else quiet = 0;
+    for (byte i = beerReads; i < samples; i++) beer.miss();
+    for (byte i = airReads; i < samples; i++) air.miss();
+    while (beerReads || airReads) {  // only the newest reading of each probe is logged
+      if ((beerAhead || !beerReads) && airReads) {
+        air.read(r.fridgeTemp);
+        airReads--;
+        ch.sample();
+        beerAhead = false;
+      }
+      else {
+        beer.read(r.beerTemp);
+        beerReads--;
+        beerAhead = true;
+      }
+    }
+    if (beerAhead && (air.getHealth().failures > 1)) {  // the air probe is missing, not late: the sample ended without it
+      ch.sample();
+      beerAhead = false;
+    }
+  }
+
+  void step(const logRecord& r, unsigned long lastMs) {  // the tasks between the previous record and r, ending with r's pidTask and fridgeTask
+    byte state = modes(r.flags);
+    if (state != programState) {  // changed from the menu
+      programState = state;
+      ch.setModes();
+    }
+    ch.setpoint = r.setpoint;  // menu, profile and telemetry inputs
+    if (!(programState & 0b100000)) ch.output = r.output;
+    if (!(programState & 0b010000)) {
+      ch.heatSetpoint = r.heatSetpoint;
+      ch.heatOutput = r.heatOutput;
+    }
+    uint32_t span = r.ms - lastMs;
+    unsigned long passes = max((span + relayMs / 2) / relayMs, 1UL);
+    for (unsigned long i = 1; i < passes; i++) {
+      if (i == passes / 2) read(r);  // when in the interval is not logged: halfway keeps the relay timing within half a record
+      ch.update(lastMs + i * relayMs);
+    }
+    if (passes < 2) read(r);
+    for (unsigned long i = max((span + sampleMs / 2) / sampleMs, 1UL); i; i--) ch.compute(pidClock += sampleMs);
+    ch.update(r.ms);
+    if (ch.getLost() != lost) sinceLost = 0;
+      else if (sinceLost < 255) sinceLost++;
+    lost = ch.getLost();
+  }
+
+  bool lostEdge(byte slip) {  // a probe was just lost or picked up again, or is a miss or two from being lost
+    byte f = max(beer.getHealth().failures, air.getHealth().failures);
+    return (sinceLost <= slip) || ((f < probeLostSamples) && (f + 2 >= probeLostSamples));
+  }
+
+  void anchor(const logRecord& r, const logRecord& q, bool relays) {  // take the logged values where the replay's round differently
+    if ((programState & 0b100000) && (q.output != r.output)) ch.mainPID.setOutput(r.output);
+    if (!relays) return;  // fridge state off by a relay decision: keep the replay's heat output and estimator until it catches up
+    if ((programState & 0b010000) && (q.heatOutput != r.heatOutput)) ch.heatPID.setOutput(r.heatOutput);
+    if (q.peakEstimator != r.peakEstimator) *ch.controller.getPeakEstimatorAddr() = r.peakEstimator;
+  }
+
+  void record(logRecord& q, const logRecord& r) {  // the record writeLog() would make now, through the log encoding
+    logRecord x = r;
+    x.fridgeFilter = air.getFilter();
+    x.beerFilter = beer.getFilter();
+    x.output = ch.output;
+    x.heatSetpoint = ch.heatSetpoint;
+    x.heatOutput = ch.heatOutput;
+    x.peakEstimator = ch.controller.getPeakEstimator();
+    x.state = ch.controller.getState(0);
+    byte buf[logRecordSize];
+    datalog::pack(x, buf);
+    datalog::unpack(buf, q);
+  }
+};
+
+struct divergence {
+  unsigned long records;  // records off by more than the tolerance
+  double worst;           // largest difference
+};
+
+static void printRecord(const char* label, const logRecord& r) {
+  printf("  %-8s fridge %8.4f/%8.4f  beer %8.4f/%8.4f  SP %8.4f  CO %8.4f  heat SP %8.4f CO %6.0f  pE %.4f  state %u\n",
+         label, r.fridgeTemp, r.fridgeFilter, r.beerTemp, r.beerFilter, r.setpoint, r.output, r.heatSetpoint,
+         r.heatOutput, r.peakEstimator, r.state);
+}
+
+static double difference(byte f, const logRecord& q, const logRecord& r) {  // replayed - logged
+  switch (f) {
+    case F_FRIDGE: return q.fridgeFilter - r.fridgeFilter;
+    case F_BEER: return q.beerFilter - r.beerFilter;
+    case F_OUTPUT: return q.output - r.output;
+    case F_HEAT_SP: return q.heatSetpoint - r.heatSetpoint;
+    case F_HEAT_OUT: return q.heatOutput - r.heatOutput;
+    case F_ESTIMATOR: return (q.peakEstimator - r.peakEstimator) / max(r.peakEstimator, 1e-6);  // relative
+    default: return q.state != r.state;
+  }
+}
+
+// relay decisions compare values the log only holds to its rounding (mainPID output, setpoint), and the
+// replay runs the fridge state machine on the log's clock rather than the board's, so a COOL or HEAT start
+// or stop may land a record or two off the logged one; with it the heat PID window and the peak estimator
+// tuning.  those fields diverge only when they stay off for more than a few records.  so does mainCO when
+// a probe has just been lost or picked up again: whether that bus sample came before or after the record's
+// PID compute is not logged either.
+struct replayer {  // record by record check of a log
+  tunings k;
+  double tol[FIELDS];
+  double settle;           // s
+  byte slip;               // records a relay decision may be off
+  bool coolModel, free, all;
+  std::unique_ptr<replayRig> rig;
+  logRecord last;          // the previous record
+  bool settling;
+  uint32_t settleUntil;
+  unsigned long records, checked, resyncs, first;
+  byte off[FIELDS];        // consecutive records off, saturating
+  divergence div[FIELDS];
+
+  replayer() : settle(600), slip(5), coolModel(false), free(false), all(false), settling(true), settleUntil(0),
+               records(0), checked(0), resyncs(0), first(0) {
+    memset(div, 0, sizeof(div));
+  }
+
+  void feed(const logRecord& r) {
+    records++;
+    bool gap = rig && (r.seq != (byte)(last.seq + 1));  // lost records: the readings in them are unknown
+    bool reset = rig && ((int32_t)(r.ms - last.ms) <= 0);  // millis() went back: the board restarted
+    if (gap || reset) {
+      resyncs++;
+      rig.reset();
+    }
+    if (!rig) {  // pick up the controller at r
+      rig.reset(new replayRig(r, k, coolModel));
+      settleUntil = r.ms + (uint32_t)(settle * 1000);
+      settling = true;
+      memset(off, 0, sizeof(off));
+      last = r;
+      return;
+    }
+    rig->step(r, last.ms);
+    logRecord q;
+    rig->record(q, r);
+    if (settling) {  // until a COOL or HEAT start lands on the logged record: the fridge timers agree from there
+      rig->anchor(r, q, true);
+      if ((r.state != last.state) && (r.state != IDLE) && (q.state == r.state) && ((int32_t)(r.ms - settleUntil) >= 0))
+        settling = false;
+      last = r;
+      return;
+    }
+    last = r;
+    check(r, q);
+  }
+
+  void check(const logRecord& r, const logRecord& q) {
+    checked++;
+    bool diverged = false;
+    double d[FIELDS];
+    for (byte f = 0; f < FIELDS; f++) {
+      d[f] = difference(f, q, r);
+      double e = fabs(d[f]);
+      if (e > div[f].worst) div[f].worst = e;
+      if (e <= tol[f]) {
+        off[f] = 0;
+        continue;
+      }
+      if (off[f] < 255) off[f]++;
+      if (((f >= F_HEAT_SP) || ((f == F_OUTPUT) && rig->lostEdge(slip))) && (off[f] <= slip)) {
+        d[f] = 0;  // not yet
+        continue;
+      }
+      div[f].records++;
+      diverged = true;
+    }
+    if (!free) rig->anchor(r, q, !off[F_STATE]);  // one step from the logged state each record
+    if (!diverged || (first && !all)) return;
+    if (!first) first = records;
+    time_t t = r.time;
+    struct tm tm;
+    gmtime_r(&t, &tm);  // the DS1307 keeps local wall time
+    printf("record %lu, millis %lu, %d/%d/%d %d:%02d:%02d:", records, r.ms, tm.tm_year + 1900, tm.tm_mon + 1,
+           tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    const char* sep = " ";
+    for (byte f = 0; f < FIELDS; f++) {
+      if (fabs(d[f]) <= tol[f]) continue;
+      printf("%s%s", sep, fieldName[f]);
+      if (f >= F_HEAT_SP) printf(" (%u records)", off[f]);
+      sep = ", ";
+    }
+    printf(" diverged\n");
+    printRecord("logged", r);
+    printRecord("replayed", q);
+  }
+};
+
+static void usage() {
+  fprintf(stderr,
+    "usage: npid-replay [options] LOGFILE\n"
+    "  -k KP,KI,KD   main PID tunings (default 10,5e-4,500 as settingsDefaults())\n"
+    "  -K KP,KI,KD   heat PID tunings (default 3.7e5,175,5.5e7)\n"
+    "  -t C          mainCO and heatSP tolerance, deg C (default 0.02)\n"
+    "  -T MS         heatCO tolerance, ms (default 2000)\n"
+    "  -w S          settle at least this long after the start and each resync (default 600)\n"
+    "  -s N          relay decisions may land up to N records off the logged ones (default 5)\n"
+    "  -m            the board stopped COOL on the coolModel prediction (not logged)\n"
+    "  -f            run free after settling instead of taking the logged outputs every record\n"
+    "  -a            report every divergent record, not only the first\n"
+    "  -q            no summary\n"
+    "filters must match to the log resolution\n"
+    "exits 0 when the replay matches, 1 on a divergence, 2 if the log is damaged or unreadable\n");
+}
+
+static bool parseTunings(const char* s, double& a, double& b, double& c) {
+  return sscanf(s, "%lf,%lf,%lf", &a, &b, &c) == 3;
+}
+
+int main(int argc, char** argv) {
+  replayer rp;
+  rp.k = (tunings){ 10, 5e-4, 500, 3.7e5, 175, 5.5e7 };
+  double tolerance = 0.02, heatTolerance = 2000;
+  bool quiet = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "k:K:t:T:w:s:mfaqh")) != -1) {
+    switch (opt) {
+      case 'k': if (!parseTunings(optarg, rp.k.kp, rp.k.ki, rp.k.kd)) { usage(); return 1; } break;
+      case 'K': if (!parseTunings(optarg, rp.k.heatKp, rp.k.heatKi, rp.k.heatKd)) { usage(); return 1; } break;
+      case 't': tolerance = atof(optarg); break;
+      case 'T': heatTolerance = atof(optarg); break;
+      case 'w': rp.settle = atof(optarg); break;
+      case 's': rp.slip = constrain(atoi(optarg), 0, 254); break;
+      case 'm': rp.coolModel = true; break;
+      case 'f': rp.free = true; break;
+      case 'a': rp.all = true; break;
+      case 'q': quiet = true; break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1) { usage(); return 1; }
+  double tol[FIELDS] = { 0.5 / logTempScale, 0.5 / logTempScale, tolerance, tolerance, heatTolerance,
+                         1e-3, 0 };  // filters: exact but for the log rounding; estimator: the tuning factor follows the stop time
+  for (byte f = 0; f < FIELDS; f++) rp.tol[f] = tol[f] + 1e-9;
+
+  FILE* in = fopen(argv[optind], "rb");
+  if (!in) { perror(argv[optind]); return 2; }
+  setvbuf(in, 0, _IOFBF, 1 << 16);
+  byte block[512];
+  if (fread(block, 1, sizeof(block), in) != sizeof(block) || !datalog::checkHeader(block)) {
+    fprintf(stderr, "%s: not a version %u notoriousPID log\n", argv[optind], logVersion);
+    return 2;
+  }
+  bool contiguous = block[12] & logContiguous;
+
+  linuxBoard board("", 0);  // relay pins for the fridge state machine; nothing else is touched
+  hal::attach(board.get());
+  typedef std::chrono::steady_clock wall;
+  wall::time_point start = wall::now();
+  unsigned long bad = 0;
+  size_t n;
+  while ((n = fread(block, 1, sizeof(block), in)) > 0) {
+    logRecord r;
+    if (contiguous && !datalog::unpack(block, r)) break;  // end of an unclosed pre-allocated log
+    for (size_t i = 0; i + logRecordSize <= n; i += logRecordSize) {
+      if (datalog::unpack(block + i, r)) rp.feed(r);
+        else if (block[i] == logSync) bad++;  // unused slots are erased (0xFF); a sync byte means a damaged record
+    }
+  }
+  fclose(in);
+  hal::attach(0);
+  double wallSec = std::chrono::duration<double>(wall::now() - start).count();
+
+  if (!quiet) {
+    printf("%lu records, %lu checked, %lu damaged, %lu resyncs; %.2f M records/s\n", rp.records, rp.checked, bad,
+           rp.resyncs, rp.records / max(wallSec, 1e-9) / 1e6);
+    for (byte f = 0; f < FIELDS; f++) printf("  %-15s %lu records off, worst %.4g\n", fieldName[f], rp.div[f].records, rp.div[f].worst);
+    if (rp.first) printf("first divergence at record %lu\n", rp.first);
+      else if (rp.checked) printf("replay matches the log\n");
+      else printf("replay never settled: no COOL or HEAT start matched the log\n");
+  }
+  if (bad) return 2;
+  return (rp.first || !rp.checked) ? 1 : 0;
+}
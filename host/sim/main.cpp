@@ -0,0 +1,276 @@
+// npid-sim -- runs the sketch closed loop against the fermentation chamber model on the virtual clock
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include "avr/wdt.h"
+#include "RTClib.h"
+#include "../../autotune.h"
+#include "../../chamber.h"
+#include "../../datalog.h"
+#include "../../fridge.h"
+#include "../../probeBus.h"
+#include "../../profile.h"
+#include "../../timeKeeper.h"
+#include "../linux.h"
+#include "metrics.h"
+#include "plant.h"
+#include "scenario.h"
+
+void setup();  // provided by notoriousPID.ino
+void loop();
+void mainUpdate();
+void backOut();
+void menu(byte event);  // uiHandler screens
+void autoTune(byte event);
+void uiOpen(void (*handler)(byte));
+void menuLeave();
+extern double &Setpoint, &Output;  // chamber 0's, as the sketch names them
+extern double Kp, Ki, Kd, heatKp, heatKi, heatKd;
+extern byte programState;
+extern datalog LogFile;
+extern pidEngine &mainPID, &heatPID;
+extern probeBus sensors;
+extern chamber chambers[];
+extern profileTable profile;
+extern profileRunner profileRun;
+extern timeKeeper wallClock;
+extern relayTuner tuner;
+extern byte tuneLoop;
+extern char encoderPos;
+
+static void usage() {
+  fprintf(stderr,
+    "usage: npid-sim [options] SCENARIO\n"
+    "  -u        run the full loop() (display/menu polling) instead of only mainUpdate()\n"
+    "  -l US     virtual time between passes (default 100000, or 500 with -u)\n"
+    "  -o FILE   write a CSV trace of the plant and controller\n"
+    "  -i SEC    trace interval (default 60)\n"
+    "  -d DIR    directory used as the SD card (default ./sd)\n"
+    "  -g        enable data logging (new LOGGERnn.BIN on the SD card, as from the menu)\n"
+    "  -p FILE   run the temperature profile FILE (.PGM) instead of the scenario's setpoints\n"
+    "  -m        stop COOL on the coolModel prediction instead of the peakEstimator (as from the menu)\n"
+    "  -a        add an ambient probe (room temperature) to the bus\n"
+    "  -T LOOP   run the relay auto-tuner on LOOP (main or heat) as from the menu; exits 1 if it fails\n"
+    "  -R PPM    board clock (millis()) runs PPM slow against the RTC (negative: fast)\n"
+    "  -W HOURS  start the board clock HOURS before the millis() rollover\n"
+    "  -s        echo Serial output to stdout\n");
+}
+
+int main(int argc, char** argv) {
+  bool ui = false, echo = false, logging = false, model = false, roomProbe = false;
+  long stepUs = -1;
+  double traceEvery = 60;
+  const char* tracePath = 0;
+  const char* sdRoot = "sd";
+  const char* profilePath = 0;
+  int tune = 0;  // TUNE_MAIN, TUNE_HEAT
+  double ppm = 0, wrapHours = -1;
+  int opt;
+  while ((opt = getopt(argc, argv, "ul:o:i:d:gp:maT:R:W:sh")) != -1) {
+    switch (opt) {
+      case 'u': ui = true; break;
+      case 'l': stepUs = atol(optarg); break;
+      case 'o': tracePath = optarg; break;
+      case 'i': traceEvery = atof(optarg); break;
+      case 'd': sdRoot = optarg; break;
+      case 'g': logging = true; break;
+      case 'p': profilePath = optarg; break;
+      case 'm': model = true; break;
+      case 'a': roomProbe = true; break;
+      case 'T':
+        tune = !strcmp(optarg, "main") ? 1 : !strcmp(optarg, "heat") ? 2 : -1;
+        if (tune < 0) { usage(); return 1; }
+        break;
+      case 'R': ppm = atof(optarg); break;
+      case 'W': wrapHours = atof(optarg); break;
+      case 's': echo = true; break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1) { usage(); return 1; }
+  if (stepUs <= 0) stepUs = ui ? 500 : 100000;
+
+  scenario scn;
+  std::string err;
+  if (!scn.load(argv[optind], err)) { fprintf(stderr, "%s\n", err.c_str()); return 1; }
+  FILE* trace = 0;
+  if (tracePath && !(trace = fopen(tracePath, "w"))) { perror(tracePath); return 1; }
+  profileTable steps;
+  if (profilePath) {  // parsed as the sketch does, copied in after setup()
+    FILE* in = fopen(profilePath, "rb");
+    if (!in) { perror(profilePath); return 1; }
+    profileParser parser;
+    parser.begin(&steps);
+    char buf[profileBlockSize];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0 && parser.feed(buf, n)) {}
+    fclose(in);
+    if (parser.finish()) {
+      fprintf(stderr, "%s:%u: profile error %u (npid-pgm explains)\n", profilePath, parser.line(), parser.error());
+      return 1;
+    }
+  }
+
+  linuxBoard& board = hostBoard();
+  board.fs.root = sdRoot;
+  if (echo) board.serial.out = stdout;
+  fermPlant plant(scn.params);
+  plant.init(scn.initAir, scn.initBeer);
+  board.wire.device(0).temp = plant.beerProbe();  // beer probe is constructed (and so enumerated) first
+  board.wire.device(1).temp = plant.airProbe();
+  if (roomProbe) board.wire.add(scn.ambient(0));  // enumerated third: ROLE_AMBIENT
+  board.rtc.ppm = ppm;
+  if (wrapHours >= 0) board.clock.advance(4294967296000ULL - (uint64_t)(wrapHours * 3.6e9));  // millis() wraps at 2^32 ms
+
+  typedef std::chrono::steady_clock wall;
+  wall::time_point start = wall::now();
+  setup();
+  programState |= 0b110000;  // both PIDs automatic (MAIN_PID_MODE | HEAT_PID_MODE)
+  mainPID.SetMode(AUTOMATIC);
+  heatPID.SetMode(AUTOMATIC);
+  Setpoint = scn.setpoint(0);
+  if (model) programState |= 0b1000000;  // COOL_MODEL
+  if (profilePath) {  // as a profile picked from the menu: ramps start from the current setpoint
+    profile = steps;
+    profileRun.begin(0, wallClock.now(), lround(Setpoint * 100));
+    programState |= 0b000100;  // TEMP_PROFILE
+  }
+  if (tune) {  // as from the menu: open PID: Autotune, pick the loop, push, then leave the menu
+    uiOpen(menu);
+    uiOpen(autoTune);
+    encoderPos = tune - 1;  // Main PID, Heat PID
+    autoTune(2);            // UI_PUSH
+    menuLeave();
+  }
+  if (logging) {
+    programState |= 0b000011;  // DATA_LOGGING | FILE_OPS: backOut() opens the next log file
+    backOut();
+  }
+
+  runMetrics metrics;
+  uint64_t t0 = board.clock.micros();
+  uint64_t next = t0;
+  double lastSetpoint = Setpoint, lastTrace = -traceEvery;
+  unsigned int peaks = 0;
+  double peakError = 0;  // sum of |actual - predicted| COOL troughs
+  double tuneEnd = -1;    // when the experiment ended (s)
+  double clockError = 0;  // worst |wall clock - RTC| after the first hour (s)
+  unsigned long rtcReads = board.rtc.reads;
+  unsigned long lostSec[2] = { 0, 0 };  // beer and air probe lost (degraded control)
+  unsigned long unsafeSec = 0;          // a relay closed while the air probe was lost
+  byte lastLost = 0;
+  if (trace) fprintf(trace, "hours,ambient,air,beer,evaporator,fridge probe,beer probe,setpoint,mainCO,compressor,heater,fridge state\n");
+  board.clock.listeners.push_back([&](uint64_t now) {  // advance the plant in 1 s steps as firmware time passes
+    while (now >= next) {
+      double t = (next - t0) / 1e6;
+      plant.compressor = board.gpio.level(A2) == LOW;  // relay1 and relay2 are active low
+      plant.heater = board.gpio.level(A3) == LOW;
+      plant.step(1, scn.ambient(t), scn.exotherm(t));
+      board.wire.device(0).temp = plant.beerProbe();
+      board.wire.device(1).temp = plant.airProbe();
+      if (roomProbe) board.wire.device(2).temp = scn.ambient(t);
+      for (int i = 0; i < 2; i++) {  // probe faults of the scenario
+        ds18b20& d = board.wire.device(i);
+        const scenario::probeFault* f = scn.fault(i, t);
+        d.present = !f || (f->kind != scenario::FAULT_DISCONNECT);
+        d.stuck = f && (f->kind == scenario::FAULT_STUCK);
+        d.resets = f && (f->kind == scenario::FAULT_RESET);
+        d.corrupt = (f && (f->kind == scenario::FAULT_CRC)) ? f->value : 0;
+        if (f && (f->kind == scenario::FAULT_VALUE)) d.temp = f->value;
+      }
+      byte lost = chambers[0].getLost();
+      for (int i = 0; i < 2; i++) if (lost & (1 << i)) lostSec[i]++;
+      if ((lost & lastLost & 0b10) && (plant.compressor || plant.heater)) unsafeSec++;  // a fridge pass has run since
+      lastLost = lost;
+      if (tune && (tuneEnd < 0) && !tuneLoop) tuneEnd = t;
+      unsigned long ms = millis();
+      if (t >= 3600) clockError = std::max(clockError, fabs(wallClock.now(ms) + wallClock.subsecond(ms) / 1000.0 - board.rtc.exact()));
+      if (mainFridge.getPeaks() != peaks) {  // a COOL peak was learned
+        peaks = mainFridge.getPeaks();
+        peakError += fabs(mainFridge.getPeakError());
+      }
+      double sp = scn.setpoint(t);
+      if (!profilePath && (sp != lastSetpoint)) Setpoint = lastSetpoint = sp;
+      double target = profilePath ? profileRun.target() : Setpoint;  // a ramp is one segment, judged at its end temperature
+      metrics.sample(t, 1, target, plant.beer(), plant.compressor, plant.heater, Setpoint);
+      if (trace && t - lastTrace >= traceEvery) {
+        fprintf(trace, "%.4f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.2f,%.3f,%d,%d,%d\n", t / 3600, scn.ambient(t), plant.air(),
+                plant.beer(), plant.evaporator(), plant.airProbe(), plant.beerProbe(), Setpoint, Output,
+                plant.compressor, plant.heater, getFridgeState(0));
+        lastTrace = t;
+      }
+      next += 1000000;
+    }
+  });
+
+  uint64_t end = t0 + (uint64_t)(scn.duration * 1e6);
+  unsigned long passes = 0;
+  while (board.clock.micros() < end) {
+    if (ui) loop();
+      else { wdt_reset(); mainUpdate(); }
+    board.clock.advance(stepUs);
+    passes++;
+    if (board.wdt.expired()) {
+      fprintf(stderr, "watchdog expired at %.3f h\n", (board.clock.micros() - t0) / 3.6e9);
+      break;
+    }
+  }
+  unsigned long logCommits = LogFile.getCommits(), logLatency = LogFile.getMaxLatency();
+  bool logContiguous = LogFile.isContiguous();
+  if (logging) {
+    programState = (programState & ~0b000010) | 0b000001;  // close the log as the menu does
+    backOut();
+  }
+  board.clock.listeners.clear();
+  double wallSec = std::chrono::duration<double>(wall::now() - start).count();
+  double simSec = (board.clock.micros() - t0) / 1e6;
+  if (trace) fclose(trace);
+
+  printf("scenario %s: %.2f days simulated in %.2f s wall (%.0fx real time), %lu passes\n",
+         scn.name.c_str(), simSec / 86400, wallSec, simSec / wallSec, passes);
+  metrics.report(stdout);
+  if (peaks) {
+    coolModel& m = mainFridge.getModel();
+    printf("COOL peaks:         %u, mean |trough - prediction| %.3f C on the %s\n", peaks, peakError / peaks,
+           mainFridge.modelActive() ? "coolModel" : "peakEstimator");
+    printf("coolModel theta:    %.3f %.3f %.3f %.3f, peakEstimator %.2f\n", m.getTheta(0), m.getTheta(1),
+           m.getTheta(2), m.getTheta(3), mainFridge.getPeakEstimator());
+  }
+  if (tune) {
+    if (tuner.getState() == TUNE_DONE)
+      printf("autotune:           %s loop, %u cycles in %.2f h: Ku %.4g, Pu %.0f s -> Kp %.4g Ki %.4g Kd %.4g\n",
+             tune == 1 ? "main" : "heat", tuner.getCycles(), tuneEnd / 3600, tuner.getKu(), tuner.getPu(),
+             tune == 1 ? Kp : heatKp, tune == 1 ? Ki : heatKi, tune == 1 ? Kd : heatKd);
+    else printf("autotune:           FAILED after %u cycles (%s)\n", tuner.getCycles(),
+                tuner.getState() == TUNE_FAILED ? "timeout" : "still running");
+  }
+  const timeStats& ts = wallClock.getStats();
+  printf("RTC:                %lu I2C reads (%.3f per minute), %lu syncs, %lu failed; drift %+.0f ppm, worst error %.0f ms\n",
+         board.rtc.reads - rtcReads, (board.rtc.reads - rtcReads) * 60 / simSec, ts.syncs, ts.failures, wallClock.getDrift() * 1e6,
+         clockError * 1000);
+  const convStats& conv = sensors.getConvStats();
+  if (conv.count)
+    printf("DS18B20 conversion: %lu samples, latency min %u / mean %.1f / max %u ms, %lu late polls, %lu timeouts\n",
+           conv.count, conv.min, (double)conv.total / conv.count, conv.max, conv.late, conv.timeouts);
+  for (byte i = 0; i < busMaxProbes; i++) {
+    probe* p = sensors.getProbe(i);
+    if (!p || !p->isPresent()) continue;
+    const probeHealth& h = p->getHealth();
+    printf("  role %u: %lu reads, %lu CRC errors, %lu missed samples; rejected %lu range, %lu rate, %lu stuck\n", i,
+           h.reads, h.crcErrors, h.misses, h.rangeErrors, h.rateErrors, h.stuckErrors);
+  }
+  if (!scn.faults.empty() || lostSec[0] || lostSec[1])
+    printf("probe faults:       %zu injected; beer probe lost %lu s, air probe lost %lu s, relays closed without the air probe %lu s\n",
+           scn.faults.size(), lostSec[0], lostSec[1], unsafeSec);
+  if (logging) {
+    printf("SD card:            %lu block writes (%lu streamed), %lu FAT/directory writes\n", board.fs.blockWrites,
+           board.fs.streamBlocks, board.fs.fatWrites);
+    printf("datalog:            %s, %lu commits, worst append() %.2f ms\n", logContiguous ? "contiguous" : "FAT append",
+           logCommits, logLatency / 1000.0);
+  }
+  if (unsafeSec) printf("FAILED: relays closed while the air probe was lost\n");
+  return ((tune && tuner.getState() != TUNE_DONE) || unsafeSec) ? 1 : 0;
+}
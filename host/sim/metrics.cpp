@@ -0,0 +1,81 @@
+#include <math.h>
+#include <algorithm>
+#include "metrics.h"
+
+runMetrics::runMetrics(double settleBand)
+  : iae(0), trackIae(0), maxOvershoot(0), worstSettle(0), unsettled(0), compressorStarts(0), heaterStarts(0),
+    compressorOn(0), heaterOn(0), total(0), shortestOn(-1), shortestOff(-1), longestOn(0),
+    _band(settleBand), _comp(false), _heat(false), _first(true), _edge(0), _lastT(0) {}
+
+void runMetrics::_close() {  // finalise the settle time of the current segment; settled if its last sample was in band
+  if (segments.empty()) return;
+  segment& s = segments.back();
+  s.settle = (s.lastOutside < _lastT) ? s.lastOutside - s.start : -1;
+  if (s.settle < 0) unsettled++;
+    else worstSettle = std::max(worstSettle, s.settle);
+}
+
+void runMetrics::sample(double t, double dt, double setpoint, double beer, bool compressor, bool heater,
+                        double command) {
+  if (segments.empty() || segments.back().setpoint != setpoint) {
+    _close();
+    segment s = { t, setpoint, beer, 0, -1, t };
+    segments.push_back(s);
+  }
+  segment& s = segments.back();
+  double err = beer - setpoint;
+  double dir = (fabs(s.setpoint - s.from) < _band) ? 0 : (s.setpoint > s.from ? 1 : -1);
+  double over = dir ? dir * err : fabs(err);  // regulation segments count excursions both ways
+  s.overshoot = std::max(s.overshoot, over);
+  maxOvershoot = std::max(maxOvershoot, s.overshoot);
+  if (fabs(err) > _band) s.lastOutside = t;
+
+  iae += fabs(err) * dt / 3600;
+  trackIae += fabs(beer - (isnan(command) ? setpoint : command)) * dt / 3600;
+  total += dt;
+  if (compressor) compressorOn += dt;
+  if (heater) heaterOn += dt;
+  if (heater && !_heat) heaterStarts++;
+  if (!_first && compressor != _comp) {
+    double len = t - _edge;
+    if (compressor) {
+      compressorStarts++;
+      if (compressorStarts > 1) shortestOff = (shortestOff < 0) ? len : std::min(shortestOff, len);
+    }
+    else {
+      shortestOn = (shortestOn < 0) ? len : std::min(shortestOn, len);
+      longestOn = std::max(longestOn, len);
+    }
+    _edge = t;
+  }
+  else if (_first && compressor) compressorStarts++;
+  _comp = compressor;
+  _heat = heater;
+  _first = false;
+  _lastT = t;
+}
+
+runMetrics runMetrics::closed() const {
+  runMetrics m = *this;
+  m._close();
+  return m;
+}
+
+void runMetrics::report(FILE* out) const {
+  runMetrics m = closed();  // close the open segment on a copy so report() stays const
+  fprintf(out, "setpoint segments:\n");
+  for (size_t i = 0; i < m.segments.size(); i++) {
+    const segment& s = m.segments[i];
+    fprintf(out, "  t=%8.2f h  SP %6.2f C (from %6.2f)  overshoot %5.2f C  settle ", s.start / 3600, s.setpoint, s.from, s.overshoot);
+    if (s.settle < 0) fprintf(out, "  never\n");
+      else fprintf(out, "%6.2f h\n", s.settle / 3600);
+  }
+  fprintf(out, "max overshoot:      %.2f C\n", maxOvershoot);
+  fprintf(out, "settling:           worst %.2f h, %u segment(s) never settled\n", m.worstSettle / 3600, m.unsettled);
+  fprintf(out, "IAE:                %.2f C*h", iae);
+  if (fabs(trackIae - iae) > 0.005) fprintf(out, " (%.2f C*h against the profile's setpoint)", trackIae);
+  fprintf(out, "\n");
+  fprintf(out, "compressor:         %u starts, duty %.1f%%, on %.1f-%.1f min, shortest off %.1f min\n",
+          compressorStarts, total ? 100 * compressorOn / total : 0, shortestOn / 60, longestOn / 60, shortestOff / 60);
+  fprintf(out, "heater:             %u starts, duty %.1f%%\n", heaterStarts, total ? 100 * heaterOn / total : 0);
+}
@@ -0,0 +1,45 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+// closed loop performance summary, fed one sample per simulated second
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+class runMetrics {
+  public:
+    struct segment {     // constant setpoint interval
+      double start, setpoint, from;
+      double overshoot;  // worst excursion past the setpoint in the direction of the step (deg C)
+      double settle;     // time after start until the beer stayed within the settle band, -1 if never
+      double lastOutside;
+    };
+
+    explicit runMetrics(double settleBand = 0.3);
+    // setpoint is the target the segments are judged against; command, when given, is the setpoint the
+    // controller actually had (a profile ramp), for the tracking IAE
+    void sample(double t, double dt, double setpoint, double beer, bool compressor, bool heater,
+                double command = NAN);
+    void report(FILE* out) const;   // also closes the open segment on a copy
+    runMetrics closed() const;      // copy with the open segment finalised (settle, unsettled)
+
+    double iae;                 // integral of |setpoint - beer| (deg C * h)
+    double trackIae;            // integral of |command - beer|
+    double maxOvershoot;
+    double worstSettle;         // longest settle time of the segments that settled (s)
+    unsigned unsettled;         // segments that never settled
+    unsigned compressorStarts, heaterStarts;
+    double compressorOn, heaterOn, total;   // seconds
+    double shortestOn, shortestOff, longestOn;  // compressor cycle extremes (s)
+    std::vector<segment> segments;
+
+  private:
+    void _close();
+    double _band;
+    bool _comp, _heat, _first;
+    double _edge;               // time of the last compressor transition
+    double _lastT;
+};
+
+#endif
@@ -0,0 +1,34 @@
+#include <math.h>
+#include "plant.h"
+
+plantParams::plantParams()
+  : airCap(12000), beerCap(90000), evapCap(3000), heaterCap(1000),
+    wallUA(1.5), beerUA(4.0), evapUA(10.0), heaterUA(5.0),
+    coolPower(90), compressorTau(60), heatPower(60),
+    airProbeTau(30), beerProbeTau(120) {}
+
+fermPlant::fermPlant(const plantParams& p) : compressor(false), heater(false), params(p) { init(20, 20); }
+
+void fermPlant::init(double air, double beer) {
+  _air = _evap = _heat = _airProbe = air;
+  _beer = _beerProbe = beer;
+  _cool = 0;
+}
+
+void fermPlant::step(double dt, double ambient, double exotherm) {  // explicit euler in <= 1 s sub-steps
+  while (dt > 0) {
+    double h = dt < 1 ? dt : 1;
+    dt -= h;
+    _cool += ((compressor ? 1.0 : 0.0) - _cool) * (1 - exp(-h / params.compressorTau));
+    double qWall = params.wallUA * (ambient - _air);
+    double qBeer = params.beerUA * (_beer - _air);
+    double qEvap = params.evapUA * (_evap - _air);
+    double qHeat = params.heaterUA * (_heat - _air);
+    _air += h * (qWall + qBeer + qEvap + qHeat) / params.airCap;
+    _beer += h * (exotherm - qBeer) / params.beerCap;
+    _evap += h * (-qEvap - _cool * params.coolPower) / params.evapCap;
+    _heat += h * ((heater ? params.heatPower : 0) - qHeat) / params.heaterCap;
+    _airProbe += (_air - _airProbe) * (1 - exp(-h / params.airProbeTau));
+    _beerProbe += (_beer - _beerProbe) * (1 - exp(-h / params.beerProbeTau));
+  }
+}
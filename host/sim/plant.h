@@ -0,0 +1,46 @@
+#ifndef PLANT_H
+#define PLANT_H
+
+// lumped thermal model of a fermentation chamber: chamber air, beer, evaporator and heater nodes plus
+// first order sensor lags.  temperatures in deg C, capacities in J/K, conductances in W/K, powers in W.
+
+struct plantParams {
+  double airCap;       // chamber air + liner/shelves
+  double beerCap;      // beer + fermenter
+  double evapCap;      // evaporator plate + refrigerant charge (source of cool overshoot)
+  double heaterCap;    // heat tape element
+  double wallUA;       // air <-> ambient through the cabinet
+  double beerUA;       // beer <-> air through the fermenter wall
+  double evapUA;       // evaporator <-> air
+  double heaterUA;     // heater <-> air
+  double coolPower;    // heat pumped out of the evaporator at full compressor output
+  double compressorTau;// compressor/refrigerant spin up and coast down time constant (s)
+  double heatPower;    // electrical power of the heat tape
+  double airProbeTau;  // DS18B20 in free air
+  double beerProbeTau; // DS18B20 in a thermowell
+  plantParams();       // 20 l batch in a small upright fridge with 60 W heat tape
+};
+
+class fermPlant {
+  public:
+    explicit fermPlant(const plantParams& p = plantParams());
+    void init(double air, double beer);      // all nodes at rest
+    void step(double dt, double ambient, double exotherm);  // advance dt seconds; exotherm = W released by the beer
+
+    bool compressor;   // relay inputs (true = energised)
+    bool heater;
+
+    double air() const { return _air; }
+    double beer() const { return _beer; }
+    double evaporator() const { return _evap; }
+    double airProbe() const { return _airProbe; }   // what the fridge sensor reads
+    double beerProbe() const { return _beerProbe; } // what the beer sensor reads
+    double coolLevel() const { return _cool; }      // 0..1 compressor output
+
+    plantParams params;
+
+  private:
+    double _air, _beer, _evap, _heat, _airProbe, _beerProbe, _cool;
+};
+
+#endif
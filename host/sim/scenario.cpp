@@ -0,0 +1,158 @@
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include "scenario.h"
+
+bool parseTime(const std::string& s, double& seconds) {
+  char* end;
+  double v = strtod(s.c_str(), &end);
+  if (end == s.c_str()) return false;
+  std::string unit(end);
+  if (unit.empty() || unit == "s") seconds = v;
+    else if (unit == "m") seconds = v * 60;
+    else if (unit == "h") seconds = v * 3600;
+    else if (unit == "d") seconds = v * 86400;
+    else return false;
+  return true;
+}
+
+static bool parseNumber(const std::string& s, double& v) {
+  char* end;
+  v = strtod(s.c_str(), &end);
+  return end != s.c_str() && *end == 0;
+}
+
+static bool keyValue(const std::string& tok, const char* key, std::string& value) {  // "key=value"
+  std::string k = std::string(key) + "=";
+  if (tok.compare(0, k.size(), k)) return false;
+  value = tok.substr(k.size());
+  return true;
+}
+
+static bool setParam(plantParams& p, const std::string& name, double v) {
+  struct field { const char* name; double plantParams::* member; };
+  static const field fields[] = {
+    { "airCap", &plantParams::airCap }, { "beerCap", &plantParams::beerCap }, { "evapCap", &plantParams::evapCap },
+    { "heaterCap", &plantParams::heaterCap }, { "wallUA", &plantParams::wallUA }, { "beerUA", &plantParams::beerUA },
+    { "evapUA", &plantParams::evapUA }, { "heaterUA", &plantParams::heaterUA }, { "coolPower", &plantParams::coolPower },
+    { "compressorTau", &plantParams::compressorTau }, { "heatPower", &plantParams::heatPower },
+    { "airProbeTau", &plantParams::airProbeTau }, { "beerProbeTau", &plantParams::beerProbeTau },
+  };
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    if (name == fields[i].name) { p.*fields[i].member = v; return true; }
+  }
+  return false;
+}
+
+scenario::scenario()
+  : duration(86400), initAir(20), initBeer(20), ambientMean(20), ambientSwing(0), ambientPeriod(86400), ambientPhase(0) {}
+
+bool scenario::load(const char* path, std::string& error) {
+  std::ifstream in(path);
+  if (!in) { error = std::string("cannot open ") + path; return false; }
+  name = path;
+  std::string line;
+  int n = 0;
+  while (std::getline(in, line)) {
+    n++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) line.erase(hash);
+    std::istringstream ls(line);
+    std::vector<std::string> tok;
+    std::string t;
+    while (ls >> t) tok.push_back(t);
+    if (tok.empty()) continue;
+
+    bool ok = true;
+    const std::string& cmd = tok[0];
+    std::string v;
+    if (cmd == "duration" && tok.size() == 2) ok = parseTime(tok[1], duration);
+    else if (cmd == "initial") {
+      for (size_t i = 1; i < tok.size() && ok; i++) {
+        if (keyValue(tok[i], "air", v)) ok = parseNumber(v, initAir);
+          else if (keyValue(tok[i], "beer", v)) ok = parseNumber(v, initBeer);
+          else ok = false;
+      }
+    }
+    else if (cmd == "ambient" && tok.size() >= 2) {
+      ok = parseNumber(tok[1], ambientMean);
+      for (size_t i = 2; i < tok.size() && ok; i++) {
+        if (keyValue(tok[i], "swing", v)) ok = parseNumber(v, ambientSwing);
+          else if (keyValue(tok[i], "period", v)) ok = parseTime(v, ambientPeriod);
+          else if (keyValue(tok[i], "phase", v)) ok = parseTime(v, ambientPhase);
+          else ok = false;
+      }
+    }
+    else if (cmd == "setpoint" && tok.size() == 3) {
+      setpointStep s;
+      ok = parseTime(tok[1], s.t) && parseNumber(tok[2], s.temp);
+      setpoints.push_back(s);
+    }
+    else if (cmd == "exotherm" && tok.size() == 4) {
+      exothermPulse e;
+      ok = parseTime(tok[1], e.start) && parseTime(tok[2], e.length) && parseNumber(tok[3], e.peak) && e.length > 0;
+      exotherms.push_back(e);
+    }
+    else if (cmd == "fault" && tok.size() == 5) {
+      probeFault f = { 0, 0, tok[3] == "beer" ? 0 : tok[3] == "air" ? 1 : -1, -1, 1 };
+      ok = parseTime(tok[1], f.start) && parseTime(tok[2], f.length) && (f.probe >= 0);
+      if (tok[4] == "disconnect") f.kind = FAULT_DISCONNECT;
+        else if (tok[4] == "stuck") f.kind = FAULT_STUCK;
+        else if (tok[4] == "reset") f.kind = FAULT_RESET;
+        else if (tok[4] == "crc") f.kind = FAULT_CRC;
+        else if (keyValue(tok[4], "crc", v)) { f.kind = FAULT_CRC; ok = ok && parseNumber(v, f.value); }
+        else if (keyValue(tok[4], "value", v)) { f.kind = FAULT_VALUE; ok = ok && parseNumber(v, f.value); }
+      ok = ok && (f.kind >= 0);
+      faults.push_back(f);
+    }
+    else if (cmd == "param" && tok.size() == 3) {
+      double pv;
+      ok = parseNumber(tok[2], pv) && setParam(params, tok[1], pv);
+    }
+    else ok = false;
+
+    if (!ok) {
+      std::ostringstream msg;
+      msg << path << ":" << n << ": cannot parse '" << line << "'";
+      error = msg.str();
+      return false;
+    }
+  }
+  std::stable_sort(setpoints.begin(), setpoints.end(),
+                   [](const setpointStep& a, const setpointStep& b) { return a.t < b.t; });
+  if (setpoints.empty() || setpoints[0].t > 0) {
+    setpointStep s = { 0, initBeer };
+    setpoints.insert(setpoints.begin(), s);
+  }
+  return true;
+}
+
+double scenario::ambient(double t) const {
+  return ambientMean + ambientSwing * sin(2 * M_PI * (t - ambientPhase) / ambientPeriod);
+}
+
+double scenario::exotherm(double t) const {
+  double w = 0;
+  for (size_t i = 0; i < exotherms.size(); i++) {
+    const exothermPulse& e = exotherms[i];
+    if (t < e.start || t > e.start + e.length) continue;
+    w += e.peak * 0.5 * (1 - cos(2 * M_PI * (t - e.start) / e.length));
+  }
+  return w;
+}
+
+double scenario::setpoint(double t) const {
+  double sp = setpoints[0].temp;
+  for (size_t i = 0; i < setpoints.size() && setpoints[i].t <= t; i++) sp = setpoints[i].temp;
+  return sp;
+}
+
+const scenario::probeFault* scenario::fault(int probe, double t) const {
+  for (size_t i = 0; i < faults.size(); i++) {
+    const probeFault& f = faults[i];
+    if ((f.probe == probe) && (t >= f.start) && (t < f.start + f.length)) return &f;
+  }
+  return 0;
+}
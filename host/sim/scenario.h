@@ -0,0 +1,46 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+// plain text description of a simulated fermentation.  one directive per line, '#' starts a comment,
+// times take an optional s/m/h/d suffix (seconds if omitted):
+//   duration 14d                        length of the run
+//   initial air=20 beer=22              starting temperatures
+//   ambient 21 swing=4 period=24h phase=15h   room temperature, sinusoidal swing (+/- swing)
+//   setpoint 3d 20.5                    main setpoint from the given time on
+//   exotherm 12h 3d 15                  fermentation heat: start, length, peak W (raised cosine)
+//   param beerUA 4.5                    override a plantParams field
+//   fault 2d 30m air disconnect         probe fault: start, length, beer or air probe, and one of
+//                                       disconnect (no answer), stuck (conversions do not update it),
+//                                       reset (browns out in every conversion: reads 85 deg C), crc[=P]
+//                                       (share P of reads corrupted, default 1), value=T (reads T deg C)
+
+#include <string>
+#include <vector>
+#include "plant.h"
+
+struct scenario {
+  struct setpointStep { double t, temp; };
+  struct exothermPulse { double start, length, peak; };
+  enum faultKind { FAULT_DISCONNECT, FAULT_STUCK, FAULT_RESET, FAULT_CRC, FAULT_VALUE };
+  struct probeFault { double start, length; int probe, kind; double value; };  // probe: 0 beer, 1 air
+
+  std::string name;
+  double duration;
+  double initAir, initBeer;
+  double ambientMean, ambientSwing, ambientPeriod, ambientPhase;
+  std::vector<setpointStep> setpoints;   // sorted by time
+  std::vector<exothermPulse> exotherms;
+  std::vector<probeFault> faults;
+  plantParams params;
+
+  scenario();
+  bool load(const char* path, std::string& error);
+  double ambient(double t) const;
+  double exotherm(double t) const;
+  double setpoint(double t) const;
+  const probeFault* fault(int probe, double t) const;  // the fault active on the probe at t, or 0
+};
+
+bool parseTime(const std::string& s, double& seconds);  // "90", "15m", "2.5h", "14d"
+
+#endif
@@ -0,0 +1,214 @@
+// npid-telem -- telemetry client: prints the board's state snapshots and sends remote commands
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <string>
+#include <vector>
+#include "../../telemetry.h"
+#include "../../trace.h"
+
+static void usage() {
+  fprintf(stderr,
+    "usage: npid-telem [options] PORT\n"
+    "  PORT is the board's serial device, or the pty printed by npid -p\n"
+    "  -s TEMP[:N]      set the main PID setpoint (deg C) of chamber N (default 0)\n"
+    "  -m PID=MODE      PID main|heat, MODE auto|manual\n"
+    "  -o PID=VALUE     manual output (main: deg C, heat: ms per window)\n"
+    "  -k PID=KP,KI,KD  tunings\n"
+    "  -r MS            snapshot period (0 stops the stream)\n"
+    "  -T FILE          request a trace dump and save it to FILE for npid-trace\n"
+    "  -n N             exit after N snapshots (default: run until interrupted)\n"
+    "  -c               print snapshots as CSV\n"
+    "  -w SEC           give up after SEC seconds without a frame (default 10)\n");
+}
+
+static const char* ackText[] = { "ok", "bad length", "bad value", "refused", "unknown command" };
+static const char* stateText[] = { "idle", "cool", "heat" };
+
+struct command {
+  byte type;
+  std::vector<byte> body;
+};
+
+static int pidArg(const char* s, const char** rest) {  // "main=..." / "heat=..."
+  const char* eq = strchr(s, '=');
+  if (!eq) return -1;
+  *rest = eq + 1;
+  std::string name(s, eq - s);
+  return name == "main" ? PID_MAIN : name == "heat" ? PID_HEAT : -1;
+}
+
+static void putFloat(std::vector<byte>& body, double v) {
+  byte b[4];
+  telemetry::putFloat(b, v);
+  body.insert(body.end(), b, b + 4);
+}
+
+static bool parse(int opt, const char* arg, command& c) {
+  const char* rest;
+  int pid;
+  c.body.clear();
+  switch (opt) {
+    case 's': {
+      char* end;
+      c.type = CMD_SETPOINT;
+      putFloat(c.body, strtod(arg, &end));
+      if (*end == ':') c.body.push_back(atoi(end + 1));  // CHAMBERS > 1 builds
+        else if (*end) return false;
+      return true;
+    }
+    case 'm':
+      if ((pid = pidArg(arg, &rest)) < 0 || (strcmp(rest, "auto") && strcmp(rest, "manual"))) return false;
+      c.type = CMD_MODE;
+      c.body.push_back(pid);
+      c.body.push_back(strcmp(rest, "auto") ? 0 : 1);
+      return true;
+    case 'o':
+      if ((pid = pidArg(arg, &rest)) < 0) return false;
+      c.type = CMD_OUTPUT;
+      c.body.push_back(pid);
+      putFloat(c.body, atof(rest));
+      return true;
+    case 'k': {
+      double k[3];
+      if ((pid = pidArg(arg, &rest)) < 0 || sscanf(rest, "%lf,%lf,%lf", &k[0], &k[1], &k[2]) != 3) return false;
+      c.type = CMD_TUNINGS;
+      c.body.push_back(pid);
+      for (int i = 0; i < 3; i++) putFloat(c.body, k[i]);
+      return true;
+    }
+    case 'r': {
+      unsigned long ms = strtoul(arg, 0, 10);
+      if (ms > 0xFFFF) return false;
+      c.type = CMD_STREAM;
+      c.body.push_back(ms & 0xFF);
+      c.body.push_back(ms >> 8);
+      return true;
+    }
+  }
+  return false;
+}
+
+int openPort(const char* path, unsigned long baud);  // port.cpp
+
+static void printSnapshot(const telemSnapshot& s, bool csv) {
+  if (csv) {
+    printf("%lu,%u,%u,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.1f,%.4f,%.4f,%.4f,%.4f,%u\n", s.ms, s.state,
+           s.programState, s.fridgeTemp, s.fridgeFilter, s.beerTemp, s.beerFilter, s.setpoint, s.output, s.mainP,
+           s.mainI, s.mainD, s.heatSetpoint, s.heatOutput, s.heatP, s.heatI, s.heatD, s.peakEstimator, s.lost);
+  } else {
+    printf("%9.1f s  %-4s  beer %6.2f (%6.2f)  fridge %6.2f (%6.2f)  SP %5.2f  CO %5.2f [P %+.3f I %+.3f D %+.3f]"
+           "  heat SP %5.2f CO %6.0f  pE %.3f%s%s\n", s.ms / 1000.0, s.state < 3 ? stateText[s.state] : "?",
+           s.beerTemp, s.beerFilter, s.fridgeTemp, s.fridgeFilter, s.setpoint, s.output, s.mainP, s.mainI, s.mainD,
+           s.heatSetpoint, s.heatOutput, s.peakEstimator, (s.lost & 0b01) ? "  BEER PROBE LOST" : "",
+           (s.lost & 0b10) ? "  FRIDGE PROBE LOST" : "");
+  }
+  fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+  std::vector<command> commands;
+  const char* traceFile = 0;
+  long snapshots = -1;
+  bool csv = false;
+  int idleSec = 10;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:m:o:k:r:T:n:cw:h")) != -1) {
+    command c;
+    switch (opt) {
+      case 's': case 'm': case 'o': case 'k': case 'r':
+        if (!parse(opt, optarg, c)) {
+          fprintf(stderr, "npid-telem: bad argument to -%c: %s\n", opt, optarg);
+          return 1;
+        }
+        commands.push_back(c);
+        break;
+      case 'T': traceFile = optarg; break;
+      case 'n': snapshots = atol(optarg); break;
+      case 'c': csv = true; break;
+      case 'w': idleSec = atoi(optarg); break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1) { usage(); return 1; }
+  if (traceFile) commands.push_back(command { CMD_TRACE, std::vector<byte>(1, traceDumpCmd) });
+
+  int fd = openPort(argv[optind], telemBaud);
+  if (fd < 0) { perror(argv[optind]); return 1; }
+  FILE* trace = 0;
+  if (traceFile && !(trace = fopen(traceFile, "wb"))) { perror(traceFile); return 1; }
+
+  byte seq = 0;
+  for (const command& c : commands) {
+    byte frame[telemMaxFrame];
+    byte n = telemetry::encode(c.type, seq++, c.body.data(), c.body.size(), frame);
+    if (write(fd, frame, n) != n) { perror("write"); return 1; }
+  }
+  if (csv)
+    printf("millis,state,programState,fridge actual,fridge filter,beer actual,beer filter,mainSP,mainCO,mainP,mainI,mainD,"
+           "heatSP,heatCO,heatP,heatI,heatD,peak estimator,lost probes\n");
+
+  size_t acks = 0;
+  unsigned int traceBytes = 0, errors = 0;
+  std::vector<byte> rx;
+  while (snapshots != 0 || acks < commands.size() || (trace && traceBytes < traceImageSize)) {
+    fd_set in;
+    FD_ZERO(&in);
+    FD_SET(fd, &in);
+    struct timeval tv = { idleSec, 0 };
+    int ready = select(fd + 1, &in, 0, 0, &tv);
+    if (ready < 0 && errno == EINTR) continue;
+    if (ready <= 0) {
+      fprintf(stderr, "npid-telem: no frames for %d s\n", idleSec);
+      return 1;
+    }
+    byte buf[256];
+    ssize_t got = read(fd, buf, sizeof(buf));
+    if (got <= 0) {
+      fprintf(stderr, "npid-telem: port closed\n");
+      return 1;
+    }
+    for (ssize_t i = 0; i < got; i++) {
+      if (buf[i]) {
+        rx.push_back(buf[i]);
+        continue;
+      }
+      byte msg[telemMaxFrame];
+      byte len = (!rx.empty() && rx.size() < telemMaxFrame) ? telemetry::decode(rx.data(), rx.size(), msg) : 0;
+      if (!len && !rx.empty()) errors++;  // also the tail of a frame sent before we connected
+      rx.clear();
+      if (!len) continue;
+      const byte* body = msg + 2;
+      byte bodyLen = len - 4;
+      switch (msg[0]) {
+        case TELEM_SNAPSHOT:
+          if (bodyLen != telemSnapshotSize || snapshots == 0) break;
+          telemSnapshot s;
+          telemetry::unpackSnapshot(body, s);
+          printSnapshot(s, csv);
+          if (snapshots > 0) snapshots--;
+          break;
+        case TELEM_ACK:
+          if (bodyLen < 2) break;
+          fprintf(stderr, "command 0x%02x: %s\n", body[0], body[1] < 5 ? ackText[body[1]] : "?");
+          acks++;
+          break;
+        case TELEM_TRACE:
+          if (!trace) break;
+          fwrite(body, 1, bodyLen, trace);
+          if (bodyLen > 4) traceBytes += body[3];  // frame payload length
+          break;
+      }
+    }
+  }
+  if (trace) {
+    fclose(trace);
+    fprintf(stderr, "trace dump saved to %s\n", traceFile);
+  }
+  if (errors) fprintf(stderr, "%u damaged frames\n", errors);
+  close(fd);
+  return 0;
+}
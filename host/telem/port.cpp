@@ -0,0 +1,16 @@
+// serial port setup for npid-telem, apart from the Arduino headers (their binary constants B0... clash with termios)
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+int openPort(const char* path, unsigned long baud) {  // raw 8N1; a pty ignores the speed
+  int fd = open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0) return -1;
+  struct termios t;
+  if (tcgetattr(fd, &t) == 0) {
+    cfmakeraw(&t);
+    cfsetspeed(&t, baud == 115200 ? B115200 : baud == 57600 ? B57600 : B9600);
+    tcsetattr(fd, TCSANOW, &t);
+  }
+  return fd;
+}
@@ -0,0 +1,151 @@
+// npid-trace -- reports the stage timing histograms dumped by a TRACE build of the sketch
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "../../trace.h"
+#include "../../telemetry.h"
+
+static const char* stageName[traceStages] = { "probe", "filter", "pid", "fridge", "log", "lcd", "loop", "jitter", "watchdog" };
+
+static void usage() {
+  fprintf(stderr,
+    "usage: npid-trace [options] CAPTURE\n"
+    "  CAPTURE is raw serial output ('-' for stdin) holding one or more dumps: send 'T' to the board, or\n"
+    "  CMD_TRACE with TELEMETRY (npid-telem -T)\n"
+    "  -a        report every dump, not only the last\n"
+    "  -H        print the histograms\n");
+}
+
+static void printUs(double us) {  // fixed width, with a unit
+  if (us < 10000) printf(" %7.0fus", us);
+    else if (us < 1e7) printf(" %7.1fms", us / 1e3);
+    else printf(" %7.2fs ", us / 1e6);
+}
+
+static double bucketTop(byte b) { return b ? (double)(1UL << b) : 0; }  // exclusive upper bound, us
+
+static double percentile(const traceHist& h, double p) {  // upper bound of the bucket holding the p quantile
+  unsigned long total = 0;
+  for (byte b = 0; b < traceBuckets; b++) total += h.buckets[b];
+  unsigned long need = (unsigned long)(p * total + 0.5), seen = 0;
+  for (byte b = 0; b < traceBuckets; b++) {
+    seen += h.buckets[b];
+    if (seen >= need && seen) return (b == traceBuckets - 1) ? h.max : (bucketTop(b) < h.max ? bucketTop(b) : h.max);
+  }
+  return h.max;
+}
+
+static void report(const traceInfo& info, const traceHist* hist, bool histograms) {
+  printf("dump at %.1f s uptime, watchdog timeout %lu ms\n", info.ms / 1000.0, info.watchdogMs);
+  printf("%-9s %10s %9s %9s %9s %9s %9s\n", "stage", "count", "mean", "p50", "p90", "p99", "max");
+  for (byte s = 0; s < traceStages; s++) {
+    const traceHist& h = hist[s];
+    printf("%-9s %10lu", stageName[s], h.count);
+    if (h.count) {
+      printUs((double)h.sum / h.count);
+      printUs(percentile(h, 0.5));
+      printUs(percentile(h, 0.9));
+      printUs(percentile(h, 0.99));
+      printUs(h.max);
+    }
+    printf("\n");
+  }
+  const traceHist& wdt = hist[TRACE_WDT];
+  if (wdt.count && info.watchdogMs)
+    printf("watchdog margin: %.1f ms (longest kick interval %.1f ms)\n", info.watchdogMs - wdt.max / 1000.0, wdt.max / 1000.0);
+  if (!histograms) return;
+  for (byte s = 0; s < traceStages; s++) {
+    const traceHist& h = hist[s];
+    if (!h.count) continue;
+    uint16_t peak = 1;
+    for (byte b = 0; b < traceBuckets; b++) if (h.buckets[b] > peak) peak = h.buckets[b];
+    printf("\n%s\n", stageName[s]);
+    for (byte b = 0; b < traceBuckets; b++) {
+      if (!h.buckets[b]) continue;
+      if (b == 0) printf("         0us");
+        else if (b == traceBuckets - 1) printf("  >= %9.0fus", bucketTop(b - 1));
+        else printf("  < %9.0fus", bucketTop(b));
+      printf(" %6u ", h.buckets[b]);
+      for (int i = 0; i < 50 * h.buckets[b] / peak; i++) putchar('#');
+      printf("\n");
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  bool all = false, histograms = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "aHh")) != -1) {
+    switch (opt) {
+      case 'a': all = true; break;
+      case 'H': histograms = true; break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1) { usage(); return 1; }
+
+  FILE* in = strcmp(argv[optind], "-") ? fopen(argv[optind], "rb") : stdin;
+  if (!in) { perror(argv[optind]); return 1; }
+  std::vector<byte> cap;
+  byte buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) cap.insert(cap.end(), buf, buf + n);
+
+  std::vector<byte> carried;  // telemetry stream: the trace frames are the bodies of TELEM_TRACE messages
+  for (size_t i = 0, start = 0; i < cap.size(); i++) {
+    if (cap[i]) continue;
+    byte msg[telemMaxFrame];
+    byte len = (i - start < telemMaxFrame) ? telemetry::decode(&cap[start], i - start, msg) : 0;
+    if (len && msg[0] == TELEM_TRACE) carried.insert(carried.end(), msg + 2, msg + len - 2);
+    start = i + 1;
+  }
+  if (!carried.empty()) cap.swap(carried);
+
+  std::vector<byte> image;  // dump being reassembled
+  int expect = -1;          // next frame index, -1: waiting for frame 0
+  unsigned long frames = 0, bad = 0, dumps = 0;
+  traceInfo info;
+  traceHist hist[traceStages], last[traceStages];
+  traceInfo lastInfo;
+  for (size_t i = 0; i + 5 <= cap.size(); i++) {
+    if (cap[i] != traceSync[0] || cap[i + 1] != traceSync[1]) continue;
+    byte index = cap[i + 2], len = cap[i + 3];
+    if (len > traceFramePayload || i + 5 + len > cap.size()) continue;
+    if (OneWire::crc8(&cap[i + 2], len + 2) != cap[i + 4 + len]) {
+      bad++;  // text that happens to contain the sync bytes, or a damaged frame
+      continue;
+    }
+    frames++;
+    if (index == 0) {
+      image.clear();
+      expect = 0;
+    }
+    if (index != expect) {  // lost a frame: drop the dump
+      expect = -1;
+      continue;
+    }
+    image.insert(image.end(), &cap[i + 4], &cap[i + 4 + len]);
+    expect++;
+    i += 4 + len;
+    if (image.size() < traceImageSize) continue;
+    expect = -1;
+    if (!tracer::decode(image.data(), image.size(), info, hist)) {
+      fprintf(stderr, "dump %lu: not a version %u trace with %u stages\n", dumps, traceVersion, traceStages);
+      continue;
+    }
+    dumps++;
+    if (all) {
+      report(info, hist, histograms);
+      printf("\n");
+    }
+    lastInfo = info;
+    memcpy(last, hist, sizeof(last));
+  }
+  if (!dumps) {
+    fprintf(stderr, "%s: no complete trace dump (%lu frames, %lu bad)\n", argv[optind], frames, bad);
+    return 1;
+  }
+  if (!all) report(lastInfo, last, histograms);
+  return 0;
+}
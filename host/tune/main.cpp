@@ -0,0 +1,238 @@
+// npid-tune -- searches the main and HEAT PID tunings by running the controller closed loop against the
+// chamber model, thousands of scenarios at a time on every core.  each run owns a complete board, probes,
+// PIDs and fridge controller; nothing is shared between runs except the read-only scenario.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "OneWire.h"
+#include "../../chamber.h"
+#include "../../probeBus.h"
+#include "../linux.h"
+#include "../sim/metrics.h"
+#include "../sim/plant.h"
+#include "../sim/scenario.h"
+#include "pool.h"
+
+static OneWire onewire(A1);  // routes to the calling thread's board, so one instance serves every run
+static const uint64_t passUs = 50000;  // virtual time between probe bus services
+
+enum { KP, KI, KD, HEAT_KP, HEAT_KI, HEAT_KD, AXES };
+static const char* axisName[AXES] = { "kp", "ki", "kd", "heatkp", "heatki", "heatkd" };
+
+struct axis {
+  double lo, hi;   // search range; lo == hi holds the axis at that value
+  bool log;        // sample/space logarithmically (ranges spanning decades)
+};
+
+static axis axes[AXES] = {  // settingsDefaults() values: 10, 5e-4, 500, 3.7e5, 175, 5.5e7
+  { 2, 50, true },
+  { 5e-5, 5e-3, true },
+  { 50, 5000, true },
+  { 3.7e5, 3.7e5, false },
+  { 175, 175, false },
+  { 5.5e7, 5.5e7, false },
+};
+
+struct trial {
+  double k[AXES];
+  double score;
+  double iae, overshoot;
+  unsigned starts, unsettled;
+};
+
+struct weights {
+  double overshoot;  // C*h per deg C of summed segment overshoot
+  double start;      // C*h per compressor start
+  double unsettled;  // C*h per segment that never settled
+};
+
+static double fitness(const runMetrics& m, const weights& w, trial& r) {  // lower is better
+  runMetrics closed = m.closed();
+  double over = 0;
+  for (size_t i = 0; i < closed.segments.size(); i++) over += closed.segments[i].overshoot;
+  r.iae = m.iae;
+  r.overshoot = over;
+  r.starts = m.compressorStarts;
+  r.unsettled = closed.unsettled;
+  return m.iae + w.overshoot * over + w.start * m.compressorStarts + w.unsettled * closed.unsettled;
+}
+
+static void simulate(const scenario& scn, const weights& w, trial& r) {  // one closed loop run, same wiring as setup()/mainUpdate()
+  linuxBoard board("", 2);
+  hal::attach(board.get());
+  fermPlant plant(scn.params);
+  plant.init(scn.initAir, scn.initBeer);
+  board.wire.device(0).temp = plant.beerProbe();
+  board.wire.device(1).temp = plant.airProbe();
+
+  probeFilter beerFilter, airFilter;
+  probe beer(&beerFilter), air(&airFilter);
+  chamber ch(&beer, &air, A2, A3);  // relay1 (compressor) and relay2 (heater); both PIDs automatic
+  ch.openRelays();
+  probeBus bus(&onewire);  // no ROM cache: roles follow enumeration order, as on a fresh EEPROM
+  bus.attach(ROLE_BEER, &beer);
+  bus.attach(ROLE_FRIDGE, &air);
+  bus.begin();
+
+  ch.sample();
+  ch.setpoint = ch.output = scn.setpoint(0);
+  ch.begin(1000, r.k[KP], r.k[KI], r.k[KD], r.k[HEAT_KP], r.k[HEAT_KI], r.k[HEAT_KD]);
+
+  runMetrics metrics;
+  uint64_t t0 = board.clock.micros();
+  for (unsigned long s = 0; s < (unsigned long)scn.duration; s++) {  // 1 Hz, as probeBus::update() paces mainUpdate()
+    double t = s;
+    plant.compressor = board.gpio.level(A2) == LOW;
+    plant.heater = board.gpio.level(A3) == LOW;
+    plant.step(1, scn.ambient(t), scn.exotherm(t));
+    board.wire.device(0).temp = plant.beerProbe();
+    board.wire.device(1).temp = plant.airProbe();
+    uint64_t due = t0 + (uint64_t)(s + 1) * 1000000;
+    while (board.clock.micros() < due) {  // mainUpdate() passes; the bus converts and reads across them
+      if (bus.update()) ch.sample();
+      board.clock.advance(std::min<uint64_t>(passUs, due - board.clock.micros()));
+    }
+    ch.setpoint = scn.setpoint(t);
+    unsigned long now = millis();
+    ch.compute(now);
+    ch.update(now);
+    metrics.sample(t, 1, ch.setpoint, plant.beer(), plant.compressor, plant.heater);
+  }
+  hal::attach(0);
+  r.score = fitness(metrics, w, r);
+}
+
+static double pick(const axis& a, double u) {  // u in [0, 1] to a point of the axis range
+  if (a.lo == a.hi) return a.lo;
+  if (a.log) return a.lo * pow(a.hi / a.lo, u);
+  return a.lo + (a.hi - a.lo) * u;
+}
+
+static bool parseAxis(const char* spec) {  // name=lo:hi or name=value
+  const char* eq = strchr(spec, '=');
+  if (!eq) return false;
+  std::string name(spec, eq - spec);
+  for (int i = 0; i < AXES; i++) {
+    if (name != axisName[i]) continue;
+    char* end;
+    double lo = strtod(eq + 1, &end), hi = lo;
+    if (*end == ':') hi = strtod(end + 1, &end);
+    if (*end || lo < 0 || hi < lo) return false;
+    axes[i].lo = lo;
+    axes[i].hi = hi;
+    axes[i].log = lo > 0 && hi / lo >= 10;
+    return true;
+  }
+  return false;
+}
+
+static void usage() {
+  fprintf(stderr,
+    "usage: npid-tune [options] SCENARIO\n"
+    "  -a AXIS=LO:HI  search range for kp, ki, kd, heatkp, heatki or heatkd (AXIS=V holds it at V)\n"
+    "                 defaults: kp=2:50 ki=5e-5:5e-3 kd=50:5000, heat gains held at their presets\n"
+    "  -g N           grid search, N points per free axis (default 6)\n"
+    "  -r N           random search, N samples (log-uniform across ranges spanning a decade or more)\n"
+    "  -S SEED        random seed (default 1)\n"
+    "  -j N           worker threads (default: all cores)\n"
+    "  -n N           print the N best tunings (default 10)\n"
+    "  -O W           score weight per deg C of overshoot (default 20)\n"
+    "  -C W           score weight per compressor start (default 0.05)\n"
+    "  -U W           score weight per segment that never settles (default 50)\n"
+    "  -o FILE        write every trial to a CSV file\n"
+    "score = IAE (C*h) + weighted overshoot + weighted compressor starts + weighted unsettled segments\n");
+}
+
+int main(int argc, char** argv) {
+  unsigned gridN = 6, randomN = 0, threads = 0, top = 10, seed = 1;
+  weights w = { 20, 0.05, 50 };
+  const char* csvPath = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:g:r:S:j:n:O:C:U:o:h")) != -1) {
+    switch (opt) {
+      case 'a': if (!parseAxis(optarg)) { fprintf(stderr, "bad axis '%s'\n", optarg); return 1; } break;
+      case 'g': gridN = atoi(optarg); randomN = 0; break;
+      case 'r': randomN = atoi(optarg); break;
+      case 'S': seed = atoi(optarg); break;
+      case 'j': threads = atoi(optarg); break;
+      case 'n': top = atoi(optarg); break;
+      case 'O': w.overshoot = atof(optarg); break;
+      case 'C': w.start = atof(optarg); break;
+      case 'U': w.unsettled = atof(optarg); break;
+      case 'o': csvPath = optarg; break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1 || (!randomN && !gridN)) { usage(); return 1; }
+
+  scenario scn;
+  std::string err;
+  if (!scn.load(argv[optind], err)) { fprintf(stderr, "%s\n", err.c_str()); return 1; }
+
+  std::vector<trial> trials;  // build the whole search up front; runs only write their own element
+  if (randomN) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> u(0, 1);
+    trials.resize(randomN);
+    for (size_t i = 0; i < trials.size(); i++)
+      for (int a = 0; a < AXES; a++) trials[i].k[a] = pick(axes[a], u(rng));
+  }
+  else {
+    size_t total = 1;
+    for (int a = 0; a < AXES; a++) if (axes[a].lo != axes[a].hi) total *= gridN;
+    trials.resize(total);
+    for (size_t i = 0; i < total; i++) {
+      size_t idx = i;
+      for (int a = 0; a < AXES; a++) {
+        if (axes[a].lo == axes[a].hi) { trials[i].k[a] = axes[a].lo; continue; }
+        trials[i].k[a] = pick(axes[a], gridN > 1 ? (double)(idx % gridN) / (gridN - 1) : 0.5);
+        idx /= gridN;
+      }
+    }
+  }
+
+  typedef std::chrono::steady_clock wall;
+  wall::time_point start = wall::now();
+  workPool pool(threads);
+  for (size_t i = 0; i < trials.size(); i++) pool.submit([&, i] { simulate(scn, w, trials[i]); });
+  pool.wait();
+  double wallSec = std::chrono::duration<double>(wall::now() - start).count();
+
+  printf("scenario %s: %zu runs of %.2f days on %u threads in %.2f s wall (%.0f simulated days/s, %lu steals)\n",
+         scn.name.c_str(), trials.size(), scn.duration / 86400, pool.size(), wallSec,
+         trials.size() * scn.duration / 86400 / wallSec, pool.steals());
+
+  if (csvPath) {
+    FILE* csv = fopen(csvPath, "w");
+    if (!csv) { perror(csvPath); return 1; }
+    fprintf(csv, "kp,ki,kd,heatkp,heatki,heatkd,score,iae,overshoot,starts,unsettled\n");
+    for (size_t i = 0; i < trials.size(); i++) {
+      const trial& r = trials[i];
+      fprintf(csv, "%g,%g,%g,%g,%g,%g,%.3f,%.3f,%.3f,%u,%u\n", r.k[0], r.k[1], r.k[2], r.k[3], r.k[4], r.k[5],
+              r.score, r.iae, r.overshoot, r.starts, r.unsettled);
+    }
+    fclose(csv);
+  }
+
+  std::vector<const trial*> best;
+  for (size_t i = 0; i < trials.size(); i++) best.push_back(&trials[i]);
+  top = std::min((size_t)top, best.size());
+  std::partial_sort(best.begin(), best.begin() + top, best.end(),
+                    [](const trial* a, const trial* b) { return a->score < b->score; });
+  printf("%4s %9s %9s %9s %9s %9s %9s %9s %8s %9s %6s %9s\n", "rank", "kp", "ki", "kd", "heatkp", "heatki", "heatkd",
+         "score", "IAE", "overshoot", "starts", "unsettled");
+  for (unsigned i = 0; i < top; i++) {
+    const trial& r = *best[i];
+    printf("%4u %9.4g %9.4g %9.4g %9.4g %9.4g %9.4g %9.2f %8.2f %9.2f %6u %9u\n", i + 1, r.k[0], r.k[1], r.k[2],
+           r.k[3], r.k[4], r.k[5], r.score, r.iae, r.overshoot, r.starts, r.unsettled);
+  }
+  return 0;
+}
@@ -0,0 +1,108 @@
+#ifndef POOL_H
+#define POOL_H
+
+// work-stealing thread pool.  every worker owns a deque: it pushes and pops its own work at the back and,
+// when that runs dry, steals from the front of the others.  tasks submitted from outside the pool are
+// dealt round robin.  simulations vary a lot in cost (a badly tuned controller cycles far more often),
+// so stealing keeps every core busy until the last batch is done.
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class workPool {
+  public:
+    typedef std::function<void()> task;
+
+    explicit workPool(unsigned threads = 0);
+    ~workPool();
+
+    void submit(task t);   // from a worker: onto its own deque; otherwise round robin
+    void wait();           // block until every submitted task has finished
+    unsigned size() const { return (unsigned)_queues.size(); }
+    unsigned long steals() const { return _steals; }
+
+  private:
+    struct queue {
+      std::mutex lock;
+      std::deque<task> tasks;
+    };
+
+    bool _pop(unsigned self, task& t);
+    void _run(unsigned self);
+
+    std::vector<std::unique_ptr<queue> > _queues;
+    std::vector<std::thread> _threads;
+    std::mutex _idleLock;
+    std::condition_variable _idle, _done;
+    std::atomic<size_t> _pending;   // submitted but not finished
+    std::atomic<size_t> _queued;    // sitting in a deque
+    std::atomic<unsigned> _next;    // round robin for outside submissions
+    std::atomic<unsigned long> _steals;
+    bool _stop;
+    static inline thread_local int _self = -1;  // worker index of the calling thread, -1 outside the pool
+};
+
+inline workPool::workPool(unsigned threads) : _pending(0), _queued(0), _next(0), _steals(0), _stop(false) {
+  if (!threads) threads = std::thread::hardware_concurrency();
+  if (!threads) threads = 1;
+  for (unsigned i = 0; i < threads; i++) _queues.emplace_back(new queue);
+  for (unsigned i = 0; i < threads; i++) _threads.emplace_back(&workPool::_run, this, i);
+}
+
+inline workPool::~workPool() {
+  wait();
+  { std::lock_guard<std::mutex> g(_idleLock); _stop = true; }
+  _idle.notify_all();
+  for (size_t i = 0; i < _threads.size(); i++) _threads[i].join();
+}
+
+inline void workPool::submit(task t) {
+  unsigned q = (_self >= 0) ? (unsigned)_self : _next++ % size();
+  _pending++;
+  { std::lock_guard<std::mutex> g(_queues[q]->lock); _queues[q]->tasks.push_back(std::move(t)); _queued++; }
+  { std::lock_guard<std::mutex> g(_idleLock); }  // order against a worker about to sleep
+  _idle.notify_one();
+}
+
+inline void workPool::wait() {
+  std::unique_lock<std::mutex> g(_idleLock);
+  _done.wait(g, [this] { return _pending == 0; });
+}
+
+inline bool workPool::_pop(unsigned self, task& t) {
+  { queue& q = *_queues[self];  // own work, newest first (still warm in cache)
+    std::lock_guard<std::mutex> g(q.lock);
+    if (!q.tasks.empty()) { t = std::move(q.tasks.back()); q.tasks.pop_back(); _queued--; return true; }
+  }
+  for (unsigned i = 1; i < size(); i++) {  // steal the oldest task of the next busy victim
+    queue& q = *_queues[(self + i) % size()];
+    std::lock_guard<std::mutex> g(q.lock);
+    if (!q.tasks.empty()) { t = std::move(q.tasks.front()); q.tasks.pop_front(); _queued--; _steals++; return true; }
+  }
+  return false;
+}
+
+inline void workPool::_run(unsigned self) {
+  _self = (int)self;
+  task t;
+  for (;;) {
+    if (_pop(self, t)) {
+      t();
+      t = task();
+      if (--_pending == 0) { std::lock_guard<std::mutex> g(_idleLock); _done.notify_all(); }
+      continue;
+    }
+    std::unique_lock<std::mutex> g(_idleLock);  // sleep until there is something to pop or steal
+    _idle.wait(g, [this] { return _stop || _queued > 0; });
+    if (_stop && _queued == 0) return;
+  }
+}
+
+#endif
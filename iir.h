@@ -0,0 +1,126 @@
+#ifndef IIR_H
+#define IIR_H
+
+#include "Arduino.h"
+
+// direct form I IIR filters with coefficients designed at compile time.
+//
+//   iirFilter<ORDER, COEFFICIENTS, SAMPLE> f;
+//
+// COEFFICIENTS is a coefficient set (butterworthLP below): a class with constexpr b(order, m), the input
+// coefficient of x[n-m], and a(order, m), the feedback coefficient of y[n-m] (m >= 1), so that
+//   y[n] = sum b(m) * x[n-m] + sum a(m) * y[n-m]
+// SAMPLE is float/double, or fix16 (Q16.16 state, Q4.28 coefficients, 64 bit accumulator).  the
+// coefficients are compile time constants and the taps are unrolled, so there are no coefficient tables
+// and no per-sample shifting: input and output history live in ring buffers.
+
+const byte iirMaxOrder = 4;  // keeps fix16 feedback coefficients inside Q4.28
+
+struct fix16 {  // Q16.16 sample
+  int32_t raw;
+};
+
+namespace iir {  // constexpr math (C++11: single return, recursion)
+  constexpr double pi = 3.14159265358979323846;
+  constexpr double sinSeries(double x2, double term, int n) {
+    return n > 13 ? term : term + sinSeries(x2, -term * x2 / ((2 * n + 2) * (2 * n + 3)), n + 1);
+  }
+  constexpr double cosSeries(double x2, double term, int n) {
+    return n > 13 ? term : term + cosSeries(x2, -term * x2 / ((2 * n + 1) * (2 * n + 2)), n + 1);
+  }
+  constexpr double sin(double x) { return sinSeries(x * x, x, 0); }  // |x| <= pi/2
+  constexpr double cos(double x) { return cosSeries(x * x, 1, 0); }
+  constexpr double tan(double x) { return sin(x) / cos(x); }
+  constexpr double ipow(double x, int k) { return k ? x * ipow(x, k - 1) : 1; }
+  constexpr double binom(int n, int k) { return (k < 0 || k > n) ? 0 : ((k == 0 || k == n) ? 1 : binom(n - 1, k - 1) + binom(n - 1, k)); }
+
+  // analog Butterworth polynomial sum a_k s^k (a_0 = a_n = 1)
+  constexpr double butterPoly(int n, int k) {
+    return k ? butterPoly(n, k - 1) * cos((k - 1) * pi / (2 * n)) / sin(k * pi / (2 * n)) : 1;
+  }
+  // coefficient of z^-m in (1 - z^-1)^k (1 + z^-1)^(n - k): one term of the bilinear transform
+  constexpr double bilinear(int n, int k, int m, int j) {
+    return j > k ? 0 : ((j & 1) ? -1 : 1) * binom(k, j) * binom(n - k, m - j) + bilinear(n, k, m, j + 1);
+  }
+  // z^-m coefficient of the digital denominator; c = 1 / tan(pi fc / fs) (pre-warped)
+  constexpr double denominator(int n, double c, int m, int k) {
+    return k > n ? 0 : butterPoly(n, k) * ipow(c, k) * bilinear(n, k, m, 0) + denominator(n, c, m, k + 1);
+  }
+}
+
+template <unsigned long cutoff, unsigned long sampleRate> struct butterworthLP {  // low pass; both rates in mHz
+  static_assert(2 * cutoff < sampleRate, "cutoff must be below the Nyquist frequency");
+  static constexpr double c() { return 1 / iir::tan(iir::pi * cutoff / sampleRate); }
+  static constexpr double b(int n, int m) { return iir::binom(n, m) / iir::denominator(n, c(), 0, 0); }
+  static constexpr double a(int n, int m) { return -iir::denominator(n, c(), m, 0) / iir::denominator(n, c(), 0, 0); }
+};
+
+template <typename T> struct iirMath {  // floating point samples
+  typedef T acc;
+  typedef T coef;
+  static constexpr coef k(double v) { return v; }
+  static T in(double v) { return v; }
+  static double out(T v) { return v; }
+  static acc mac(acc sum, coef c, T x) { return sum + c * x; }
+  static T result(acc sum) { return sum; }
+};
+
+template <> struct iirMath<fix16> {  // Q16.16 samples, Q4.28 coefficients
+  typedef int64_t acc;
+  typedef int32_t coef;
+  static constexpr coef k(double v) { return v * 268435456.0 + (v < 0 ? -0.5 : 0.5); }
+  static fix16 in(double v) { fix16 f = { (int32_t)(v * 65536.0 + (v < 0 ? -0.5 : 0.5)) }; return f; }
+  static double out(fix16 v) { return v.raw / 65536.0; }
+  static acc mac(acc sum, coef c, fix16 x) { return sum + (int64_t)c * x.raw; }
+  static fix16 result(acc sum) { fix16 f = { (int32_t)((sum + (1L << 27)) >> 28) }; return f; }
+};
+
+template <byte N, class C, typename T, byte M> struct iirTap {  // taps M..0, unrolled at compile time
+  typedef iirMath<T> math;
+  static typename math::acc run(const T* x, const T* y, byte pos, typename math::acc sum) {
+    static constexpr typename math::coef bm = math::k(C::b(N, M));
+    static constexpr typename math::coef am = math::k(C::a(N, M));
+    byte i = (pos >= M) ? pos - M : pos + N + 1 - M;
+    sum = math::mac(math::mac(sum, bm, x[i]), am, y[i]);
+    return iirTap<N, C, T, M - 1>::run(x, y, pos, sum);
+  }
+};
+
+template <byte N, class C, typename T> struct iirTap<N, C, T, 0> {
+  typedef iirMath<T> math;
+  static typename math::acc run(const T* x, const T* y, byte pos, typename math::acc sum) {
+    static constexpr typename math::coef b0 = math::k(C::b(N, 0));
+    return math::mac(sum, b0, x[pos]);
+  }
+};
+
+class tempFilter {  // what a probe needs from its filter
+  public:
+    virtual void reset(double v) = 0;      // settle at v
+    virtual double update(double v) = 0;   // filter one sample, return the output
+    virtual double output(byte k) = 0;     // output k samples ago (k <= order)
+};
+
+template <byte N, class C, typename T = double> class iirFilter : public tempFilter {
+    static_assert(N >= 1 && N <= iirMaxOrder, "unsupported filter order");
+    typedef iirMath<T> math;
+    T _x[N + 1];  // input and output rings; _pos is the newest sample
+    T _y[N + 1];
+    byte _pos;
+
+  public:
+    iirFilter() { reset(0); }
+    void reset(double v) {
+      for (byte i = 0; i <= N; i++) _x[i] = _y[i] = math::in(v);
+      _pos = 0;
+    }
+    double update(double v) {
+      _pos = (_pos == N) ? 0 : _pos + 1;
+      _x[_pos] = math::in(v);
+      _y[_pos] = math::result(iirTap<N, C, T, N>::run(_x, _y, _pos, typename math::acc()));
+      return math::out(_y[_pos]);
+    }
+    double output(byte k) { return math::out(_y[(_pos >= k) ? _pos - k : _pos + N + 1 - k]); }
+};
+
+#endif
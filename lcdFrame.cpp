@@ -0,0 +1,62 @@
+#include "lcdFrame.h"
+
+lcdFrame::lcdFrame(LiquidCrystal* lcd) {
+  _lcd = lcd;
+  memset(&_stats, 0, sizeof(_stats));
+  clear();
+  invalidate();  // whatever setup() left on the glass
+}
+
+void lcdFrame::clear() {
+  memset(_next, ' ', sizeof(_next));
+  _col = _row = 0;
+}
+
+void lcdFrame::setCursor(byte col, byte row) {
+  _col = col;
+  _row = (row < lcdRows) ? row : lcdRows - 1;
+}
+
+size_t lcdFrame::write(uint8_t c) {
+  if (_col >= lcdCols) return 0;
+  _next[_row][_col++] = c;
+  return 1;
+}
+
+void lcdFrame::labels(const lcdLabel* table, byte count) {
+  lcdLabel l;
+  for (byte i = 0; i < count; i++) {
+    memcpy_P(&l, &table[i], sizeof(l));
+    setCursor(l.col, l.row);
+    for (byte j = 0; (j < sizeof(l.text)) && l.text[j]; j++) write((uint8_t)l.text[j]);
+  }
+}
+
+void lcdFrame::invalidate() {
+  memset(_shown, lcdUnknown, sizeof(_shown));
+}
+
+unsigned int lcdFrame::flush() {
+  unsigned int sent = 0;
+  for (byte r = 0; r < lcdRows; r++) {
+    byte c = 0;
+    while (c < lcdCols) {
+      if (_next[r][c] == _shown[r][c]) { c++; continue; }
+      byte end = c;  // last changed cell of the run
+      for (byte j = c + 1; (j < lcdCols) && (j - end <= lcdRunGap + 1); j++)
+        if (_next[r][j] != _shown[r][j]) end = j;
+      _lcd->setCursor(c, r);
+      sent++;
+      for (; c <= end; c++) {
+        _lcd->write(_next[r][c]);
+        _shown[r][c] = _next[r][c];
+        sent++;
+      }
+    }
+  }
+  _stats.frames++;
+  _stats.bytes += sent;
+  _stats.last = sent;
+  if (sent > _stats.max) _stats.max = sent;
+  return sent;
+}
@@ -0,0 +1,50 @@
+#ifndef LCDFRAME_H
+#define LCDFRAME_H
+
+#include "Arduino.h"
+#include <LiquidCrystal.h>
+
+// shadow frame buffer for the 20x4 character LCD.  the sketch prints a whole frame into RAM (same Print
+// interface as LiquidCrystal, nothing is sent), then flush() compares it with what is already on the glass
+// and sends only the cells that differ.  changed cells of a row are pushed as runs behind one setCursor();
+// an unchanged cell between two changes costs the same one byte as a new setCursor(), so gaps of up to
+// lcdRunGap cells are rewritten rather than re-addressed.  the sketch draws a frame every lcdFrameMs.
+
+const byte lcdCols = 20;
+const byte lcdRows = 4;
+const byte lcdRunGap = 1;             // unchanged cells bridged inside a run
+const unsigned int lcdFrameMs = 250;  // time between frames (4 Hz)
+const byte lcdUnknown = 0xFE;         // shown-cell marker: contents unknown, always rewritten
+
+struct lcdLabel {  // static text of a page, kept in PROGMEM.  CGRAM glyph 0 is written as 8 (its mirror)
+  byte col, row;
+  char text[9];
+};
+
+struct lcdFrameStats {
+  unsigned long frames;  // flushes
+  unsigned long bytes;   // instruction and data bytes sent, all frames
+  unsigned int last;     // bytes sent by the last frame
+  unsigned int max;
+};
+
+class lcdFrame : public Print {
+    LiquidCrystal* _lcd;
+    byte _next[lcdRows][lcdCols];   // frame being drawn
+    byte _shown[lcdRows][lcdCols];  // what the glass holds
+    byte _col, _row;
+    lcdFrameStats _stats;
+
+  public:
+    lcdFrame(LiquidCrystal* lcd);
+    void clear();                            // blank the frame being drawn
+    void setCursor(byte col, byte row);
+    virtual size_t write(uint8_t c);         // cells beyond the last column are dropped
+    using Print::write;
+    void labels(const lcdLabel* table, byte count);  // draw a PROGMEM label table
+    void invalidate();                       // glass written behind our back (menu): repaint every cell next frame
+    unsigned int flush();                    // send the changes, returns the bytes sent
+    const lcdFrameStats& getStats() { return _stats; }
+};
+
+#endif
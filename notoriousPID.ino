@@ -8,67 +8,119 @@
 #include <SD.h>
 #include <SPI.h>
 #include <OneWire.h>
-#include <QueueList.h>
 #include <EEPROM.h>
 #include "PID_v1.h"
+#include "PID_fixed.h"
 #include "probe.h"
+#include "probeBus.h"
 #include "EEPROMio.h"
+#include "settings.h"
+#include "profile.h"
 #include "fridge.h"
-#include "globals.h"
-#define DEBUG true  // debug flag for including debugging code
-
-void mainUpdate();  // update sensors, PID output, fridge state, write to log, run profiles
+#include "chamber.h"
+#include "timeKeeper.h"
+#include "autotune.h"
+#include "datalog.h"
+#include "lcdFrame.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "telemetry.h"
+#include "encoder.h"
+#include "globals.h"  // DEBUG is set in telemetry.h: text debugging needs TELEMETRY false
+
+void mainUpdate();  // run the control, relay and logging tasks (no display/menu)
+void probeTask();    // scheduler tasks
+void profileTask();
+void pidTask();
+void fridgeTask();
+void tuneTask();     // relay auto-tuning experiment
+void logTask();
+void uiTask();
+void displayTask();
+void settingsTask();   // batched EEPROM commits
+void timeTask();       // hourly RTC sync of the wall clock
+#if TRACE == true
+void traceTask();    // trace dump/clear commands on Serial
+#endif
+#if TELEMETRY == true
+void telemTask();       // drain the telemetry queue, run received commands
+void snapshotTask();    // queue a state snapshot
+void remoteCommand();   // apply the received command and acknowledge it
+#endif
 
 boolean updateProfile();  // update temperature profile
 void writeLog();          // write new line to log file
 void dateTime(uint16_t* date, uint16_t* time);  // date/time callback function for SdFat to timestamp file creation/modification
 
-void initDisplay();    // print static characters to LCD (lables, scrollbar, page names, etc)
-void updateDisplay();  // print dynamic characters to LCD (PID/temp values, etc)
-
-void menu();       // change PID and program settings
-void mainPIDmode();  // mainPID manual/automatic
-void mainPIDsp();    // mainPID setpoint
-void heatPIDmode();  // heatPID manual/automatic
-void dataLog();      // data logging
-void tempProfile();  // temperature profiles
-void tempUnit();     // temperature display units C/F
-void avrReset();     // restore default settings and reset
+void initDisplay();    // page changed: draw the next frame immediately
+void updateDisplay();  // draw the current page (labels, scrollbar, values) into the frame buffer, send the changes
+void drawTasks();      // task statistics page
+
+void mainPages(byte event);    // screen handlers, called by uiTask() with uiEvent events
+void menu(byte event);         // change PID and program settings
+void mainPIDmode(byte event);  // mainPID manual/automatic
+void mainPIDsp(byte event);    // mainPID setpoint
+void heatPIDmode(byte event);  // heatPID manual/automatic
+void dataLog(byte event);      // data logging
+void tempProfile(byte event);  // temperature profiles
+void coolMode(byte event);     // COOL stop prediction: peakEstimator or coolModel
+void autoTune(byte event);     // relay auto-tuning of the main or heat PID
+void tempUnit(byte event);     // temperature display units C/F
+void avrReset(byte event);     // restore default settings and reset
+void editValue(byte event);    // numeric entry for uiEdit()
+void uiWait(byte event);       // message showing; input ignored
+void uiOpen(uiHandler handler);   // make handler the active screen
+void uiList(char size, char pos); // encoder range and position of the active screen
+void uiReturn();                  // back to the menu list
+void uiBack();                    // long press: leave the active screen
+void menuLeave();                 // menu back to the main display
+void uiMessage(const __FlashStringHelper* text);
+void uiOption();
+void uiEdit(double* target, const __FlashStringHelper* name, boolean limit, byte manual);
+void profileLoad();  // parse the selected profile, one block per call
+boolean profileBlock();  // feed the next block of ProFile to the parser; false at the end or on an error
+void profileReport();    // show a profile error
 void backOut();    // finalize changes and leave menu
+void tuneStart(byte loop);    // PID to manual, relay experiment on its loop
+void tuneFinish(byte state);  // apply the tunings (TUNE_DONE) and restore the PID modes
+void applyTunings();          // Kp, Ki, Kd and heatKp, heatKi, heatKd to every chamber's PIDs
 
-void EEPROMReadSettings();   // read saved settings from EEPROM
-void EEPROMWriteSettings();  // write current settings to EEPROM
-void EEPROMWritePresets();   // write default settings to EEPROM
+void loadSettings();                        // newest settings record (or defaults); reopen log and profile
+void settingsApply(const settingsRecord& r);  // record into the current settings
+void settingsCapture(settingsRecord& r);    // current settings into a record, for commits
+void settingsDefaults(settingsRecord& r);   // default settings
 
-void encoderChanA();  // manage encoder pin A transitions
-void encoderChanB();  // manage encoder pin B transitions
+void encoderEdge();  // either encoder channel changed
 
 #if DEBUG == true
 int freeRAM();  // approximate free SRAM for debugging
 #endif
 
+const byte taskPage = 4;      // main display page of the scheduler statistics
+#if DEBUG == true
+const byte displayPages = 5;  // debug builds add the task page
+#else
+const byte displayPages = 4;
+#endif
+
 void setup() {
   pinMode(chipSelect, OUTPUT);  // select pin i/o and enable pullup resistors
-  pinMode(encoderPinA, INPUT_PULLUP);
-  pinMode(encoderPinB, INPUT_PULLUP);
-  pinMode(pushButton, INPUT_PULLUP);
-  pinMode(relay1, OUTPUT);  // configure relay pins and write default HIGH (relay open)
-    digitalWrite(relay1, HIGH);
-  pinMode(relay2, OUTPUT);
-    digitalWrite(relay2, HIGH);
-  attachInterrupt(0, encoderChanA, CHANGE);  // interrupt 0 (pin 2) triggered by change
-  attachInterrupt(1, encoderChanB, CHANGE);  // interrupt 1 (pin 3) triggered by change
+  knob.begin();
+  button.begin();
+  for (byte i = 0; i < chamberCount; i++) chambers[i].openRelays();  // configure relay pins and write default HIGH (relay open)
+  attachInterrupt(0, encoderEdge, CHANGE);  // interrupt 0 (pin 2) triggered by change
+  attachInterrupt(1, encoderEdge, CHANGE);  // interrupt 1 (pin 3) triggered by change
   encoderPos = 0;
-  encoderState = 0b000;
-  encoderChanA();  // call interrupt routines once to init rotary encoder
-  encoderChanB();
 
-  #if DEBUG == true  //start serial at 9600 baud for debuging
+  #if TELEMETRY == true
+    telem.begin(&Serial);  // binary protocol at telemBaud
+  #elif DEBUG == true || TRACE == true  //start serial at 9600 baud for debuging and trace dumps
     Serial.begin(9600);
   #endif
 
   Wire.begin();              // initialize rtc communication
   RTC.begin();               // start real time clock
+  wallClock.begin();         // wall time from millis() between hourly RTC syncs
   lcd.createChar(0, (uint8_t*)delta);  // create custom characters for LCD (slots 0-7)
   lcd.createChar(1, (uint8_t*)rightArrow);
   lcd.createChar(2, (uint8_t*)disc);
@@ -78,53 +130,59 @@ void setup() {
   lcd.createChar(6, (uint8_t*)degc);
   lcd.createChar(7, (uint8_t*)degf);
   lcd.begin(20, 4);          // initialize lcd display
-  if (SD.begin(chipSelect, mosi, miso, sck)) lcd.print(F("SDCard Init Success"));  // verify and initialize SD card
+  if (SD.begin(chipSelect, mosi, miso, sck)) {  // verify and initialize SD card
+    datalog::begin(chipSelect, mosi, miso, sck);  // raw block access for contiguous logs
+    lcd.print(F("SDCard Init Success"));
+  }
     else lcd.print(F("SDCard Failed/Absent"));
   delay(1500);
   SdFile::dateTimeCallback(&dateTime);
 
-  byte ver;
-  EEPROMRead(0, &ver, BYTE);  // first byte of EEPROM stores a version # for tracking stored settings
-  
-  #if DEBUG == true
-    Serial.print(F("Current EEPROM ver:"));
-    Serial.print(EEPROM_VER);
-    Serial.print(F(" value read from EEPROM:"));
-    Serial.println(ver);
+  loadSettings();  // load program settings from EEPROM
+
+  sensors.attach(ROLE_BEER, &beer);
+  sensors.attach(ROLE_FRIDGE, &fridge);
+  sensors.attach(ROLE_AMBIENT, &ambient);
+  sensors.attach(ROLE_VESSEL, &vessel);
+  sensors.attach(ROLE_COIL, &coil);
+  #if CHAMBERS > 1
+    sensors.attach(ROLE_VESSEL_AIR, &vesselAir);
   #endif
-  
-  if (ver != EEPROM_VER) {  // EEPROM version number != hard coded version number
-    #if DEBUG == true
-      Serial.println(F("Outdated or null EEPROM settings. Writing Defaults."));
-    #endif
-    
-    EEPROMWritePresets();  // if version # is outdated, write presets
-  }
-  EEPROMReadSettings();    // load program settings from EEPROM
-  #if DEBUG == true
-    Serial.println(F("Settings loaded from EEPROM:"));
+  beer.setResolution(beerResolution);
+  fridge.setResolution(fridgeResolution);
+  fridge.setStuckLimit(airStuckSamples);  // a cycling fridge moves its air
+  #if CHAMBERS > 1
+    vesselAir.setStuckLimit(airStuckSamples);
   #endif
+  sensors.begin();  // enumerate once; roles are kept in EEPROM
+  for (byte i = 0; i < chamberCount; i++) {
+    chamber& c = chambers[i];
+    c.controller.setAmbient(&ambient);  // coolModel input when the ambient probe is present
+    if (i) c.setpoint = c.output = Setpoint;  // until told otherwise
+    c.begin(mainSampleMs, Kp, Ki, Kd, heatKp, heatKi, heatKd);  // tunings, limits, man/auto from the program state
+  }
 
-  fridge.init();
-  beer.init();
-  
-  mainPID.SetTunings(Kp, Ki, Kd);    // set tuning params
-  mainPID.SetSampleTime(1000);       // (ms) matches sample rate (1 hz)
-  mainPID.SetOutputLimits(0.3, 38);  // deg C (~32.5 - ~100 deg F)
-  if (programState & MAIN_PID_MODE) mainPID.SetMode(AUTOMATIC);  // set man/auto
-    else mainPID.SetMode(MANUAL);
-  mainPID.setOutputType(FILTERED);
-  mainPID.setFilterConstant(10);
-  mainPID.initHistory();
-
-  heatPID.SetTunings(heatKp, heatKi, heatKd);
-  heatPID.SetSampleTime(heatWindow);       // sampletime = time proportioning window length
-  heatPID.SetOutputLimits(0, heatWindow);  // heatPID output = duty time per window
-  if (programState & HEAT_PID_MODE) heatPID.SetMode(AUTOMATIC);
-    else heatPID.SetMode(MANUAL);
-  heatPID.initHistory();
-
-  encoderPos = 0;  // zero rotary encoder position for main loop
+  uiActive = mainPages;
+  uiList(displayPages, 0);  // zero rotary encoder position for main loop
+
+  sched.every(busPollMs, probeTask, TASK_CONTROL, F("prb"));  // probeBus paces the 1 Hz samples itself
+  sched.every(1000, profileTask, TASK_CONTROL, F("prof"));
+  sched.every(mainSampleMs, pidTask, TASK_CONTROL, F("pid"));
+  sched.every(relayPeriodMs, fridgeTask, TASK_RELAYS, F("frdg"));
+  sched.every(mainSampleMs, tuneTask, TASK_CONTROL, F("tune"));
+  sched.every(logPeriodMs, logTask, TASK_LOGGING, F("log"));
+  sched.every(uiPeriodMs, uiTask, TASK_DISPLAY, F("ui"));
+  displayTaskId = sched.every(lcdFrameMs, displayTask, TASK_DISPLAY, F("lcd"));
+  sched.every(settingsPollMs, settingsTask, TASK_LOGGING, F("eep"));
+  sched.every(timePollMs, timeTask, TASK_CONTROL, F("time"));  // control priority: the sync times the RTC tick
+  #if TELEMETRY == true
+    sched.every(telemPollMs, telemTask, TASK_LOGGING, F("tlm"));
+    snapshotTaskId = sched.every(telemPeriodMs, snapshotTask, TASK_LOGGING, F("snap"));
+  #endif
+  #if TRACE == true
+    sched.every(traceTaskMs, traceTask, TASK_LOGGING, F("trc"));
+    trace.begin(8000);  // watchdog timeout below
+  #endif
   
   wdt_enable(WDTO_8S);  // enable watchdog timer with 8 second timeout (max setting)
                         // wdt will reset the arduino if there is an infinite loop or other hangup; this is a failsafe device
@@ -134,296 +192,437 @@ void setup() {
     Serial.print(F("ms elapsed. "));
     Serial.print(freeRAM());
     Serial.println(F(" bytes free SRAM remaining"));
+    Serial.print(chamberCount);  // memory budget: how many more chambers the free SRAM would hold
+    Serial.print(F(" chamber(s) of "));
+    Serial.print(sizeof(chamber));
+    Serial.print(F(" bytes; room for "));
+    Serial.print(max(freeRAM() - stackReserve, 0) / (int)sizeof(chamber));
+    Serial.print(F(" more with "));
+    Serial.print(stackReserve);
+    Serial.println(F(" bytes kept for the stack"));
   #endif
 }
 
 void loop() {
-  wdt_reset();                      // reset the watchdog timer (once timer is set/reset, next reset pulse must be sent before timeout or arduino reset will occur)
-  static char listSize = 4;         // for constraining rotary encoder position
-  static char lastReportedPos = 1;  // default to 1 to force display initialze on first iteration
-  encoderState |= DEBOUNCE;         // reset rotary debouncer
-  if (encoderPos != lastReportedPos) {
-    encoderPos = (encoderPos + listSize) % listSize;  // constrain encoder position
-    initDisplay();                  // re-init display on encoder position change
-    lastReportedPos = encoderPos;
-  }                                                    
-  updateDisplay();                       // update display data
-  mainUpdate();                            // subroutines manage their own timings, call every loop
-  if (!digitalRead(pushButton)) menu();  // call menu routine on rotary button-press
+  wdt_reset();  // reset the watchdog timer (once timer is set/reset, next reset pulse must be sent before timeout or arduino reset will occur)
+  TRACE_INTERVAL(TRACE_WDT);
+  TRACE_BEGIN(TRACE_LOOP);
+  sched.run();  // every released task, highest priority first; tasks keep their own periods
+  TRACE_END(TRACE_LOOP);
+}
+
+void mainUpdate() {             // control, relays and logging only (no display/menu)
+  sched.run(TASK_LOGGING);
 }
 
-void mainUpdate() {                              // call all update subroutines
-  probe::startConv();                            // start conversion for all sensors
-  if (probe::isReady()) {                        // update sensors when conversion complete
-    fridge.update();
-    beer.update();
-    Input = beer.getFilter();
+void probeTask() {
+  TRACE_BEGIN(TRACE_PROBE);
+  boolean sampled = sensors.update();
+  TRACE_END(TRACE_PROBE);
+  if (sampled) {  // non-blocking; true once every sensor holds a new sample
+    for (byte i = 0; i < chamberCount; i++) chambers[i].sample();
   }
+}
+
+void profileTask() {
   if (programState & TEMP_PROFILE) updateProfile();  // update main Setpoint if fermentation profile active
-  mainPID.Compute();                             // update main PID
-  updateFridge();                                // update fridge status
-  if (programState & DATA_LOGGING) writeLog();       // if data capture enabled, run logging routine
 }
 
-boolean updateProfile() {
-  static unsigned int step = 0;
-  static unsigned long lastStep = 0;  // last profile step (ms)
-  static profileStep Step;            // current profile step
-  if ((millis() >= (unsigned long)(lastStep + Step.duration * 3600000UL)) && !profile.isEmpty()) {
-    step++;                      // increment step number
-    EEPROMWrite(52, step, INT);  // write step number to EEPROM
-    Step = profile.pop();        // pop next step off the queue
-    Setpoint = Step.temp;        // update Setpoint with new temp (deg C)
-    lastStep = millis();
-    return true;
-  }
-  return false;
+void pidTask() {
+  #if TRACE == true
+    long late = (int32_t)(micros() - sched.deadline() * 1000UL);  // release jitter
+    TRACE_VALUE(TRACE_JITTER, max(late, 0L));
+  #endif
+  TRACE_BEGIN(TRACE_PID);
+  for (byte i = 0; i < chamberCount; i++) chambers[i].compute(sched.deadline());  // released every SampleTime; the release time keeps the PIDs on their period
+  TRACE_END(TRACE_PID);
 }
 
-void writeLog() {
-  static double LogHz = 1;           // datalogging frequency (hz)
-  static unsigned long lastLog = 0;  // millis() at last log
-  if (millis() >= (unsigned long)(lastLog + 1000/LogHz)) {
-    #if DEBUG == true
-      Serial.print(F("logging to file... "));
-      Serial.print((unsigned long)(millis() - lastLog));
-      Serial.print(F("ms elapsed. "));
-      Serial.print(lastLog);
-      Serial.print(F(" "));
-      Serial.print(freeRAM());
-      Serial.println(F(" bytes free SRAM remaining"));
+void fridgeTask() {
+  TRACE_BEGIN(TRACE_FRIDGE);
+  unsigned long now = millis();
+  for (byte i = 0; i < chamberCount; i++) chambers[i].update(now);
+  TRACE_END(TRACE_FRIDGE);
+}
+
+void tuneTask() {
+  if (!tuneLoop) return;
+  byte state = tuner.update(millis());
+  if (state != TUNE_RUNNING) tuneFinish(state);
+}
+
+void logTask() {
+  if (!(programState & DATA_LOGGING)) return;
+  TRACE_BEGIN(TRACE_LOG);
+  writeLog();
+  TRACE_END(TRACE_LOG);
+}
+
+void displayTask() {
+  if (uiActive != mainPages) return;
+  TRACE_BEGIN(TRACE_LCD);
+  updateDisplay();
+  TRACE_END(TRACE_LCD);
+}
+
+void settingsTask() {
+  settings.poll();  // a few cells per release while a commit is written
+}
+
+void timeTask() {
+  wallClock.poll(millis());  // no bus traffic outside the hourly sync window
+}
+
+#if TRACE == true
+void traceTask() {  // a dump goes out a few frames per release, as the port drains
+  byte frame[traceFrameMax];
+  #if TELEMETRY == true  // commands arrive as CMD_TRACE
+    while (trace.dumping() && (telem.room() >= traceFrameMax + 6)) {
+      byte n = trace.nextFrame(frame);
+      telem.send(TELEM_TRACE, frame, n);
+    }
+  #else
+    while (Serial.available()) trace.command(Serial.read());
+    while (trace.dumping() && (Serial.availableForWrite() >= traceFrameMax)) {  // whole frames only, so other output cannot split one
+      byte n = trace.nextFrame(frame);
+      Serial.write(frame, n);
+    }
+  #endif
+}
+#endif
+
+#if TELEMETRY == true
+void telemTask() {
+  while (telem.poll()) remoteCommand();
+}
+
+void snapshotTask() {
+  if (!streaming) return;
+  telemSnapshot s;
+  s.ms = millis();
+  s.state = getFridgeState(0);
+  s.programState = programState;
+  s.fridgeTemp = fridge.getTemp();
+  s.fridgeFilter = fridge.getFilter();
+  s.beerTemp = beer.getTemp();
+  s.beerFilter = beer.getFilter();
+  s.setpoint = Setpoint;
+  s.output = Output;
+  s.mainP = mainPID.GetPTerm();
+  s.mainI = mainPID.GetITerm();
+  s.mainD = mainPID.GetDTerm();
+  s.heatSetpoint = heatSetpoint;
+  s.heatOutput = heatOutput;
+  s.heatP = heatPID.GetPTerm();
+  s.heatI = heatPID.GetITerm();
+  s.heatD = heatPID.GetDTerm();
+  s.peakEstimator = getPeakEstimator();
+  s.lost = chambers[0].getLost();
+  telem.snapshot(s);
+}
+
+void remoteCommand() {  // same rules as the menu; settings are saved as backOut() saves them
+  const byte* b = telem.body();
+  byte len = telem.length();
+  byte status = ACK_OK;
+  byte pid = len ? b[0] : 0;
+  switch (telem.type()) {
+    case CMD_SETPOINT: {
+      double sp = telemetry::getFloat(b);
+      byte c = (len == 5) ? b[4] : 0;
+      if ((len != 4) && (len != 5)) status = ACK_BAD_LENGTH;
+        else if (!(sp >= 0.3 && sp <= 38) || (c >= chamberCount)) status = ACK_BAD_VALUE;  // fridge target range; rejects NaN
+        else if (!c && (programState & TEMP_PROFILE)) status = ACK_REFUSED;  // the profile owns the setpoint
+        else chambers[c].setpoint = sp;
+      break;
+    }
+    case CMD_OUTPUT: {
+      double co = telemetry::getFloat(b + 1);
+      if (len != 5) status = ACK_BAD_LENGTH;
+        else if (pid == PID_MAIN) {
+          if (!(co >= 0.3 && co <= 38)) status = ACK_BAD_VALUE;  // main PID output limits
+            else if ((programState & MAIN_PID_MODE) || tuneLoop) status = ACK_REFUSED;  // manual mode only; the tuner owns the outputs
+            else Output = co;
+        }
+        else if (pid == PID_HEAT) {
+          if (!(co >= 0 && co <= heatWindow)) status = ACK_BAD_VALUE;
+            else if ((programState & HEAT_PID_MODE) || tuneLoop) status = ACK_REFUSED;
+            else heatOutput = co;
+        }
+        else status = ACK_BAD_VALUE;
+      break;
+    }
+    case CMD_TUNINGS: {
+      double kp = telemetry::getFloat(b + 1), ki = telemetry::getFloat(b + 5), kd = telemetry::getFloat(b + 9);
+      if (len != 13) status = ACK_BAD_LENGTH;
+        else if ((pid > PID_HEAT) || !(kp >= 0 && ki >= 0 && kd >= 0)) status = ACK_BAD_VALUE;
+        else if (tuneLoop) status = ACK_REFUSED;  // tunings are about to be replaced
+        else if (pid == PID_MAIN) {
+          Kp = kp; Ki = ki; Kd = kd;
+          applyTunings();
+        }
+        else {
+          heatKp = kp; heatKi = ki; heatKd = kd;
+          applyTunings();
+        }
+      break;
+    }
+    case CMD_MODE: {
+      byte flag = (pid == PID_MAIN) ? MAIN_PID_MODE : HEAT_PID_MODE;
+      if (len != 2) status = ACK_BAD_LENGTH;
+        else if ((pid > PID_HEAT) || (b[1] > AUTOMATIC)) status = ACK_BAD_VALUE;
+        else if (((pid == PID_MAIN) && (programState & TEMP_PROFILE)) || tuneLoop) status = ACK_REFUSED;
+        else {
+          if (b[1] == AUTOMATIC) programState |= flag;
+            else programState &= ~flag;
+          ((pid == PID_MAIN) ? mainPID : heatPID).SetMode(b[1]);
+        }
+      break;
+    }
+    case CMD_STREAM: {
+      unsigned int ms = len == 2 ? b[0] | b[1] << 8 : 0;
+      if (len != 2) status = ACK_BAD_LENGTH;
+        else {
+          streaming = ms;
+          if (ms) sched.setPeriod(snapshotTaskId, ms);
+        }
+      break;
+    }
+    #if TRACE == true
+    case CMD_TRACE:
+      if ((len != 1) || !trace.command(b[0])) status = ACK_BAD_VALUE;
+      break;
     #endif
-  
-    lastLog = millis();
-    DateTime time = RTC.now();
-    LogFile.print(lastLog, DEC);
-    LogFile.print(F(","));
-    LogFile.print(time.year(), DEC);
-    LogFile.print(F("/"));
-    LogFile.print(time.month(), DEC);
-    LogFile.print(F("/"));
-    LogFile.print(time.day(), DEC);
-    LogFile.print(F(" "));
-    LogFile.print(time.hour(), DEC);
-    LogFile.print(F(":"));
-    LogFile.print(time.minute(), DEC);
-    LogFile.print(F(":"));
-    LogFile.print(time.second(), DEC);
-    LogFile.print(F(","));
-    LogFile.print(fridge.getTemp(), DEC);
-    LogFile.print(F(","));
-    LogFile.print(fridge.getFilter(), DEC);
-    LogFile.print(F(","));
-    LogFile.print(beer.getTemp(), DEC);
-    LogFile.print(F(","));
-    LogFile.print(beer.getFilter(), DEC);
-    LogFile.print(F(","));
-    LogFile.print(Setpoint, DEC);
-    LogFile.print(F(","));
-    LogFile.print(Output, DEC);
-    LogFile.print(F(","));
-    LogFile.print(heatSetpoint, DEC);
-    LogFile.print(F(","));
-    LogFile.print(heatOutput, DEC);
-    LogFile.print(F(","));
-    LogFile.print(getPeakEstimator());
-    LogFile.print(F(","));
-    LogFile.println(getFridgeState(0));
-    LogFile.flush();
+    default:
+      status = ACK_UNKNOWN;
   }
+  if ((status == ACK_OK) && (telem.type() != CMD_STREAM) && (telem.type() != CMD_TRACE)) settings.change();  // committed once the commands stop
+  telem.ack(telem.type(), status);
+}
+#endif
+
+void uiTask() {  // encoder and push button; events go to the active screen handler
+  char steps = knob.read();  // detents queued by encoderEdge()
+  encoderPos = ((encoderPos + steps) % uiListSize + uiListSize) % uiListSize;  // constrain encoder position
+  if (encoderPos != uiLastPos) {
+    uiLastPos = encoderPos;
+    uiActive(UI_TURN);
+  }
+  switch (button.poll(millis())) {
+    case BUTTON_PUSH:
+      uiActive(UI_PUSH);
+      break;
+    case BUTTON_HOLD:
+      uiBack();
+      break;
+  }
+}
+
+boolean updateProfile() {  // every sample: ramps move the Setpoint smoothly
+  if (!profileRun.update(wallClock.now(), Input, &Setpoint)) return false;
+  settings.change();  // step, start time and start setpoint are kept in the settings record
+  return true;
+}
+
+void writeLog() {  // one record per logTask release (logPeriodMs)
+  static unsigned long lastLog = 0;  // millis() at last log
+  static unsigned long beerReads = 0, fridgeReads = 0;  // probe readings at last log
+  #if DEBUG == true
+    Serial.print(F("logging to file... "));
+    Serial.print((uint32_t)(millis() - lastLog));
+    Serial.print(F("ms elapsed. "));
+    Serial.print(lastLog);
+    Serial.print(F(" "));
+    Serial.print(freeRAM());
+    Serial.println(F(" bytes free SRAM remaining"));
+  #endif
+
+  lastLog = millis();
+  logRecord rec;  // staged in RAM; datalog commits whole sectors, on its flush interval and on fridge state changes
+  rec.ms = lastLog;
+  rec.time = wallClock.now();
+  rec.fridgeTemp = fridge.getTemp();
+  rec.fridgeFilter = fridge.getFilter();
+  rec.beerTemp = beer.getTemp();
+  rec.beerFilter = beer.getFilter();
+  rec.setpoint = Setpoint;
+  rec.output = Output;
+  rec.heatSetpoint = heatSetpoint;
+  rec.heatOutput = heatOutput;
+  rec.peakEstimator = getPeakEstimator();
+  rec.state = getFridgeState(0);
+  unsigned long reads = beer.getHealth().reads;  // what a replay of the record needs besides its values
+  rec.flags = min(reads - beerReads, 3UL);
+  beerReads = reads;
+  reads = fridge.getHealth().reads;
+  rec.flags |= min(reads - fridgeReads, 3UL) << 2;
+  fridgeReads = reads;
+  if (programState & MAIN_PID_MODE) rec.flags |= logMainAuto;
+  if (programState & HEAT_PID_MODE) rec.flags |= logHeatAuto;
+  LogFile.append(rec);
 }
 
 void dateTime(uint16_t* date, uint16_t* time) {
-  DateTime now = RTC.now();
+  DateTime now(wallClock.now());
   *date = FAT_DATE(now.year(), now.month(), now.day());
   *time = FAT_TIME(now.hour(), now.minute(), now.second());
 }
 
+const lcdLabel mainLabels[] PROGMEM = {  // page layouts: static text drawn under the values every frame
+  { 0, 0, "nPID 1.0" }, { 1, 1, "Tf=" }, { 1, 2, "Tb=" }, { 11, 1, "SP=" },
+};
+const lcdLabel mainPIDLabels[] PROGMEM = {
+  { 0, 0, "main PID" }, { 1, 1, "tP=" }, { 1, 2, "tD=" }, { 11, 1, "tI=" }, { 11, 2, "CO=" },
+};
+const lcdLabel heatPIDLabels[] PROGMEM = {
+  { 0, 0, "heat PID" }, { 1, 1, "tP=" }, { 1, 2, "tD=" }, { 11, 1, "tI=" }, { 11, 2, "CO=" },
+};
+const lcdLabel fridgeLabels[] PROGMEM = {
+  { 0, 0, " fridge " }, { 1, 2, "pE=" }, { 11, 2, "\x08t=" },  // delta glyph
+};
+struct displayPage {
+  const lcdLabel* labels;
+  byte count;
+};
+const lcdLabel taskLabels[] PROGMEM = {
+  { 0, 0, "tasks us" },  // worst execution time of each periodic task
+};
+const displayPage pageLayout[] = {
+  { mainLabels, sizeof(mainLabels) / sizeof(lcdLabel) },
+  { mainPIDLabels, sizeof(mainPIDLabels) / sizeof(lcdLabel) },
+  { heatPIDLabels, sizeof(heatPIDLabels) / sizeof(lcdLabel) },
+  { fridgeLabels, sizeof(fridgeLabels) / sizeof(lcdLabel) },
+  { taskLabels, sizeof(taskLabels) / sizeof(lcdLabel) },
+};
+
 void initDisplay() {
-  lcd.clear();
-  switch (encoderPos) {
-    default:
-    case 0:
-      lcd.print(F("nPID 1.0"));
-      lcd.setCursor(1, 1);
-      lcd.print(F("Tf="));
-      lcd.setCursor(1, 2);
-      lcd.print(F("Tb="));
-      lcd.setCursor(11, 1);
-      lcd.print(F("SP="));
-      lcd.setCursor(5, 3);
-      lcd.write((byte)2);
-      lcd.write((byte)4);
-      lcd.write((byte)4);
-      lcd.write((byte)3);
-      lcd.write((byte)4);
-      lcd.write((byte)4);
-      lcd.write((byte)3);
-      lcd.write((byte)4);
-      lcd.write((byte)4);
-      lcd.write((byte)3);
-      break;
-      
-    case 1:
-      lcd.print(F("main PID"));
-      lcd.setCursor(1, 1);
-      lcd.print(F("tP="));
-      lcd.setCursor(1, 2);
-      lcd.print(F("tD="));
-      lcd.setCursor(11, 1);
-      lcd.print(F("tI="));
-      lcd.setCursor(11, 2);
-      lcd.print(F("CO="));
-      lcd.setCursor(5, 3);
-      lcd.write((byte)3);
-      lcd.write((byte)4);
-      lcd.write((byte)4);
-      lcd.write((byte)2);
-      lcd.write((byte)4);
-      lcd.write((byte)4);
-      lcd.write((byte)3);
-      lcd.write((byte)4);
-      lcd.write((byte)4);
-      lcd.write((byte)3);
-      break;
+  sched.wake(displayTaskId);  // new page: draw it on this pass; unchanged cells (status line, scrollbar) are not resent
+}
 
-    case 2:
-      lcd.print(F("heat PID"));
-      lcd.setCursor(1, 1);
-      lcd.print(F("tP="));
-      lcd.setCursor(1, 2);
-      lcd.print(F("tD="));
-      lcd.setCursor(11, 1);
-      lcd.print(F("tI="));
-      lcd.setCursor(11, 2);
-      lcd.print(F("CO="));
-      lcd.setCursor(5, 3);
-      lcd.write((byte)3);
-      lcd.write((byte)4);
-      lcd.write((byte)4);
-      lcd.write((byte)3);
-      lcd.write((byte)4);
-      lcd.write((byte)4);
-      lcd.write((byte)2);
-      lcd.write((byte)4);
-      lcd.write((byte)4);
-      lcd.write((byte)3);
-      break;
-      
-    case 3:
-      lcd.print(F(" fridge "));
-      lcd.setCursor(1, 2);
-      lcd.print(F("pE="));
-      lcd.setCursor(11, 2);
-      lcd.write((byte)0);
-      lcd.print(F("t="));
-      lcd.setCursor(5, 3);
-      lcd.write((byte)3);
-      lcd.write((byte)4);
-      lcd.write((byte)4);
-      lcd.write((byte)3);
-      lcd.write((byte)4);
-      lcd.write((byte)4);
-      lcd.write((byte)3);
-      lcd.write((byte)4);
-      lcd.write((byte)4);
-      lcd.write((byte)2);
-      break;
+void drawTasks() {  // four periodic tasks at a time, alternating every 2 s
+  byte count = 0;
+  for (byte id = 0; id < sched.getSlots(); id++) if (sched.getTask(id)->period) count++;
+  byte group = (millis() / 2000) % ((count + 3) / 4);
+  byte shown = 0;
+  for (byte id = 0; id < sched.getSlots(); id++) {
+    const task* t = sched.getTask(id);
+    if (!t->period) continue;
+    if (shown / 4 == group) {
+      byte col = (shown % 2) * 10, row = 1 + (shown % 4) / 2;
+      screen.setCursor(col, row);
+      screen.print(t->name);
+      screen.setCursor(col + 4, row);
+      for (unsigned long d = 10000; (d > 1) && (t->stats.maxUs < d); d /= 10) screen.write(' ');
+      screen.print(t->stats.maxUs);
+    }
+    shown++;
   }
 }
 
 void updateDisplay() {
-  lcd.setCursor(9, 0);
-  if (programState & DISPLAY_UNIT) lcd.write((byte)7);
-    else lcd.write((byte)6);
-  if (programState & TEMP_PROFILE) lcd.print(F(" PGM "));
+  // runs every lcdFrameMs; values are redrawn into the frame buffer, only changes reach the LCD
+  byte page = ((byte)encoderPos < displayPages) ? encoderPos : 0;
+  screen.clear();
+  screen.labels(pageLayout[page].labels, pageLayout[page].count);
+  screen.setCursor(5, 3);  // scrollbar: a circle marks each page, the disc the current one
+  for (byte i = 0; i < 3 * displayPages - 2; i++) {
+    if (i == 3 * page) screen.write((byte)2);
+      else screen.write((i % 3) ? (byte)4 : (byte)3);
+  }
+  screen.setCursor(9, 0);
+  if (programState & DISPLAY_UNIT) screen.write((byte)7);
+    else screen.write((byte)6);
+  if (tuneLoop) screen.print(F(" TUN "));
+  else if (programState & TEMP_PROFILE) screen.print(F(" PGM "));
   else {
-    if (programState & MAIN_PID_MODE) lcd.print(F(" A "));
-      else lcd.print(F(" M "));
-    if (programState & HEAT_PID_MODE) lcd.print(F("A "));
-      else lcd.print(F("M "));
+    if (programState & MAIN_PID_MODE) screen.print(F(" A "));
+      else screen.print(F(" M "));
+    if (programState & HEAT_PID_MODE) screen.print(F("A "));
+      else screen.print(F("M "));
   }
-  if (getFridgeState(0) == IDLE) lcd.print(F("I "));
-  if (getFridgeState(0) == HEAT) lcd.print(F("H "));
-  if (getFridgeState(0) == COOL) lcd.print(F("C "));
-  if (programState & DATA_LOGGING) lcd.print(F("SD"));
-    else { lcd.write((byte)5); lcd.write((byte)5); }
+  if (chambers[0].getLost()) screen.print(F("! "));  // degraded: a control probe is lost
+  else if (getFridgeState(0) == IDLE) screen.print(F("I "));
+  else if (getFridgeState(0) == HEAT) screen.print(F("H "));
+  else if (getFridgeState(0) == COOL) screen.print(F("C "));
+  if (programState & DATA_LOGGING) screen.print(F("SD"));
+    else { screen.write((byte)5); screen.write((byte)5); }
   if (!encoderPos) {
-    DateTime time = RTC.now();
-    lcd.setCursor(11, 2);
-    lcd.print((time.hour() - (time.hour() % 10))/10);
-    lcd.print(time.hour() % 10);
-    lcd.print(F(":"));
-    lcd.print(time.minute()/10 % 6);
-    lcd.print(time.minute() % 10);
-    lcd.print(F(":"));
-    lcd.print(time.second()/10 % 6);
-    lcd.print(time.second() % 10);
+    DateTime time(wallClock.now());
+    screen.setCursor(11, 2);
+    screen.print((time.hour() - (time.hour() % 10))/10);
+    screen.print(time.hour() % 10);
+    screen.print(F(":"));
+    screen.print(time.minute()/10 % 6);
+    screen.print(time.minute() % 10);
+    screen.print(F(":"));
+    screen.print(time.second()/10 % 6);
+    screen.print(time.second() % 10);
   }
-  if (programState & DISPLAY_UNIT) {  // temperature units = deg F
+  if (page == taskPage) drawTasks();
+  else if (programState & DISPLAY_UNIT) {  // temperature units = deg F
     switch (encoderPos) {         // perform conversion for display
       default:
       case 0:
-        lcd.setCursor(4, 1);
-        lcd.print(probe::tempCtoF(fridge.getTemp()));
-        lcd.setCursor(4, 2);
-        lcd.print(probe::tempCtoF(beer.getTemp()));
-        lcd.setCursor(14, 1);
-        lcd.print(probe::tempCtoF(Setpoint));
+        screen.setCursor(4, 1);
+        screen.print(probe::tempCtoF(fridge.getTemp()));
+        screen.setCursor(4, 2);
+        screen.print(probe::tempCtoF(beer.getTemp()));
+        screen.setCursor(14, 1);
+        screen.print(probe::tempCtoF(Setpoint));
         break;
 
       case 1:
-        lcd.setCursor(4, 1);
-        lcd.print(mainPID.GetPTerm()*9/5);
-        lcd.setCursor(4, 2);
-        lcd.print(mainPID.GetDTerm()*9/5);
-        lcd.setCursor(14, 1);
-        lcd.print(mainPID.GetITerm()*9/5);
-        lcd.setCursor(14, 2);
-        lcd.print(probe::tempCtoF(Output));
+        screen.setCursor(4, 1);
+        screen.print(mainPID.GetPTerm()*9/5);
+        screen.setCursor(4, 2);
+        screen.print(mainPID.GetDTerm()*9/5);
+        screen.setCursor(14, 1);
+        screen.print(mainPID.GetITerm()*9/5);
+        screen.setCursor(14, 2);
+        screen.print(probe::tempCtoF(Output));
         break;
 
       case 2:
-        lcd.setCursor(4, 1);
-        lcd.print(heatPID.GetPTerm()/heatWindow);
-        lcd.print('%');
-        lcd.setCursor(4, 2);
-        lcd.print(heatPID.GetDTerm()/heatWindow);
-        lcd.print('%');
-        lcd.setCursor(14, 1);
-        lcd.print(heatPID.GetITerm()/heatWindow);
-        lcd.print('%');
-        lcd.setCursor(14, 2);
-        lcd.print((double)(heatOutput/heatWindow));
-        lcd.print('%');
+        screen.setCursor(4, 1);
+        screen.print(heatPID.GetPTerm()/heatWindow);
+        screen.print('%');
+        screen.setCursor(4, 2);
+        screen.print(heatPID.GetDTerm()/heatWindow);
+        screen.print('%');
+        screen.setCursor(14, 1);
+        screen.print(heatPID.GetITerm()/heatWindow);
+        screen.print('%');
+        screen.setCursor(14, 2);
+        screen.print((double)(heatOutput/heatWindow));
+        screen.print('%');
         break;
 
       case 3:
         double elapsed = 0;
-        lcd.setCursor(0, 1);
+        screen.setCursor(0, 1);
         switch (getFridgeState(0)) {
           case IDLE:
-            if (getFridgeState(1) == COOL) lcd.print(F("    wait on peak    "));
-              else lcd.print(F("       idling       "));
-            elapsed = (double)(millis() - getStopTime()) / 60000;   // time since IDLE start in min
+            if (getFridgeState(1) == COOL) screen.print(F("    wait on peak    "));
+              else screen.print(F("       idling       "));
+            elapsed = (double)(uint32_t)(millis() - getStopTime()) / 60000;   // time since IDLE start in min
             break;
 
           case COOL:
-            lcd.print(F("       cooling      "));
-            elapsed = (double)(millis() - getStartTime()) / 60000;  // time since COOL start in min
+            screen.print(F("       cooling      "));
+            elapsed = (double)(uint32_t)(millis() - getStartTime()) / 60000;  // time since COOL start in min
             break;
 
           case HEAT:
-            elapsed = millis() - getStartTime();  // time since HEAT window start in ms
-            if (elapsed < heatOutput) lcd.print(F("      heating      "));
-              else lcd.print(F("    idle on heat    "));
+            elapsed = (uint32_t)(millis() - getStartTime());  // time since HEAT window start in ms
+            if (elapsed < heatOutput) screen.print(F("      heating      "));
+              else screen.print(F("    idle on heat    "));
             elapsed /= 60000;  // convert ms to min
             break;
         }
-        lcd.setCursor(4, 2);
-        lcd.print(getPeakEstimator());
-        lcd.setCursor(14, 2);
-        lcd.print(elapsed);
+        screen.setCursor(4, 2);
+        screen.print(getPeakEstimator());
+        screen.setCursor(14, 2);
+        screen.print(elapsed);
         break;
     }
   }
@@ -431,91 +630,198 @@ void updateDisplay() {
     switch (encoderPos) {  // no conversion needed
       default:
       case 0:
-        lcd.setCursor(4, 1);
-        lcd.print(fridge.getTemp());
-        lcd.setCursor(4, 2);
-        lcd.print(beer.getTemp());
-        lcd.setCursor(14, 1);
-        lcd.print(Setpoint);
+        screen.setCursor(4, 1);
+        screen.print(fridge.getTemp());
+        screen.setCursor(4, 2);
+        screen.print(beer.getTemp());
+        screen.setCursor(14, 1);
+        screen.print(Setpoint);
         break;
 
       case 1:
-        lcd.setCursor(4, 1);
-        lcd.print(mainPID.GetPTerm());
-        lcd.setCursor(4, 2);
-        lcd.print(mainPID.GetDTerm());
-        lcd.setCursor(14, 1);
-        lcd.print(mainPID.GetITerm());
-        lcd.setCursor(14, 2);
-        lcd.print(Output);
+        screen.setCursor(4, 1);
+        screen.print(mainPID.GetPTerm());
+        screen.setCursor(4, 2);
+        screen.print(mainPID.GetDTerm());
+        screen.setCursor(14, 1);
+        screen.print(mainPID.GetITerm());
+        screen.setCursor(14, 2);
+        screen.print(Output);
         break;
 
       case 2:
-        lcd.setCursor(4, 1);
-        lcd.print(heatPID.GetPTerm()/heatWindow);
-        lcd.print('%');
-        lcd.setCursor(4, 2);
-        lcd.print(heatPID.GetDTerm()/heatWindow);
-        lcd.print('%');
-        lcd.setCursor(14, 1);
-        lcd.print(heatPID.GetITerm()/heatWindow);
-        lcd.print('%');
-        lcd.setCursor(14, 2);
-        lcd.print((unsigned int)heatOutput/heatWindow);
-        lcd.print('%');
+        screen.setCursor(4, 1);
+        screen.print(heatPID.GetPTerm()/heatWindow);
+        screen.print('%');
+        screen.setCursor(4, 2);
+        screen.print(heatPID.GetDTerm()/heatWindow);
+        screen.print('%');
+        screen.setCursor(14, 1);
+        screen.print(heatPID.GetITerm()/heatWindow);
+        screen.print('%');
+        screen.setCursor(14, 2);
+        screen.print((unsigned int)heatOutput/heatWindow);
+        screen.print('%');
         break;
         
       case 3:
         double elapsed = 0;
-        lcd.setCursor(0, 1);
+        screen.setCursor(0, 1);
         switch (getFridgeState(0)) {
           case IDLE:
-            if (getFridgeState(1) == COOL) lcd.print(F("    wait on peak    "));
-              else lcd.print(F("       idling       "));
-            elapsed = (double)(millis() - getStopTime()) / 60000;   // time since IDLE start in min
+            if (getFridgeState(1) == COOL) screen.print(F("    wait on peak    "));
+              else screen.print(F("       idling       "));
+            elapsed = (double)(uint32_t)(millis() - getStopTime()) / 60000;   // time since IDLE start in min
             break;
 
           case COOL:
-            lcd.print(F("       cooling      "));
-            elapsed = (double)(millis() - getStartTime()) / 60000;  // time since COOL start in min
+            screen.print(F("       cooling      "));
+            elapsed = (double)(uint32_t)(millis() - getStartTime()) / 60000;  // time since COOL start in min
             break;
 
           case HEAT:
-            elapsed = millis() - getStartTime();  // time since HEAT window start in ms
-            if (elapsed < heatOutput) lcd.print(F("      heating      "));
-              else lcd.print(F("    idle on heat    "));
+            elapsed = (uint32_t)(millis() - getStartTime());  // time since HEAT window start in ms
+            if (elapsed < heatOutput) screen.print(F("      heating      "));
+              else screen.print(F("    idle on heat    "));
             elapsed /= 60000;  // convert ms to min
             break;
         }
-        lcd.setCursor(4, 2);
-        lcd.print(getPeakEstimator());
-        lcd.setCursor(14, 2);
-        lcd.print(elapsed);
+        screen.setCursor(4, 2);
+        screen.print(getPeakEstimator());
+        screen.setCursor(14, 2);
+        screen.print(elapsed);
         break;
     }
   }
-}
-
-void menu() {
   #if DEBUG == true
-    Serial.print(F("control suspended, entering menu... "));
-    Serial.print(freeRAM());
-    Serial.println(F(" bytes free SRAM remaining"));
+    unsigned int sent = screen.flush();
+    if (sent) {
+      Serial.print(F("lcd frame: "));
+      Serial.print(sent);
+      Serial.println(F(" bytes pushed"));
+    }
+  #else
+    screen.flush();
   #endif
+}
 
-  static char menu_list [8][21] = {"Main PID: Mode", "Main PID: SP", "Heat PID: Mode", "[SD] Logging", "[SD] Profiles", "Display Units", "Restore & Reset", "BACK"};
-  boolean exit = false;
-  encoderPos = 0;
-  do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));  // wait for user to let go of button; continue to poll wdt with reset pulse
-  
-  do {  // main menu loop; display current menu option
-    wdt_reset();
-    mainUpdate();
-    static char lastReportedPos = 1;
-    static char listSize = 8;
-    encoderState |= DEBOUNCE;
-    if (lastReportedPos != encoderPos) {
-      encoderPos = (encoderPos + listSize) % listSize;
+void mainPages(byte event) {  // main display: the encoder selects the page, a push opens the menu
+  if (event == UI_TURN) initDisplay();
+    else if (event == UI_PUSH) uiOpen(menu);
+}
+
+void uiOpen(uiHandler handler) {  // make handler the active screen
+  uiActive = handler;
+  uiStep = 0;
+  handler(UI_ENTER);
+}
+
+void uiList(char size, char pos) {  // encoder range and start position of the screen; drawn by the next UI_TURN
+  uiListSize = size;
+  encoderPos = pos;
+  uiLastPos = pos + 1;
+}
+
+void uiReturn() {  // back to the menu list, on the item that was opened
+  uiActive = menu;
+  menu(UI_RESUME);
+}
+
+void uiBack() {  // long press: an option screen returns to the menu unchanged, the menu to the main display
+  if ((uiActive == mainPages) || (uiActive == uiWait)) return;
+  if (uiActive == menu) {
+    menuLeave();
+    return;
+  }
+  lcd.noCursor();
+  uiActive(UI_CANCEL);  // release what the screen holds
+  uiReturn();
+}
+
+void uiMessage(const __FlashStringHelper* text) {  // show text on the option line for 1.5 s, then return to the menu
+  lcd.setCursor(0, 2);
+  lcd.print(text);
+  uiActive = uiWait;
+  sched.once(1500, uiReturn, TASK_DISPLAY);
+}
+
+void uiWait(byte event) {}  // input is ignored while a message shows
+
+void uiOption() {  // clear the option line and point at it
+  lcd.setCursor(0, 2);
+  lcd.print(F("                    "));
+  lcd.setCursor(2, 2);
+  lcd.write((byte)1);
+}
+
+void uiEdit(double* target, const __FlashStringHelper* name, boolean limit, byte manual) {  // enter a value: integer part, then tenths
+  uiEditing.target = target;
+  uiEditing.name = name;
+  uiEditing.limit = limit;
+  uiEditing.manual = manual;
+  uiEditing.value = *target;  // edited as a copy; control keeps using the old value meanwhile
+  if (programState & DISPLAY_UNIT) uiEditing.value = probe::tempCtoF(uiEditing.value);  // if display unit = deg F, convert
+  uiActive = editValue;
+  uiStep = 0;
+  uiList(100, int(uiEditing.value));
+}
+
+void editValue(byte event) {
+  double& value = uiEditing.value;
+  if (event == UI_TURN) {
+    lcd.setCursor(3, 2);
+    if (uiStep == 0) lcd.print(encoderPos + value - int(value));  // coarse-grained ajustment (integers)
+      else lcd.print(value + double(encoderPos)/10);             // fine-grained ajustment (tenths)
+    if (programState & DISPLAY_UNIT) lcd.print(F(" \337F"));
+      else lcd.print(F(" \337C"));
+    lcd.setCursor(uiStep ? 6 : 4, 2);
+    lcd.cursor();
+  }
+  else if (event == UI_PUSH) {
+    lcd.noCursor();
+    if (uiStep == 0) {
+      value = encoderPos + value - int(value);
+      uiStep = 1;
+      uiList(10, (value - int(value)) * 10);
+      value = int(value);
+      return;
+    }
+    value = value + double(encoderPos)/10;
+    if (programState & DISPLAY_UNIT) value = probe::tempFtoC(value);  // if display is in deg F, convert user entry back to native deg C
+    if (uiEditing.limit) value = constrain(value, 0.3, 38);  // constrain main PID Output to allowed range 0.3 - 38 deg C (~32.5 - ~100 deg F)
+    programState &= ~uiEditing.manual;
+    *uiEditing.target = value;
+
+    #if DEBUG == true
+      Serial.print(uiEditing.name);
+      Serial.print(F(" set to:"));
+      Serial.print(value);
+      Serial.print(F(" "));
+      Serial.print(freeRAM());
+      Serial.println(F(" bytes free SRAM remaining"));
+    #endif
+    uiReturn();
+  }
+}
+
+void menu(byte event) {  // main menu list; control, relays and logging keep running in their own tasks
+  static char menu_list [10][21] = {"Main PID: Mode", "Main PID: SP", "Heat PID: Mode", "Cool: Predictor", "PID: Autotune", "[SD] Logging", "[SD] Profiles", "Display Units", "Restore & Reset", "BACK"};
+  static const uiHandler menu_items[9] = {mainPIDmode, mainPIDsp, heatPIDmode, coolMode, autoTune, dataLog, tempProfile, tempUnit, avrReset};
+  const char listSize = 10;
+  switch (event) {
+    case UI_ENTER:
+      #if DEBUG == true
+        Serial.print(F("entering menu... "));
+        Serial.print(freeRAM());
+        Serial.println(F(" bytes free SRAM remaining"));
+      #endif
+      LogFile.pause();  // end the log's multi-block write; profiles and backOut() use the card
+      uiItem = 0;
+    case UI_RESUME:  // display current menu option
+      uiList(listSize, uiItem);
+      break;
+
+    case UI_TURN:
       lcd.clear();
       lcd.setCursor(1, 0);
       lcd.print(menu_list[(encoderPos - 1 + listSize) % listSize]);
@@ -526,561 +832,452 @@ void menu() {
       lcd.print(menu_list[(encoderPos + 1 + listSize) % listSize]);
       lcd.setCursor(1, 3);
       lcd.print(menu_list[(encoderPos + 2 + listSize) % listSize]);
-      lastReportedPos = encoderPos;
-    }
-    if (!digitalRead(pushButton)) {
-      switch (encoderPos) {  // main menu switch; run subroutine for current menu option on rotary encoder push
-
-        case 0:  // main PID operation -- manual / automatic
-          do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));
-          mainPIDmode();
-          encoderPos = 0;  // return encoder position to current option on the menu
-          break;
-
-        case 1:  // main PID Setpoint
-          do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));
-          mainPIDsp();
-          encoderPos = 1;
-          break;
-
-        case 2:  // heat PID operation -- manual / automatic
-          do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));
-          heatPIDmode();
-          encoderPos = 2;
-          break;
-          
-        case 3:  // data logging operations
-          do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));
-          dataLog();
-          encoderPos = 3;
-          break;
-
-        case 4:  // fermentation temperature profiles
-          do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));
-          tempProfile(); 
-          encoderPos = 4;
-          break;
-
-        case 5:  // temperature units C/F
-          do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));
-          tempUnit();          
-          encoderPos = 5;
-          break;
-        
-        case 6:  // reset all settings to defaults and reboot arduino
-          do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));
-          avrReset();
-          encoderPos = 6;
-          break;
-          
-        case 7:  // backOut of the menu and save settings; do file operations if needed
-          backOut();
-          exit = true;  // exit the menu loop
-          break;
+      break;
+
+    case UI_PUSH:  // run subroutine for current menu option on rotary encoder push
+      uiItem = encoderPos;
+      if (uiItem < listSize - 1) {
+        uiOpen(menu_items[(byte)uiItem]);
+        break;
       }
-      do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));
-      lastReportedPos += 1;  // force re-draw of menu list
-    }
-  } while (!exit);
-  encoderPos = 0;  // zero encoder position for main display
-  initDisplay();   // re-initialize main display
+      menuLeave();
+      break;
+  }
 }
 
-void mainPIDmode() {
-  if (programState & TEMP_PROFILE) {
-    lcd.setCursor(0, 2);
-    lcd.print(F(" PROFILE IS RUNNING "));
-    unsigned long start = millis();
-    do { wdt_reset(); mainUpdate(); } while (millis() <= (unsigned long)(start + 1500));  // wait for 1.5 seconds without hard delay
-    return;
-  }
-  char listSize = 2;
-  encoderPos = (programState & MAIN_PID_MODE) >> 5;
-  char lastReportedPos = encoderPos + 1;
-  lcd.setCursor(0, 2);
-  lcd.print(F("                    "));
-  lcd.setCursor(2, 2);
-  lcd.write((byte)1);
-  do {
-    wdt_reset();
-    mainUpdate();
-    encoderState |= DEBOUNCE;
-    if (lastReportedPos != encoderPos) {
-      encoderPos = (encoderPos + listSize) % listSize;
-      lcd.setCursor(3, 2);
-      if (encoderPos) lcd.print(F("Automatic"));
-        else lcd.print(F("Manual   "));
-      lastReportedPos = encoderPos;
-    }
-  } while (digitalRead(pushButton));
-          
-  #if DEBUG == true
-    if (encoderPos) Serial.print(F("main PID set to automatic. "));
-    else Serial.print(F("main PID set to manual. "));
-    Serial.print(freeRAM());
-    Serial.println(F(" bytes free SRAM remaining"));
-  #endif
+void menuLeave() {
+  backOut();  // backOut of the menu and save settings; do file operations if needed
+  uiActive = mainPages;
+  uiList(displayPages, 0);  // zero encoder position for main display
+  screen.invalidate();      // the menu drew on the LCD directly
+}
 
-  if (encoderPos) {programState |= MAIN_PID_MODE;}  // set main PID to automatic mode
-  else {  // set main PID to manual mode; user entry of main Output for manual only
-    programState &= ~MAIN_PID_MODE;
-    do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));
-    char listSize = 100;
-    if (programState & DISPLAY_UNIT) Output = probe::tempCtoF(Output);  // if display unit = deg F, convert Output
-    encoderPos = int(Output);
-    char lastReportedPos = encoderPos + 1;
+void mainPIDmode(byte event) {  // main PID manual/automatic; manual asks for the Output
+  if (event == UI_ENTER) {
+    if (programState & TEMP_PROFILE) {
+      uiMessage(F(" PROFILE IS RUNNING "));
+      return;
+    }
+    if (tuneLoop) {
+      uiMessage(F(" TUNING IS RUNNING  "));
+      return;
+    }
+    uiOption();
+    uiList(2, (programState & MAIN_PID_MODE) >> 5);
+  }
+  else if (event == UI_TURN) {
     lcd.setCursor(3, 2);
+    if (encoderPos) lcd.print(F("Automatic"));
+      else lcd.print(F("Manual   "));
+  }
+  else if (event == UI_PUSH) {
+    #if DEBUG == true
+      if (encoderPos) Serial.print(F("main PID set to automatic. "));
+      else Serial.print(F("main PID set to manual. "));
+      Serial.print(freeRAM());
+      Serial.println(F(" bytes free SRAM remaining"));
+    #endif
+
+    if (encoderPos) {  // set main PID to automatic mode
+      programState |= MAIN_PID_MODE;
+      uiReturn();
+      return;
+    }
+    lcd.setCursor(3, 2);  // main PID goes to manual mode once the main Output is entered
     lcd.print(F("                 "));
-    do {  // coarse-grained ajustment (integers)
-      wdt_reset();
-      mainUpdate();
-      encoderState |= DEBOUNCE;
-      if (lastReportedPos != encoderPos) {
-        encoderPos = (encoderPos + listSize) % listSize;
-        lcd.setCursor(3, 2);
-        lcd.print(encoderPos + Output - int(Output));
-        if (programState & DISPLAY_UNIT) lcd.print(F(" \337F"));
-          else lcd.print(F(" \337C"));
-        lastReportedPos = encoderPos;
-      }
-      lcd.setCursor(4, 2);
-      lcd.cursor();
-    } while (digitalRead(pushButton));
-    lcd.noCursor();
-    Output = encoderPos + Output - int(Output);
-    encoderPos = (Output - int(Output)) * 10;
-    lastReportedPos = encoderPos + 1;
-    Output = int(Output);
-    listSize = 10;
-    do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));
-    do {  // fine-grained ajustment (tenths)
-      wdt_reset();
-      mainUpdate();
-      encoderState |= DEBOUNCE;
-      if (lastReportedPos != encoderPos) {
-        encoderPos = (encoderPos + listSize) % listSize;
-        lcd.setCursor(3, 2);
-        lcd.print(Output + double(encoderPos)/10);
-        if (programState & DISPLAY_UNIT) lcd.print(F(" \337F"));
-          else lcd.print(F(" \337C"));
-        lastReportedPos = encoderPos;
-      }
-      lcd.setCursor(6, 2);
-      lcd.cursor();
-    } while (digitalRead(pushButton));
-    lcd.noCursor();
-    Output = Output + double(encoderPos)/10; 
-    if (programState & DISPLAY_UNIT) Output = probe::tempFtoC(Output);  // if display is in deg F, convert user entry back to native deg C
-    Output = constrain(Output, 0.3, 38);  // constrain main PID Output to allowed range 0.3 - 38 deg C (~32.5 - ~100 deg F)
+    uiEdit(&Output, F("main PID Output"), true, MAIN_PID_MODE);
   }
-            
-  #if DEBUG == true
-    Serial.print(F("main PID Output set to:"));
-    Serial.print(Output);
-    Serial.print(F(" "));
-    Serial.print(freeRAM());
-    Serial.println(F(" bytes free SRAM remaining"));
-  #endif
 }
 
-void mainPIDsp() {
+void mainPIDsp(byte event) {  // main PID setpoint
+  if (event != UI_ENTER) return;
   if (programState & TEMP_PROFILE) {
-    lcd.setCursor(0, 2);
-    lcd.print(F(" PROFILE IS RUNNING "));
-    unsigned long start = millis();
-    do { wdt_reset(); mainUpdate(); } while (millis() <= (unsigned long)(start + 1500));
+    uiMessage(F(" PROFILE IS RUNNING "));
     return;
   }
-  lcd.setCursor(0, 2);
-  lcd.print(F("                    "));
-  lcd.setCursor(2, 2);
-  lcd.write((byte)1);
-  char listSize = 100;
-  if (programState & DISPLAY_UNIT) Setpoint = probe::tempCtoF(Setpoint);
-  encoderPos = int(Setpoint);
-  char lastReportedPos = encoderPos + 1;
-  do {  // coarse-grained ajustment (integers)
-    wdt_reset();
-    mainUpdate();
-    encoderState |= DEBOUNCE;
-    if (lastReportedPos != encoderPos) {
-      encoderPos = (encoderPos + listSize) % listSize;
-      lcd.setCursor(3, 2);
-      lcd.print(encoderPos + Setpoint - int(Setpoint));
-      if (programState & DISPLAY_UNIT) lcd.print(F(" \337F"));
-        else lcd.print(F(" \337C"));
-      lastReportedPos = encoderPos;
+  uiOption();
+  uiEdit(&Setpoint, F("main PID Setpoint"), false, 0);
+}
+
+void heatPIDmode(byte event) {  // heat PID manual/automatic; manual asks for the heat setpoint
+  if (event == UI_ENTER) {
+    if (programState & TEMP_PROFILE) {
+      uiMessage(F(" PROFILE IS RUNNING "));
+      return;
     }
-    lcd.setCursor(4, 2);
-    lcd.cursor();
-  } while (digitalRead(pushButton));
-  lcd.noCursor();
-  Setpoint = encoderPos + Setpoint - int(Setpoint);
-
-  encoderPos = (Setpoint - int(Setpoint)) * 10;
-  lastReportedPos = encoderPos + 1;
-  Setpoint = int(Setpoint);
-  listSize = 10;
-  do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));
-  do {  // fine-grained ajustment (tenths)
-    wdt_reset();
-    mainUpdate();
-    encoderState |= DEBOUNCE;
-    if (lastReportedPos != encoderPos) {
-      encoderPos = (encoderPos + listSize) % listSize;
-      lcd.setCursor(3, 2);
-      lcd.print(Setpoint + double(encoderPos)/10);
-      if (programState & DISPLAY_UNIT) lcd.print(F(" \337F"));
-        else lcd.print(F(" \337C"));
-      lastReportedPos = encoderPos;
+    if (tuneLoop) {
+      uiMessage(F(" TUNING IS RUNNING  "));
+      return;
     }
-    lcd.setCursor(6, 2);
-    lcd.cursor();
-  } while (digitalRead(pushButton));
-  lcd.noCursor();
-  Setpoint = Setpoint + double(encoderPos)/10;
-  if (programState & DISPLAY_UNIT) Setpoint = probe::tempFtoC(Setpoint);
+    uiOption();
+    uiList(2, (programState & HEAT_PID_MODE) >> 4);
+  }
+  else if (event == UI_TURN) {
+    lcd.setCursor(3, 2);
+    if (encoderPos) lcd.print(F("Automatic"));
+      else lcd.print(F("Manual   "));
+  }
+  else if (event == UI_PUSH) {
+    #if DEBUG == true
+      if (encoderPos) Serial.print(F("heat PID set to Automatic. "));
+        else Serial.print(F("heat PID set to Manual. "));
+      Serial.print(freeRAM());
+      Serial.println(F(" bytes free SRAM remaining"));
+    #endif
 
-  #if DEBUG == true
-    Serial.print(F("main PID Setpoint set to:"));
-    Serial.print(Setpoint);
-    Serial.print(F(" "));
-    Serial.print(freeRAM());
-    Serial.println(F(" bytes free SRAM remaining"));
-  #endif
+    if (encoderPos) {  // set heat PID to automatic mode
+      programState |= HEAT_PID_MODE;
+      uiReturn();
+      return;
+    }
+    lcd.setCursor(3, 2);  // heat PID goes to manual mode once the heat setpoint is entered
+    lcd.print(F("                 "));
+    uiEdit(&heatSetpoint, F("heat PID Setpoint"), false, HEAT_PID_MODE);
+  }
 }
 
-void heatPIDmode() {
-  if (programState & TEMP_PROFILE) {
-    lcd.setCursor(0, 2);
-    lcd.print(F(" PROFILE IS RUNNING "));
-    unsigned long start = millis();
-    do { wdt_reset(); mainUpdate(); } while (millis() <= (unsigned long)(start + 1500));
-    return;
+void dataLog(byte event) {  // data logging enabled/disabled; file operations happen in backOut()
+  if (event == UI_ENTER) {
+    uiOption();
+    uiList(2, (programState & DATA_LOGGING) >> 1);
   }
-  char listSize = 2;
-  encoderPos = (programState & HEAT_PID_MODE) >> 4;
-  char lastReportedPos = encoderPos + 1;
-  lcd.setCursor(0, 2);
-  lcd.print(F("                    "));
-  lcd.setCursor(2, 2);
-  lcd.write((byte)1);
-  do {
-    wdt_reset();
-    mainUpdate();
-    encoderState |= DEBOUNCE;
-    if (lastReportedPos != encoderPos) {
-      encoderPos = (encoderPos + listSize) % listSize;
-      lcd.setCursor(3, 2);
-      if (encoderPos) lcd.print(F("Automatic"));
-        else lcd.print(F("Manual   "));
-      lastReportedPos = encoderPos;
-    }
-  } while (digitalRead(pushButton));
-
-  #if DEBUG == true
-    if (encoderPos) Serial.print(F("heat PID set to Automatic. "));
-      else Serial.print(F("heat PID set to Manual. "));
-    Serial.print(freeRAM());
-    Serial.println(F(" bytes free SRAM remaining"));
-  #endif
-
-  if (encoderPos) programState |= HEAT_PID_MODE;  // set heat PID to automatic mode
-  else {  // set heat PID to manual mode; user entry of heat Output for manual only
-    programState &= ~HEAT_PID_MODE;
-    do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));
-    char listSize = 100;
-    if (programState & DISPLAY_UNIT) heatSetpoint = probe::tempCtoF(heatSetpoint);
-    encoderPos = int(heatSetpoint);
-    char lastReportedPos = encoderPos + 1;
+  else if (event == UI_TURN) {
     lcd.setCursor(3, 2);
-    lcd.print(F("                 "));
-    do {  // coarse-grained ajustment (integers)
-      wdt_reset();
-      mainUpdate();
-      encoderState |= DEBOUNCE;
-      if (lastReportedPos != encoderPos) {
-        encoderPos = (encoderPos + listSize) % listSize;
-        lcd.setCursor(3, 2);
-        lcd.print(encoderPos + heatSetpoint - int(heatSetpoint));
-        if (programState & DISPLAY_UNIT) lcd.print(F(" \337F"));
-          else lcd.print(F(" \337C"));
-        lastReportedPos = encoderPos;
+    if (encoderPos) lcd.print(F("Enabled "));
+      else lcd.print(F("Disabled"));
+  }
+  else if (event == UI_PUSH) {
+    if (encoderPos) {
+      if (!(programState & (DATA_LOGGING + FILE_OPS))) {
+        #if DEBUG == true
+          Serial.print(F("New logfile pending... "));
+          Serial.print(freeRAM());
+          Serial.println(F(" bytes free SRAM remaining"));
+        #endif
+
+        programState += DATA_LOGGING + FILE_OPS;  // start new LogFile on menu exit
       }
-      lcd.setCursor(4, 2);
-      lcd.cursor();
-    } while (digitalRead(pushButton));
-    lcd.noCursor();
-    heatSetpoint = encoderPos + heatSetpoint - int(heatSetpoint);
-
-    encoderPos = (heatSetpoint - int(heatSetpoint)) * 10;
-    lastReportedPos = encoderPos + 1;
-    heatSetpoint = int(heatSetpoint);
-    listSize = 10;
-    do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));
-    do {  // fine-grained ajustment (tenths)
-      wdt_reset();
-      mainUpdate();
-      encoderState |= DEBOUNCE;
-      if (lastReportedPos != encoderPos) {
-        encoderPos = (encoderPos + listSize) % listSize;
-        lcd.setCursor(3, 2);
-        lcd.print(heatSetpoint + double(encoderPos)/10);
-        if (programState & DISPLAY_UNIT) lcd.print(F(" \337F"));
-          else lcd.print(F(" \337C"));
-        lastReportedPos = encoderPos;
+      else if ((programState & (DATA_LOGGING + FILE_OPS)) == FILE_OPS) {
+        #if DEBUG == true
+          Serial.print(F("Pending close operation canceled... "));
+          Serial.print(freeRAM());
+          Serial.println(F(" bytes free SRAM remaining"));
+        #endif
+
+        programState = programState & ~(DATA_LOGGING + FILE_OPS) + DATA_LOGGING;  // cancel pending file close and leave log running
       }
-      lcd.setCursor(6, 2);
-      lcd.cursor();
-    } while (digitalRead(pushButton));
-    lcd.noCursor();
-    heatSetpoint = heatSetpoint + double(encoderPos)/10; 
-    if (programState & DISPLAY_UNIT) heatSetpoint = probe::tempFtoC(heatSetpoint);
+    }
+    else {
+      if ((programState & (DATA_LOGGING + FILE_OPS)) == DATA_LOGGING) {
+        #if DEBUG == true
+          Serial.print(F("Logfile close pending... "));
+          Serial.print(freeRAM());
+          Serial.println(F(" bytes free SRAM remaining"));
+        #endif
+
+        programState = (programState & ~(DATA_LOGGING + FILE_OPS)) + FILE_OPS;  // close current LogFile on menu exit
+      }
+      else if ((programState & (DATA_LOGGING + FILE_OPS)) == DATA_LOGGING + FILE_OPS) {
+        #if DEBUG == true
+          Serial.print(F("Pending new operation canceled... "));
+          Serial.print(freeRAM());
+          Serial.println(F(" bytes free SRAM remaining"));
+        #endif
+
+        programState &= ~(DATA_LOGGING + FILE_OPS);  // cancel pending file opening
+      }
+    }
+    uiReturn();
   }
-
-  #if DEBUG == true
-    Serial.print(F("heat PID Setpoint set to:"));
-    Serial.print(heatSetpoint);
-    Serial.print(F(" "));
-    Serial.print(freeRAM());
-    Serial.println(F(" bytes free SRAM remaining"));
-  #endif
 }
 
-void dataLog() {
-  char listSize = 2;
-  encoderPos = (programState & DATA_LOGGING) >> 1;
-  char lastReportedPos = encoderPos + 1;
-  lcd.setCursor(0, 2);
-  lcd.print(F("                    "));
-  lcd.setCursor(2, 2);
-  lcd.write((byte)1);
-  do {
-    wdt_reset();
-    mainUpdate();
-    encoderState |= DEBOUNCE;
-    if (lastReportedPos != encoderPos) {
-      encoderPos = (encoderPos + listSize) % listSize;
-      lcd.setCursor(3, 2);
-      if (encoderPos) lcd.print(F("Enabled "));
-        else lcd.print(F("Disabled"));
-      lastReportedPos = encoderPos;
+void tempProfile(byte event) {  // manage SP profiles: stop the running one, or pick a file from /PROFILES/
+  static File root;
+  if (programState & TEMP_PROFILE) {  // if profile already running
+    if (event == UI_ENTER) {
+      lcd.setCursor(0, 2);
+      lcd.print(F(" STOP PROFILE?      "));
+      lcd.setCursor(15, 2);
+      lcd.write((byte)1);
+      uiList(2, 0);
     }
-  } while (digitalRead(pushButton));
-  if (encoderPos) {
-    if (!(programState & (DATA_LOGGING + FILE_OPS))) {
-      #if DEBUG == true
-        Serial.print(F("New logfile pending... "));
-        Serial.print(freeRAM());
-        Serial.println(F(" bytes free SRAM remaining"));
-      #endif
-
-      programState += DATA_LOGGING + FILE_OPS;  // start new LogFile on menu exit
+    else if (event == UI_TURN) {
+      lcd.setCursor(16, 2);
+      if (encoderPos) lcd.print(F("YES"));
+        else lcd.print(F("NO "));
     }
-    else if ((programState & (DATA_LOGGING + FILE_OPS)) == FILE_OPS) {
-      #if DEBUG == true
-        Serial.print(F("Pending close operation canceled... "));
-        Serial.print(freeRAM());
-        Serial.println(F(" bytes free SRAM remaining"));
-      #endif
-                
-      programState = programState & ~(DATA_LOGGING + FILE_OPS) + DATA_LOGGING;  // cancel pending file close and leave log running
+    else if (event == UI_PUSH) {
+      if (encoderPos) {  // empty profile table, reset program flag and return to main menu
+        programState &= ~TEMP_PROFILE;
+        profile.clear();
+      }
+      uiReturn();
     }
+    return;
   }
-  else {
-    if ((programState & (DATA_LOGGING + FILE_OPS)) == DATA_LOGGING) {
-      #if DEBUG == true
-        Serial.print(F("Logfile close pending... "));
-        Serial.print(freeRAM());
-        Serial.println(F(" bytes free SRAM remaining"));
-      #endif
-              
-      programState = (programState & ~(DATA_LOGGING + FILE_OPS)) + FILE_OPS;  // close current LogFile on menu exit
+  if (event == UI_ENTER) {
+    if (tuneLoop) {
+      uiMessage(F(" TUNING IS RUNNING  "));
+      return;
     }
-    else if ((programState & (DATA_LOGGING + FILE_OPS)) == DATA_LOGGING + FILE_OPS) {
-      #if DEBUG == true
-        Serial.print(F("Pending new operation canceled... "));
-        Serial.print(freeRAM());
-        Serial.println(F(" bytes free SRAM remaining"));
-      #endif
-
-      programState &= ~(DATA_LOGGING + FILE_OPS);  // cancel pending file opening
+    root = SD.open("/PROFILES/", FILE_READ);  //  open root to profile directory
+    if (!root) {  // profile directory does not exist
+      uiMessage(F(" /PROFILES/ MISSING "));
+      return;
     }
-  }
-}
-
-void tempProfile() {              // manage SP profiles
-  if (programState & TEMP_PROFILE) {  // if profile already running
-    char listSize = 2;
-    encoderPos = 0;
-    char lastReportedPos = 1;
     lcd.setCursor(0, 2);
-    lcd.print(F(" STOP PROFILE?      "));
-    lcd.setCursor(15, 2);
-    lcd.write((byte)1);
+    lcd.print(F("                    "));
+    uiList(100, 0);  // every encoder step moves to the next file
+  }
+  else if (event == UI_TURN) {
     do {
-      wdt_reset();
-      mainUpdate();
-      encoderState |= DEBOUNCE;
-      if (lastReportedPos != encoderPos) {
-        encoderPos = (encoderPos + listSize) % listSize;
-        lcd.setCursor(16, 2);
-        if (encoderPos) lcd.print(F("YES"));
-          else lcd.print(F("NO "));
-        lastReportedPos = encoderPos;
-      }
-    } while (digitalRead(pushButton));
-    if (encoderPos) {  // empty profile queue, reset program flag and return to main menu
-      programState &= ~TEMP_PROFILE;
-      while (!profile.isEmpty()) {
-        wdt_reset();
-        mainUpdate();
-        profile.pop();
-      }
+      ProFile = root.openNextFile();  // open next file in /profiles/
+    } while (ProFile.isDirectory());  // ignore directories
+    lcd.setCursor(2, 2);
+    lcd.write((byte)1);
+    if (!ProFile) {                   // no more files in /profiles/
+      root.rewindDirectory();         // return to top of /profiles/
+      lcd.print(F("BACK        "));
+    }
+    else lcd.print(ProFile.name());  // print current filename to LCD
+  }
+  else if (event == UI_PUSH) {
+    root.close();
+    if (ProFile) {
+      memset(profileName, 0, sizeof(profileName));  // base name, kept in the settings record
+      for (byte i = 0; (i < 8) && ProFile.name()[i] && (ProFile.name()[i] != '.'); i++) profileName[i] = ProFile.name()[i];
+      profileReader.begin(&profile);
+      sched.once(0, profileLoad, TASK_LOGGING, F("pgm"));  // read in the background, one block per pass
     }
-    encoderPos = 4;
+    uiReturn();
+  }
+  else if (event == UI_CANCEL) {  // the file shown when the screen was left
+    if (ProFile) ProFile.close();
+    root.close();
+  }
+}
+
+void profileLoad() {  // parse one block of ProFile into the profile table; at EOF start the profile
+  if (profileBlock()) {
+    sched.once(0, profileLoad, TASK_LOGGING, F("pgm"));
     return;
   }
-  encoderPos = 0;
-  char lastReportedPos = 1;
-  File root = SD.open("/PROFILES/", FILE_READ);  //  open root to profile directory
-  if (!root) {  // profile directory does not exist
-    lcd.setCursor(0, 2);
-    lcd.print(F(" /PROFILES/ MISSING "));
-    unsigned long start = millis();
-    do { wdt_reset(); mainUpdate(); } while (millis() <= (unsigned long)(start + 1500));
+  ProFile.close();
+  if (profileReader.finish() != PROFILE_OK) {
+    profileReport();
     return;
   }
-  lcd.setCursor(0, 2);
-  lcd.print(F("                    "));
-  do {
-    wdt_reset();
-    mainUpdate();
-    encoderState |= DEBOUNCE;
-    if (lastReportedPos != encoderPos) {
-      do {
-        ProFile = root.openNextFile();  // open next file in /profiles/
-      } while (ProFile.isDirectory());  // ignore directories
-      if (!ProFile) {                   // no more files in /profiles/
-        root.rewindDirectory();         // return to top of /profiles/
-        lcd.setCursor(2, 2);
-        lcd.write((byte)1);
-        lcd.print(F("BACK        "));
-      } 
-      else {
-        lcd.setCursor(2, 2);
-        lcd.write((byte)1);
-        lcd.print(ProFile.name());  // print current filename to LCD
-      }
-      lastReportedPos = encoderPos;
+  profileRun.begin(0, wallClock.now(), lround(Setpoint * 100));  // ramps start from the current setpoint
+  programState |= MAIN_PID_MODE + HEAT_PID_MODE + TEMP_PROFILE;  //  set PIDs to automatic and enable temperature profile bit
+}
+
+boolean profileBlock() {
+  char buf[profileBlockSize];
+  int n = ProFile.read(buf, sizeof(buf));
+  if (n < 0) profileReader.fail(PROFILE_READ);
+  return (n > 0) && profileReader.feed(buf, n);
+}
+
+void profileReport() {  // on the menu's option line (the load runs right after the file is picked)
+  #if DEBUG == true
+    Serial.print(F("profile error "));
+    Serial.print(profileReader.error());
+    Serial.print(F(" at line "));
+    Serial.println(profileReader.line());
+  #endif
+  if (uiActive != menu) return;
+  uiMessage(F(" PROFILE ERR LINE   "));
+  lcd.setCursor(17, 2);
+  lcd.print(profileReader.line());
+}
+
+void coolMode(byte event) {  // COOL stop prediction; the model learns under either, and waits for its warmup peaks
+  if (event == UI_ENTER) {
+    uiOption();
+    uiList(2, (programState & COOL_MODEL) >> 6);
+  }
+  else if (event == UI_TURN) {
+    lcd.setCursor(3, 2);
+    if (encoderPos) lcd.print(F("Model    "));
+      else lcd.print(F("Estimator"));
+  }
+  else if (event == UI_PUSH) {
+    if (encoderPos) programState |= COOL_MODEL;
+      else programState &= ~COOL_MODEL;
+
+    #if DEBUG == true
+      if (encoderPos) Serial.print(F("COOL on the model. "));
+        else Serial.print(F("COOL on the peak estimator. "));
+      Serial.print(freeRAM());
+      Serial.println(F(" bytes free SRAM remaining"));
+    #endif
+    uiReturn();
+  }
+}
+
+void autoTune(byte event) {  // relay auto-tuning: pick the loop, or stop the running experiment
+  if (tuneLoop) {
+    if (event == UI_ENTER) {
+      lcd.setCursor(0, 2);
+      lcd.print(F(" STOP TUNING?       "));
+      lcd.setCursor(15, 2);
+      lcd.write((byte)1);
+      uiList(2, 0);
     }
-  } while (digitalRead(pushButton));
-  do {wdt_reset(); mainUpdate();} while (!digitalRead(pushButton));
-  if (ProFile) {
-    char filename[12];
-    for (int i = 0; i++; i < 8) {  // store profile name in EEPROM
-      EEPROMWrite(44 + i, ProFile.name()[i], BYTE);
+    else if (event == UI_TURN) {
+      lcd.setCursor(16, 2);
+      if (encoderPos) lcd.print(F("YES"));
+        else lcd.print(F("NO "));
     }
-    char buff[20];     // char buffer for file data
-    profileStep Step;  // temporary profile step to push to queue
-    while (ProFile.peek() != -1) {  // if not EOF, read temperature,duration one byte at a time
-      wdt_reset();
-      mainUpdate();
-      for (int i = 0; i < 20; i++) {  // read step temperature (deg C) into buffer until ',' found
-        buff[i] = ProFile.read();
-        if (buff[i] == ',') break;
-      }
-      Step.temp = strtod(buff, 0);    // convert (char)buffer to double
-      memset(buff, 0, 20);            // reset buffer
-      for (int i = 0; i < 20; i++) {  // read step duration (hours) into buffer until newline found
-        buff[i] = ProFile.read();
-        if (buff[i] == '\n') break;
-      }
-      Step.duration = strtod(buff, 0);
-      if (Step.temp || Step.duration) profile.push(Step);  // push (non-null) fermentation profile step into queue
+    else if (event == UI_PUSH) {
+      if (encoderPos) tuneFinish(TUNE_IDLE);  // tunings unchanged
+      uiReturn();
     }
-    programState |= MAIN_PID_MODE + HEAT_PID_MODE + TEMP_PROFILE;  //  set PIDs to automatic and enable temperature profile bit
+    return;
   }
-  root.close();
-  ProFile.close();
-}
-
-void tempUnit() {
-  char listSize = 2;
-  encoderPos = (programState & DISPLAY_UNIT) >> 3;
-  char lastReportedPos = encoderPos + 1;
-  lcd.setCursor(0, 2);
-  lcd.print(F("                    "));
-  lcd.setCursor(2, 2);
-  lcd.write((byte)1);
-  lcd.print(F(" \337"));
-  do {
-    wdt_reset();
-    mainUpdate();
-    encoderState |= DEBOUNCE;
-    if (lastReportedPos != encoderPos) {
-      encoderPos = (encoderPos + listSize) % listSize;
-      lcd.setCursor(5, 2);
-      if (encoderPos) lcd.print(F("F"));
-        else lcd.print(F("C"));
-      lastReportedPos = encoderPos;
+  if (event == UI_ENTER) {
+    if (programState & TEMP_PROFILE) {
+      uiMessage(F(" PROFILE IS RUNNING "));
+      return;
     }
-  } while (digitalRead(pushButton));
-  if (encoderPos) programState |= DISPLAY_UNIT;
-    else programState &= ~DISPLAY_UNIT;
+    uiOption();
+    uiList(3, 0);
+  }
+  else if (event == UI_TURN) {
+    lcd.setCursor(3, 2);
+    if (encoderPos == 0) lcd.print(F("Main PID"));
+    else if (encoderPos == 1) lcd.print(F("Heat PID"));
+    else lcd.print(F("BACK    "));
+  }
+  else if (event == UI_PUSH) {
+    if (encoderPos < 2) tuneStart(encoderPos ? TUNE_HEAT : TUNE_MAIN);
+    uiReturn();
+  }
+}
 
+void tuneStart(byte loop) {  // both PIDs stay in their programState modes; only the PID objects go manual
+  tuneSaved[0] = Output;
+  tuneSaved[1] = heatOutput;
+  mainPID.SetMode(MANUAL);
+  if (loop == TUNE_MAIN) {  // beer loop: relay on the fridge target; fridgeControl runs COOL/HEAT to it
+    tuner.begin(&Input, &Output, Setpoint, min(Setpoint + tuneMainStep, 38.0), max(Setpoint - tuneMainStep, 0.3),
+                tuneMainHysteresis, tuneMainTimeout, millis());
+  }
+  else {  // air loop: relay on the heater duty, fridge target frozen
+    heatPID.SetMode(MANUAL);
+    heatSetpoint = Output;
+    tuner.begin(&heatInput, &heatOutput, Output, heatWindow, 0, tuneHeatHysteresis, tuneHeatTimeout, millis());
+  }
+  tuneLoop = loop;
   #if DEBUG == true
-    if (encoderPos) Serial.print(F("Units set to deg F."));
-      else Serial.print(F("Units set to deg C."));
+    Serial.print(F("autotune started. "));
     Serial.print(freeRAM());
     Serial.println(F(" bytes free SRAM remaining"));
   #endif
 }
 
-void avrReset() {
-  char listSize = 2;
-  encoderPos = 0;
-  char lastReportedPos = 1;
-  lcd.setCursor(0, 2);
-  lcd.print(F("  SURE?             "));
-  lcd.setCursor(8, 2);
-  lcd.write((byte)1);
-  do {
-    wdt_reset();
-    mainUpdate();
-    encoderState |= DEBOUNCE;
-    if (lastReportedPos != encoderPos) {
-      encoderPos = (encoderPos + listSize) % listSize;
-      lcd.setCursor(9, 2);
-      if (encoderPos) lcd.print(F("YES"));
-        else lcd.print(F("NO "));
-      lastReportedPos = encoderPos;
+void applyTunings() {
+  for (byte i = 0; i < chamberCount; i++) {
+    chambers[i].mainPID.SetTunings(Kp, Ki, Kd);
+    chambers[i].heatPID.SetTunings(heatKp, heatKi, heatKd);
+  }
+}
+
+void tuneFinish(byte state) {
+  if (state == TUNE_DONE) {  // new tunings, committed with the settings record
+    if (tuneLoop == TUNE_MAIN) tuner.getTunings(tuneMainRule, &Kp, &Ki, &Kd);
+      else tuner.getTunings(tuneHeatRule, &heatKp, &heatKi, &heatKd);
+    applyTunings();  // every chamber runs them
+    settings.change();
+  }
+  Output = tuneSaved[0];  // manual outputs as they were; automatic PIDs restart bumplessly from them
+  heatOutput = tuneSaved[1];
+  if (programState & MAIN_PID_MODE) mainPID.SetMode(AUTOMATIC);
+  if (programState & HEAT_PID_MODE) heatPID.SetMode(AUTOMATIC);
+  tuneLoop = TUNE_NONE;
+  #if DEBUG == true
+    if (state == TUNE_DONE) {
+      Serial.print(F("autotune done: Ku "));
+      Serial.print(tuner.getKu());
+      Serial.print(F(" Pu "));
+      Serial.print(tuner.getPu());
+      Serial.println(F(" s"));
+    }
+    else Serial.println(F("autotune stopped; tunings unchanged"));
+  #endif
+}
+
+void tempUnit(byte event) {  // temperature display units C/F
+  if (event == UI_ENTER) {
+    uiOption();
+    lcd.print(F(" \337"));
+    uiList(2, (programState & DISPLAY_UNIT) >> 3);
+  }
+  else if (event == UI_TURN) {
+    lcd.setCursor(5, 2);
+    if (encoderPos) lcd.print(F("F"));
+      else lcd.print(F("C"));
+  }
+  else if (event == UI_PUSH) {
+    if (encoderPos) programState |= DISPLAY_UNIT;
+      else programState &= ~DISPLAY_UNIT;
+
+    #if DEBUG == true
+      if (encoderPos) Serial.print(F("Units set to deg F."));
+        else Serial.print(F("Units set to deg C."));
+      Serial.print(freeRAM());
+      Serial.println(F(" bytes free SRAM remaining"));
+    #endif
+    uiReturn();
+  }
+}
+
+void avrReset(byte event) {  // restore default settings and reset
+  if (event == UI_ENTER) {
+    lcd.setCursor(0, 2);
+    lcd.print(F("  SURE?             "));
+    lcd.setCursor(8, 2);
+    lcd.write((byte)1);
+    uiList(2, 0);
+  }
+  else if (event == UI_TURN) {
+    lcd.setCursor(9, 2);
+    if (encoderPos) lcd.print(F("YES"));
+      else lcd.print(F("NO "));
+  }
+  else if (event == UI_PUSH) {
+    if (!encoderPos) {
+      uiReturn();
+      return;
     }
-  } while (digitalRead(pushButton));
-  if (encoderPos) {
     #if DEBUG == true
       Serial.println(F("Restoring PID to default settings and rebooting..."));
     #endif
 
-    EEPROMWritePresets();    // restore default settings to EEPROM
+    settingsRecord r;
+    settingsDefaults(r);
+    settingsApply(r);
+    settings.commit();       // restore default settings to EEPROM
+    settings.flush();
     wdt_enable(WDTO_250MS);  // change watchdog timer to 250ms
     do {} while (true);      // infinte loop; wait for arduino to reset after 250ms timeout with no watchdog reset pulse
   }
 }
 
 void backOut() {  //  finalize any changes in preparation for menu exit
-  if (programState & MAIN_PID_MODE) mainPID.SetMode(AUTOMATIC);
-    else mainPID.SetMode(MANUAL);
-  if (programState & HEAT_PID_MODE) heatPID.SetMode(AUTOMATIC);
-    else heatPID.SetMode(MANUAL);
-  if ((programState & (DATA_LOGGING + FILE_OPS)) == DATA_LOGGING + FILE_OPS) {  // create a new comma seperated value LogFile
-    char filename[] = "LOGGER00.CSV";
+  if (!tuneLoop) {  // a running experiment holds the PIDs in manual; tuneFinish() restores the modes
+    if (programState & MAIN_PID_MODE) mainPID.SetMode(AUTOMATIC);
+      else mainPID.SetMode(MANUAL);
+    if (programState & HEAT_PID_MODE) heatPID.SetMode(AUTOMATIC);
+      else heatPID.SetMode(MANUAL);
+  }
+  if ((programState & (DATA_LOGGING + FILE_OPS)) == DATA_LOGGING + FILE_OPS) {  // create a new binary LogFile (host/build/npid-log converts to CSV)
+    char filename[] = "LOGGER00.BIN";
     for (int i = 0; i < 100; i++) {
       filename[6] = i/10 + '0';
       filename[7] = i%10 + '0';
       if (!SD.exists(filename)) {  // only open a new file if it doesn't exist
-        LogFile = SD.open(filename, FILE_WRITE);
-        if (LogFile) {
+        if (LogFile.open(filename, logPreallocate)) {  // pre-allocates a contiguous file and writes the log header block
           #if DEBUG == true
             Serial.print(F("New file success:"));
             Serial.print(filename);
@@ -1092,8 +1289,6 @@ void backOut() {  //  finalize any changes in preparation for menu exit
         break;
       }
     }
-    LogFile.println(F("millis,datetime,fridge actual,fridge filter,beer actual,beer filter,mainSP,mainCO,heatSP,heatCO,peak estimator,fridge state"));
-    LogFile.flush();  //print header to file
   }
   if ((programState & (DATA_LOGGING + FILE_OPS)) == FILE_OPS) {
     #if DEBUG == true
@@ -1102,31 +1297,31 @@ void backOut() {  //  finalize any changes in preparation for menu exit
       Serial.println(F(" bytes free SRAM remaining"));
     #endif
 
-    LogFile.close();  // close LogFile
+    LogFile.close();  // commit staged records and close LogFile
   }
   programState &= ~FILE_OPS;  // reset file change flag
-  EEPROMWriteSettings();     // update settings stored in non-volatile memory
+  settings.change();          // update settings stored in non-volatile memory
 }
 
-void EEPROMReadSettings() {  // read settings from EEPROM
-  EEPROMRead(1, &programState, BYTE);
-  EEPROMRead(2, &Setpoint, DOUBLE);
-  EEPROMRead(6, &Output, DOUBLE);
-  EEPROMRead(10, &Kp, DOUBLE);
-  EEPROMRead(14, &Ki, DOUBLE);
-  EEPROMRead(18, &Kd, DOUBLE);
-  EEPROMRead(22, &heatOutput, DOUBLE);
-  EEPROMRead(26, &heatKp, DOUBLE);
-  EEPROMRead(30, &heatKi, DOUBLE);
-  EEPROMRead(34, &heatKd, DOUBLE);
-  double* estimator = getPeakEstimatorAddr();
-  EEPROMRead(38, &estimator, DOUBLE);
+void loadSettings() {  // read settings from EEPROM
+  settingsRecord r;
+  byte source = settings.begin(r, settingsCapture);
+  if (source == SETTINGS_NONE) {  // blank EEPROM or an unknown schema
+    settingsDefaults(r);
+    settings.commit();
+  }
+  settingsApply(r);
+  #if DEBUG == true
+    const char* sourceText[] = { "defaults", "EEPROM", "EEPROM (migrated)", "EEPROM (legacy layout)" };
+    Serial.print(F("Settings loaded from "));
+    Serial.println(sourceText[source]);
+  #endif
   if (programState & DATA_LOGGING) {  // load previous logfile if data logging active
-    char filename[] = "LOGGER00.CSV";
-    EEPROMRead(42, &filename[6], BYTE); 
-    EEPROMRead(43, &filename[7], BYTE);
+    char filename[] = "LOGGER00.BIN";
+    filename[6] = r.logFile / 10 % 10 + '0';
+    filename[7] = r.logFile % 10 + '0';
     if (SD.exists(filename)) {
-      LogFile = SD.open(filename, FILE_WRITE);
+      LogFile.open(filename, logPreallocate);  // resumes the block stream (or appends from the next free block)
       lcd.clear();
       lcd.print(filename);
       lcd.print(F(" open."));
@@ -1138,16 +1333,19 @@ void EEPROMReadSettings() {  // read settings from EEPROM
     }
   }
   if (programState & TEMP_PROFILE) {  // load previous profile if active
-    char filename[] = "/PROFILES/        .PGM";
-    for (int i = 0; i++; i < 8) {
-      EEPROMRead(44 + i, &filename[10 + i], BYTE);
-    }
+    char filename[24] = "/PROFILES/";
+    strcat(filename, profileName);
+    strcat(filename, ".PGM");
     #if DEBUG == true
       Serial.print(F("Opening file:"));
       Serial.println(filename);
     #endif
     ProFile = SD.open(filename, FILE_READ);
-    if (ProFile) {
+    profileReader.begin(&profile);
+    if (!ProFile) profileReader.fail(PROFILE_READ);
+    while (profileBlock()) wdt_reset();
+    ProFile.close();
+    if (profileReader.finish() == PROFILE_OK) {
       lcd.clear();
       lcd.print(filename);
       lcd.print(F(" open."));
@@ -1156,97 +1354,86 @@ void EEPROMReadSettings() {  // read settings from EEPROM
         Serial.println(F(" re-opened."));
       #endif
       delay(1500);
-      char buff[20];     // char buffer for file data
-      profileStep Step;  // temporary profile step to push to queue
-      while (ProFile.peek() != -1) {  // if not EOF, read temperature,duration one byte at a time
-        wdt_reset();
-        mainUpdate();
-        for (int i = 0; i < 20; i++) {  // read step temperature (deg C) into buffer until ',' found
-          buff[i] = ProFile.read();
-          if (buff[i] == ',') break;
-        }
-        Step.temp = strtod(buff, 0);    // convert (char)buffer to double
-        memset(buff, 0, 20);            // reset buffer
-        for (int i = 0; i < 20; i++) {  // read step duration (hours) into buffer until newline found
-          buff[i] = ProFile.read();
-          if (buff[i] == '\n') break;
-        }
-        Step.duration = strtod(buff, 0);
-        if (Step.temp || Step.duration) profile.push(Step);  // push (non-null) fermentation profile step into queue
-      }
-      programState |= MAIN_PID_MODE + HEAT_PID_MODE + TEMP_PROFILE;  //  set PIDs to automatic and enable temperature profile bit
+      programState |= MAIN_PID_MODE + HEAT_PID_MODE;  //  set PIDs to automatic
+      if (r.profileStart) profileRun.begin(max((int)r.profileStep - 1, 0), r.profileStart, r.profileFrom);  // exact resume
+        else profileRun.begin(max((int)r.profileStep - 1, 0), wallClock.now(), lround(Setpoint * 100));  // restart the step
     }
-    ProFile.close();
-    unsigned int step = 0;
-    unsigned int count = 1;
-    EEPROMRead(52, &step, INT);
-    while (step > count) {  // reset queue to last step
-      count++;
-      wdt_reset();
-      mainUpdate();
-      profile.pop();
+    else {
+      profileReport();
+      programState &= ~TEMP_PROFILE;
     }
   }
 }
 
-void EEPROMWriteSettings() {  // write current settings to EEPROM
-  byte temp = EEPROM_VER;
-  EEPROMWrite(0, &temp, BYTE);
-  EEPROMWrite(1, (byte)(programState & ~FILE_OPS), BYTE);
-  EEPROMWrite(2, Setpoint, DOUBLE);
-  EEPROMWrite(6, Output, DOUBLE);
-  EEPROMWrite(10, Kp, DOUBLE);
-  EEPROMWrite(14, Ki, DOUBLE);
-  EEPROMWrite(18, Kd, DOUBLE);
-  EEPROMWrite(22, heatOutput, DOUBLE);
-  EEPROMWrite(26, heatKp, DOUBLE);
-  EEPROMWrite(30, heatKi, DOUBLE);
-  EEPROMWrite(34, heatKd, DOUBLE);
-  EEPROMWrite(38, getPeakEstimator(), DOUBLE);
-  if (programState & DATA_LOGGING) {  //  write logfile name to EEPROM if data logging active
-    EEPROMWrite(42, (byte)LogFile.name()[6], BYTE);
-    EEPROMWrite(43, (byte)LogFile.name()[7], BYTE);
-  }
+void settingsApply(const settingsRecord& r) {  // record into the live settings
+  programState = r.programState;
+  Setpoint = r.setpoint;
+  Output = r.output;
+  Kp = r.kp;
+  Ki = r.ki;
+  Kd = r.kd;
+  heatOutput = r.heatOutput;
+  heatKp = r.heatKp;
+  heatKi = r.heatKi;
+  heatKd = r.heatKd;
+  *getPeakEstimatorAddr() = r.peakEstimator;
+  memcpy(profileName, r.profile, sizeof(profileName));
+  profileName[8] = 0;
 }
 
-void EEPROMWritePresets() {      // save defaults to eeprom
-  byte temp = EEPROM_VER;
-  EEPROMWrite(0, &temp, BYTE);                 // update EEPROM version
-  EEPROMWrite(1, (byte)DISPLAY_UNIT, BYTE);    // default programState (main PID manual, heat PID manual, deg F, no file operations)
-  EEPROMWrite(2, (double)20.00, DOUBLE);       // default main Setpoint
-  EEPROMWrite(6, (double)20.00, DOUBLE);       // default main Output for manual operation
-  EEPROMWrite(10, (double)10.00, DOUBLE);      // default main Kp
-  EEPROMWrite(14, (double)5E-4, DOUBLE);       // default main Ki
-  EEPROMWrite(18, (double)500.0, DOUBLE);     // default main Kd
-  EEPROMWrite(22, (double)00.00, DOUBLE);      // default HEAT Output for manual operation
-  EEPROMWrite(26, (double)05.00, DOUBLE);      // default HEAT Kp
-  EEPROMWrite(30, (double)00.25, DOUBLE);      // default HEAT Ki
-  EEPROMWrite(34, (double)01.15, DOUBLE);      // default HEAT Kd
-  EEPROMWrite(38, (double)05.00, DOUBLE);      // default peakEstimator
+void settingsCapture(settingsRecord& r) {  // called by settings.poll() when a commit starts
+  r.programState = programState & ~FILE_OPS;
+  r.setpoint = Setpoint;
+  r.output = tuneLoop ? tuneSaved[0] : Output;  // not the relay outputs of a running experiment
+  r.kp = Kp;
+  r.ki = Ki;
+  r.kd = Kd;
+  r.heatOutput = tuneLoop ? tuneSaved[1] : heatOutput;
+  r.heatKp = heatKp;
+  r.heatKi = heatKi;
+  r.heatKd = heatKd;
+  r.peakEstimator = getPeakEstimator();
+  r.logFile = (programState & DATA_LOGGING) ? (LogFile.name()[6] - '0') * 10 + (LogFile.name()[7] - '0') : 0;
+  memcpy(r.profile, profileName, sizeof(r.profile));
+  if (programState & TEMP_PROFILE) {
+    r.profileStep = profileRun.step() + 1;
+    r.profileStart = profileRun.start();
+    r.profileFrom = profileRun.from();
+  }
+  else {
+    r.profileStep = 0;
+    r.profileStart = 0;
+    r.profileFrom = 0;
+  }
 }
 
-void encoderChanA() {  // interrupt for rotary encoder A channel
-  if (encoderState & DEBOUNCE) delay (1);  // debounce
-  if (digitalRead(encoderPinA) != ((encoderState & CHAN_A) >> 2)) {    // make sure signal has changed
-    encoderState = (encoderState & ~CHAN_A) + (~encoderState & CHAN_A);  // update encoderState with new A value
-    if ((encoderState & ~DEBOUNCE) == CHAN_A) encoderPos++;  // increment encoder position if A leads B
-    encoderState &= ~DEBOUNCE;  // reset debounce flag
-  }
+void settingsDefaults(settingsRecord& r) {
+  memset(&r, 0, sizeof(r));
+  r.programState = DISPLAY_UNIT;  // default programState (main PID manual, heat PID manual, deg F, no file operations)
+  r.setpoint = 20.00;     // default main Setpoint
+  r.output = 20.00;       // default main Output for manual operation
+  r.kp = 10.00;           // default main Kp
+  r.ki = 5E-4;            // default main Ki
+  r.kd = 500.0;           // default main Kd
+  r.heatOutput = 00.00;   // default HEAT Output for manual operation
+  r.heatKp = settingsHeatKp;  // default HEAT Kp
+  r.heatKi = settingsHeatKi;  // default HEAT Ki
+  r.heatKd = settingsHeatKd;  // default HEAT Kd
+  r.peakEstimator = 05.00;  // default peakEstimator
 }
 
-void encoderChanB() {  // interrupt for rotary encoder B channel
-  if (encoderState & DEBOUNCE) delay (1);
-  if (digitalRead(encoderPinB) != ((encoderState & CHAN_B) >> 1)) {
-    encoderState = (encoderState & ~CHAN_B) + (~encoderState & CHAN_B);
-    if ((encoderState & ~DEBOUNCE) == CHAN_B) encoderPos--; // decrement encoder position if B leads A
-    encoderState &= ~DEBOUNCE;
-  }
+void encoderEdge() {  // interrupts 0 and 1: one decoder step, the detent (if any) queued for uiTask
+  knob.edge();
 }
 
 #if DEBUG == true
 int freeRAM() {
-  extern int __heap_start, *__brkval;
-  int v;
-  return (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval);
+  #ifdef __AVR__
+    extern int __heap_start, *__brkval;
+    int v;
+    return (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval);
+  #else
+    return 0;  // no heap/stack boundary to measure off-target
+  #endif
 }
 #endif
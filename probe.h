@@ -5,34 +5,70 @@
 #include <Serial.h>
 #include <avr/wdt.h>
 #include <OneWire.h>
+#include "iir.h"
 
-class probe {
-    static OneWire* _myWire;
-    static double _sampleHz;
-    static boolean _sampled;
-    static unsigned long _lastSample;
-    static unsigned int _offset;
+typedef butterworthLP<33, 1000> probeLowPass;            // fc = 0.033 Hz at the 1 Hz sample rate
+typedef iirFilter<3, probeLowPass, double> probeFilter;   // 3rd order Butterworth, float on AVR
+typedef iirFilter<3, probeLowPass, fix16> probeFilterQ16; // same response, Q16.16 arithmetic
+
+// a reading that passes the CRC is still checked before it reaches the filter.  it is rejected when the
+// scratchpad is malformed (an all zero read passes the CRC), outside probeMinTemp - probeMaxTemp (which
+// also catches the 85 deg C power-on value of a sensor that reset and never converted), more than
+// probeMaxStep from the last good reading, or (with a stuck limit set) the same raw value for that many
+// samples in a row.  a rejected reading is a miss: the probe holds its last good temperature and filter.
+// after probeLostSamples consecutive misses the probe is lost and the chamber falls back to a degraded
+// mode (chamber.h).  a lost probe is picked up again by two consecutive readings within probeMaxStep of
+// each other, and its filter restarts at the new reading.
+const double probeMinTemp = -30;       // deg C; a fermenter or chamber below or above is a bad reading
+const double probeMaxTemp = 60;
+const double probeMaxStep = 5;         // deg C per sample
+const byte probeLostSamples = 10;      // consecutive misses before the probe is lost
+
+struct probeHealth {  // per sensor read statistics
+  unsigned long reads;      // good scratchpad reads
+  unsigned long crcErrors;  // reads rejected by the CRC check (each retry counts)
+  unsigned long rangeErrors;  // readings outside probeMinTemp - probeMaxTemp or malformed
+  unsigned long rateErrors;   // readings too far from the last good one
+  unsigned long stuckErrors;  // readings past the stuck limit
+  unsigned long misses;     // samples without a good read inside the retry budget (or rejected)
+  byte failures;            // consecutive misses
+  boolean present;          // found on the bus by the last enumeration
+};
+
+class probe {  // one DS18B20; addressed, read and scheduled by probeBus
+    friend class probeBus;
 
     byte _address[8];
-    double _temperature[4];
-    double _filter[4];
+    byte _resolution;  // bits; requested, then as read back from the configuration register
+    double _temperature;
+    tempFilter* _filter;  // optional; getFilter() returns the raw reading without one
+    probeHealth _health;
+    int16_t _raw;            // last reading in range, 1/16 deg C
+    unsigned int _same;      // consecutive readings of _raw; 0xFFFF: the last reading was out of range
+    unsigned int _stuckLimit;  // readings of one value that make the sensor stuck; 0 = no check
 
-    static boolean _isConv() { return !_myWire->read(); }
-    boolean _getAddr();
-    boolean _updateTemp();
+    void _init();
+    boolean _updateTemp(const byte* data);  // data = verified scratchpad; false if the reading is rejected
     void _updateFilter();
-    
+    void _good();
+
   public:
-    probe(OneWire* onewire) { if (!_myWire) _myWire = onewire; _getAddr(); }
-    void init();
-    void update();
+    probe(tempFilter* filter = 0);
+    void setResolution(byte bits) { _resolution = constrain(bits, 9, 12); }  // 9-12 bits, applied by probeBus::begin()
+    byte getResolution() { return _resolution; }
+    const byte* getAddress() { return _address; }
+    const probeHealth& getHealth() { return _health; }
+    boolean isPresent() { return _health.present; }
+    boolean isValid() { return _health.failures < probeLostSamples; }  // not lost
+    void setStuckLimit(unsigned int samples) { _stuckLimit = samples; }
     boolean peakDetect();
-    double getTemp() { return _temperature[0]; }
-    double getFilter() { return _filter[0]; }
+    double getTemp() { return _temperature; }
+    double getFilter();
+    void setFilter(tempFilter* filter) { _filter = filter; }
+    void read(double tempC) { _temperature = tempC; _good(); }  // a good reading from outside the bus (a log replay)
+    void miss();             // a sample without a good reading
 
-    static void setSampleHz(double hz) { _sampleHz = hz; }
-    static boolean isReady();
-    static void startConv();
+    static unsigned int convTime(byte bits);  // datasheet maximum conversion time (ms)
     static double tempCtoF(double tempC) { return ((tempC * 9 / 5) + 32); }
     static double tempFtoC(double tempF) { return ((tempF - 32) * 5 / 9); }
 };
@@ -0,0 +1,222 @@
+#include "probeBus.h"
+#include "trace.h"
+#include "telemetry.h"  // DEBUG
+
+probeBus::probeBus(OneWire* onewire, unsigned int cacheAddr) {
+  _wire = onewire;
+  _cacheAddr = cacheAddr;
+  memset(_probes, 0, sizeof(_probes));
+  memset(_rom, 0, sizeof(_rom));
+  _found = 0;
+  _sampleHz = 1;
+  _state = IDLE;
+  _next = 0;
+  _lastSample = _deadline = _readStart = 0;
+  _convBits = _seenBits = 12;  // power-on resolution
+  memset(&_stats, 0, sizeof(_stats));
+  _stats.min = 0xFFFF;
+}
+
+void probeBus::attach(byte role, probe* p) {
+  if (role < busMaxProbes) _probes[role] = p;
+}
+
+byte probeBus::begin() {  // enumerate, bind roles, set resolutions, first (blocking) conversion
+  byte addr[8];
+  _loadCache();
+  for (byte i = 0; i < busMaxProbes; i++) if (_probes[i]) _probes[i]->_health.present = false;
+  _found = 0;
+  for (byte attempt = 0; attempt < 3; attempt++) {  // a corrupted search result restarts the enumeration
+    boolean clean = true;
+    _found = 0;
+    _wire->reset_search();
+    while (_wire->search(addr)) {
+      if ((OneWire::crc8(addr, 7) != addr[7]) || (addr[0] != 0x28)) { clean = false; break; }
+      _found++;
+      byte role = busMaxProbes;
+      for (byte i = 0; i < busMaxProbes; i++) if (!memcmp(_rom[i], addr, 8)) role = i;
+      if (role == busMaxProbes) {  // new sensor: first free role
+        for (role = 0; (role < busMaxProbes) && _bound(role); role++);
+        if (role == busMaxProbes) continue;  // every role taken
+        memcpy(_rom[role], addr, 8);
+        _saveCache(role);
+      }
+      if (_probes[role]) {
+        memcpy(_probes[role]->_address, addr, 8);
+        _probes[role]->_health.present = true;
+      }
+      #if DEBUG == true
+        Serial.print(F("DS18B20 sensor, role "));
+        Serial.print(role);
+        Serial.print(F(", addr:"));
+        for (int i = 0; i < 8; i++) {
+          Serial.print(F(" "));
+          Serial.print(addr[i], HEX);
+        }
+        Serial.println();
+      #endif
+    }
+    if (clean) break;
+  }
+
+  _convBits = 9;
+  for (byte i = 0; i < busMaxProbes; i++) {
+    probe* p = _probes[i];
+    if (!p || !p->_health.present) continue;
+    _writeConfig(p->_address, p->_resolution);
+    if (p->_resolution > _convBits) _convBits = p->_resolution;
+  }
+  _wire->reset();
+  _wire->skip();
+  _wire->write(0x44);
+  delay(probe::convTime(_convBits));  // setup() only; update() never waits on the bus
+  _lastSample = millis();
+  _seenBits = 9;
+  for (byte i = 0; i < busMaxProbes; i++) {
+    probe* p = _probes[i];
+    byte data[9];
+    if (!p || !p->_health.present) continue;
+    for (byte attempt = 0; attempt < 3; attempt++) {
+      if (!_readScratch(p->_address, data)) { p->_health.crcErrors++; continue; }
+      if (p->_updateTemp(data)) {
+        p->_init();
+        p->_health.reads++;
+        p->_health.failures = 0;
+      }
+      if (p->_resolution > _seenBits) _seenBits = p->_resolution;
+      break;
+    }
+  }
+  for (byte i = 0; i < busMaxProbes; i++) {  // attached but not found, or no good first reading: lost until one
+    probe* p = _probes[i];
+    if (p && (!p->_health.present || !p->_health.reads)) p->_health.failures = 255;
+  }
+  _state = IDLE;
+  return _found;
+}
+
+boolean probeBus::update() {  // call every pass; true once every attached probe holds a new sample
+  switch (_state) {
+    case IDLE:
+      if ((uint32_t)(millis() - _lastSample) >= 1000/_sampleHz) _startConv();
+      return false;
+    case CONVERTING:
+      if (!_pollConv()) return false;
+      // fall through: first scratchpad in the same pass
+    default:
+      return _readNext();
+  }
+}
+
+void probeBus::forget(byte role) {  // unbind a role (sensor replaced); rebound by the next begin()
+  if (role >= busMaxProbes) return;
+  memset(_rom[role], 0, 8);
+  _saveCache(role);
+  if (_probes[role]) {
+    _probes[role]->_health.present = false;
+    _probes[role]->_health.failures = 255;  // lost: not read until the next begin()
+  }
+}
+
+void probeBus::_startConv() {  // broadcast CONVERT T; the deadline follows the slowest resolution read back
+  _wire->reset();
+  _wire->skip();
+  _wire->write(0x44);
+  _lastSample = millis();
+  _convBits = _seenBits;
+  _seenBits = 9;
+  _deadline = _lastSample + probe::convTime(_convBits);
+  _state = CONVERTING;
+}
+
+boolean probeBus::_pollConv() {  // true once the conversion is complete; no bus traffic before the deadline
+  if ((int32_t)(millis() - _deadline) < 0) return false;
+  unsigned long elapsed = (uint32_t)(millis() - _lastSample);
+  if (!_wire->read()) {  // sensors hold the read slot low while converting
+    if (elapsed < (unsigned long)busTimeoutMs) {
+      _stats.late++;
+      _deadline = millis() + busPollMs;
+      return false;
+    }
+    _stats.timeouts++;
+    for (byte i = 0; i < busMaxProbes; i++) {
+      probe* p = _probes[i];
+      if (p && p->_health.present) p->miss();
+    }
+    _seenBits = 12;  // resolution unknown until the sensors read back again
+    _state = IDLE;
+    return false;
+  }
+  _stats.count++;
+  _stats.total += elapsed;
+  if (elapsed < _stats.min) _stats.min = elapsed;
+  if (elapsed > _stats.max) _stats.max = elapsed;
+  #if DEBUG == true
+    Serial.println(elapsed);
+  #endif
+  _readStart = millis();
+  _next = 0;
+  _state = READING;
+  return true;
+}
+
+boolean probeBus::_readNext() {  // read one scratchpad; true when the last attached probe is done
+  while ((_next < busMaxProbes) && (!_probes[_next] || !_probes[_next]->_health.present)) _next++;
+  if (_next < busMaxProbes) {
+    probe* p = _probes[_next];
+    byte data[9];
+    if (_readScratch(p->_address, data)) {
+      if (p->_updateTemp(data)) {
+        TRACE_BEGIN(TRACE_FILTER);
+        p->_good();
+        TRACE_END(TRACE_FILTER);
+      }
+      else p->miss();  // implausible: the last good temperature holds
+      if (p->_resolution > _seenBits) _seenBits = p->_resolution;
+      _next++;
+    }
+    else {
+      p->_health.crcErrors++;
+      if ((uint32_t)(millis() - _readStart) < (uint32_t)busRetryMs) return false;  // retried next pass
+      p->miss();
+      if (p->_resolution > _seenBits) _seenBits = p->_resolution;  // last known resolution still times the next conversion
+      _next++;
+    }
+    while ((_next < busMaxProbes) && (!_probes[_next] || !_probes[_next]->_health.present)) _next++;
+    if (_next < busMaxProbes) return false;
+  }
+  _state = IDLE;
+  return true;
+}
+
+boolean probeBus::_readScratch(const byte* rom, byte* data) {  // READ SCRATCHPAD; false on CRC failure
+  _wire->reset();
+  _wire->select(rom);
+  _wire->write(0xBE);
+  for (int i = 0; i < 9; i++) data[i] = _wire->read();
+  return OneWire::crc8(data, 8) == data[8];
+}
+
+boolean probeBus::_writeConfig(const byte* rom, byte bits) {  // set resolution, keeping the alarm bytes
+  byte data[9];
+  if (!_readScratch(rom, data)) return false;
+  _wire->reset();
+  _wire->select(rom);
+  _wire->write(0x4E);
+  _wire->write(data[2]);  // TH
+  _wire->write(data[3]);  // TL
+  _wire->write((constrain(bits, 9, 12) - 9) << 5);
+  return true;
+}
+
+void probeBus::_loadCache() {  // roles bound by earlier enumerations; invalid slots are free
+  if (!_cacheAddr) return;
+  for (byte i = 0; i < busMaxProbes; i++) {
+    EEPROMRead(_cacheAddr + 8 * i, _rom[i], 8);
+    if ((_rom[i][0] != 0x28) || (OneWire::crc8(_rom[i], 7) != _rom[i][7])) memset(_rom[i], 0, 8);
+  }
+}
+
+void probeBus::_saveCache(byte role) {
+  if (_cacheAddr) EEPROMWrite(_cacheAddr + 8 * role, _rom[role], 8);  // only changed cells are written
+}
@@ -0,0 +1,83 @@
+#ifndef PROBEBUS_H
+#define PROBEBUS_H
+
+#include "Arduino.h"
+#include <OneWire.h>
+#include "probe.h"
+#include "EEPROMio.h"
+
+// one-wire bus manager.  begin() enumerates every DS18B20 once and binds each to a role.  ROM codes are
+// cached in EEPROM by role (8 bytes per role from the cache address), so a sensor keeps its role across
+// resets, a missing sensor leaves its role empty instead of shifting the others, and a new sensor takes
+// the first free role.
+//
+// sampling never blocks: update() issues one broadcast CONVERT T at the sample rate and returns, leaves
+// the bus alone until the conversion deadline of the slowest resolution in use, then polls a single read
+// slot.  a conversion still running at its deadline is polled again every busPollMs; one that never
+// completes is abandoned after busTimeoutMs.  scratchpads are then read one sensor per call, so a pass
+// costs at most one read whatever the sensor count.  a read failing its CRC is retried on the next call
+// until busRetryMs after the conversion completed, then counted as a miss.  a read that passes the CRC
+// still has to pass the probe's plausibility checks (probe.h) to reach its filter.
+
+enum probeRole {  // EEPROM cache slot and index of each sensor
+  ROLE_BEER,
+  ROLE_FRIDGE,
+  ROLE_AMBIENT,
+  ROLE_VESSEL,     // second fermenter
+  ROLE_COIL,       // evaporator coil
+  ROLE_VESSEL_AIR, // second fermenter's chamber air (CHAMBERS 2)
+};
+
+const byte busMaxProbes = 8;      // roles (and EEPROM cache slots)
+const byte busPollMs = 10;        // re-poll interval for a conversion still running at its deadline
+const int busTimeoutMs = 1500;    // give up on a conversion (sensor missing or bus held low)
+const int busRetryMs = 250;       // time allowed for re-reading scratchpads that fail the CRC check
+
+struct convStats {  // measured conversion latency, CONVERT T to the poll that found it complete
+  unsigned long count;
+  unsigned long total;     // ms, for the mean
+  unsigned int min, max;   // ms
+  unsigned long late;      // polls that found the conversion still running
+  unsigned long timeouts;  // conversions abandoned
+};
+
+class probeBus {
+    enum { IDLE, CONVERTING, READING };
+    OneWire* _wire;
+    unsigned int _cacheAddr;           // EEPROM address of the ROM cache; 0 = no cache
+    probe* _probes[busMaxProbes];      // attached probes by role
+    byte _rom[busMaxProbes][8];        // ROM code bound to each role (all zero: free)
+    byte _found;                       // sensors answering the last enumeration
+    double _sampleHz;
+    byte _state;
+    byte _next;                        // READING: role to read next
+    unsigned long _lastSample;         // millis() at the last CONVERT T
+    unsigned long _deadline;           // millis() of the next read slot poll
+    unsigned long _readStart;          // millis() the conversion was found complete
+    byte _convBits;                    // resolution the running conversion is timed for
+    byte _seenBits;                    // highest resolution read back since the last CONVERT T
+    convStats _stats;
+
+    boolean _bound(byte role) { return _rom[role][0] != 0; }
+    boolean _readScratch(const byte* rom, byte* data);
+    boolean _writeConfig(const byte* rom, byte bits);
+    void _startConv();
+    boolean _pollConv();
+    boolean _readNext();
+    void _loadCache();
+    void _saveCache(byte role);
+
+  public:
+    probeBus(OneWire* onewire, unsigned int cacheAddr = 0);
+    void attach(byte role, probe* p);    // read this role into p
+    byte begin();                        // enumerate, bind roles, set resolutions, first (blocking) conversion
+    boolean update();                    // call every pass; true once every attached probe holds a new sample
+    void forget(byte role);              // unbind a role (sensor replaced); rebound by the next begin()
+    void setSampleHz(double hz) { _sampleHz = hz; }
+    byte getFound() { return _found; }
+    probe* getProbe(byte role) { return role < busMaxProbes ? _probes[role] : 0; }
+    const byte* getRom(byte role) { return _rom[role]; }
+    const convStats& getConvStats() { return _stats; }
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "profile.h"
+
+boolean profileTable::add(const profileStep& s) {
+  if (_count >= profileMaxSteps) return false;
+  _steps[_count++] = s;
+  return true;
+}
+
+void profileParser::begin(profileTable* table) {
+  _table = table;
+  _table->clear();
+  _line = 1;
+  _length = 0;
+  _index = 0;
+  _gap = false;
+  _comment = false;
+  _error = PROFILE_OK;
+}
+
+boolean profileParser::_number() {  // temperature or duration field complete
+  _field[_length] = 0;
+  long v;  // x 100
+  if (!parseFixed(_field, &v)) return _fail(PROFILE_SYNTAX);
+  if (!_index) {
+    if ((v < profileMinTemp) || (v > profileMaxTemp)) return _fail(PROFILE_RANGE);
+    _temp = v;
+  }
+  else {
+    _minutes = (v * 60 + 50) / 100;  // hours
+    if ((v < 0) || (_minutes > 0xFFFF)) return _fail(PROFILE_RANGE);
+  }
+  return true;
+}
+
+boolean profileParser::_endField() {
+  if (_index > 1) return _fail(PROFILE_FIELDS);
+  if (!_number()) return false;
+  _index++;
+  _length = 0;
+  _gap = false;
+  return true;
+}
+
+boolean profileParser::_endLine() {
+  if (!_index && !_length) return true;  // blank or comment line
+  if (!_index) return _fail(PROFILE_SYNTAX);  // no duration
+  profileStep s;
+  s.segment = SEGMENT_HOLD;
+  if (_index == 1) {
+    if (!_number()) return false;
+  }
+  else {
+    _field[_length] = 0;
+    if (!strcasecmp(_field, "hold")) s.segment = SEGMENT_HOLD;
+    else if (!strcasecmp(_field, "ramp")) s.segment = SEGMENT_RAMP;
+    else if (!strcasecmp(_field, "exp")) s.segment = SEGMENT_EXP;
+    else if (!strcasecmp(_field, "wait")) s.segment = SEGMENT_WAIT;
+    else return _fail(PROFILE_SYNTAX);
+  }
+  boolean skip = (_index == 1) && !_temp && !_minutes;  // "0,0" steps were always skipped
+  _index = 0;
+  _length = 0;
+  _gap = false;
+  if (skip) return true;
+  s.temp = _temp;
+  s.minutes = _minutes;
+  return _table->add(s) || _fail(PROFILE_FULL);
+}
+
+boolean profileParser::feed(const char* buf, int n) {
+  if (_error) return false;
+  for (int i = 0; i < n; i++) {
+    char c = buf[i];
+    if (c == '\n') {
+      if (!_endLine()) return false;
+      _comment = false;
+      _line++;
+      continue;
+    }
+    if (_comment || (c == '\r')) continue;
+    if (c == '#') _comment = true;
+    else if ((c == ' ') || (c == '\t')) _gap = (_length > 0);
+    else if (c == ',') {
+      if (!_endField()) return false;
+    }
+    else {
+      if (_gap) return _fail(PROFILE_SYNTAX);  // "18 5"
+      if (_length >= profileFieldMax) return _fail(PROFILE_LONG);
+      _field[_length++] = c;
+    }
+  }
+  return true;
+}
+
+byte profileParser::finish() {
+  if (!_error && _endLine() && !_table->count()) _fail(PROFILE_EMPTY);  // last line may lack its newline
+  return _error;
+}
+
+boolean profileParser::parseFixed(const char* s, long* v) {  // [+-]digits[.digits]; no strtod
+  boolean negative = (*s == '-');
+  if ((*s == '-') || (*s == '+')) s++;
+  long value = 0;
+  byte digits = 0, decimals = 0;
+  boolean point = false, round = false;
+  for (; *s; s++) {
+    if (*s == '.') {
+      if (point) return false;
+      point = true;
+    }
+    else if ((*s >= '0') && (*s <= '9')) {
+      digits++;
+      if (!point || (decimals < 2)) {
+        if (value > 9999999L) return false;  // out of any range, and long enough to overflow
+        value = value * 10 + (*s - '0');
+        if (point) decimals++;
+      }
+      else if (decimals++ == 2) round = (*s >= '5');  // third decimal rounds
+    }
+    else return false;
+  }
+  if (!digits) return false;
+  for (; decimals < 2; decimals++) value *= 10;
+  if (round) value++;
+  *v = negative ? -value : value;
+  return true;
+}
+
+void profileRunner::begin(byte step, uint32_t start, int16_t from) {
+  _step = min(step, _table->count());
+  _start = start;
+  _from = from;
+}
+
+double profileRunner::target() {
+  if (!_table->count()) return 0;
+  return profileTable::toTemp(_table->step(min(_step, _table->count() - 1)).temp);
+}
+
+boolean profileRunner::update(uint32_t now, double beer, double* setpoint) {
+  boolean started = false;
+  while (_step < _table->count()) {
+    const profileStep& s = _table->step(_step);
+    double to = profileTable::toTemp(s.temp), from = profileTable::toTemp(_from);
+    uint32_t elapsed = (now > _start) ? now - _start : 0;  // s
+    uint32_t length = s.minutes * 60UL;
+    boolean done = (elapsed >= length);
+    switch (s.segment) {
+      case SEGMENT_RAMP:
+        *setpoint = done ? to : from + (to - from) * elapsed / length;
+        break;
+      case SEGMENT_EXP:
+        *setpoint = done ? to : to + (from - to) * exp(-5.0 * elapsed / length);
+        break;
+      case SEGMENT_WAIT:
+        *setpoint = to;
+        done = (abs(beer - to) <= profileWaitBand) || (length && done);
+        if (done) length = elapsed;  // the next step starts now
+        break;
+      default:
+        *setpoint = to;
+    }
+    if (!done) break;
+    _from = s.temp;  // next step, at the nominal end of this one
+    _start += length;
+    _step++;
+    started = true;
+  }
+  return started;
+}
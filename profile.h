@@ -0,0 +1,117 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "Arduino.h"
+
+// fermentation temperature profiles.  a profile is a text file in /PROFILES/ on the SD card, one step per
+// line:
+//
+//   temperature,duration[,segment]   deg C and hours, decimals allowed (2 places kept), e.g. "18.5,72"
+//
+// segment is how the setpoint gets to the temperature:
+//   hold   jump to it and hold for the duration (the default)
+//   ramp   linear from the previous setpoint, reaching it at the end of the duration
+//   exp    exponential approach from the previous setpoint (time constant duration / 5), then hold
+//   wait   jump to it and wait until the beer is within profileWaitBand of it; the duration is a timeout
+//          (0: none)
+// blank lines and anything after '#' are ignored, as are spaces, tabs and CR.  a "0,0" step is skipped.
+//
+// profileParser streams the file in blocks of any size (no line buffer, only the current field) and
+// validates every line; the first error stops it with its line number.  steps go into a fixed capacity
+// profileTable in a packed form (5 bytes), so the step running before a reset is found by index.
+//
+// profileRunner evaluates the running step from the RTC time it started and the setpoint it started from,
+// once per sample, so a ramp moves smoothly and the profile resumes at the exact point after a reset (the
+// settings record keeps the step, its start time and start setpoint).  timed steps chain at their
+// nominal end times: a late sample, or a reset, does not stretch the profile.
+
+const byte profileMaxSteps = 32;       // profileTable capacity (5 bytes each)
+const byte profileFieldMax = 10;       // characters in a number
+const byte profileBlockSize = 64;      // bytes read from the file per parser feed
+const int profileMinTemp = -1000;      // 0.01 deg C
+const int profileMaxTemp = 4000;
+const double profileWaitBand = 0.2;    // deg C; a wait step ends when the beer is this close
+
+enum profileError {
+  PROFILE_OK,
+  PROFILE_SYNTAX,     // not a number, unknown segment, or a line without a duration
+  PROFILE_FIELDS,     // more than three fields
+  PROFILE_LONG,       // number longer than profileFieldMax
+  PROFILE_RANGE,      // temperature or duration out of range
+  PROFILE_FULL,       // more than profileMaxSteps steps
+  PROFILE_EMPTY,      // no steps
+  PROFILE_READ,       // SD read error
+};
+
+enum profileSegment {
+  SEGMENT_HOLD,
+  SEGMENT_RAMP,
+  SEGMENT_EXP,
+  SEGMENT_WAIT,
+};
+
+struct profileStep {
+  int16_t temp;       // 0.01 deg C
+  uint16_t minutes;
+  byte segment;
+};
+
+class profileTable {
+    profileStep _steps[profileMaxSteps];
+    byte _count;
+
+  public:
+    profileTable() : _count(0) {}
+    void clear() { _count = 0; }
+    boolean add(const profileStep& s);
+    byte count() { return _count; }
+    const profileStep& step(byte i) { return _steps[i]; }
+    static double toTemp(int16_t t) { return t / 100.0; }  // deg C
+};
+
+class profileParser {
+    profileTable* _table;
+    unsigned int _line;       // line being parsed, from 1
+    char _field[profileFieldMax + 1];
+    byte _length;
+    byte _index;              // field of the line: 0 temperature, 1 duration, 2 segment
+    boolean _gap;             // whitespace after the field's characters
+    boolean _comment;         // rest of the line is a comment
+    long _temp;               // parsed temperature field
+    long _minutes;            // parsed duration field
+    byte _error;
+
+    boolean _endField();
+    boolean _number();        // temperature or duration field complete
+    boolean _endLine();
+    boolean _fail(byte error) { _error = error; return false; }
+
+  public:
+    profileParser() : _table(0), _error(PROFILE_OK) {}
+    void begin(profileTable* table);  // clears the table
+    boolean feed(const char* buf, int n);  // false once an error is found
+    byte finish();            // end of file; returns profileError
+    void fail(byte error) { _fail(error); }
+    byte error() { return _error; }
+    unsigned int line() { return _line; }
+
+    static boolean parseFixed(const char* s, long* v);  // decimal number -> value x 100, rounded
+};
+
+class profileRunner {
+    profileTable* _table;
+    byte _step;               // running step; count() when the profile has finished
+    uint32_t _start;          // RTC time the running step started (s)
+    int16_t _from;            // setpoint it started from, 0.01 deg C
+
+  public:
+    profileRunner(profileTable* table) : _table(table), _step(0), _start(0), _from(0) {}
+    void begin(byte step, uint32_t start, int16_t from);  // start (or resume) at step
+    boolean update(uint32_t now, double beer, double* setpoint);  // true when a step started
+    byte step() { return _step; }
+    uint32_t start() { return _start; }
+    int16_t from() { return _from; }
+    double target();          // temperature of the running (or last) step, deg C
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "scheduler.h"
+
+scheduler::scheduler() {
+  _slots = 0;
+  _current = 0;
+  memset(_tasks, 0, sizeof(_tasks));
+}
+
+byte scheduler::_slot() {  // first free slot (one-shot slots are reused once they have run)
+  for (byte i = 0; i < _slots; i++) if (!_tasks[i].active) return i;
+  return (_slots < schedMaxTasks) ? _slots++ : schedNone;
+}
+
+byte scheduler::every(unsigned long periodMs, void (*fn)(), byte priority, const __FlashStringHelper* name) {
+  byte id = _slot();
+  if (id == schedNone) return id;
+  task& t = _tasks[id];
+  memset(&t, 0, sizeof(t));
+  t.fn = fn;
+  t.name = name;
+  t.period = max(periodMs, 1UL);
+  t.deadline = millis();
+  t.priority = priority;
+  t.active = true;
+  return id;
+}
+
+byte scheduler::once(unsigned long delayMs, void (*fn)(), byte priority, const __FlashStringHelper* name) {
+  byte id = _slot();
+  if (id == schedNone) return id;
+  task& t = _tasks[id];
+  memset(&t, 0, sizeof(t));
+  t.fn = fn;
+  t.name = name;
+  t.deadline = millis() + delayMs;
+  t.priority = priority;
+  t.active = true;
+  return id;
+}
+
+void scheduler::wake(byte id) {
+  if ((id < _slots) && _tasks[id].active) _tasks[id].deadline = millis();
+}
+
+void scheduler::cancel(byte id) {
+  if (id < _slots) _tasks[id].active = false;
+}
+
+void scheduler::setPeriod(byte id, unsigned long periodMs) {
+  if ((id < _slots) && _tasks[id].period) _tasks[id].period = max(periodMs, 1UL);
+}
+
+byte scheduler::run(byte minPriority) {
+  unsigned int done = 0;  // one bit per slot: each task runs at most once per pass
+  byte count = 0;
+  unsigned long now = millis();
+  while (true) {
+    byte best = schedNone;
+    for (byte i = 0; i < _slots; i++) {
+      const task& t = _tasks[i];
+      if (!t.active || (done & (1U << i)) || (t.priority < minPriority) || ((int32_t)(now - t.deadline) < 0)) continue;
+      if ((best == schedNone) || (t.priority > _tasks[best].priority)
+          || ((t.priority == _tasks[best].priority) && ((int32_t)(t.deadline - _tasks[best].deadline) < 0))) best = i;
+    }
+    if (best == schedNone) return count;
+    done |= 1U << best;
+    _execute(best, now);
+    count++;
+    now = millis();
+  }
+}
+
+void scheduler::_execute(byte id, unsigned long now) {
+  task& t = _tasks[id];
+  unsigned long lateMs = (uint32_t)(now - t.deadline);
+  _current = id;
+  unsigned long start = micros();
+  t.fn();
+  unsigned long us = (uint32_t)(micros() - start);
+  t.stats.runs++;
+  t.stats.totalUs += us;
+  if (us > t.stats.maxUs) t.stats.maxUs = us;
+  if (!t.period) {  // one-shot: free the slot
+    t.active = false;
+    return;
+  }
+  if (lateMs >= t.period) t.stats.late++;
+  if (us > t.period * 1000UL) t.stats.overruns++;
+  t.deadline += t.period;
+  if ((int32_t)(millis() - t.deadline) >= (int32_t)t.period) t.deadline = millis();  // drop missed releases
+}
@@ -0,0 +1,62 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "Arduino.h"
+
+// cooperative scheduler.  tasks are plain functions that return quickly; each is registered as periodic
+// (every()) or one-shot (once()) with a priority.  run() executes every released task once: highest
+// priority first, earliest deadline first within a priority.  a periodic task keeps its phase (its next
+// deadline is the last one plus the period), so a late release is caught up on the next pass; when a
+// whole period or more has been missed the lost releases are dropped and counted as late instead of
+// being run back to back.  a run longer than the task's period is counted as an overrun.
+
+enum taskPriority {  // lowest first
+  TASK_DISPLAY,      // LCD, encoder and menu
+  TASK_LOGGING,
+  TASK_RELAYS,
+  TASK_CONTROL,      // sensors, profile, PID
+};
+
+const byte schedMaxTasks = 16;  // run() marks the tasks done in an unsigned int
+const byte schedNone = 0xFF;
+
+struct taskStats {
+  unsigned long runs;
+  unsigned long totalUs;   // execution time, for the mean
+  unsigned long maxUs;
+  unsigned long late;      // releases started a full period or more after their deadline
+  unsigned long overruns;  // runs longer than the period
+};
+
+struct task {
+  void (*fn)();
+  const __FlashStringHelper* name;
+  unsigned long period;    // ms, 0 = one-shot
+  unsigned long deadline;  // ms, next release
+  byte priority;
+  boolean active;
+  taskStats stats;
+};
+
+class scheduler {
+    task _tasks[schedMaxTasks];
+    byte _slots;    // slots ever used
+    byte _current;  // running task
+
+    byte _slot();
+    void _execute(byte id, unsigned long now);
+
+  public:
+    scheduler();
+    byte every(unsigned long periodMs, void (*fn)(), byte priority, const __FlashStringHelper* name);  // first release now
+    byte once(unsigned long delayMs, void (*fn)(), byte priority, const __FlashStringHelper* name = 0);
+    void wake(byte id);    // release now; a periodic task continues from the new phase
+    void cancel(byte id);
+    void setPeriod(byte id, unsigned long periodMs);  // periodic task: takes effect after its next release
+    byte run(byte minPriority = TASK_DISPLAY);  // run the released tasks of at least minPriority once each; returns the count
+    unsigned long deadline() { return _tasks[_current].deadline; }  // release time of the running task, ms
+    byte getSlots() { return _slots; }
+    const task* getTask(byte id) { return (id < _slots) ? &_tasks[id] : 0; }
+};
+
+#endif
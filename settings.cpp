@@ -0,0 +1,198 @@
+#include "settings.h"
+
+uint16_t settingsStore::crc16(const byte* data, byte len) {  // CRC-16/CCITT, as the telemetry frames
+  uint16_t crc = 0xFFFF;
+  for (byte i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (byte b = 0; b < 8; b++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+static void putFloat(byte* p, double v) {
+  float f = v;
+  memcpy(p, &f, 4);
+}
+
+static double getFloat(const byte* p) {
+  float f;
+  memcpy(&f, p, 4);
+  return f;
+}
+
+settingsStore::settingsStore(unsigned int base, byte slots) {
+  _capture = 0;
+  _base = base;
+  _slots = slots;
+  _slot = slots;
+  _seq = 0;
+  _pos = settingsSlotSize;
+  _dirty = false;
+  _first = _last = 0;
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+byte settingsStore::begin(settingsRecord& r, void (*capture)(settingsRecord&)) {
+  _capture = capture;
+  byte slot[settingsSlotSize];
+  byte newest[settingsSlotSize];
+  for (byte i = 0; i < _slots; i++) {
+    EEPROMRead(_base + i * settingsSlotSize, slot, settingsSlotSize);
+    if (slot[0] != settingsMagic) continue;  // never written (0xFF)
+    if (!check(slot)) {
+      _stats.badSlots++;
+      continue;
+    }
+    uint16_t seq = slot[2] | (uint16_t)slot[3] << 8;
+    if ((_slot == _slots) || ((int16_t)(seq - _seq) > 0)) {  // sequence numbers wrap
+      _slot = i;
+      _seq = seq;
+      memcpy(newest, slot, settingsSlotSize);
+    }
+  }
+  if ((_slot < _slots) && _unpack(newest, r)) {
+    _stats.source = (newest[1] == settingsSchema) ? SETTINGS_RING : SETTINGS_MIGRATED;
+  } else {
+    _slot = _slots;
+    byte ver;
+    EEPROMRead(0, &ver, BYTE);
+    if (ver == settingsLegacyVer) {
+      _importLegacy(r);
+      _stats.source = SETTINGS_LEGACY;
+    }
+    else _stats.source = SETTINGS_NONE;
+  }
+  if ((_stats.source == SETTINGS_MIGRATED) || (_stats.source == SETTINGS_LEGACY)) commit();  // store in the current schema
+  return _stats.source;
+}
+
+void settingsStore::change() {
+  unsigned long now = millis();
+  if (!_dirty) _first = now;
+  _last = now;
+  _dirty = true;
+}
+
+void settingsStore::commit() {
+  change();
+  _first = millis() - settingsMaxDelayMs;  // due now
+}
+
+void settingsStore::_start() {  // capture the live settings into the next slot's image
+  settingsRecord r;
+  _capture(r);
+  pack(r, ++_seq, _buf);
+  _pos = 0;
+  _dirty = false;
+}
+
+boolean settingsStore::_write(byte cells) {  // true when the slot is complete
+  byte next = (_slot + 1 >= _slots) ? 0 : _slot + 1;
+  unsigned int addr = _base + next * settingsSlotSize;
+  while ((_pos < settingsSlotSize) && cells) {
+    if (EEPROMWrite(addr + _pos, &_buf[_pos], BYTE)) {  // cells that already hold the value cost nothing
+      _stats.cells++;
+      cells--;
+    }
+    _pos++;
+  }
+  if (_pos < settingsSlotSize) return false;
+  _slot = next;
+  _stats.commits++;
+  return true;
+}
+
+void settingsStore::poll() {
+  if (_pos < settingsSlotSize) {
+    _write(settingsCellsPerPoll);
+    return;
+  }
+  if (!_dirty || !_capture) return;
+  unsigned long now = millis();
+  if (((uint32_t)(now - _last) < settingsQuietMs) && ((uint32_t)(now - _first) < settingsMaxDelayMs)) return;
+  _start();
+  _write(settingsCellsPerPoll);
+}
+
+void settingsStore::flush() {
+  if (_pos < settingsSlotSize) _write(settingsSlotSize);  // finish a commit in progress
+  if (!_dirty || !_capture) return;
+  _start();
+  _write(settingsSlotSize);
+}
+
+void settingsStore::pack(const settingsRecord& r, uint16_t seq, byte* slot) {
+  memset(slot, 0, settingsSlotSize);
+  slot[0] = settingsMagic;
+  slot[1] = settingsSchema;
+  slot[2] = seq & 0xFF;
+  slot[3] = seq >> 8;
+  slot[4] = r.programState;
+  const double v[10] = { r.setpoint, r.output, r.kp, r.ki, r.kd, r.heatOutput, r.heatKp, r.heatKi, r.heatKd,
+                         r.peakEstimator };
+  for (byte i = 0; i < 10; i++) putFloat(slot + 5 + 4 * i, v[i]);
+  slot[45] = r.logFile;
+  memcpy(slot + 46, r.profile, 8);
+  slot[54] = r.profileStep & 0xFF;
+  slot[55] = r.profileStep >> 8;
+  for (byte i = 0; i < 4; i++) slot[56 + i] = r.profileStart >> (8 * i);
+  slot[60] = r.profileFrom & 0xFF;
+  slot[61] = (unsigned int)r.profileFrom >> 8;
+  uint16_t crc = crc16(slot, settingsSlotSize - 2);
+  slot[settingsSlotSize - 2] = crc & 0xFF;
+  slot[settingsSlotSize - 1] = crc >> 8;
+}
+
+boolean settingsStore::check(const byte* slot) {
+  uint16_t crc = slot[settingsSlotSize - 2] | (uint16_t)slot[settingsSlotSize - 1] << 8;
+  return (slot[0] == settingsMagic) && (crc16(slot, settingsSlotSize - 2) == crc);
+}
+
+boolean settingsStore::_unpack(const byte* slot, settingsRecord& r) {  // any known schema; false if unknown
+  switch (slot[1]) {
+    case 1:
+    case 2:
+    case 3: {
+      r.programState = slot[4];
+      double* v[10] = { &r.setpoint, &r.output, &r.kp, &r.ki, &r.kd, &r.heatOutput, &r.heatKp, &r.heatKi, &r.heatKd,
+                        &r.peakEstimator };
+      for (byte i = 0; i < 10; i++) *v[i] = getFloat(slot + 5 + 4 * i);
+      r.logFile = slot[45];
+      memcpy(r.profile, slot + 46, 8);
+      r.profile[8] = 0;
+      r.profileStep = slot[54] | (unsigned int)slot[55] << 8;
+      r.profileStart = 0;
+      r.profileFrom = 0;
+      if (slot[1] < 3) _heatDefaults(r);
+      if (slot[1] == 1) return true;
+      for (byte i = 0; i < 4; i++) r.profileStart |= (unsigned long)slot[56 + i] << (8 * i);
+      r.profileFrom = (int16_t)(slot[60] | (unsigned int)slot[61] << 8);
+      return true;
+    }
+  }
+  return false;  // written by a newer firmware
+}
+
+void settingsStore::_importLegacy(settingsRecord& r) {  // fixed addresses of EEPROM_VER 11
+  EEPROMRead(1, &r.programState, BYTE);
+  double* v[10] = { &r.setpoint, &r.output, &r.kp, &r.ki, &r.kd, &r.heatOutput, &r.heatKp, &r.heatKi, &r.heatKd,
+                    &r.peakEstimator };
+  for (byte i = 0; i < 10; i++) EEPROMRead(2 + 4 * i, v[i], DOUBLE);
+  char digits[2];
+  EEPROMRead(42, digits, 2);
+  r.logFile = (digits[0] - '0') * 10 + (digits[1] - '0');
+  EEPROMRead(44, r.profile, 8);
+  r.profile[8] = 0;
+  uint16_t step;
+  EEPROMRead(52, &step, INT);
+  r.profileStep = step;
+  r.profileStart = 0;
+  r.profileFrom = 0;
+  _heatDefaults(r);
+}
+
+void settingsStore::_heatDefaults(settingsRecord& r) {  // heat gains older than schema 3 worked on no process value
+  r.heatKp = settingsHeatKp;
+  r.heatKi = settingsHeatKi;
+  r.heatKd = settingsHeatKd;
+}
@@ -0,0 +1,101 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include "Arduino.h"
+#include "EEPROMio.h"
+
+// program settings, kept in EEPROM as a log-structured ring of records.  every commit writes the whole
+// record to the slot after the newest one, so writes are spread over all slots (62 on a Mega) instead of
+// hitting the same cells; at start the newest slot with a good CRC wins.  a commit cut short by a power
+// loss leaves a slot with a bad CRC and the previous record stands.
+//
+// changes are batched: change() marks the settings dirty and the record is committed once nothing has
+// changed for settingsQuietMs, or settingsMaxDelayMs after the first change.  poll() writes the record a
+// few cells per call (each EEPROM cell takes 3.4 ms), so a commit never stalls the control tasks.
+//
+// slot layout (settingsSlotSize bytes, little endian, floats IEEE 754 single):
+//   0 settingsMagic, 1 schema, 2-3 sequence number, 4.. record (schema layout), zero padded,
+//   last two bytes CRC-16/CCITT of everything before them
+// schema 2 record: 4 programState, 5-44 main setpoint, main output, Kp, Ki, Kd, heat output, heat Kp,
+//   heat Ki, heat Kd, peak estimator, 45 log file number, 46-53 profile name (8.3 base name, 0 padded),
+//   54-55 profile step, 56-59 RTC time the step started, 60-61 setpoint it started from (0.01 deg C)
+// schema 3 keeps the schema 2 layout; it marks heat PID gains made for a measured air temperature (heatPID
+//   had no process value before, so older gains are replaced by the defaults below on migration)
+// schema 1 ended at 55 (no step start: a migrated profile restarts its running step)
+// older schemas are read with their own layout and upgraded in RAM; the next commit writes the current
+// schema.  before the ring existed settings were stored at fixed addresses 0-53 (EEPROM_VER 11), those are
+// imported once when the ring is empty.  EEPROM 64-127 belongs to the probeBus ROM cache.
+
+const byte settingsMagic = 0x5E;
+const byte settingsSchema = 3;             // bump when the record layout or meaning changes; add the old one to _unpack()
+const byte settingsLegacyVer = 11;         // EEPROM_VER of the fixed address layout
+const unsigned int settingsBase = 128;     // first slot
+const byte settingsSlotSize = 64;
+const byte settingsSlots = 62;             // 128-4095
+const unsigned long settingsQuietMs = 5000;    // commit after this long without a change
+const unsigned long settingsMaxDelayMs = 60000;  // or at most this long after the first change
+const byte settingsCellsPerPoll = 2;       // EEPROM cells written per poll() (~7 ms)
+const double settingsHeatKp = 3.7E5;       // default heat PID gains (ms of duty per window per deg C; relay tuned on
+const double settingsHeatKi = 175.0;       //   the host chamber model), also given to records older than schema 3
+const double settingsHeatKd = 5.5E7;
+
+enum settingsSource {  // where begin() found the settings
+  SETTINGS_NONE,       // nothing usable: the caller sets defaults and commits
+  SETTINGS_RING,       // newest good record, current schema
+  SETTINGS_MIGRATED,   // newest good record, older schema (rewritten in the current one)
+  SETTINGS_LEGACY,     // fixed address layout (rewritten as a record)
+};
+
+struct settingsRecord {
+  byte programState;
+  double setpoint, output, kp, ki, kd;
+  double heatOutput, heatKp, heatKi, heatKd;
+  double peakEstimator;
+  byte logFile;            // LOGGERnn.BIN
+  char profile[9];         // profile base name
+  unsigned int profileStep; // running step, from 1; 0 = not started
+  unsigned long profileStart;  // RTC time the step started, 0 = unknown
+  int profileFrom;         // setpoint the step started from, 0.01 deg C
+};
+
+struct settingsStats {
+  unsigned long commits;   // records completed
+  unsigned long cells;     // EEPROM cells written (cells that already held the value are skipped)
+  byte badSlots;           // slots with a magic byte but a bad CRC at begin() (torn writes)
+  byte source;             // settingsSource
+};
+
+class settingsStore {
+    void (*_capture)(settingsRecord&);  // fills a record from the live settings at commit time
+    unsigned int _base;
+    byte _slots;
+    byte _slot;               // slot of the newest good record (_slots: none)
+    uint16_t _seq;
+    byte _buf[settingsSlotSize];  // slot being written
+    byte _pos;                // next byte of _buf to write; settingsSlotSize when idle
+    boolean _dirty;
+    unsigned long _first, _last;  // millis() of the first and last change since the last commit
+    settingsStats _stats;
+
+    void _start();
+    boolean _write(byte cells);
+    static boolean _unpack(const byte* slot, settingsRecord& r);
+    static void _importLegacy(settingsRecord& r);
+    static void _heatDefaults(settingsRecord& r);
+
+  public:
+    settingsStore(unsigned int base = settingsBase, byte slots = settingsSlots);
+    byte begin(settingsRecord& r, void (*capture)(settingsRecord&));  // load the newest record; returns settingsSource
+    void change();            // a setting changed; committed once quiet
+    void commit();            // start a commit on the next poll()
+    void flush();             // write everything pending now (blocking), e.g. before a reset
+    void poll();              // scheduler task
+    boolean busy() { return _dirty || (_pos < settingsSlotSize); }
+    const settingsStats& getStats() { return _stats; }
+
+    static void pack(const settingsRecord& r, uint16_t seq, byte* slot);
+    static boolean check(const byte* slot);  // magic and CRC
+    static uint16_t crc16(const byte* data, byte len);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef SLOPE_HISTORY_H
+#define SLOPE_HISTORY_H
+
+#include "Arduino.h"
+
+// decimated sample window for slope estimates, as used by the PID derivative term.
+//
+//   slopeHistory<SAMPLE, SUM, CAPACITY> h;
+//
+// every decimation-th sample() call stores the sample in a ring of `length` (<= CAPACITY) entries; insert
+// is O(1), nothing is shifted.  running sums over the window are kept on insert so that both slope
+// estimates are O(1):
+//   delta()      newest - oldest (endpoint difference)
+//   numerator()  sum (2i - (length-1)) * y_i, i = 0 (oldest) .. length-1; times scale() this is the
+//                least squares slope per stored sample
+// SUM is the accumulator type: double for floating point samples, int64_t for integer samples (exact).
+// the sums are rebuilt from the ring each time it wraps, so floating point rounding cannot build up.
+
+#define SLOPE_ENDPOINT 0    // slope from the oldest and newest samples of the window
+#define SLOPE_REGRESSION 1  // least squares slope over the whole window
+
+template <typename T, typename S, byte N> class slopeHistory {
+    static_assert(N >= 2, "a slope needs two samples");
+    T _v[N];
+    S _sumY, _sumIY;     // sum y_i and sum i * y_i, i = 0 (oldest) .. _length-1
+    byte _head;          // oldest sample, next to be replaced
+    byte _length, _decimation, _count;
+
+    void _resync() {
+      _sumY = _sumIY = 0;
+      byte j = _head;
+      for (byte i = 0; i < _length; i++) {
+        _sumY += _v[j];
+        _sumIY += (S)_v[j] * i;
+        j = (j + 1 == _length) ? 0 : j + 1;
+      }
+    }
+
+  public:
+    slopeHistory() : _head(0), _length(N), _decimation(1), _count(0) { fill(0); }
+
+    void configure(byte length, byte decimation, T v) {  // window length (2..N) and decimation (>= 1), refilled with v
+      _length = constrain(length, 2, N);
+      _decimation = max(decimation, (byte)1);
+      _count = 0;
+      fill(v);
+    }
+
+    void fill(T v) {  // flat window at v; the decimation phase is kept
+      for (byte i = 0; i < _length; i++) _v[i] = v;
+      _head = 0;
+      _resync();
+    }
+
+    bool sample(T v) {  // true when v was stored
+      if (++_count < _decimation) return false;
+      _count = 0;
+      T old = _v[_head];
+      _v[_head] = v;
+      if (++_head == _length) {
+        _head = 0;
+        _resync();
+      } else {  // every sample moves one place older
+        _sumIY += (S)v * (_length - 1) - (_sumY - old);
+        _sumY += (S)v - old;
+      }
+      return true;
+    }
+
+    T newest() { return _v[(_head ? _head : _length) - 1]; }
+    T oldest() { return _v[_head]; }
+    T delta() { return newest() - oldest(); }
+    S numerator() { return 2 * _sumIY - _sumY * (_length - 1); }
+    double scale() { return 6.0 / ((double)_length * ((double)_length * _length - 1)); }  // numerator() to slope
+    double slope() { return numerator() * scale(); }  // least squares, per stored sample
+    byte length() { return _length; }
+    byte decimation() { return _decimation; }
+};
+
+#endif
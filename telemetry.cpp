@@ -0,0 +1,147 @@
+#include "telemetry.h"
+
+telemetry::telemetry() {
+  _port = 0;
+  _head = _tail = 0;
+  _seq = 0;
+  _rxLen = 0;
+  _rxOverflow = false;
+  _msgLen = 0;
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void telemetry::begin(HardwareSerial* port) {
+  _port = port;
+  _port->begin(telemBaud);
+}
+
+byte telemetry::room() {
+  return telemRingSize - 1 - (byte)((_head + telemRingSize - _tail) % telemRingSize);
+}
+
+boolean telemetry::send(byte type, const byte* body, byte len) {
+  byte frame[telemMaxFrame];
+  byte n = encode(type, _seq, body, len, frame);
+  if (n > room()) {
+    _stats.dropped++;
+    return false;
+  }
+  for (byte i = 0; i < n; i++) {
+    _ring[_head] = frame[i];
+    _head = (_head + 1) % telemRingSize;
+  }
+  _seq++;
+  _stats.sent++;
+  return true;
+}
+
+boolean telemetry::snapshot(const telemSnapshot& s) {
+  byte body[telemSnapshotSize];
+  packSnapshot(s, body);
+  return send(TELEM_SNAPSHOT, body, telemSnapshotSize);
+}
+
+boolean telemetry::poll() {
+  if (!_port) return false;
+  for (int room = _port->availableForWrite(); (room > 0) && (_tail != _head); room--) {
+    _port->write(_ring[_tail]);
+    _tail = (_tail + 1) % telemRingSize;
+  }
+  while (_port->available()) {
+    byte c = _port->read();
+    if (c) {
+      if (_rxLen < sizeof(_rx)) _rx[_rxLen++] = c;
+        else _rxOverflow = true;
+      continue;
+    }
+    byte n = (_rxLen && !_rxOverflow) ? decode(_rx, _rxLen, _msg) : 0;  // end of frame
+    if (_rxLen && !n) _stats.errors++;
+    _rxLen = 0;
+    _rxOverflow = false;
+    if (n) {
+      _msgLen = n;
+      _stats.received++;
+      return true;  // one message per call; the rest stays in the UART buffer
+    }
+  }
+  return false;
+}
+
+uint16_t telemetry::crc16(const byte* data, byte len) {
+  uint16_t crc = 0xFFFF;
+  for (byte i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (byte b = 0; b < 8; b++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+byte telemetry::encode(byte type, byte seq, const byte* body, byte len, byte* frame) {
+  byte msg[telemMaxBody + 4];
+  if (len > telemMaxBody) len = telemMaxBody;
+  msg[0] = type;
+  msg[1] = seq;
+  memcpy(msg + 2, body, len);
+  uint16_t crc = crc16(msg, len + 2);
+  msg[len + 2] = crc & 0xFF;
+  msg[len + 3] = crc >> 8;
+  byte n = len + 4;
+  byte code = 0, out = 1;  // COBS: each 0 is replaced by the distance to the next one
+  for (byte i = 0; i < n; i++) {
+    if (msg[i]) {
+      frame[out++] = msg[i];
+      if (out - code < 0xFF) continue;
+    }
+    frame[code] = out - code;
+    code = out++;
+  }
+  frame[code] = out - code;
+  frame[out++] = 0;
+  return out;
+}
+
+byte telemetry::decode(const byte* frame, byte len, byte* msg) {
+  byte n = 0, i = 0;
+  while (i < len) {
+    byte code = frame[i++];
+    if (!code || (i + code - 1 > len)) return 0;
+    for (byte j = 1; j < code; j++) msg[n++] = frame[i++];
+    if ((code < 0xFF) && (i < len)) msg[n++] = 0;
+  }
+  if (n < 4) return 0;
+  uint16_t crc = msg[n - 2] | (uint16_t)msg[n - 1] << 8;
+  return (crc16(msg, n - 2) == crc) ? n : 0;
+}
+
+void telemetry::putFloat(byte* p, double v) {
+  float f = v;
+  memcpy(p, &f, 4);  // AVR and x86 are both little endian
+}
+
+double telemetry::getFloat(const byte* p) {
+  float f;
+  memcpy(&f, p, 4);
+  return f;
+}
+
+void telemetry::packSnapshot(const telemSnapshot& s, byte* body) {
+  for (byte i = 0; i < 4; i++) body[i] = s.ms >> (8 * i);
+  body[4] = s.state;
+  body[5] = s.programState;
+  const double v[15] = { s.fridgeTemp, s.fridgeFilter, s.beerTemp, s.beerFilter, s.setpoint, s.output,
+                         s.mainP, s.mainI, s.mainD, s.heatSetpoint, s.heatOutput, s.heatP, s.heatI, s.heatD,
+                         s.peakEstimator };
+  for (byte i = 0; i < 15; i++) putFloat(body + 6 + 4 * i, v[i]);
+  body[66] = s.lost;
+}
+
+void telemetry::unpackSnapshot(const byte* body, telemSnapshot& s) {
+  s.ms = body[0] | (unsigned long)body[1] << 8 | (unsigned long)body[2] << 16 | (unsigned long)body[3] << 24;
+  s.state = body[4];
+  s.programState = body[5];
+  double* v[15] = { &s.fridgeTemp, &s.fridgeFilter, &s.beerTemp, &s.beerFilter, &s.setpoint, &s.output,
+                    &s.mainP, &s.mainI, &s.mainD, &s.heatSetpoint, &s.heatOutput, &s.heatP, &s.heatI, &s.heatD,
+                    &s.peakEstimator };
+  for (byte i = 0; i < 15; i++) *v[i] = getFloat(body + 6 + 4 * i);
+  s.lost = body[66];
+}
@@ -0,0 +1,125 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "Arduino.h"
+
+// binary telemetry and remote control on the serial port, replacing the DEBUG text output.
+//
+// a message is: type, sequence number, body, CRC-16/CCITT (poly 0x1021, init 0xFFFF, little endian) of
+// the bytes before it.  on the wire it is COBS encoded and ends with a 0 byte, so a receiver resyncs at
+// the next 0 after a damaged or partial frame.  frames are queued in a RAM ring and moved to the UART
+// buffer as it drains; a frame that does not fit the ring is dropped whole, so sending never blocks.
+//
+// board to host:
+//   TELEM_SNAPSHOT  state snapshot, telemSnapshotSize bytes (little endian, floats IEEE 754 single):
+//                   0-3 millis(), 4 fridge state, 5 programState, 6-65 fridge actual, fridge filter,
+//                   beer actual, beer filter, main setpoint, main output, main P, I and D terms, heat
+//                   setpoint, heat output, heat P, I and D terms, peak estimator, 66 lost probes (bit 0
+//                   beer, bit 1 fridge air: the chamber runs degraded)
+//   TELEM_ACK       0 command type, 1 status (telemAckStatus)
+//   TELEM_TRACE     one trace dump frame (trace.h)
+// host to board:
+//   CMD_SETPOINT    0-3 main setpoint (deg C), 4 chamber (optional, 0 when absent)
+//   CMD_OUTPUT      0 PID (telemPid), 1-4 output, manual mode only
+//   CMD_TUNINGS     0 PID, 1-12 Kp, Ki, Kd
+//   CMD_MODE        0 PID, 1 mode (MANUAL/AUTOMATIC)
+//   CMD_STREAM      0-1 snapshot period, ms (0 stops the stream)
+//   CMD_TRACE       0 trace command (traceDumpCmd/traceClearCmd)
+
+#ifndef TELEMETRY
+#define TELEMETRY true  // false: the serial port prints DEBUG text instead
+#endif
+
+#ifndef DEBUG           // debug flag for including debugging code (text on the serial port)
+#if TELEMETRY == true
+#define DEBUG false
+#else
+#define DEBUG true
+#endif
+#endif
+
+enum telemType {
+  TELEM_SNAPSHOT = 0x01,
+  TELEM_ACK = 0x02,
+  TELEM_TRACE = 0x03,
+  CMD_SETPOINT = 0x10,
+  CMD_OUTPUT = 0x11,
+  CMD_TUNINGS = 0x12,
+  CMD_MODE = 0x13,
+  CMD_STREAM = 0x14,
+  CMD_TRACE = 0x15,
+};
+
+enum telemAckStatus {
+  ACK_OK,
+  ACK_BAD_LENGTH,   // body does not match the command
+  ACK_BAD_VALUE,    // argument out of range
+  ACK_REFUSED,      // not in this state (e.g. setpoint while a profile runs, output in automatic)
+  ACK_UNKNOWN,      // command type not supported by this build
+};
+
+enum telemPid {
+  PID_MAIN,
+  PID_HEAT,
+};
+
+const unsigned long telemBaud = 115200;
+const byte telemSnapshotSize = 67;
+const byte telemMaxBody = telemSnapshotSize;  // largest body
+const byte telemMaxFrame = telemMaxBody + 6;  // type, seq, CRC, COBS overhead byte and the delimiter
+const byte telemRingSize = 160;               // TX ring: two snapshots and a few small frames
+
+struct telemSnapshot {
+  unsigned long ms;
+  byte state;
+  byte programState;
+  double fridgeTemp, fridgeFilter, beerTemp, beerFilter;
+  double setpoint, output, mainP, mainI, mainD;
+  double heatSetpoint, heatOutput, heatP, heatI, heatD;
+  double peakEstimator;
+  byte lost;
+};
+
+struct telemStats {
+  unsigned long sent;      // frames queued
+  unsigned long dropped;   // frames that did not fit the ring
+  unsigned long received;  // valid frames received
+  unsigned long errors;    // received frames with a bad COBS code, length or CRC
+};
+
+class telemetry {
+    HardwareSerial* _port;
+    byte _ring[telemRingSize];
+    byte _head, _tail;       // ring write and read positions
+    byte _seq;
+    byte _rx[telemMaxFrame - 1];  // COBS frame being received, without the delimiter
+    byte _rxLen;
+    boolean _rxOverflow;
+    byte _msg[telemMaxBody + 4];  // last decoded message: type, seq, body, CRC
+    byte _msgLen;
+    telemStats _stats;
+
+  public:
+    telemetry();
+    void begin(HardwareSerial* port);
+    boolean send(byte type, const byte* body, byte len);  // false if the frame was dropped
+    byte room();                        // free bytes in the TX ring (a frame takes its body + 6)
+    boolean snapshot(const telemSnapshot& s);
+    void ack(byte type, byte status) { byte b[2] = { type, status }; send(TELEM_ACK, b, 2); }
+    boolean poll();                     // move queued bytes to the UART; true when a message has arrived
+    byte type() { return _msg[0]; }     // the message poll() returned true for
+    const byte* body() { return _msg + 2; }
+    byte length() { return _msgLen - 4; }
+    const telemStats& getStats() { return _stats; }
+
+    // frame coding, shared with the host client
+    static uint16_t crc16(const byte* data, byte len);
+    static byte encode(byte type, byte seq, const byte* body, byte len, byte* frame);  // returns the frame length
+    static byte decode(const byte* frame, byte len, byte* msg);  // frame without the delimiter; 0 if invalid
+    static void packSnapshot(const telemSnapshot& s, byte* body);
+    static void unpackSnapshot(const byte* body, telemSnapshot& s);
+    static void putFloat(byte* p, double v);
+    static double getFloat(const byte* p);
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include "timeKeeper.h"
+
+timeKeeper::timeKeeper() : _anchor(0), _anchorMs(0), _drift(0), _edge(false), _state(TIME_IDLE), _syncMs(0) {
+  _stats.reads = _stats.syncs = _stats.failures = 0;
+  _stats.error = 0;
+}
+
+uint32_t timeKeeper::_read() {
+  _stats.reads++;
+  return RTC_DS1307::now().unixtime();
+}
+
+uint32_t timeKeeper::_elapsed(unsigned long ms) {
+  uint32_t e = ms - _anchorMs;  // modulo 2^32: correct across the millis() rollover
+  return e + (int32_t)(e * _drift);
+}
+
+void timeKeeper::begin() {
+  uint32_t first = _read(), t = first;
+  unsigned long start = millis();
+  while ((t == first) && ((uint32_t)(millis() - start) < timeWindowMs)) {  // wait for the seconds register to tick
+    delay(timePollMs);
+    t = _read();
+  }
+  _anchor = t;
+  _anchorMs = _syncMs = millis();
+  _edge = t != first;
+  _state = TIME_IDLE;
+}
+
+void timeKeeper::_sync(uint32_t t, unsigned long edgeMs) {  // RTC ticked to t at edgeMs
+  uint32_t e = edgeMs - _anchorMs;
+  long rtcMs = (long)(t - _anchor) * 1000;
+  _stats.error = rtcMs - (long)_elapsed(edgeMs);
+  if (_edge && (e >= timeSyncMs / 2)) {  // long enough a baseline between two timed ticks
+    double d = (double)rtcMs / e - 1;
+    if (abs(d) <= timeMaxDrift) _drift += (_stats.syncs ? timeDriftGain : 1) * (d - _drift);  // first measurement replaces the guess
+  }
+  _anchor = t;
+  _anchorMs = edgeMs;
+  _edge = true;
+  _stats.syncs++;
+}
+
+void timeKeeper::poll(unsigned long ms) {
+  switch (_state) {
+    case TIME_IDLE:
+      if ((uint32_t)(ms - _syncMs) < timeSyncMs) return;
+      _state = TIME_LEAD;
+      // fall through: the window may already be open
+    case TIME_LEAD:
+      if (subsecond(ms) < 1000 - timeLeadMs) return;  // window opens just before the predicted tick
+      _last = _read();
+      _windowMs = _pollMs = ms;
+      _state = TIME_EDGE;
+      return;
+    case TIME_EDGE: {
+      uint32_t t = _read();
+      if (t != _last) _sync(t, _pollMs + (uint32_t)(ms - _pollMs) / 2);  // ticked between the two polls
+        else if ((uint32_t)(ms - _windowMs) > timeWindowMs) {  // no tick: carry on from the extrapolated time
+          uint32_t e = _elapsed(ms);
+          _anchor += e / 1000;
+          _anchorMs = ms - e % 1000;
+          _edge = false;
+          _stats.failures++;
+        }
+        else {
+          _pollMs = ms;
+          return;
+        }
+      _syncMs = ms;
+      _state = TIME_IDLE;
+    }
+  }
+}
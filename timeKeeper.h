@@ -0,0 +1,67 @@
+#ifndef TIMEKEEPER_H
+#define TIMEKEEPER_H
+
+#include "Arduino.h"
+#include <RTClib.h>
+
+// wall time without bus traffic.  every RTC_DS1307::now() is an I2C transaction (~1 ms at 100 kHz); the
+// timeKeeper reads the DS1307 at boot and then once an hour, and in between extrapolates from millis():
+//
+//   now = anchor + (elapsed + elapsed * drift) / 1000,  elapsed = millis() - anchorMs
+//
+// the anchor is an RTC second edge: begin() polls the RTC until its seconds register ticks, and each
+// hourly sync opens a short polling window timeLeadMs before the predicted edge and times the tick to
+// the poll period.  the tick against the prediction gives the error of the millis() clock over the hour
+// (ceramic resonator boards run up to ~0.5 % off); drift follows it with gain timeDriftGain.  elapsed is
+// an unsigned difference, so the millis() rollover after 49.7 days is harmless as long as the anchor is
+// renewed more often than that: a sync that finds no tick (RTC stopped or missing) re-anchors on the
+// extrapolated time.  now() may step by the residual error at a sync, tens of ms once drift has settled.
+
+const unsigned long timeSyncMs = 3600000;  // RTC resync period, ms (1 h)
+const byte timePollMs = 20;                // poll period during a sync: resolution of the edge timing, ms
+const unsigned int timeLeadMs = 100;       // sync window opens this long before the predicted edge, ms
+const unsigned int timeWindowMs = 2500;    // give up on a tick after this long, ms
+const double timeDriftGain = 0.25;         // share of each measured drift taken into the estimate
+const double timeMaxDrift = 0.01;          // larger measurements are rejected (RTC adjusted), ms per ms
+
+enum timeSyncState {
+  TIME_IDLE,
+  TIME_LEAD,   // sync due, waiting for the window before the predicted edge
+  TIME_EDGE,   // polling the RTC for its next tick
+};
+
+struct timeStats {
+  unsigned long reads;     // RTC reads (I2C transactions)
+  unsigned long syncs;     // ticks timed after begin()
+  unsigned long failures;  // sync windows without a tick
+  long error;              // RTC - extrapolated time at the last sync, ms
+};
+
+class timeKeeper {
+    uint32_t _anchor;          // RTC time at the anchor, s
+    unsigned long _anchorMs;   // millis() at the anchor
+    double _drift;             // RTC ms gained per millis() ms
+    boolean _edge;             // anchor measured at a tick (drift can be measured against it)
+    byte _state;               // timeSyncState
+    uint32_t _last;            // RTC second when the window opened
+    unsigned long _windowMs;   // millis() when the window opened
+    unsigned long _pollMs;     // millis() of the previous poll in the window
+    unsigned long _syncMs;     // millis() of the last sync (or attempt)
+    timeStats _stats;
+
+    uint32_t _read();
+    uint32_t _elapsed(unsigned long ms);  // drift corrected ms since the anchor
+    void _sync(uint32_t t, unsigned long edgeMs);
+
+  public:
+    timeKeeper();
+    void begin();                      // anchor on the next RTC tick; blocks up to ~1 s
+    void poll(unsigned long ms);       // every timePollMs; reads the RTC only in a sync window
+    uint32_t now() { return now(millis()); }  // unix time, s
+    uint32_t now(unsigned long ms) { return _anchor + _elapsed(ms) / 1000; }
+    unsigned int subsecond(unsigned long ms) { return _elapsed(ms) % 1000; }  // ms into the second
+    double getDrift() { return _drift; }
+    const timeStats& getStats() { return _stats; }
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "trace.h"
+
+#if TRACE == true
+tracer trace;
+#endif
+
+tracer::tracer() {
+  _enabled = _dumping = false;
+  _watchdogMs = _dumpMs = 0;
+  _sent = 0;
+  _frame = 0;
+  clear();
+}
+
+void tracer::begin(unsigned long watchdogMs) {
+  _watchdogMs = watchdogMs;
+  _enabled = true;
+}
+
+void tracer::clear() {
+  memset(_hist, 0, sizeof(_hist));
+}
+
+void tracer::record(byte stage, unsigned long us) {
+  if (!_enabled || _dumping) return;
+  traceHist& h = _hist[stage];
+  byte b = us ? sizeof(us) * 8 - __builtin_clzl(us) : 0;  // bit length
+  if (b >= traceBuckets) b = traceBuckets - 1;
+  if (h.buckets[b] == 0xFFFF)
+    for (byte i = 0; i < traceBuckets; i++) h.buckets[i] >>= 1;
+  h.buckets[b]++;
+  h.count++;
+  h.sum += us;
+  if (us > h.max) h.max = us;
+}
+
+boolean tracer::command(int c) {
+  if (c == traceDumpCmd) {
+    if (!_dumping) {
+      _dumping = true;
+      _dumpMs = millis();
+      _sent = 0;
+      _frame = 0;
+    }
+    return true;
+  }
+  if (c == traceClearCmd) {
+    clear();
+    return true;
+  }
+  return false;
+}
+
+byte tracer::_imageByte(unsigned int i) {
+  uint64_t v;
+  byte shift;
+  if (i < traceHeaderSize) {
+    switch (i) {
+      case 0: return traceVersion;
+      case 1: return traceStages;
+      case 2: return traceBuckets;
+      case 3: return 0;
+    }
+    v = (i < 8) ? _dumpMs : _watchdogMs;
+    shift = i % 4;
+  } else {
+    const traceHist& h = _hist[(i - traceHeaderSize) / traceStageSize];
+    byte o = (i - traceHeaderSize) % traceStageSize;
+    if (o < 4) v = h.count;
+      else if (o < 8) v = h.max;
+      else if (o < 16) v = h.sum;
+      else v = h.buckets[(o - 16) / 2];
+    shift = (o < 8) ? o % 4 : (o < 16) ? o - 8 : o % 2;
+  }
+  return (byte)(v >> (8 * shift));
+}
+
+byte tracer::nextFrame(byte* frame) {
+  if (!_dumping) return 0;
+  byte len = min((unsigned int)traceFramePayload, traceImageSize - _sent);
+  frame[0] = traceSync[0];
+  frame[1] = traceSync[1];
+  frame[2] = _frame++;
+  frame[3] = len;
+  for (byte i = 0; i < len; i++) frame[4 + i] = _imageByte(_sent++);
+  frame[4 + len] = OneWire::crc8(frame + 2, len + 2);
+  if (_sent == traceImageSize) _dumping = false;
+  return len + 5;
+}
+
+boolean tracer::decode(const byte* image, unsigned int size, traceInfo& info, traceHist* hist) {
+  if ((size < traceHeaderSize) || (image[0] != traceVersion)) return false;
+  info.version = image[0];
+  info.stages = image[1];
+  info.buckets = image[2];
+  if ((info.stages != traceStages) || (info.buckets != traceBuckets) || (size != traceImageSize)) return false;
+  info.ms = image[4] | (unsigned long)image[5] << 8 | (unsigned long)image[6] << 16 | (unsigned long)image[7] << 24;
+  info.watchdogMs = image[8] | (unsigned long)image[9] << 8 | (unsigned long)image[10] << 16 | (unsigned long)image[11] << 24;
+  for (byte s = 0; s < traceStages; s++) {
+    const byte* p = image + traceHeaderSize + s * traceStageSize;
+    traceHist& h = hist[s];
+    h.count = p[0] | (unsigned long)p[1] << 8 | (unsigned long)p[2] << 16 | (unsigned long)p[3] << 24;
+    h.max = p[4] | (unsigned long)p[5] << 8 | (unsigned long)p[6] << 16 | (unsigned long)p[7] << 24;
+    h.sum = 0;
+    for (byte i = 0; i < 8; i++) h.sum |= (uint64_t)p[8 + i] << (8 * i);
+    for (byte b = 0; b < traceBuckets; b++) h.buckets[b] = p[16 + 2 * b] | (uint16_t)p[17 + 2 * b] << 8;
+  }
+  return true;
+}
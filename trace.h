@@ -0,0 +1,107 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "Arduino.h"
+#include <OneWire.h>
+
+// hot path tracing.  with TRACE true the sketch times its stages with micros() and keeps a log2 histogram
+// per stage; with TRACE false (the default) the TRACE_ macros expand to nothing and no RAM is used.
+//
+//   TRACE_BEGIN(stage) ... TRACE_END(stage)   time the code in between (same scope)
+//   TRACE_VALUE(stage, us)                    record a measured value
+//   TRACE_INTERVAL(stage)                     record the time since this macro last ran
+//
+// bucket 0 holds 0 us, bucket b holds [2^(b-1), 2^b) us, the last bucket everything above.  buckets are
+// 16 bit; when one would overflow all buckets of that stage are halved, so the shape is kept (count, sum
+// and max stay exact).  recording stops while a dump is being sent.
+//
+// dump: the sketch answers traceDumpCmd with the histograms, framed so that the frames survive other
+// output (debug prints) between them; each frame is handed to the port in one piece.  with TELEMETRY the
+// command arrives as CMD_TRACE and every frame travels as the body of a TELEM_TRACE message.  a frame is:
+//   0-1 traceSync, 2 frame index, 3 payload length (<= traceFramePayload), payload, CRC-8 of bytes 2..end
+// the payloads, concatenated in index order, form the image (little endian):
+//   0 traceVersion, 1 stage count, 2 bucket count, 3 reserved, 4-7 millis() at the dump,
+//   8-11 watchdog timeout (ms), then per stage: count (4), max us (4), sum us (8), buckets (2 each)
+
+#ifndef TRACE
+#define TRACE false  // true: build the sketch with tracing
+#endif
+
+enum traceStage {
+  TRACE_PROBE,   // probe bus state machine, including one-wire transfers
+  TRACE_FILTER,  // probe low pass filters
+  TRACE_PID,     // main PID compute
+  TRACE_FRIDGE,  // fridge state machine and heat PID
+  TRACE_LOG,     // log record
+  TRACE_LCD,     // display frame, drawing and flush
+  TRACE_LOOP,    // one loop() pass
+  TRACE_JITTER,  // main PID release: start time minus deadline
+  TRACE_WDT,     // time between watchdog kicks
+  traceStages
+};
+
+const byte traceVersion = 1;
+const byte traceBuckets = 24;          // last bucket: >= 2^22 us (4.2 s)
+const byte traceSync[2] = { 'n', 'T' };
+const byte traceFramePayload = 32;
+const byte traceFrameMax = traceFramePayload + 5;  // fits the 63 byte UART buffer
+const byte traceHeaderSize = 12;
+const byte traceStageSize = 16 + 2 * traceBuckets;
+const unsigned int traceImageSize = traceHeaderSize + traceStages * traceStageSize;
+const char traceDumpCmd = 'T';         // serial command: send a dump
+const char traceClearCmd = 'C';        // serial command: clear the histograms
+
+struct traceHist {
+  unsigned long count;
+  unsigned long max;  // us
+  uint64_t sum;       // us
+  uint16_t buckets[traceBuckets];
+};
+
+struct traceInfo {    // image header
+  byte version, stages, buckets;
+  unsigned long ms;
+  unsigned long watchdogMs;
+};
+
+class tracer {
+    traceHist _hist[traceStages];
+    unsigned long _watchdogMs;
+    unsigned long _dumpMs;
+    unsigned int _sent;  // image bytes sent, while dumping
+    byte _frame;         // next frame index
+    boolean _enabled, _dumping;
+
+    byte _imageByte(unsigned int i);
+
+  public:
+    tracer();
+    void begin(unsigned long watchdogMs);  // start recording; until then record() is a no-op
+    void clear();
+    void record(byte stage, unsigned long us);
+    boolean command(int c);             // serial command byte; true if it was one
+    boolean dumping() { return _dumping; }
+    byte nextFrame(byte* frame);        // next frame of a pending dump (traceFrameMax bytes); returns its length
+    const traceHist& getHist(byte stage) { return _hist[stage]; }
+    static boolean decode(const byte* image, unsigned int size, traceInfo& info, traceHist* hist);  // host side
+};
+
+#if TRACE == true
+extern tracer trace;
+#define TRACE_BEGIN(stage) unsigned long _traceStart##stage = micros()
+#define TRACE_END(stage) trace.record(stage, (uint32_t)(micros() - _traceStart##stage))
+#define TRACE_VALUE(stage, us) trace.record(stage, us)
+#define TRACE_INTERVAL(stage) do { \
+    static unsigned long _traceLast = 0; \
+    unsigned long _traceNow = micros(); \
+    if (_traceLast) trace.record(stage, (uint32_t)(_traceNow - _traceLast)); \
+    _traceLast = _traceNow; \
+  } while (0)
+#else
+#define TRACE_BEGIN(stage)
+#define TRACE_END(stage)
+#define TRACE_VALUE(stage, us)
+#define TRACE_INTERVAL(stage)
+#endif
+
+#endif